@@ -342,7 +342,7 @@ void Engine::drawEntities(const std::shared_ptr<Map> &map)
             }
         }
     }
-    m_unitsRenderer->render(renderTarget_, visibleEntities);
+    m_unitsRenderer->render(renderTarget_, visibleEntities, { firstCol, lastCol, firstRow, lastRow });
     m_unitsRenderer->display(renderTarget_);
 }
 
@@ -90,7 +90,7 @@ IAction::UpdateResult ActionAttack::update(Time time)
             DBG << "this unit can't move...";
             return IAction::UpdateResult::Failed;
         }
-        DBG << unit->debugName << "is too far away" << distance << unit->data()->Combat.MaxRange;
+        DBG << unit->debugName() << "is too far away" << distance << unit->data()->Combat.MaxRange;
 
         std::shared_ptr<ActionMove> moveAction = ActionMove::moveUnitTo(unit, targetUnit);
 
@@ -173,10 +173,9 @@ IAction::UpdateResult ActionAttack::update(Time time)
     } else if (unit->data()->Combat.ProjectileUnitID != -1) {
         spawnMissiles(unit, unit->data()->Combat.ProjectileUnitID, targetUnit);
     } else if (targetUnit) {
-        // Not firing missiles, deal damage directly
-        for (const genie::unit::AttackOrArmor &attack : unit->data()->Combat.Attacks) {
-            targetUnit->receiveAttack(attack, 1.); // todo: damage multiplier from elevation
-        }
+        // Not firing missiles, deal damage directly, same high ground rule as for missiles
+        const DamageTable::Elevation elevation = targetUnit->position().z < unit->position().z ? DamageTable::HighGround : DamageTable::SameLevel;
+        targetUnit->receiveAttack(*unit->data(), unit->player().lock(), elevation);
     } else {
         WARN << "No target unit, and not firing missiles";
         return IAction::UpdateResult::Completed;
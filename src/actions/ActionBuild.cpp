@@ -13,7 +13,7 @@ ActionBuild::ActionBuild(const Unit::Ptr &builder, const Task &task) :
         WARN << "target building gone";
     }
     m_targetBuilding = building;
-    DBG << builder->debugName << "building" << building->debugName;
+    DBG << builder->debugName() << "building" << building->debugName();
 }
 
 ActionBuild::~ActionBuild()
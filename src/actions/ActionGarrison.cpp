@@ -44,7 +44,7 @@ IAction::UpdateResult ActionGarrison::update(Time /*time*/)
     }
 
     target->garrisonedUnits.push_back(unit);
-    unit->garrisonedIn = target;
+    unit->setGarrisonedIn(target);
 
     EventManager::unitGarrisoned(unit.get(), target.get());
 
@@ -25,7 +25,7 @@ ActionGather::ActionGather(const std::shared_ptr<Unit> &unit, const Task &task)
     }
     m_target = target;
     m_resourceType = genie::ResourceType(m_task.data->ResourceIn);
-    DBG << unit->debugName << "gathering from" << target->debugName;
+    DBG << unit->debugName() << "gathering from" << target->debugName();
 
     if (m_task.data->ResourceOut >= 0 && m_task.data->ResourceOut < int(genie::ResourceType::NumberOfTypes)) {
         m_resourceType = genie::ResourceType(m_task.data->ResourceOut);
@@ -69,9 +69,9 @@ IAction::UpdateResult ActionGather::update(Time time)
 
     if (unit->resources[m_resourceType] >= unit->data()->ResourceCapacity || target->resources[m_resourceType] == 0) {
         if (target->resources[m_resourceType] == 0) {
-            DBG << target->debugName << "is empty" << target->resources[m_resourceType];
+            DBG << target->debugName() << "is empty" << target->resources[m_resourceType];
         } else {
-            DBG << unit->debugName << "is full" << unit->resources[m_resourceType] << "/" << unit->data()->ResourceCapacity;
+            DBG << unit->debugName() << "is full" << unit->resources[m_resourceType] << "/" << unit->data()->ResourceCapacity;
         }
 
         return maybeDropOff(unit);
@@ -95,6 +95,7 @@ IAction::UpdateResult ActionGather::update(Time time)
     amount = std::min(amount, target->resources[m_resourceType]);
 
     target->resources[m_resourceType] -= amount;
+    target->wake(); // e. g. farms need to notice when they run out
     unit->resources[m_resourceType] += amount;
 
     return UpdateResult::Updated;
@@ -181,7 +182,7 @@ ActionDropOff::ActionDropOff(const std::shared_ptr<Unit> &unit, const Task &task
     }
     m_target = target;
     m_resourceType = genie::ResourceType(m_task.data->ResourceIn);
-    DBG << unit->debugName << "dropping off" << target->debugName;
+    DBG << unit->debugName() << "dropping off" << target->debugName();
 
     if (m_task.data->ResourceOut >= 0 && m_task.data->ResourceOut < int(genie::ResourceType::NumberOfTypes)) {
         m_resourceType = genie::ResourceType(m_task.data->ResourceOut);
@@ -371,7 +371,7 @@ IAction::UpdateResult ActionMove::update(Time time) noexcept
     }
 
     if (!isPassable(unitPosition.x, unitPosition.y)) {
-        WARN << "we got stuck!" << unit->debugName;
+        WARN << "we got stuck!" << unit->debugName();
         unitPosition = findClosestWalkableBorder(m_destination, unitPosition, 1);
         if (isPassable(unitPosition.x, unitPosition.y)) {
             unitPosition.z = m_map->elevationAt(unitPosition);
@@ -410,7 +410,7 @@ IAction::UpdateResult ActionMove::update(Time time) noexcept
             }
         }
 
-        WARN << "failed to reach target" << unit->debugName;
+        WARN << "failed to reach target" << unit->debugName();
         return UpdateResult::Failed;
     }
 
@@ -434,7 +434,7 @@ IAction::UpdateResult ActionMove::update(Time time) noexcept
     if (m_path.size() == 0) { // NOLINT
         m_targetReached = true;
         if (!isPassable(unitPosition.x, unitPosition.y)) {
-            WARN << "path empty after loop, complete, distance left:" << unitPosition.distance(m_destination) << unit->debugName;
+            WARN << "path empty after loop, complete, distance left:" << unitPosition.distance(m_destination) << unit->debugName();
             return UpdateResult::Failed;
         }
 
@@ -446,7 +446,7 @@ IAction::UpdateResult ActionMove::update(Time time) noexcept
 
     MapPos nextPos = m_path.back();
     if (!isPassable(nextPos.x, nextPos.y)) {
-//        DBG << "next waypoint inaccessible, repathing" << unit->debugName;
+//        DBG << "next waypoint inaccessible, repathing" << unit->debugName();
 
         updatePath();
 
@@ -512,10 +512,10 @@ IAction::UpdateResult ActionMove::update(Time time) noexcept
             unit->setPosition(m_destination);
             return UpdateResult::Completed;
         }
-        DBG << "can't move forward and too far from the destination" << distanceLeft << "finding intermediat path for" << unit->debugName;
+        DBG << "can't move forward and too far from the destination" << distanceLeft << "finding intermediat path for" << unit->debugName();
         DBG << unitPosition << newPos << movement;
 
-        DBG << "can't move forward, finding intermediat path for" << unit->debugName;
+        DBG << "can't move forward, finding intermediat path for" << unit->debugName();
 
         std::vector<MapPos> partial = findPath(unitPosition, nextPos, 1);
         if (partial.size() < 1) {
@@ -576,7 +576,7 @@ IAction::UpdateResult ActionMove::update(Time time) noexcept
 std::shared_ptr<ActionMove> ActionMove::moveUnitTo(const UnitPtr &unit, const Task &task) noexcept
 {
     if (!unit->data()->Speed) {
-        DBG << "Handed unit that can't move" << unit->debugName;
+        DBG << "Handed unit that can't move" << unit->debugName();
         return nullptr;
     }
 
@@ -596,7 +596,7 @@ std::shared_ptr<ActionMove> ActionMove::moveUnitTo(const UnitPtr &unit, const Ta
 std::shared_ptr<ActionMove> ActionMove::moveUnitTo(const Unit::Ptr &unit, MapPos destination, const Task &task) noexcept
 {
     if (!unit->data()->Speed) {
-        DBG << "Handed unit that can't move" << unit->debugName;
+        DBG << "Handed unit that can't move" << unit->debugName();
         return nullptr;
     }
 
@@ -1072,7 +1072,7 @@ void ActionMove::updatePath() noexcept
     }
 
     if (m_path.size() == 0) { // NOLINT
-        DBG << "Failed to find path for" << unit->debugName;
+        DBG << "Failed to find path for" << unit->debugName();
     }
 
     TIME_TICK;
@@ -94,7 +94,7 @@ void IAction::assignTask(const Task &task, const std::shared_ptr<Unit> &unit, co
     }
     case genie::ActionType::Combat: {
         if (target) {
-            DBG << "attacking" << target->debugName;
+            DBG << "attacking" << target->debugName();
         }
 
         if (assignType == AssignType::Replace) {
@@ -1,7 +1,19 @@
 #include "AiPlayer.h"
 
+#include "ai/BasePlanner.h"
 #include "resource/DataManager.h"
 
+#include <algorithm>
+
+AiPlayer::AiPlayer(const int id, const int civId, const std::shared_ptr<Map> &map, const ResourceMap &startingResources) :
+    Player(id, civId, map, startingResources)
+{
+}
+
+AiPlayer::~AiPlayer()
+{
+}
+
 void AiPlayer::addResource(const genie::ResourceType type, float amount)
 {
     float toEscrow = amount * m_escrowPercentages[type] / 100.;
@@ -14,9 +26,48 @@ void AiPlayer::addResource(const genie::ResourceType type, float amount)
 
 bool AiPlayer::canAffordUnitWithEscrow(const int unitId) const
 {
+    REQUIRE(unitId >= 0, return false);
+
+    checkAffordabilityCache();
+    if (m_affordableUnits.isKnown(unitId)) {
+        return m_affordableUnits.isAffordable(unitId);
+    }
+
+    const bool affordable = canAfford(unitCost(unitId));
+    m_affordableUnits.set(unitId, affordable);
+    return affordable;
+}
+
+bool AiPlayer::canAffordResearchWithEscrow(const int researchId) const
+{
+    REQUIRE(researchId >= 0, return false);
+
+    checkAffordabilityCache();
+    if (m_affordableResearch.isKnown(researchId)) {
+        return m_affordableResearch.isAffordable(researchId);
+    }
+
+    const bool affordable = canAfford(researchCost(researchId));
+    m_affordableResearch.set(researchId, affordable);
+    return affordable;
+}
+
+const AiPlayer::Cost &AiPlayer::unitCost(const int unitId) const
+{
+    if (size_t(unitId) >= m_unitCosts.size()) {
+        m_unitCosts.resize(unitId + 1);
+    }
+
+    Cost &cost = m_unitCosts[unitId];
+    if (cost.known) {
+        return cost;
+    }
+    cost = Cost();
+    cost.known = true;
+
     const genie::Unit &unit = civilization.unitData(unitId);
     if (unit.ID == -1 || !unit.Enabled || unit.Creatable.TrainLocationID == -1) {
-        return false;
+        return cost;
     }
 
     for (const genie::Unit::ResourceStorage &res : unit.ResourceStorages) {
@@ -31,23 +82,67 @@ bool AiPlayer::canAffordUnitWithEscrow(const int unitId) const
         default:
             continue;
         }
+        REQUIRE(cost.storageCount < Cost::MaxEntries, break);
 
-        const genie::ResourceType resourceType = genie::ResourceType(res.Type);
+        cost.storage[cost.storageCount++] = { genie::ResourceType(res.Type), float(res.Amount) };
+    }
 
-        int available = resourcesAvailableWithEscrow(genie::ResourceType(resourceType)) - resourcesUsed(genie::ResourceType(res.Type));
-        if (available < res.Amount) {
-            DBG << unit.Name << "Not affordable" << available << res.Amount;
-            return false;
+    for (const genie::Resource<short, short> &res : unit.Creatable.ResourceCosts) {
+        if (!res.Paid) {
+            continue;
         }
+        REQUIRE(cost.paidCount < Cost::MaxEntries, break);
+
+        cost.paid[cost.paidCount++] = { genie::ResourceType(res.Type), float(res.Amount) };
+    }
+
+    cost.valid = true;
+    return cost;
+}
+
+const AiPlayer::Cost &AiPlayer::researchCost(const int researchId) const
+{
+    if (size_t(researchId) >= m_researchCosts.size()) {
+        m_researchCosts.resize(researchId + 1);
     }
 
-    for (const genie::Resource<short, short> &cost : unit.Creatable.ResourceCosts) {
-        if (!cost.Paid) {
+    // The tech data never changes, so these are never invalidated
+    Cost &cost = m_researchCosts[researchId];
+    if (cost.known) {
+        return cost;
+    }
+    cost.known = true;
+
+    const genie::Tech &research = DataManager::Inst().getTech(researchId);
+    for (const genie::Tech::ResearchResourceCost &res : research.ResourceCosts) {
+        if (res.Type < 0) {
             continue;
         }
+        REQUIRE(cost.paidCount < Cost::MaxEntries, break);
 
-        const genie::ResourceType type = genie::ResourceType(cost.Type);
-        if (resourcesAvailableWithEscrow(type) < cost.Amount) {
+        cost.paid[cost.paidCount++] = { genie::ResourceType(res.Type), float(res.Amount) };
+    }
+
+    cost.valid = true;
+    return cost;
+}
+
+bool AiPlayer::canAfford(const Cost &cost) const noexcept
+{
+    if (!cost.valid) {
+        return false;
+    }
+
+    for (int i=0; i<cost.storageCount; i++) {
+        const Cost::Entry &entry = cost.storage[i];
+        if (resourcesAvailableWithEscrow(entry.type) - resourcesUsed(entry.type) < entry.amount) {
+            return false;
+        }
+    }
+
+    for (int i=0; i<cost.paidCount; i++) {
+        const Cost::Entry &entry = cost.paid[i];
+        if (resourcesAvailableWithEscrow(entry.type) < entry.amount) {
             return false;
         }
     }
@@ -55,18 +150,46 @@ bool AiPlayer::canAffordUnitWithEscrow(const int unitId) const
     return true;
 }
 
-bool AiPlayer::canAffordResearchWithEscrow(const int researchId) const
+void AiPlayer::checkAffordabilityCache() const
 {
-    const genie::Tech &research = DataManager::Inst().getTech(researchId);
-    for (const genie::Tech::ResearchResourceCost &cost : research.ResourceCosts) {
-        const genie::ResourceType resourceType = genie::ResourceType(cost.Type);
-        if (resourcesAvailableWithEscrow(resourceType) < cost.Amount) {
-            return false;
+    if (unitDataVersion() != m_cachedUnitDataVersion) {
+        m_cachedUnitDataVersion = unitDataVersion();
+
+        // Costs might have changed, or units have been enabled
+        for (Cost &cost : m_unitCosts) {
+            cost.known = false;
         }
+        m_affordableUnits.clear();
     }
 
-    return true;
+    if (resourcesVersion() != m_cachedResourcesVersion) {
+        m_cachedResourcesVersion = resourcesVersion();
+
+        m_affordableUnits.clear();
+        m_affordableResearch.clear();
+    }
+}
 
+void AiPlayer::AffordabilityCache::set(const int id, const bool canAfford)
+{
+    const size_t word = id / 64;
+    if (word >= known.size()) {
+        known.resize(word + 1, 0);
+        affordable.resize(word + 1, 0);
+    }
+
+    const uint64_t bit = uint64_t(1) << (id % 64);
+    known[word] |= bit;
+    if (canAfford) {
+        affordable[word] |= bit;
+    } else {
+        affordable[word] &= ~bit;
+    }
+}
+
+void AiPlayer::AffordabilityCache::clear() noexcept
+{
+    std::fill(known.begin(), known.end(), 0);
 }
 
 void AiPlayer::onChatMessage(const int sourcePlayer, const int targetPlayer, const std::string &message)
@@ -77,3 +200,15 @@ void AiPlayer::onChatMessage(const int sourcePlayer, const int targetPlayer, con
         return;
     }
 }
+
+ai::BasePlanner *AiPlayer::basePlanner()
+{
+    if (!m_basePlanner) {
+        std::shared_ptr<Map> currentMap = map();
+        if (!currentMap) {
+            return nullptr;
+        }
+        m_basePlanner = std::make_unique<ai::BasePlanner>(currentMap, playerId);
+    }
+    return m_basePlanner.get();
+}
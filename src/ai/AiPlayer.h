@@ -3,15 +3,24 @@
 #include "mechanics/Player.h"
 #include "gen/enums.h"
 
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ai {
+class BasePlanner;
+}
+
 struct AiPlayer : public Player
 {
-    AiPlayer(const int id, const int civId, const std::shared_ptr<Map> &map, const ResourceMap &startingResources = {}) :
-        Player(id, civId, map, startingResources)
-    {}
+    AiPlayer(const int id, const int civId, const std::shared_ptr<Map> &map, const ResourceMap &startingResources = {});
+    ~AiPlayer();
 
     ai::DifficultyLevel difficultyLevel = ai::DifficultyLevel::Moderate;
 
-    // Held in escrow
+    // Held in escrow, always change the available resources after changing
+    // this (like addResource() does) so the affordability cache notices
     ResourceMap m_reserves;
 
     // How much to hold in escrow
@@ -20,20 +29,67 @@ struct AiPlayer : public Player
     void addResource(const genie::ResourceType type, float amount) override;
 
     float resourcesAvailableWithEscrow(const genie::ResourceType type) const {
-        float ret = Player::resourcesAvailable(type);
-
-        ResourceMap::const_iterator it = m_reserves.find(type);
-        if (it != m_reserves.end()) {
-            ret += it->second;
-        }
-
-        return ret;
+        return Player::resourcesAvailable(type) + m_reserves.value(type);
     }
 
-    // meh, duplicating code ish
+    /// Cached until our resources change, the conditions ask a lot
     bool canAffordUnitWithEscrow(const int unitId) const;
     bool canAffordResearchWithEscrow(const int researchId) const;
 
     void onChatMessage(const int sourcePlayer, const int targetPlayer, const std::string &message) override;
+
+    /// Created the first time something wants to build, null if the map is gone
+    ai::BasePlanner *basePlanner();
+
+private:
+    /// What a unit or tech costs, looked up from the data once
+    struct Cost {
+        struct Entry {
+            genie::ResourceType type = genie::ResourceType::InvalidResource;
+            float amount = 0.f;
+        };
+
+        // Nothing costs more than three things in the data
+        static constexpr int MaxEntries = 3;
+
+        std::array<Entry, MaxEntries> paid{}; // taken from the stockpile
+        std::array<Entry, MaxEntries> storage{}; // population etc., compared with what is used
+        uint8_t paidCount = 0;
+        uint8_t storageCount = 0;
+
+        bool known = false;
+        bool valid = false; // false if it can't be created at all
+    };
+
+    /// Two bits per unit or tech id, if we have checked it and if we can afford it
+    struct AffordabilityCache {
+        std::vector<uint64_t> known;
+        std::vector<uint64_t> affordable;
+
+        inline bool isKnown(const int id) const noexcept {
+            return size_t(id / 64) < known.size() && (known[id / 64] & (uint64_t(1) << (id % 64)));
+        }
+        inline bool isAffordable(const int id) const noexcept {
+            return affordable[id / 64] & (uint64_t(1) << (id % 64));
+        }
+        void set(const int id, const bool canAfford);
+        void clear() noexcept;
+    };
+
+    const Cost &unitCost(const int unitId) const;
+    const Cost &researchCost(const int researchId) const;
+    bool canAfford(const Cost &cost) const noexcept;
+    void checkAffordabilityCache() const;
+
+    std::unique_ptr<ai::BasePlanner> m_basePlanner;
+
+    // Indexed by id, grown when something asks
+    mutable std::vector<Cost> m_unitCosts;
+    mutable std::vector<Cost> m_researchCosts;
+
+    mutable AffordabilityCache m_affordableUnits;
+    mutable AffordabilityCache m_affordableResearch;
+    mutable uint32_t m_cachedResourcesVersion = 0;
+    mutable uint32_t m_cachedUnitDataVersion = 0;
 };
 
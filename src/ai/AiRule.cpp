@@ -1,7 +1,9 @@
 #include "AiRule.h"
 
-#include "ai/conditions/Conditions.h"
+#include "ai/AiScript.h"
+#include "ai/AiPlayer.h"
 #include "ai/actions/Actions.h"
+#include "core/Logger.h"
 
 namespace ai {
 
@@ -9,7 +11,7 @@ AiRule::~AiRule()
 {
 }
 
-void ai::AiRule::onConditionSatisfied()
+void AiRule::fire()
 {
     if (!m_owner) {
         WARN << "No script set for rule!";
@@ -20,12 +22,6 @@ void ai::AiRule::onConditionSatisfied()
         return;
     }
 
-    for (const std::shared_ptr<Condition> &condition : m_conditions) {
-        if (!condition->satisfied(this)) {
-            return;
-        }
-    }
-
     DBG << "rule triggered";
 
     for (const std::shared_ptr<Action> &action : m_actions) {
@@ -33,17 +29,6 @@ void ai::AiRule::onConditionSatisfied()
     }
 }
 
-void AiRule::addCondition(const std::shared_ptr<ai::Condition> &condition)
-{
-    if (!condition) {
-        WARN << "Got null condition";
-        return;
-    }
-
-    m_conditions.push_back(condition);
-    condition->connect(Condition::SatisfiedChanged, this, &AiRule::onConditionSatisfied);
-}
-
 void AiRule::addAction(const std::shared_ptr<Action> &action)
 {
     if (!action) {
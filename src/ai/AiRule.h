@@ -2,15 +2,13 @@
 
 #include <memory>
 #include <vector>
-#include "core/SignalEmitter.h"
 
 namespace ai {
 
-struct Condition;
 struct Action;
 struct AiScript;
 
-struct AiRule : public SignalReceiver
+struct AiRule
 {
     AiRule(AiScript *owner) : m_owner(owner) {}
     AiRule() = delete;
@@ -18,14 +16,13 @@ struct AiRule : public SignalReceiver
 
     AiScript *m_owner = nullptr;
 
-    void onConditionSatisfied();
+    /// The conditions are checked by the script's RuleNetwork, this just runs the actions
+    void fire();
 
-    void addCondition(const std::shared_ptr<Condition> &condition);
     void addAction(const std::shared_ptr<Action> &action);
 
 private:
     // should really have unique_ptr, but bison is a pile of shit
-    std::vector<std::shared_ptr<Condition>> m_conditions;
     std::vector<std::shared_ptr<Action>> m_actions;
 };
 
@@ -1,49 +1,115 @@
 #include "AiScript.h"
 
 #include "AiPlayer.h"
+#include "AiRule.h"
+
+#include <algorithm>
 
 namespace ai
 {
 
+AiScript::AiScript(AiPlayer *player, const std::shared_ptr<TimerWheel> &timers) :
+    m_player(player),
+    m_facts(player),
+    m_timers(timers)
+{
+    if (!m_timers) {
+        m_timers = std::make_shared<TimerWheel>();
+        m_ownsTimers = true;
+    }
+}
+
+AiScript::~AiScript()
+{
+    // The timers might be shared, so don't leave callbacks to us around
+    for (const std::pair<const int, TimerWheel::TimerId> &timer : m_activeTimers) {
+        m_timers->cancel(timer.second);
+    }
+}
+
 bool AiScript::update(const Time time)
+{
+    collect();
+    const bool updated = think(time);
+    applyCommands();
+    return updated;
+}
+
+void AiScript::collect()
+{
+    m_facts.collect();
+    takeFiredTimers();
+}
+
+bool AiScript::think(const Time time)
 {
     m_currentTime = time;
 
-    std::vector<Timer>::iterator it = m_activeTimers.begin();
+    // Otherwise whoever owns them advances them on the main thread, and collect() got what fired
+    if (m_ownsTimers) {
+        m_timers->advance(time);
+        takeFiredTimers();
+    }
 
-    bool foundExpired = false;
-    while (it != m_activeTimers.end()) {
-        if (it->time < time) {
+    for (const FiredTimer &timer : m_timerEvents) {
+        if (timer.generation != m_timerGenerations[timer.id]) {
             continue;
         }
-        m_expiredTimers.insert(it->id);
-        it = m_activeTimers.erase(it);
-        foundExpired = true;
+        m_expiredTimers.insert(timer.id);
+        emit(TimerTriggered);
     }
+    m_timerEvents.clear();
 
-    if (foundExpired) {
-        emit(TimerTriggered);
+    // Let the conditions know what changed since last time, and then fire what that satisfied
+    m_facts.publish();
+
+    return m_ruleNetwork.fireAgenda();
+}
+
+void AiScript::applyCommands()
+{
+    if (m_commands.empty()) {
+        return;
+    }
+
+    // Running them might cause events that end up queuing more, those wait until the next time
+    std::vector<Command> commands;
+    commands.swap(m_commands);
+
+    for (const Command &command : commands) {
+        command(m_player);
     }
+}
+
+void AiScript::addRule(const std::shared_ptr<AiRule> &rule, const std::vector<std::shared_ptr<Condition>> &conditions)
+{
+    rules.push_back(rule);
+    m_ruleNetwork.addRule(rule, conditions);
+}
 
-    // TODO: I guess we should loop through our rules here
+void AiScript::disableRule(const AiRule *rule)
+{
+    m_ruleNetwork.removeRule(rule);
 
-    return false;
+    rules.erase(std::remove_if(
+        rules.begin(),
+        rules.end(),
+        [=](const std::shared_ptr<AiRule> &containedRule) {
+            return containedRule.get() == rule;
+        }
+    ), rules.end());
 }
 
 void AiScript::setEscrow(const genie::ResourceType resource, float amount)
 {
-    m_player->m_escrowPercentages[resource] = amount;
-
+    queueCommand([=](AiPlayer *player) {
+        player->m_escrowPercentages[resource] = amount;
+    });
 }
 
 float AiScript::escrowAmount(const genie::ResourceType resource) const
 {
-    ResourceMap::const_iterator escrowIt = m_player->m_reserves.find(resource);
-    if (escrowIt != m_player->m_reserves.end()) {
-        return escrowIt->second;
-    }
-
-    return 0.f;
+    return m_facts.escrow(resource);
 }
 
 void AiScript::showDebugMessage(const std::string &message)
@@ -55,19 +121,44 @@ void AiScript::showDebugMessage(const std::string &message)
 
 void AiScript::addTimer(const int id, const Time targetTime)
 {
-    Timer timer;
-    timer.id = id;
-    timer.time = targetTime;
-    m_activeTimers.push_back(timer);
+    // Setting it again starts it over
+    const uint32_t generation = ++m_timerGenerations[id];
     m_expiredTimers.erase(id);
+
+    queueCommand([this, id, targetTime, generation](AiPlayer *) {
+        std::unordered_map<int, TimerWheel::TimerId>::iterator it = m_activeTimers.find(id);
+        if (it != m_activeTimers.end()) {
+            m_timers->cancel(it->second);
+        }
+        m_activeTimers[id] = m_timers->arm(targetTime, [this, id, generation]() { onTimerExpired(id, generation); });
+    });
 }
 
 void AiScript::disableTimer(const int id)
 {
-    // holy shit I hate STL, why can't this be simple and readable...
-    std::erase_if(m_activeTimers, [=](const Timer &timer){
-        return timer.id == id;
+    m_timerGenerations[id]++;
+
+    queueCommand([this, id](AiPlayer *) {
+        std::unordered_map<int, TimerWheel::TimerId>::iterator it = m_activeTimers.find(id);
+        if (it == m_activeTimers.end()) {
+            return;
+        }
+        m_timers->cancel(it->second);
+        m_activeTimers.erase(it);
     });
 }
 
+void AiScript::onTimerExpired(const int id, const uint32_t generation)
+{
+    // Called from the wheel, so from the main thread if it's shared, think() looks at it
+    m_activeTimers.erase(id);
+    m_firedTimers.push_back({id, generation});
+}
+
+void AiScript::takeFiredTimers()
+{
+    m_timerEvents.insert(m_timerEvents.end(), m_firedTimers.begin(), m_firedTimers.end());
+    m_firedTimers.clear();
+}
+
 } // namespace ai
@@ -1,11 +1,15 @@
 #pragma once
 
+#include "ai/FactTable.h"
+#include "ai/RuleNetwork.h"
 #include "ai/gen/enums.h"
 #include "core/SignalEmitter.h"
+#include "core/TimerWheel.h"
 #include "core/Types.h"
 
 #include <genie/dat/ResourceType.h>
 
+#include <functional>
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
@@ -16,6 +20,7 @@ struct AiPlayer;
 namespace ai {
 
 struct AiRule;
+struct Condition;
 
 struct AiScript : public SignalEmitter<AiScript>
 {
@@ -26,15 +31,38 @@ struct AiScript : public SignalEmitter<AiScript>
         SignalCount
     };
 
-    AiScript(AiPlayer *player) : m_player(player) { }
+    /// If there are no shared timers (e. g. when testing scripts) it has its own and advances them in think()
+    AiScript(AiPlayer *player, const std::shared_ptr<TimerWheel> &timers = nullptr);
     AiScript() = delete;
+    ~AiScript();
 
+    /// Everything below in one go, for when it all runs on the main thread
     bool update(const Time time);
 
+    /// Main thread, before think(). Reads the game for the facts, and picks up
+    /// the timers that fired in the shared wheel.
+    void collect();
+
+    /// Checks the rules and runs the actions, doesn't touch the game so it
+    /// can run on another thread
+    bool think(const Time time);
+
+    /// Main thread, runs what the actions queued up
+    void applyCommands();
+
+    /// Anything that changes the game goes through this
+    typedef std::function<void(AiPlayer *player)> Command;
+    void queueCommand(Command &&command) { m_commands.push_back(std::move(command)); }
+
     std::unordered_map<StrategicNumberName, int> strategicNumbers;
 
     std::vector<std::shared_ptr<AiRule>> rules;
 
+    void addRule(const std::shared_ptr<AiRule> &rule, const std::vector<std::shared_ptr<Condition>> &conditions);
+    void disableRule(const AiRule *rule);
+    const RuleNetwork &ruleNetwork() const { return m_ruleNetwork; }
+
+    FactTable *facts() { return &m_facts; }
 
     AiPlayer *m_player = nullptr;
 
@@ -53,6 +81,8 @@ struct AiScript : public SignalEmitter<AiScript>
 
     void showDebugMessage(const std::string &message);
 
+    /// The wheel itself is only touched from applyCommands(), so these are
+    /// fine to call from think()
     void addTimer(const int id, const Time targetTime);
 
     void disableTimer(const int id);
@@ -60,15 +90,38 @@ struct AiScript : public SignalEmitter<AiScript>
     bool hasTimerExpired(const int id) { return m_expiredTimers.count(id) > 0; }
 
 private:
-    struct Timer {
-        int id = -1;
-        Time time = 0;
+    struct FiredTimer {
+        int id;
+        uint32_t generation;
     };
-    std::vector<Timer> m_activeTimers;
+
+    void onTimerExpired(const int id, const uint32_t generation);
+    void takeFiredTimers();
+
+    FactTable m_facts;
+
+    // After the facts, the conditions in it look at them
+    RuleNetwork m_ruleNetwork;
+
+    std::shared_ptr<TimerWheel> m_timers;
+    bool m_ownsTimers = false;
+
+    // Script timer id -> timer in the wheel, only touched where the wheel is
+    std::unordered_map<int, TimerWheel::TimerId> m_activeTimers;
+
+    // Where the wheel callbacks put what fired, collect() hands it over
+    std::vector<FiredTimer> m_firedTimers;
+
+    // What think() looks at. Bumped every time a timer is set or disabled, so
+    // if it fired before the wheel heard about that it's ignored.
+    std::vector<FiredTimer> m_timerEvents;
+    std::unordered_map<int, uint32_t> m_timerGenerations;
     std::unordered_set<int> m_expiredTimers;
 
     std::unordered_map<int, int> m_goals;
     Time m_currentTime = -1;
+
+    std::vector<Command> m_commands;
 };
 
 } // namespace ai
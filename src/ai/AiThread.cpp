@@ -0,0 +1,112 @@
+#include "AiThread.h"
+
+#include "ai/AiScript.h"
+#include "core/Logger.h"
+
+namespace ai {
+
+AiThread::AiThread(const int threadCount)
+{
+    for (int i=0; i<threadCount; i++) {
+        m_workers.emplace_back(&AiThread::run, this);
+    }
+}
+
+AiThread::~AiThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_workAvailable.notify_all();
+
+    for (std::thread &worker : m_workers) {
+        worker.join();
+    }
+}
+
+void AiThread::addScript(const std::shared_ptr<AiScript> &script)
+{
+    REQUIRE(script, return);
+
+    // Can't change the list while the workers are going through it
+    finish();
+
+    m_scripts.push_back(script);
+}
+
+void AiThread::update(const Time time)
+{
+    finish();
+
+    for (const std::shared_ptr<AiScript> &script : m_scripts) {
+        script->collect();
+    }
+
+    if (m_workers.empty()) {
+        for (const std::shared_ptr<AiScript> &script : m_scripts) {
+            script->think(time);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_time = time;
+        m_nextScript = 0;
+        m_scriptsDone = 0;
+        m_inFlight = true;
+        m_tick++;
+    }
+    m_workAvailable.notify_all();
+}
+
+void AiThread::finish()
+{
+    if (!m_workers.empty()) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_workDone.wait(lock, [this]() {
+            return !m_inFlight || m_scriptsDone == m_scripts.size();
+        });
+        m_inFlight = false;
+    }
+
+    // Always in the same order, so it doesn't matter which worker was fastest
+    for (const std::shared_ptr<AiScript> &script : m_scripts) {
+        script->applyCommands();
+    }
+}
+
+void AiThread::run()
+{
+    uint64_t lastTick = 0;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_workAvailable.wait(lock, [&]() {
+            return m_quit || m_tick != lastTick;
+        });
+        if (m_quit) {
+            return;
+        }
+        lastTick = m_tick;
+
+        // Whoever is free takes the next one
+        while (m_nextScript < m_scripts.size()) {
+            AiScript *script = m_scripts[m_nextScript++].get();
+            const Time time = m_time;
+
+            lock.unlock();
+            script->think(time);
+            lock.lock();
+
+            m_scriptsDone++;
+        }
+
+        if (m_scriptsDone == m_scripts.size()) {
+            m_workDone.notify_all();
+        }
+    }
+}
+
+} // namespace ai
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "core/Types.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ai {
+
+struct AiScript;
+
+/// Runs the AI scripts on worker threads, so they don't eat into the frame
+/// time on the main thread.
+///
+/// update() first waits for the scripts to be done with the previous tick
+/// and runs the commands they queued (in the order the scripts were added),
+/// then lets the fact tables read the game, and hands the scripts to the
+/// workers while the main thread continues with the rest of the tick. So
+/// what an AI does always lands exactly one tick after what it saw, no
+/// matter how fast the workers are.
+///
+/// Timers in a shared TimerWheel fire on the main thread when the wheel is
+/// advanced, the scripts pick up what fired when they read the facts. The
+/// workers never touch the wheel, the scripts arm and cancel through commands.
+class AiThread
+{
+public:
+    /// With 0 threads it all runs in update(), for comparing and debugging
+    AiThread(const int threadCount = 1);
+    ~AiThread();
+
+    AiThread(const AiThread &) = delete;
+    const AiThread &operator=(const AiThread &) = delete;
+
+    void addScript(const std::shared_ptr<AiScript> &script);
+
+    /// Call once per game tick from the main thread
+    void update(const Time time);
+
+    /// Waits for the scripts to be done and applies what they queued
+    void finish();
+
+private:
+    void run();
+
+    std::vector<std::shared_ptr<AiScript>> m_scripts;
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_workDone;
+
+    // All protected by the mutex
+    Time m_time = 0;
+    uint64_t m_tick = 0; // bumped every time there's something for the workers
+    size_t m_nextScript = 0;
+    size_t m_scriptsDone = 0;
+    bool m_inFlight = false;
+    bool m_quit = false;
+};
+
+} // namespace ai
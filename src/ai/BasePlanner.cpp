@@ -0,0 +1,391 @@
+#include "BasePlanner.h"
+
+#include <genie/dat/Unit.h>
+
+#include "ai/Ids.h"
+#include "core/Logger.h"
+#include "global/EventManager.h"
+#include "mechanics/BuildabilityMap.h"
+#include "mechanics/Map.h"
+#include "mechanics/Unit.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ai {
+
+namespace {
+
+static constexpr float Excluded = std::numeric_limits<float>::lowest();
+
+// All in tiles
+static constexpr float GenericDistance = 12.f;
+static constexpr float HousingDistance = 8.f;
+static constexpr float WallMargin = 2.f;
+static constexpr float MinDropSiteSpacing = 6.f;
+static constexpr float MaxCoverageDistance = 16.f;
+
+// How far a drop site changes the scores around it
+static constexpr int CoverageCells = int(MaxCoverageDistance) / BasePlanner::CellSize + 1;
+
+} // namespace
+
+BasePlanner::BasePlanner(const std::shared_ptr<Map> &map, const int playerId) :
+    m_map(map),
+    m_playerId(playerId),
+    m_cells(GridSize * GridSize),
+    m_dirty(GridSize * GridSize, true),
+    m_townCenterIds(unitIds(Building::TownCenter)),
+    m_lumberCampIds(unitIds(Building::LumberCamp)),
+    m_miningCampIds(unitIds(Building::MiningCamp)),
+    m_millIds(unitIds(Building::Mill))
+{
+    for (std::vector<float> &scores : m_scores) {
+        scores.resize(GridSize * GridSize, Excluded);
+    }
+
+    EventManager::registerListener(this, EventManager::UnitCreated);
+    EventManager::registerListener(this, EventManager::UnitDestroyed);
+    EventManager::registerListener(this, EventManager::UnitChangedOwner);
+    EventManager::registerListener(this, EventManager::UnitCaptured);
+
+    // Pick up whatever is already there, the map is usually populated before the AI starts
+    REQUIRE(map, return);
+    for (int row = 0; row < map->rowCount(); row++) {
+        for (int col = 0; col < map->columnCount(); col++) {
+            for (const std::weak_ptr<Entity> &entity : map->entitiesAt(col, row)) {
+                std::shared_ptr<::Unit> unit = ::Unit::fromEntity(entity);
+                if (!unit) {
+                    continue;
+                }
+                updateUnit(*unit, unit->playerId(), 1);
+            }
+        }
+    }
+}
+
+BasePlanner::~BasePlanner()
+{
+}
+
+BasePlanner::PlacementKind BasePlanner::placementKind(const Building building)
+{
+    switch(building) {
+    case Building::House:
+        return Housing;
+    case Building::LumberCamp:
+        return WoodDropSite;
+    case Building::MiningCamp:
+        return MiningDropSite;
+    case Building::Mill:
+        return FoodDropSite;
+    default:
+        return Generic;
+    }
+}
+
+bool BasePlanner::findPlacement(const genie::Unit &data, const PlacementKind kind, MapPos *position)
+{
+    REQUIRE(kind >= 0 && kind < PlacementKindCount, return false);
+
+    std::shared_ptr<Map> map = m_map.lock();
+    REQUIRE(map, return false);
+
+    updateScores();
+
+    const std::vector<float> &scores = m_scores[kind];
+    std::vector<int> candidates;
+    for (int y = 0; y < m_rows; y++) {
+        for (int x = 0; x < m_columns; x++) {
+            const int index = y * GridSize + x;
+            if (scores[index] != Excluded) {
+                candidates.push_back(index);
+            }
+        }
+    }
+
+    // Ties go to the lowest index, so we always pick the same spot for the same map
+    const size_t candidateCount = std::min(candidates.size(), size_t(MaxCandidateCells));
+    std::partial_sort(candidates.begin(), candidates.begin() + candidateCount, candidates.end(), [&](const int a, const int b) {
+        if (scores[a] != scores[b]) {
+            return scores[a] > scores[b];
+        }
+        return a < b;
+    });
+
+    BuildabilityMap &buildability = map->buildability();
+    for (size_t i = 0; i < candidateCount; i++) {
+        const int cellX = candidates[i] % GridSize;
+        const int cellY = candidates[i] / GridSize;
+
+        TileRect region;
+        region.firstX = cellX * CellSize;
+        region.firstY = cellY * CellSize;
+        region.lastX = std::min(region.firstX + CellSize, map->columnCount()) - 1;
+        region.lastY = std::min(region.firstY + CellSize, map->rowCount()) - 1;
+
+        for (const MapPos &candidate : buildability.findPlacements(data, region)) {
+            // Leave a free tile all around so villagers can still walk between buildings
+            TileRect surroundings = BuildabilityMap::obstructionTiles(data, candidate);
+            surroundings.firstX--;
+            surroundings.firstY--;
+            surroundings.lastX++;
+            surroundings.lastY++;
+            if (buildability.isObstructed(surroundings)) {
+                continue;
+            }
+
+            *position = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void BasePlanner::setWallRadius(const int radius)
+{
+    if (radius == m_wallRadius) {
+        return;
+    }
+    m_wallRadius = radius;
+    m_allDirty = true;
+}
+
+void BasePlanner::onUnitCreated(::Unit *unit)
+{
+    updateUnit(*unit, unit->playerId(), 1);
+}
+
+void BasePlanner::onUnitDying(::Unit *unit)
+{
+    updateUnit(*unit, unit->playerId(), -1);
+}
+
+void BasePlanner::onUnitOwnerChanged(::Unit *unit, int oldPlayerId, int newPlayerId)
+{
+    if (oldPlayerId != m_playerId && newPlayerId != m_playerId) {
+        return;
+    }
+    updateUnit(*unit, oldPlayerId, -1);
+    updateUnit(*unit, newPlayerId, 1);
+}
+
+void BasePlanner::onUnitCaptured(::Unit *unit, int oldPlayerId, int newPlayerId)
+{
+    onUnitOwnerChanged(unit, oldPlayerId, newPlayerId);
+}
+
+void BasePlanner::updateUnit(const ::Unit &unit, const int playerId, const int delta)
+{
+    const genie::Unit *data = unit.data();
+    if (!data) {
+        return;
+    }
+
+    const MapPos tile = unit.position() / Constants::TILE_SIZE;
+    const int cellX = tile.x / CellSize;
+    const int cellY = tile.y / CellSize;
+    if (cellX < 0 || cellY < 0 || cellX >= GridSize || cellY >= GridSize) {
+        return;
+    }
+
+    // Doesn't matter who owns the trees
+    const int resource = resourceKind(*data);
+    if (resource >= 0) {
+        int16_t &count = m_cells[cellY * GridSize + cellX].resources[resource];
+        count = std::max(count + delta, 0);
+        markDirty(cellX, cellY, ResourceRadius);
+    }
+
+    if (playerId != m_playerId) {
+        return;
+    }
+
+    if (m_townCenterIds.count(data->ID)) {
+        // The town center takes everything, and everything is placed around it
+        updateSites(&m_townCenters, tile, delta);
+        for (std::vector<MapPos> &sites : m_dropSites) {
+            updateSites(&sites, tile, delta);
+        }
+        m_allDirty = true;
+    } else if (m_lumberCampIds.count(data->ID)) {
+        updateSites(&m_dropSites[Wood], tile, delta);
+        markDirty(cellX, cellY, CoverageCells);
+    } else if (m_miningCampIds.count(data->ID)) {
+        updateSites(&m_dropSites[Gold], tile, delta);
+        updateSites(&m_dropSites[Stone], tile, delta);
+        markDirty(cellX, cellY, CoverageCells);
+    } else if (m_millIds.count(data->ID)) {
+        updateSites(&m_dropSites[Food], tile, delta);
+        markDirty(cellX, cellY, CoverageCells);
+    }
+}
+
+void BasePlanner::updateSites(std::vector<MapPos> *sites, const MapPos &position, const int delta)
+{
+    if (delta > 0) {
+        sites->push_back(position);
+        return;
+    }
+
+    std::vector<MapPos>::iterator it = std::find(sites->begin(), sites->end(), position);
+    REQUIRE(it != sites->end(), return);
+    *it = sites->back();
+    sites->pop_back();
+}
+
+void BasePlanner::markDirty(const int cellX, const int cellY, const int radius)
+{
+    if (m_allDirty) {
+        return;
+    }
+
+    for (int y = std::max(cellY - radius, 0); y <= std::min(cellY + radius, GridSize - 1); y++) {
+        for (int x = std::max(cellX - radius, 0); x <= std::min(cellX + radius, GridSize - 1); x++) {
+            m_dirty[y * GridSize + x] = true;
+        }
+    }
+}
+
+void BasePlanner::updateScores()
+{
+    std::shared_ptr<Map> map = m_map.lock();
+    REQUIRE(map, return);
+
+    // The map might have been recreated with a different size
+    const int columns = (map->columnCount() + CellSize - 1) / CellSize;
+    const int rows = (map->rowCount() + CellSize - 1) / CellSize;
+    if (columns != m_columns || rows != m_rows) {
+        m_columns = std::min(columns, GridSize);
+        m_rows = std::min(rows, GridSize);
+        m_allDirty = true;
+    }
+
+    for (int y = 0; y < m_rows; y++) {
+        for (int x = 0; x < m_columns; x++) {
+            const int index = y * GridSize + x;
+            if (!m_allDirty && !m_dirty[index]) {
+                continue;
+            }
+            for (int kind = 0; kind < PlacementKindCount; kind++) {
+                m_scores[kind][index] = score(PlacementKind(kind), x, y);
+            }
+            m_dirty[index] = false;
+        }
+    }
+
+    m_allDirty = false;
+}
+
+float BasePlanner::score(const PlacementKind kind, const int cellX, const int cellY) const
+{
+    const MapPos center((cellX + 0.5f) * CellSize, (cellY + 0.5f) * CellSize);
+
+    // Without a town center there's nothing to plan around, so just don't care about the distance
+    const bool hasTownCenter = !m_townCenters.empty();
+    const float townCenterDistance = hasTownCenter ? closestDistance(m_townCenters, center) : 0.f;
+    const bool isDropSite = kind == WoodDropSite || kind == MiningDropSite || kind == FoodDropSite;
+
+    if (hasTownCenter && m_wallRadius > 0) {
+        if (std::abs(townCenterDistance - m_wallRadius) <= WallMargin) {
+            return Excluded;
+        }
+
+        // Only drop sites are worth putting outside the walls
+        if (!isDropSite && townCenterDistance > m_wallRadius) {
+            return Excluded;
+        }
+    }
+
+    switch(kind) {
+    case Generic:
+        return hasTownCenter ? -std::abs(townCenterDistance - GenericDistance) : 0.f;
+    case Housing:
+        return hasTownCenter ? -std::abs(townCenterDistance - HousingDistance) : 0.f;
+    default:
+        break;
+    }
+
+    ResourceKind resources[2] = { ResourceKindCount, ResourceKindCount };
+    switch(kind) {
+    case WoodDropSite:
+        resources[0] = Wood;
+        break;
+    case MiningDropSite:
+        resources[0] = Gold;
+        resources[1] = Stone;
+        break;
+    case FoodDropSite:
+        resources[0] = Food;
+        break;
+    default:
+        WARN << "Unhandled placement kind" << kind;
+        return Excluded;
+    }
+
+    float best = Excluded;
+    for (const ResourceKind resource : resources) {
+        if (resource == ResourceKindCount) {
+            continue;
+        }
+
+        const int amount = resourcesAround(resource, cellX, cellY);
+        if (amount == 0) {
+            continue;
+        }
+
+        // The resources closer to an existing drop site are already covered
+        float coverage = 1.f;
+        if (!m_dropSites[resource].empty()) {
+            const float distance = closestDistance(m_dropSites[resource], center);
+            if (distance < MinDropSiteSpacing) {
+                continue;
+            }
+            coverage = std::min(distance, MaxCoverageDistance) / MaxCoverageDistance;
+        }
+
+        best = std::max(best, amount * coverage - townCenterDistance * 0.5f);
+    }
+
+    return best;
+}
+
+int BasePlanner::resourcesAround(const ResourceKind kind, const int cellX, const int cellY) const
+{
+    int ret = 0;
+    for (int y = std::max(cellY - ResourceRadius, 0); y <= std::min(cellY + ResourceRadius, GridSize - 1); y++) {
+        for (int x = std::max(cellX - ResourceRadius, 0); x <= std::min(cellX + ResourceRadius, GridSize - 1); x++) {
+            ret += m_cells[y * GridSize + x].resources[kind];
+        }
+    }
+    return ret;
+}
+
+float BasePlanner::closestDistance(const std::vector<MapPos> &sites, const MapPos &position)
+{
+    float ret = std::numeric_limits<float>::max();
+    for (const MapPos &site : sites) {
+        ret = std::min(ret, std::hypot(site.x - position.x, site.y - position.y));
+    }
+    return ret;
+}
+
+int BasePlanner::resourceKind(const genie::Unit &data)
+{
+    switch(data.Class) {
+    case genie::Unit::Tree:
+        return Wood;
+    case genie::Unit::GoldMine:
+        return Gold;
+    case genie::Unit::StoneMine:
+        return Stone;
+    case genie::Unit::BerryBush:
+        return Food;
+    default:
+        return -1;
+    }
+}
+
+} // namespace ai
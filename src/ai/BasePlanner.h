@@ -0,0 +1,120 @@
+#pragma once
+
+#include "ai/gen/enums.h"
+#include "core/Constants.h"
+#include "core/Types.h"
+#include "global/EventListener.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+class Map;
+
+namespace genie {
+class Unit;
+}
+
+namespace ai {
+
+/// Decides where an AI player puts its buildings.
+///
+/// The map is split into cells of CellSize x CellSize tiles, and each cell
+/// has a score per kind of building: drop sites want lots of their resource
+/// around that isn't already close to another drop site, houses and the rest
+/// want to be at a reasonable distance from the town center, and nothing
+/// goes on the line where the wall is planned. The unit events keep the
+/// counts up to date, and only the cells near what changed are scored again.
+///
+/// Finding a spot then just goes through the best cells and asks the
+/// BuildabilityMap where the building fits in each, and only takes spots
+/// that leave a free tile around the building so we don't wall ourselves in.
+class BasePlanner : public EventListener
+{
+public:
+    enum PlacementKind {
+        Generic,
+        Housing,
+        WoodDropSite,
+        MiningDropSite,
+        FoodDropSite,
+        PlacementKindCount
+    };
+
+    static constexpr int CellSize = 4;
+    static constexpr int GridSize = (Constants::MAP_MAX_SIZE + CellSize - 1) / CellSize;
+
+    BasePlanner(const std::shared_ptr<Map> &map, const int playerId);
+    ~BasePlanner();
+
+    BasePlanner(const BasePlanner &) = delete;
+    const BasePlanner &operator=(const BasePlanner &) = delete;
+
+    static PlacementKind placementKind(const Building building);
+
+    /// Returns false if there's nowhere good to put it
+    bool findPlacement(const genie::Unit &data, const PlacementKind kind, MapPos *position);
+
+    /// In tiles from the town center, 0 if we're not walling
+    void setWallRadius(const int radius);
+
+private:
+    enum ResourceKind {
+        Wood,
+        Gold,
+        Stone,
+        Food,
+        ResourceKindCount
+    };
+
+    // How far (in cells) the resources count for a drop site
+    static constexpr int ResourceRadius = 2;
+
+    // Only look at this many of the best cells before giving up
+    static constexpr int MaxCandidateCells = 32;
+
+    struct Cell {
+        std::array<int16_t, ResourceKindCount> resources{};
+    };
+
+    void onUnitCreated(::Unit *unit) override;
+    void onUnitDying(::Unit *unit) override;
+    void onUnitOwnerChanged(::Unit *unit, int oldPlayerId, int newPlayerId) override;
+    void onUnitCaptured(::Unit *unit, int oldPlayerId, int newPlayerId) override;
+
+    void updateUnit(const ::Unit &unit, const int playerId, const int delta);
+    void updateSites(std::vector<MapPos> *sites, const MapPos &position, const int delta);
+
+    void markDirty(const int cellX, const int cellY, const int radius);
+    void updateScores();
+    float score(const PlacementKind kind, const int cellX, const int cellY) const;
+
+    int resourcesAround(const ResourceKind kind, const int cellX, const int cellY) const;
+    static float closestDistance(const std::vector<MapPos> &sites, const MapPos &position);
+    static int resourceKind(const genie::Unit &data);
+
+    std::weak_ptr<Map> m_map;
+    const int m_playerId;
+    int m_wallRadius = 0;
+
+    int m_columns = 0;
+    int m_rows = 0;
+
+    std::vector<Cell> m_cells;
+    std::array<std::vector<float>, PlacementKindCount> m_scores;
+    std::vector<bool> m_dirty;
+    bool m_allDirty = true;
+
+    // Our own, in map coordinates
+    std::vector<MapPos> m_townCenters;
+    std::array<std::vector<MapPos>, ResourceKindCount> m_dropSites;
+
+    const std::unordered_set<int> m_townCenterIds;
+    const std::unordered_set<int> m_lumberCampIds;
+    const std::unordered_set<int> m_miningCampIds;
+    const std::unordered_set<int> m_millIds;
+};
+
+} // namespace ai
@@ -0,0 +1,311 @@
+#include "CompiledScript.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "ai/ScriptLoader.h"
+#include "core/Logger.h"
+#include "global/Config.h"
+
+namespace ai {
+
+namespace {
+
+static constexpr uint32_t Magic = 0x43494146; // FAIC
+
+template<typename T>
+inline void writeValue(std::ostream &out, const T &value)
+{
+    static_assert(std::is_trivially_copyable<T>());
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+inline bool readValue(std::istream &in, T *value)
+{
+    static_assert(std::is_trivially_copyable<T>());
+    return bool(in.read(reinterpret_cast<char*>(value), sizeof(T)));
+}
+
+// The counts come straight from the file, so check that it actually has that
+// much left before allocating anything for it (or a broken file can make us
+// try to allocate gigabytes)
+bool hasBytesLeft(std::istream &in, const uint64_t needed)
+{
+    const std::istream::pos_type current = in.tellg();
+    if (current == std::istream::pos_type(-1)) {
+        return false;
+    }
+
+    in.seekg(0, std::ios::end);
+    const std::istream::pos_type end = in.tellg();
+    in.seekg(current);
+
+    return end != std::istream::pos_type(-1) && uint64_t(end - current) >= needed;
+}
+
+void writeCalls(std::ostream &out, const std::vector<CompiledScript::Call> &calls)
+{
+    writeValue(out, uint32_t(calls.size()));
+    for (const CompiledScript::Call &call : calls) {
+        writeValue(out, call.type);
+        writeValue(out, call.arguments);
+    }
+}
+
+bool readCalls(std::istream &in, std::vector<CompiledScript::Call> *calls)
+{
+    uint32_t count = 0;
+    if (!readValue(in, &count)) {
+        return false;
+    }
+    if (!hasBytesLeft(in, uint64_t(count) * (sizeof(CompiledScript::Call::type) + sizeof(CompiledScript::Call::arguments)))) {
+        return false;
+    }
+    calls->resize(count);
+    for (CompiledScript::Call &call : *calls) {
+        if (!readValue(in, &call.type) || !readValue(in, &call.arguments)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename T>
+void writeVector(std::ostream &out, const std::vector<T> &values)
+{
+    writeValue(out, uint32_t(values.size()));
+    for (const T &value : values) {
+        writeValue(out, value);
+    }
+}
+
+template<typename T>
+bool readVector(std::istream &in, std::vector<T> *values)
+{
+    uint32_t count = 0;
+    if (!readValue(in, &count)) {
+        return false;
+    }
+    if (!hasBytesLeft(in, uint64_t(count) * sizeof(T))) {
+        return false;
+    }
+    values->resize(count);
+    for (T &value : *values) {
+        if (!readValue(in, &value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool CompiledScript::write(std::ostream &out) const
+{
+    writeValue(out, Magic);
+    writeValue(out, FormatVersion);
+
+    writeCalls(out, conditions);
+    writeCalls(out, actions);
+
+    writeValue(out, uint32_t(strings.size()));
+    for (const std::string &string : strings) {
+        writeValue(out, uint32_t(string.size()));
+        out.write(string.data(), string.size());
+    }
+
+    writeVector(out, ruleConditions);
+    writeVector(out, ruleActions);
+    writeVector(out, rules);
+
+    return bool(out);
+}
+
+bool CompiledScript::read(std::istream &in)
+{
+    uint32_t magic = 0, version = 0;
+    if (!readValue(in, &magic) || !readValue(in, &version)) {
+        return false;
+    }
+    if (magic != Magic || version != FormatVersion) {
+        return false;
+    }
+
+    if (!readCalls(in, &conditions) || !readCalls(in, &actions)) {
+        return false;
+    }
+
+    uint32_t stringCount = 0;
+    if (!readValue(in, &stringCount)) {
+        return false;
+    }
+    if (!hasBytesLeft(in, uint64_t(stringCount) * sizeof(uint32_t))) {
+        return false;
+    }
+    strings.resize(stringCount);
+    for (std::string &string : strings) {
+        uint32_t length = 0;
+        if (!readValue(in, &length)) {
+            return false;
+        }
+        if (!hasBytesLeft(in, length)) {
+            return false;
+        }
+        string.resize(length);
+        if (!in.read(string.data(), length)) {
+            return false;
+        }
+    }
+
+    if (!readVector(in, &ruleConditions) || !readVector(in, &ruleActions) || !readVector(in, &rules)) {
+        return false;
+    }
+
+    // Don't trust it blindly, it's just a file on disk
+    for (const Rule &rule : rules) {
+        if (size_t(rule.firstCondition) + rule.conditionCount > ruleConditions.size()) {
+            return false;
+        }
+        if (size_t(rule.firstAction) + rule.actionCount > ruleActions.size()) {
+            return false;
+        }
+    }
+    for (const uint32_t condition : ruleConditions) {
+        if (condition >= conditions.size()) {
+            return false;
+        }
+    }
+    for (const uint32_t action : ruleActions) {
+        if (action >= actions.size()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::mutex ScriptCache::s_mutex;
+std::unordered_map<uint64_t, std::weak_ptr<const CompiledScript>> ScriptCache::s_scripts;
+
+std::shared_ptr<const CompiledScript> ScriptCache::load(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.good()) {
+        WARN << "Failed to open AI script" << path;
+        return nullptr;
+    }
+
+    std::ostringstream contents;
+    contents << file.rdbuf();
+
+    return compile(contents.str());
+}
+
+std::shared_ptr<const CompiledScript> ScriptCache::compile(const std::string &source)
+{
+    const uint64_t sourceHash = hash(source);
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    std::shared_ptr<const CompiledScript> script = s_scripts[sourceHash].lock();
+    if (script) {
+        return script;
+    }
+
+    script = loadCacheFile(sourceHash);
+    if (!script) {
+        ScriptLoader loader;
+        std::istringstream in(source);
+        std::ostringstream debugOutput;
+        if (loader.parse(in, debugOutput) != 0) {
+            WARN << "Failed to parse AI script";
+            return nullptr;
+        }
+        script = loader.result();
+        writeCacheFile(sourceHash, *script);
+    }
+
+    s_scripts[sourceHash] = script;
+    return script;
+}
+
+uint64_t ScriptCache::hash(const std::string &source) noexcept
+{
+    // FNV-1a, with the format version so old cache files aren't used
+    uint64_t ret = 14695981039346656037ULL ^ CompiledScript::FormatVersion;
+    for (const char c : source) {
+        ret ^= uint8_t(c);
+        ret *= 1099511628211ULL;
+    }
+    return ret;
+}
+
+std::string ScriptCache::cacheFilePath(const uint64_t hash)
+{
+    const std::string &cachePath = Config::Inst().cachePath();
+    if (cachePath.empty()) {
+        return {};
+    }
+
+    std::ostringstream path;
+    path << cachePath << "ai/" << std::hex << std::setw(16) << std::setfill('0') << hash << ".aic";
+    return path.str();
+}
+
+std::shared_ptr<const CompiledScript> ScriptCache::loadCacheFile(const uint64_t hash)
+{
+    const std::string path = cacheFilePath(hash);
+    if (path.empty()) {
+        return nullptr;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.good()) {
+        return nullptr;
+    }
+
+    std::shared_ptr<CompiledScript> script = std::make_shared<CompiledScript>();
+    if (!script->read(file)) {
+        WARN << "Invalid cached AI script" << path;
+        return nullptr;
+    }
+
+    DBG << "Loaded cached AI script" << path;
+    return script;
+}
+
+void ScriptCache::writeCacheFile(const uint64_t hash, const CompiledScript &script)
+{
+    const std::string path = cacheFilePath(hash);
+    if (path.empty()) {
+        return;
+    }
+
+    // Not the end of the world if it fails, we just parse it again next time
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+    if (error) {
+        WARN << "Failed to create AI script cache directory" << error.message();
+        return;
+    }
+
+    // Write to a temporary file first, so nobody reads it half written
+    const std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.good() || !script.write(file)) {
+            WARN << "Failed to write AI script cache" << temporaryPath;
+            return;
+        }
+    }
+
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        WARN << "Failed to store AI script cache" << path << error.message();
+    }
+}
+
+} // namespace ai
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ai {
+
+/// A parsed AI script as a flat table, with everything already resolved to
+/// enum values and numbers.
+///
+/// Each condition and action is stored as which ScriptLoader::createCondition()
+/// or createAction() overload the parser called and with what, so ScriptBuilder
+/// can create the actual objects for a player by calling the same thing again.
+/// It doesn't know anything about players, so the same one is shared by
+/// everyone using the same script.
+struct CompiledScript
+{
+    /// Bump when the call types or lists/*.list change, the cached files
+    /// store the enum values directly.
+    static constexpr uint32_t FormatVersion = 1;
+
+    static constexpr int MaxArguments = 5;
+
+    // Stored in the cache, so only append
+    enum class ConditionCall : uint8_t {
+        Fact,
+        FactAge,
+        FactBuilding,
+        FactBuildingCompare,
+        FactCiv,
+        FactCommodity,
+        FactCommodityCompare,
+        FactMapSize,
+        FactMapType,
+        FactPlayer,
+        FactPlayerNumber,
+        FactPlayerCompare,
+        FactPlayerBuildingCompare,
+        FactPlayerCiv,
+        FactPlayerCommodityCompare,
+        FactPlayerStance,
+        FactPlayerAgeCompare,
+        FactPlayerUnitCompare,
+        FactAgeCompare,
+        FactDifficultyCompare,
+        FactStartingResourcesCompare,
+        FactStrategicNumberCompare,
+        FactUnitCompare,
+        FactNumberCompare,
+        FactTwoNumbers,
+        FactNumberWall,
+        FactNumber,
+        FactResearch,
+        FactUnit,
+        FactVictoryCondition,
+        FactCompare,
+
+        // The arguments are indices of other conditions
+        And,
+        Or,
+        Not,
+    };
+
+    // Stored in the cache, so only append
+    enum class ActionCall : uint8_t {
+        Action,
+        ActionString,
+        ActionTwoNumbers,
+        ActionNumber,
+        ActionNumberWall,
+        ActionAge,
+        ActionBuilding,
+        ActionResearch,
+        ActionCommodity,
+        ActionUnit,
+        ActionCommodityNumber,
+        ActionPlayerNumber,
+        ActionStrategicNumber,
+        ActionPlayerCommodityNumber,
+        ActionPlayerString,
+        ActionPlayerStance,
+        ActionPlayerCommodity,
+        ActionDifficulty,
+        ActionPlayerTwoNumbers,
+    };
+
+    /// Strings are stored as indices into strings
+    struct Call {
+        uint8_t type = 0; // ConditionCall or ActionCall
+        std::array<int32_t, MaxArguments> arguments{};
+    };
+
+    struct Rule {
+        // Indices into ruleConditions and ruleActions
+        uint32_t firstCondition = 0;
+        uint32_t conditionCount = 0;
+        uint32_t firstAction = 0;
+        uint32_t actionCount = 0;
+    };
+
+    std::vector<Call> conditions;
+    std::vector<Call> actions;
+    std::vector<std::string> strings;
+
+    std::vector<uint32_t> ruleConditions; // indices into conditions
+    std::vector<uint32_t> ruleActions; // indices into actions
+    std::vector<Rule> rules;
+
+    bool write(std::ostream &out) const;
+    bool read(std::istream &in);
+};
+
+/// Keeps the compiled scripts around, both in memory and on disk, keyed by a
+/// hash of the script contents. So when eight AI players use the same script
+/// it is only parsed once, and the next time the game starts not at all.
+class ScriptCache
+{
+public:
+    /// Returns null if the script couldn't be read or parsed
+    static std::shared_ptr<const CompiledScript> load(const std::string &path);
+
+    /// For scripts that don't come from a file
+    static std::shared_ptr<const CompiledScript> compile(const std::string &source);
+
+    static uint64_t hash(const std::string &source) noexcept;
+
+    /// Where the compiled script is stored on disk, empty if there's no cache directory
+    static std::string cacheFilePath(const uint64_t hash);
+
+private:
+    static std::shared_ptr<const CompiledScript> loadCacheFile(const uint64_t hash);
+    static void writeCacheFile(const uint64_t hash, const CompiledScript &script);
+
+    static std::mutex s_mutex;
+    static std::unordered_map<uint64_t, std::weak_ptr<const CompiledScript>> s_scripts;
+};
+
+} // namespace ai
@@ -0,0 +1,406 @@
+#include "FactTable.h"
+
+#include <genie/dat/Unit.h>
+
+#include "ai/AiPlayer.h"
+#include "core/Logger.h"
+#include "global/EventManager.h"
+#include "mechanics/Unit.h"
+
+namespace ai {
+
+FactTable::FactTable(AiPlayer *player) :
+    m_player(player)
+{
+    EventManager::registerListener(this, EventManager::UnitCreated);
+    EventManager::registerListener(this, EventManager::UnitDestroyed);
+    EventManager::registerListener(this, EventManager::UnitChangedOwner);
+    EventManager::registerListener(this, EventManager::UnitCaptured);
+    EventManager::registerListener(this, EventManager::UnitChangedGroup);
+    EventManager::registerListener(this, EventManager::ResearchComplete);
+    EventManager::registerListener(this, EventManager::PlayerResourceChanged);
+    EventManager::registerListener(this, EventManager::TradingPriceChanged);
+
+    // Conditions check us when they are added, so have something sensible up front
+    updateResources();
+    updatePopulation();
+    updateCombatUnits();
+    m_current = m_next;
+}
+
+FactTable::~FactTable()
+{
+}
+
+void FactTable::update()
+{
+    collect();
+    publish();
+}
+
+void FactTable::collect()
+{
+    if (!m_dirty) {
+        return;
+    }
+
+    const uint32_t dirty = m_dirty;
+    m_dirty = 0;
+
+    if ((dirty & ResourcesDirty) && updateResources()) {
+        m_changed |= 1 << ResourcesChanged;
+    }
+    if ((dirty & PopulationDirty) && updatePopulation()) {
+        m_changed |= 1 << PopulationChanged;
+    }
+    if ((dirty & UnitCountsDirty) && updateUnitCounts()) {
+        m_changed |= 1 << UnitCountsChanged;
+    }
+    if ((dirty & CombatUnitsDirty) && updateCombatUnits()) {
+        m_changed |= 1 << CombatUnitsChanged;
+    }
+    if ((dirty & TradingPricesDirty) && m_next.tradingPrices != m_tradingPrices) {
+        m_next.tradingPrices = m_tradingPrices;
+        m_changed |= 1 << TradingPricesChanged;
+    }
+    if ((dirty & AvailabilityDirty) && updateAvailability()) {
+        m_changed |= 1 << AvailabilityChanged;
+    }
+}
+
+void FactTable::publish()
+{
+    if (!m_changed) {
+        return;
+    }
+
+    const uint32_t changed = m_changed;
+    m_changed = 0;
+
+    // Copy everything first, so the conditions see all of it whatever gets emitted first
+    if (changed & (1 << ResourcesChanged)) {
+        m_current.resources = m_next.resources;
+        m_current.reserves = m_next.reserves;
+    }
+    if (changed & (1 << PopulationChanged)) {
+        m_current.populationHeadroom = m_next.populationHeadroom;
+    }
+    if (changed & (1 << UnitCountsChanged)) {
+        m_current.unitCounts = m_next.unitCounts;
+        m_current.totalUnitCounts = m_next.totalUnitCounts;
+    }
+    if (changed & (1 << CombatUnitsChanged)) {
+        m_current.combatUnits = m_next.combatUnits;
+    }
+    if (changed & (1 << TradingPricesChanged)) {
+        m_current.tradingPrices = m_next.tradingPrices;
+    }
+    if (changed & (1 << AvailabilityChanged)) {
+        m_current.trainable = m_next.trainable;
+        m_current.researchable = m_next.researchable;
+    }
+
+    // Whatever the signals cause to change waits for the next update
+    for (int signal = 0; signal < SignalCount; signal++) {
+        if (changed & (1 << signal)) {
+            emit(Signals(signal));
+        }
+    }
+}
+
+int FactTable::unitTypeCount(const int typeId, const bool allPlayers) const
+{
+    const std::unordered_map<int, int> &counts = allPlayers ? m_current.totalUnitCounts : m_current.unitCounts;
+
+    std::unordered_map<int, int>::const_iterator it = counts.find(typeId);
+    if (IS_UNLIKELY(it == counts.end())) {
+        WARN << "Unit type" << typeId << "isn't watched";
+        return 0;
+    }
+    return it->second;
+}
+
+int FactTable::tradingPrice(const genie::ResourceType type) const
+{
+    if (size_t(type) >= m_current.tradingPrices.size()) {
+        WARN << "Can't trade" << type;
+        return 0;
+    }
+    return m_current.tradingPrices[size_t(type)];
+}
+
+bool FactTable::canTrainOrBuild(const int typeId, const bool withEscrow) const
+{
+    std::unordered_map<int, Availability>::const_iterator it = m_current.trainable.find(typeId);
+    if (IS_UNLIKELY(it == m_current.trainable.end())) {
+        WARN << "Unit type" << typeId << "isn't watched";
+        return false;
+    }
+    return withEscrow ? it->second.availableWithEscrow : it->second.available;
+}
+
+bool FactTable::canResearch(const int techId, const bool withEscrow) const
+{
+    std::unordered_map<int, Availability>::const_iterator it = m_current.researchable.find(techId);
+    if (IS_UNLIKELY(it == m_current.researchable.end())) {
+        WARN << "Tech" << techId << "isn't watched";
+        return false;
+    }
+    return withEscrow ? it->second.availableWithEscrow : it->second.available;
+}
+
+// The watch functions are only called when the script is set up, so they
+// can touch both snapshots
+
+void FactTable::watchUnitCount(const int typeId)
+{
+    if (m_totalUnitCounts.count(typeId)) {
+        return;
+    }
+    m_totalUnitCounts[typeId] = 0;
+    m_next.totalUnitCounts[typeId] = 0;
+    m_current.totalUnitCounts[typeId] = 0;
+
+    const int count = m_player->unitCount(typeId);
+    m_next.unitCounts[typeId] = count;
+    m_current.unitCounts[typeId] = count;
+}
+
+void FactTable::watchTrainable(const int typeId)
+{
+    if (m_next.trainable.count(typeId)) {
+        return;
+    }
+    const Availability availability = checkTrainable(typeId);
+    m_next.trainable[typeId] = availability;
+    m_current.trainable[typeId] = availability;
+}
+
+void FactTable::watchResearch(const int techId)
+{
+    if (m_next.researchable.count(techId)) {
+        return;
+    }
+    const Availability availability = checkResearch(techId);
+    m_next.researchable[techId] = availability;
+    m_current.researchable[techId] = availability;
+}
+
+void FactTable::onUnitCreated(::Unit *unit)
+{
+    onUnitCountChanged(unit->data()->ID, unit->playerId(), 1);
+}
+
+void FactTable::onUnitDying(::Unit *unit)
+{
+    onUnitCountChanged(unit->data()->ID, unit->playerId(), -1);
+
+    if (unit->playerId() == m_player->playerId) {
+        m_dirty |= CombatUnitsDirty;
+    }
+}
+
+void FactTable::onUnitOwnerChanged(::Unit *unit, int oldPlayerId, int newPlayerId)
+{
+    (void)unit;
+
+    if (oldPlayerId == m_player->playerId || newPlayerId == m_player->playerId) {
+        m_dirty |= UnitCountsDirty | CombatUnitsDirty | AvailabilityDirty;
+    }
+}
+
+void FactTable::onUnitCaptured(::Unit *unit, int oldPlayerId, int newPlayerId)
+{
+    onUnitOwnerChanged(unit, oldPlayerId, newPlayerId);
+}
+
+void FactTable::onUnitChangedGroup(::Unit *unit, int oldGroup, int newGroup)
+{
+    (void)oldGroup;
+    (void)newGroup;
+
+    if (unit->playerId() == m_player->playerId) {
+        m_dirty |= CombatUnitsDirty;
+    }
+}
+
+void FactTable::onResearchCompleted(Player *player, int researchId)
+{
+    (void)researchId;
+
+    if (player->playerId == m_player->playerId) {
+        m_dirty |= AvailabilityDirty;
+    }
+}
+
+void FactTable::onPlayerResourceChanged(Player *player, const genie::ResourceType type, float newValue)
+{
+    (void)newValue;
+
+    if (player->playerId != m_player->playerId) {
+        return;
+    }
+
+    m_dirty |= ResourcesDirty | AvailabilityDirty;
+
+    if (type == genie::ResourceType::CurrentPopulation || type == genie::ResourceType::PopulationHeadroom) {
+        m_dirty |= PopulationDirty;
+    }
+}
+
+void FactTable::onTradingPriceChanged(const genie::ResourceType type, const int newPrice)
+{
+    if (size_t(type) >= m_tradingPrices.size()) {
+        return;
+    }
+
+    m_tradingPrices[size_t(type)] = newPrice;
+    m_dirty |= TradingPricesDirty;
+}
+
+void FactTable::onUnitCountChanged(const int typeId, const int playerId, const int delta)
+{
+    std::unordered_map<int, int>::iterator it = m_totalUnitCounts.find(typeId);
+    if (it != m_totalUnitCounts.end()) {
+        it->second += delta;
+        m_dirty |= UnitCountsDirty;
+    }
+
+    // Might be where something gets trained, or something in the way of research
+    if (playerId == m_player->playerId) {
+        m_dirty |= UnitCountsDirty | AvailabilityDirty;
+    }
+}
+
+bool FactTable::updateResources()
+{
+    // No cheap way to tell if anything actually changed, but it's just copying two arrays
+    m_next.resources = m_player->availableResources();
+    m_next.reserves = m_player->m_reserves;
+    return true;
+}
+
+bool FactTable::updatePopulation()
+{
+    const int housingAvailable = m_player->resourcesAvailable(genie::ResourceType::PopulationHeadroom) + m_player->resourcesUsed(genie::ResourceType::CurrentPopulation);
+    const int populationCap = m_player->resourcesAvailable(genie::ResourceType::CurrentPopulation) + m_player->resourcesUsed(genie::ResourceType::CurrentPopulation);
+
+    const int headroom = populationCap - housingAvailable;
+    if (headroom == m_next.populationHeadroom) {
+        return false;
+    }
+    m_next.populationHeadroom = headroom;
+    return true;
+}
+
+bool FactTable::updateUnitCounts()
+{
+    bool changed = false;
+    for (std::pair<const int, int> &count : m_next.unitCounts) {
+        const int newCount = m_player->unitCount(count.first);
+        if (newCount != count.second) {
+            count.second = newCount;
+            changed = true;
+        }
+    }
+    if (m_next.totalUnitCounts != m_totalUnitCounts) {
+        m_next.totalUnitCounts = m_totalUnitCounts;
+        changed = true;
+    }
+    return changed;
+}
+
+bool FactTable::updateCombatUnits()
+{
+    std::array<std::array<int, CombatUnitGroupCount>, CombatUnitTypeCount> counts{};
+
+    // Group 0 is the defenders, the rest are attacking
+    for (int group = 0; group < m_player->unitGroupCount(); group++) {
+        const CombatUnitGroup groupType = group == 0 ? Defending : Attacking;
+
+        for (const ::Unit *unit : m_player->unitsInGroup(group)) {
+            for (int type = 0; type < CombatUnitTypeCount; type++) {
+                if (!isCombatUnit(*unit->data(), CombatUnitType(type))) {
+                    continue;
+                }
+                counts[type][groupType]++;
+                counts[type][AllGroups]++;
+            }
+        }
+    }
+
+    if (counts == m_next.combatUnits) {
+        return false;
+    }
+    m_next.combatUnits = counts;
+    return true;
+}
+
+bool FactTable::updateAvailability()
+{
+    bool changed = false;
+    for (std::pair<const int, Availability> &trainable : m_next.trainable) {
+        const Availability availability = checkTrainable(trainable.first);
+        if (availability != trainable.second) {
+            trainable.second = availability;
+            changed = true;
+        }
+    }
+    for (std::pair<const int, Availability> &research : m_next.researchable) {
+        const Availability availability = checkResearch(research.first);
+        if (availability != research.second) {
+            research.second = availability;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+FactTable::Availability FactTable::checkTrainable(const int typeId) const
+{
+    Availability ret;
+
+    const genie::Unit &data = m_player->civilization.unitData(typeId);
+    const int16_t trainLocationId = data.Creatable.TrainLocationID;
+    if (trainLocationId < 0) {
+        WARN << "Failed to find unit where" << data.Name << "is created";
+        return ret;
+    }
+    if (!m_player->findUnitByTypeID(trainLocationId)) {
+        return ret;
+    }
+
+    ret.available = m_player->canAffordUnit(typeId);
+    ret.availableWithEscrow = m_player->canAffordUnitWithEscrow(typeId);
+    return ret;
+}
+
+FactTable::Availability FactTable::checkResearch(const int techId) const
+{
+    Availability ret;
+    if (!m_player->researchAvailable(techId)) {
+        return ret;
+    }
+
+    ret.available = m_player->canAffordResearch(techId);
+    ret.availableWithEscrow = m_player->canAffordResearchWithEscrow(techId);
+    return ret;
+}
+
+bool FactTable::isCombatUnit(const genie::Unit &data, const CombatUnitType type)
+{
+    if (data.Type < genie::Unit::CombatantType) {
+        return false;
+    }
+    if (data.CombatLevel != genie::Unit::SoldierCombatLevel) {
+        return false;
+    }
+
+    if (type == Warboats) {
+        return data.Class == genie::Unit::Warship;
+    }
+
+    return true;
+}
+
+} // namespace ai
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+
+#include "core/ResourceMap.h"
+#include "core/SignalEmitter.h"
+#include "global/EventListener.h"
+
+struct AiPlayer;
+
+namespace genie {
+class Unit;
+}
+
+namespace ai {
+
+/// The facts (from lists/facts.list) that the conditions in a script check,
+/// kept in one place per AI player.
+///
+/// This is the only thing that listens to the game events, it just marks what
+/// changed and then update() once per tick recomputes what is dirty and emits
+/// for it. So 20 conditions looking at the same thing cost one update instead
+/// of 20 event handlers all calling into the player and the game data.
+///
+/// Things that are specific to a unit type or tech (can-train, can-research)
+/// are only kept for what the conditions have asked for with watch*().
+///
+/// The conditions only see a copy, so the script can run on another thread
+/// (see AiThread): collect() reads the game on the main thread while the
+/// script isn't running, publish() makes it visible to the conditions and
+/// emits. update() just does both.
+class FactTable : public EventListener, public SignalEmitter<FactTable>
+{
+public:
+    enum Signals {
+        ResourcesChanged,
+        PopulationChanged,
+        UnitCountsChanged,
+        CombatUnitsChanged,
+        TradingPricesChanged,
+        AvailabilityChanged, // can-train, can-build, can-research
+        SignalCount
+    };
+
+    enum CombatUnitType {
+        Soldiers,
+        Warboats,
+        CombatUnitTypeCount
+    };
+
+    enum CombatUnitGroup {
+        Defending,
+        Attacking,
+        AllGroups,
+        CombatUnitGroupCount
+    };
+
+    FactTable(AiPlayer *player);
+    ~FactTable();
+
+    FactTable(const FactTable &) = delete;
+    const FactTable &operator=(const FactTable &) = delete;
+
+    AiPlayer *player() const { return m_player; }
+
+    /// Recomputes what has changed since last time, and emits for it
+    void update();
+
+    /// Main thread, reads what is dirty from the game
+    void collect();
+
+    /// Script thread, lets the conditions see what collect() found
+    void publish();
+
+    float resource(const genie::ResourceType type) const { return m_current.resources.value(type); }
+
+    /// Held in escrow
+    float escrow(const genie::ResourceType type) const { return m_current.reserves.value(type); }
+
+    int populationHeadroom() const { return m_current.populationHeadroom; }
+
+    /// allPlayers only counts what has been created since it was watched
+    int unitTypeCount(const int typeId, const bool allPlayers) const;
+
+    int combatUnitCount(const CombatUnitType type, const CombatUnitGroup group) const { return m_current.combatUnits[type][group]; }
+
+    /// Base price, without the buy/sell markup
+    int tradingPrice(const genie::ResourceType type) const;
+
+    bool canTrainOrBuild(const int typeId, const bool withEscrow) const;
+    bool canResearch(const int techId, const bool withEscrow) const;
+
+    void watchUnitCount(const int typeId);
+    void watchTrainable(const int typeId);
+    void watchResearch(const int techId);
+
+private:
+    enum DirtyFlags : uint32_t {
+        ResourcesDirty = 1 << 0,
+        PopulationDirty = 1 << 1,
+        UnitCountsDirty = 1 << 2,
+        CombatUnitsDirty = 1 << 3,
+        TradingPricesDirty = 1 << 4,
+        AvailabilityDirty = 1 << 5,
+    };
+
+    struct Availability {
+        bool available = false;
+        bool availableWithEscrow = false;
+
+        bool operator!=(const Availability &other) const {
+            return available != other.available || availableWithEscrow != other.availableWithEscrow;
+        }
+    };
+
+    struct Snapshot {
+        ResourceMap resources;
+        ResourceMap reserves;
+
+        int populationHeadroom = 0;
+        std::array<std::array<int, CombatUnitGroupCount>, CombatUnitTypeCount> combatUnits{};
+
+        // Food, wood, stone, the only things that can be traded
+        std::array<int, 3> tradingPrices = { 100, 100, 100 };
+
+        std::unordered_map<int, int> unitCounts;
+        std::unordered_map<int, int> totalUnitCounts;
+        std::unordered_map<int, Availability> trainable;
+        std::unordered_map<int, Availability> researchable;
+    };
+
+    void onUnitCreated(::Unit *unit) override;
+    void onUnitDying(::Unit *unit) override;
+    void onUnitOwnerChanged(::Unit *unit, int oldPlayerId, int newPlayerId) override;
+    void onUnitCaptured(::Unit *unit, int oldPlayerId, int newPlayerId) override;
+    void onUnitChangedGroup(::Unit *unit, int oldGroup, int newGroup) override;
+    void onResearchCompleted(Player *player, int researchId) override;
+    void onPlayerResourceChanged(Player *player, const genie::ResourceType type, float newValue) override;
+    void onTradingPriceChanged(const genie::ResourceType type, const int newPrice) override;
+
+    void onUnitCountChanged(const int typeId, const int playerId, const int delta);
+
+    bool updateResources();
+    bool updatePopulation();
+    bool updateUnitCounts();
+    bool updateCombatUnits();
+    bool updateAvailability();
+
+    Availability checkTrainable(const int typeId) const;
+    Availability checkResearch(const int techId) const;
+    static bool isCombatUnit(const genie::Unit &data, const CombatUnitType type);
+
+    AiPlayer *m_player;
+
+    // Main thread only, the events update these directly
+    uint32_t m_dirty = 0;
+    std::array<int, 3> m_tradingPrices = { 100, 100, 100 };
+    std::unordered_map<int, int> m_totalUnitCounts;
+
+    // Written by collect()
+    Snapshot m_next;
+
+    // Set by collect(), handed over in publish()
+    uint32_t m_changed = 0;
+
+    // What the conditions see
+    Snapshot m_current;
+};
+
+} // namespace ai
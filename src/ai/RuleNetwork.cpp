@@ -0,0 +1,157 @@
+#include "RuleNetwork.h"
+
+#include <algorithm>
+
+#include "ai/AiRule.h"
+#include "ai/AiScript.h"
+#include "ai/conditions/Conditions.h"
+#include "core/Logger.h"
+
+namespace ai {
+
+RuleNetwork::~RuleNetwork()
+{
+}
+
+void RuleNetwork::addRule(const std::shared_ptr<AiRule> &rule, const std::vector<std::shared_ptr<Condition>> &conditions)
+{
+    if (!rule->m_owner || !rule->m_owner->m_player) {
+        WARN << "Rule without a script or player, can't check its conditions";
+        return;
+    }
+
+    const uint32_t ruleIndex = m_rules.size();
+    m_rules.emplace_back();
+    m_rules.back().rule = rule;
+
+    for (const std::shared_ptr<Condition> &condition : conditions) {
+        if (!condition) {
+            WARN << "Got null condition";
+            continue;
+        }
+
+        FactNode &fact = *m_facts[factFor(condition, rule)];
+        fact.rules.push_back(ruleIndex);
+
+        RuleNode &node = m_rules[ruleIndex];
+        node.factCount++;
+        if (fact.satisfied) {
+            node.satisfiedCount++;
+        }
+    }
+
+    // Things like (true) for setting up stuff at the start
+    if (m_rules[ruleIndex].satisfiedCount == m_rules[ruleIndex].factCount) {
+        schedule(ruleIndex);
+    }
+}
+
+void RuleNetwork::removeRule(const AiRule *rule)
+{
+    for (RuleNode &node : m_rules) {
+        if (node.rule.get() == rule) {
+            node.rule.reset();
+            return;
+        }
+    }
+}
+
+bool RuleNetwork::fireAgenda()
+{
+    if (m_agenda.empty()) {
+        return false;
+    }
+
+    // Whatever the rules we fire cause to be satisfied waits until the next time
+    std::vector<uint32_t> agenda;
+    agenda.swap(m_agenda);
+    std::sort(agenda.begin(), agenda.end());
+
+    for (const uint32_t ruleIndex : agenda) {
+        m_rules[ruleIndex].onAgenda = false;
+    }
+
+    for (const uint32_t ruleIndex : agenda) {
+        const RuleNode &node = m_rules[ruleIndex];
+
+        // Might have been disabled or stopped being satisfied by an earlier rule
+        if (!node.rule || node.satisfiedCount != node.factCount) {
+            continue;
+        }
+
+        // Keep it alive, disable-self removes it
+        std::shared_ptr<AiRule> rule = node.rule;
+        rule->fire();
+    }
+
+    return true;
+}
+
+uint32_t RuleNetwork::factFor(const std::shared_ptr<Condition> &condition, const std::shared_ptr<AiRule> &rule)
+{
+    const Condition::Key key = condition->key();
+    if (!key.empty()) {
+        std::map<Condition::Key, uint32_t>::const_iterator it = m_factsByKey.find(key);
+        if (it != m_factsByKey.end()) {
+            return it->second;
+        }
+    }
+
+    const uint32_t index = m_facts.size();
+
+    std::unique_ptr<FactNode> fact = std::make_unique<FactNode>(this, index);
+    fact->condition = condition;
+    fact->owner = rule;
+    fact->satisfied = condition->satisfied(rule.get());
+    condition->connect(Condition::SatisfiedChanged, fact.get(), &FactNode::onSatisfiedChanged);
+    m_facts.push_back(std::move(fact));
+
+    if (!key.empty()) {
+        m_factsByKey[key] = index;
+    }
+
+    return index;
+}
+
+void RuleNetwork::onFactChanged(const uint32_t index)
+{
+    FactNode &fact = *m_facts[index];
+
+    const bool satisfied = fact.condition->satisfied(fact.owner.get());
+    if (satisfied != fact.satisfied) {
+        fact.satisfied = satisfied;
+
+        for (const uint32_t ruleIndex : fact.rules) {
+            if (satisfied) {
+                m_rules[ruleIndex].satisfiedCount++;
+            } else {
+                m_rules[ruleIndex].satisfiedCount--;
+            }
+        }
+    }
+
+    if (!satisfied) {
+        return;
+    }
+
+    // Same as before, a rule fires on any change as long as everything still holds
+    for (const uint32_t ruleIndex : fact.rules) {
+        const RuleNode &node = m_rules[ruleIndex];
+        if (node.satisfiedCount == node.factCount) {
+            schedule(ruleIndex);
+        }
+    }
+}
+
+void RuleNetwork::schedule(const uint32_t ruleIndex)
+{
+    RuleNode &node = m_rules[ruleIndex];
+    if (!node.rule || node.onAgenda) {
+        return;
+    }
+
+    node.onAgenda = true;
+    m_agenda.push_back(ruleIndex);
+}
+
+} // namespace ai
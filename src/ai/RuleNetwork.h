@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stddef.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "core/SignalEmitter.h"
+
+namespace ai {
+
+struct AiRule;
+struct Condition;
+
+/// All the rules of a script compiled into one network, instead of every
+/// rule listening to and checking all of its own conditions.
+///
+/// Conditions that check the same thing (which is most of them in a normal
+/// script, things like "food-amount > 100" show up all over the place) become
+/// one fact node, which is only checked once when it says something changed.
+/// Each rule just counts how many of its facts are true, and when that reaches
+/// the number of facts it has it goes on the agenda, which gets fired in the
+/// order the rules are in the script the next time the script is updated.
+///
+/// So a change costs the number of rules that actually use that fact, instead
+/// of every rule re-checking everything.
+class RuleNetwork
+{
+public:
+    RuleNetwork() = default;
+    ~RuleNetwork();
+
+    RuleNetwork(const RuleNetwork &) = delete;
+    const RuleNetwork &operator=(const RuleNetwork &) = delete;
+
+    /// Rules are fired in the order they are added
+    void addRule(const std::shared_ptr<AiRule> &rule, const std::vector<std::shared_ptr<Condition>> &conditions);
+
+    /// Won't fire anymore, e. g. after disable-self
+    void removeRule(const AiRule *rule);
+
+    /// Fires the rules that have been satisfied since last time.
+    /// Returns true if anything was fired.
+    bool fireAgenda();
+
+    size_t ruleCount() const noexcept { return m_rules.size(); }
+
+    /// How many conditions we actually check, after merging identical ones
+    size_t factCount() const noexcept { return m_facts.size(); }
+
+private:
+    struct FactNode : public SignalReceiver {
+        FactNode(RuleNetwork *network, const uint32_t index) : m_network(network), m_index(index) {}
+        void onSatisfiedChanged() { m_network->onFactChanged(m_index); }
+
+        std::shared_ptr<Condition> condition;
+        std::shared_ptr<AiRule> owner; // what we pass to satisfied(), they only use it to get to the script
+        std::vector<uint32_t> rules; // indices of the rules using it
+        bool satisfied = false;
+
+    private:
+        RuleNetwork *m_network;
+        const uint32_t m_index;
+    };
+
+    struct RuleNode {
+        std::shared_ptr<AiRule> rule; // null when removed
+        uint32_t factCount = 0;
+        uint32_t satisfiedCount = 0;
+        bool onAgenda = false;
+    };
+
+    uint32_t factFor(const std::shared_ptr<Condition> &condition, const std::shared_ptr<AiRule> &rule);
+    void onFactChanged(const uint32_t index);
+    void schedule(const uint32_t ruleIndex);
+
+    std::vector<std::unique_ptr<FactNode>> m_facts;
+    std::map<std::vector<int>, uint32_t> m_factsByKey;
+
+    std::vector<RuleNode> m_rules;
+    std::vector<uint32_t> m_agenda;
+};
+
+} // namespace ai
@@ -0,0 +1,756 @@
+#include "ScriptBuilder.h"
+
+#include "core/Logger.h"
+#include "EnumLogDefs.h"
+
+#include "conditions/Conditions.h"
+#include "actions/Actions.h"
+
+namespace ai {
+
+typedef CompiledScript::ConditionCall ConditionCall;
+typedef CompiledScript::ActionCall ActionCall;
+
+ScriptBuilder::ScriptBuilder(AiPlayer *player, const std::shared_ptr<TimerWheel> &timers) :
+    m_player(player),
+    m_timers(timers)
+{
+}
+
+ScriptBuilder::~ScriptBuilder()
+{
+}
+
+std::shared_ptr<AiScript> ScriptBuilder::build(const CompiledScript &compiled)
+{
+    m_compiled = &compiled;
+    m_script = std::make_shared<AiScript>(m_player, m_timers);
+
+    for (const CompiledScript::Rule &compiledRule : compiled.rules) {
+        std::vector<std::shared_ptr<Condition>> conditions;
+        conditions.reserve(compiledRule.conditionCount);
+        for (uint32_t i = 0; i < compiledRule.conditionCount; i++) {
+            conditions.push_back(buildCondition(compiled.ruleConditions[compiledRule.firstCondition + i]));
+        }
+
+        std::shared_ptr<AiRule> rule = std::make_shared<AiRule>(m_script.get());
+        for (uint32_t i = 0; i < compiledRule.actionCount; i++) {
+            rule->addAction(buildAction(compiled.ruleActions[compiledRule.firstAction + i]));
+        }
+
+        // Conditions that check the same thing as one in an earlier rule get merged
+        m_script->addRule(rule, conditions);
+    }
+
+    m_compiled = nullptr;
+
+    std::shared_ptr<AiScript> ret;
+    ret.swap(m_script);
+    return ret;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::buildCondition(const uint32_t index)
+{
+    const CompiledScript::Call &call = m_compiled->conditions[index];
+    const std::array<int32_t, CompiledScript::MaxArguments> &arguments = call.arguments;
+
+    // Sub conditions are always recorded before the ones using them
+    switch(ConditionCall(call.type)) {
+    case ConditionCall::And:
+    case ConditionCall::Or: {
+        if (uint32_t(arguments[0]) >= index || uint32_t(arguments[1]) >= index) {
+            WARN << "Invalid sub conditions for" << index;
+            return nullptr;
+        }
+        std::shared_ptr<Condition> condition1 = buildCondition(arguments[0]);
+        std::shared_ptr<Condition> condition2 = buildCondition(arguments[1]);
+        if (ConditionCall(call.type) == ConditionCall::And) {
+            return createAndCondition(condition1, condition2);
+        }
+        return createOrCondition(condition1, condition2);
+    }
+    case ConditionCall::Not: {
+        if (uint32_t(arguments[0]) >= index) {
+            WARN << "Invalid sub condition for" << index;
+            return nullptr;
+        }
+        std::shared_ptr<Condition> condition = buildCondition(arguments[0]);
+        return createNotCondition(condition);
+    }
+    case ConditionCall::Fact:
+        return createCondition(Fact(arguments[0]));
+    case ConditionCall::FactAge:
+        return createCondition(Fact(arguments[0]), Age(arguments[1]));
+    case ConditionCall::FactBuilding:
+        return createCondition(Fact(arguments[0]), Building(arguments[1]));
+    case ConditionCall::FactBuildingCompare:
+        return createCondition(Fact(arguments[0]), Building(arguments[1]), RelOp(arguments[2]), arguments[3]);
+    case ConditionCall::FactCiv:
+        return createCondition(Fact(arguments[0]), Civ(arguments[1]));
+    case ConditionCall::FactCommodity:
+        return createCondition(Fact(arguments[0]), Commodity(arguments[1]));
+    case ConditionCall::FactCommodityCompare:
+        return createCondition(Fact(arguments[0]), Commodity(arguments[1]), RelOp(arguments[2]), arguments[3]);
+    case ConditionCall::FactMapSize:
+        return createCondition(Fact(arguments[0]), MapSizeType(arguments[1]));
+    case ConditionCall::FactMapType:
+        return createCondition(Fact(arguments[0]), MapTypeName(arguments[1]));
+    case ConditionCall::FactPlayer:
+        return createCondition(Fact(arguments[0]), PlayerNumberType(arguments[1]));
+    case ConditionCall::FactPlayerNumber:
+        return createCondition(Fact(arguments[0]), PlayerNumberType(arguments[1]), arguments[2]);
+    case ConditionCall::FactPlayerCompare:
+        return createCondition(Fact(arguments[0]), PlayerNumberType(arguments[1]), RelOp(arguments[2]), arguments[3]);
+    case ConditionCall::FactPlayerBuildingCompare:
+        return createCondition(Fact(arguments[0]), PlayerNumberType(arguments[1]), Building(arguments[2]), RelOp(arguments[3]), arguments[4]);
+    case ConditionCall::FactPlayerCiv:
+        return createCondition(Fact(arguments[0]), PlayerNumberType(arguments[1]), Civ(arguments[2]));
+    case ConditionCall::FactPlayerCommodityCompare:
+        return createCondition(Fact(arguments[0]), PlayerNumberType(arguments[1]), Commodity(arguments[2]), RelOp(arguments[3]), arguments[4]);
+    case ConditionCall::FactPlayerStance:
+        return createCondition(Fact(arguments[0]), PlayerNumberType(arguments[1]), DiplomaticStance(arguments[2]));
+    case ConditionCall::FactPlayerAgeCompare:
+        return createCondition(Fact(arguments[0]), PlayerNumberType(arguments[1]), RelOp(arguments[2]), Age(arguments[3]));
+    case ConditionCall::FactPlayerUnitCompare:
+        return createCondition(Fact(arguments[0]), PlayerNumberType(arguments[1]), Unit(arguments[2]), RelOp(arguments[3]), arguments[4]);
+    case ConditionCall::FactAgeCompare:
+        return createCondition(Fact(arguments[0]), RelOp(arguments[1]), Age(arguments[2]));
+    case ConditionCall::FactDifficultyCompare:
+        return createCondition(Fact(arguments[0]), RelOp(arguments[1]), DifficultyLevel(arguments[2]));
+    case ConditionCall::FactStartingResourcesCompare:
+        return createCondition(Fact(arguments[0]), RelOp(arguments[1]), StartingResourcesType(arguments[2]));
+    case ConditionCall::FactStrategicNumberCompare:
+        return createCondition(Fact(arguments[0]), StrategicNumberName(arguments[1]), RelOp(arguments[2]), arguments[3]);
+    case ConditionCall::FactUnitCompare:
+        return createCondition(Fact(arguments[0]), Unit(arguments[1]), RelOp(arguments[2]), arguments[3]);
+    case ConditionCall::FactNumberCompare:
+        return createCondition(Fact(arguments[0]), arguments[1], RelOp(arguments[2]), arguments[3]);
+    case ConditionCall::FactTwoNumbers:
+        return createCondition(Fact(arguments[0]), arguments[1], arguments[2]);
+    case ConditionCall::FactNumberWall:
+        return createCondition(Fact(arguments[0]), arguments[1], WallType(arguments[2]));
+    case ConditionCall::FactNumber:
+        return createCondition(Fact(arguments[0]), arguments[1]);
+    case ConditionCall::FactResearch:
+        return createCondition(Fact(arguments[0]), ResearchItem(arguments[1]));
+    case ConditionCall::FactUnit:
+        return createCondition(Fact(arguments[0]), Unit(arguments[1]));
+    case ConditionCall::FactVictoryCondition:
+        return createCondition(Fact(arguments[0]), VictoryConditionName(arguments[1]));
+    case ConditionCall::FactCompare:
+        return createCondition(Fact(arguments[0]), RelOp(arguments[1]), arguments[2]);
+    default:
+        break;
+    }
+
+    WARN << "Unknown condition call" << int(call.type);
+    return nullptr;
+}
+
+std::shared_ptr<Action> ScriptBuilder::buildAction(const uint32_t index)
+{
+    const CompiledScript::Call &call = m_compiled->actions[index];
+    const std::array<int32_t, CompiledScript::MaxArguments> &arguments = call.arguments;
+
+    switch(ActionCall(call.type)) {
+    case ActionCall::Action:
+        return createAction(ActionType(arguments[0]));
+    case ActionCall::ActionString:
+        return createAction(ActionType(arguments[0]), string(arguments[1]));
+    case ActionCall::ActionTwoNumbers:
+        return createAction(ActionType(arguments[0]), arguments[1], arguments[2]);
+    case ActionCall::ActionNumber:
+        return createAction(ActionType(arguments[0]), arguments[1]);
+    case ActionCall::ActionNumberWall:
+        return createAction(ActionType(arguments[0]), arguments[1], WallType(arguments[2]));
+    case ActionCall::ActionAge:
+        return createAction(ActionType(arguments[0]), Age(arguments[1]));
+    case ActionCall::ActionBuilding:
+        return createAction(ActionType(arguments[0]), Building(arguments[1]));
+    case ActionCall::ActionResearch:
+        return createAction(ActionType(arguments[0]), ResearchItem(arguments[1]));
+    case ActionCall::ActionCommodity:
+        return createAction(ActionType(arguments[0]), Commodity(arguments[1]));
+    case ActionCall::ActionUnit:
+        return createAction(ActionType(arguments[0]), Unit(arguments[1]));
+    case ActionCall::ActionCommodityNumber:
+        return createAction(ActionType(arguments[0]), Commodity(arguments[1]), arguments[2]);
+    case ActionCall::ActionPlayerNumber:
+        return createAction(ActionType(arguments[0]), PlayerNumberType(arguments[1]), arguments[2]);
+    case ActionCall::ActionStrategicNumber:
+        return createAction(ActionType(arguments[0]), StrategicNumberName(arguments[1]), arguments[2]);
+    case ActionCall::ActionPlayerCommodityNumber:
+        return createAction(ActionType(arguments[0]), PlayerNumberType(arguments[1]), Commodity(arguments[2]), arguments[3]);
+    case ActionCall::ActionPlayerString:
+        return createAction(ActionType(arguments[0]), PlayerNumberType(arguments[1]), string(arguments[2]));
+    case ActionCall::ActionPlayerStance:
+        return createAction(ActionType(arguments[0]), PlayerNumberType(arguments[1]), DiplomaticStance(arguments[2]));
+    case ActionCall::ActionPlayerCommodity:
+        return createAction(ActionType(arguments[0]), PlayerNumberType(arguments[1]), Commodity(arguments[2]));
+    case ActionCall::ActionDifficulty:
+        return createAction(ActionType(arguments[0]), DifficultyParameter(arguments[1]), arguments[2]);
+    case ActionCall::ActionPlayerTwoNumbers:
+        return createAction(ActionType(arguments[0]), PlayerNumberType(arguments[1]), arguments[2], arguments[3]);
+    default:
+        break;
+    }
+
+    WARN << "Unknown action call" << int(call.type);
+    return nullptr;
+}
+
+const std::string &ScriptBuilder::string(const int index)
+{
+    static const std::string empty;
+    if (IS_UNLIKELY(size_t(index) >= m_compiled->strings.size())) {
+        WARN << "Invalid string" << index;
+        return empty;
+    }
+    return m_compiled->strings[index];
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type)
+{
+    switch(type) {
+    case Fact::Trueval:
+        return std::make_shared<Conditions::ConstantCondition>(true);
+    case Fact::Falseval:
+        return std::make_shared<Conditions::ConstantCondition>(false);
+    default:
+        WARN << "unimplemented condition" << type;
+        break;
+    }
+
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const Age age)
+{
+    switch (type) {
+    case Fact::CanResearch: // todo: handle cost
+        return std::make_shared<Conditions::TechAvailableCondition>(m_script->facts(), age, false);
+    case Fact::CanResearchWithEscrow: // todo: handle escrow
+        return std::make_shared<Conditions::TechAvailableCondition>(m_script->facts(), age, true);
+    default:
+        break;
+    }
+
+    WARN << "unimplemented condition" << type << age;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const Building building)
+{
+    switch(type) {
+    case Fact::CanBuild:
+        return std::make_shared<Conditions::CanTrainOrBuildCondition>(m_script->facts(), building, false);
+    case Fact::CanBuildWithEscrow:
+        return std::make_shared<Conditions::CanTrainOrBuildCondition>(m_script->facts(), building, true);
+    default:
+        break;
+    }
+
+    WARN << "unimplemented condition" << type << building;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const Building building, const RelOp comparison, const int number)
+{
+    switch(type) {
+    case Fact::BuildingTypeCount:
+        return std::make_shared<Conditions::UnitTypeCount>(m_script->facts(), building, comparison, number, false);
+    case Fact::BuildingTypeCountTotal:
+        return std::make_shared<Conditions::UnitTypeCount>(m_script->facts(), building, comparison, number, true);
+    default:
+        break;
+    }
+
+    WARN << "unimplemented condition" << type << building << comparison << number;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const Civ civ)
+{
+    WARN << "unimplemented condition" << type << civ;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const Commodity commodity)
+{
+    switch(type) {
+    case Fact::CanSellCommodity:
+        return std::make_shared<Conditions::CanTrade>(m_script->facts(), commodity, Conditions::CanTrade::Sell);
+    case Fact::CanBuyCommodity:
+        return std::make_shared<Conditions::CanTrade>(m_script->facts(), commodity, Conditions::CanTrade::Buy);
+    default:
+        break;
+    }
+
+    WARN << "unimplemented condition" << type << commodity;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const Commodity commodity, const RelOp comparison, const int number)
+{
+    switch(type) {
+    case Fact::CommodityBuyingPrice:
+        return std::make_shared<Conditions::TradingPrice>(m_script->facts(), Conditions::TradingPrice::Buy, commodity, comparison, number);
+    case Fact::CommoditySellingPrice:
+        return std::make_shared<Conditions::TradingPrice>(m_script->facts(), Conditions::TradingPrice::Sell, commodity, comparison, number);
+    case Fact::EscrowAmount:
+        return std::make_shared<Conditions::EscrowAmount>(commodity, comparison, number);
+    default:
+        break;
+    }
+
+    WARN << "unimplemented condition" << type << commodity << comparison << number;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const MapSizeType mapsize)
+{
+    WARN << "unimplemented condition" << type << mapsize;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const MapTypeName maptype)
+{
+    WARN << "unimplemented condition" << type << maptype;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const PlayerNumberType playerNumber)
+{
+    WARN << "unimplemented condition" << type << playerNumber;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const PlayerNumberType playerNumber, const int number)
+{
+    WARN << "unimplemented condition" << type << playerNumber << number;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const PlayerNumberType playerNumber, const RelOp comparison, const int number)
+{
+    WARN << "unimplemented condition" << type << playerNumber << comparison << number;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const PlayerNumberType playerNumber, const Building building, const RelOp comparison, const int number)
+{
+    WARN << "unimplemented condition" << type << playerNumber << building << comparison << number;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const PlayerNumberType playerNumber, const Civ civ)
+{
+    WARN << "unimplemented condition" << type << playerNumber << civ;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const PlayerNumberType playerNumber, const Commodity commodity, const RelOp comparison, const int number)
+{
+    WARN << "unimplemented condition" << type << playerNumber << commodity << comparison << number;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const PlayerNumberType playerNumber, const DiplomaticStance stance)
+{
+    WARN << "unimplemented condition" << type << playerNumber << stance;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const PlayerNumberType playerNumber, const RelOp comparison, const Age age)
+{
+    WARN << "unimplemented condition" << type << playerNumber << comparison << age;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const PlayerNumberType playerNumber, const Unit unit, const RelOp comparison, const int number)
+{
+    WARN << "unimplemented condition" << type << playerNumber << unit << comparison << number;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const RelOp comparison, const Age age)
+{
+    switch(type) {
+    case Fact::CurrentAge:
+        return std::make_shared<Conditions::ResourceValue>(m_script->facts(), genie::ResourceType::CurrentAge, comparison, int(age));
+    default:
+        break;
+    }
+
+    WARN << "unimplemented condition" << type << comparison << age;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const RelOp comparison, const DifficultyLevel level)
+{
+    switch(type) {
+    case ai::Fact::Difficulty:
+        return std::make_shared<Conditions::DifficultyCondition>(comparison, level);
+    default:
+        break;
+    }
+
+    WARN << "unimplemented condition" << type << comparison << level;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const RelOp comparison, const StartingResourcesType startingResources)
+{
+    WARN << "unimplemented condition" << type << comparison << startingResources;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const StrategicNumberName strategicNumber, const RelOp comparison, const int number)
+{
+    WARN << "unimplemented condition" << type << strategicNumber << comparison << number;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const Unit unit, const RelOp comparison, const int number)
+{
+    switch(type) {
+    case Fact::UnitTypeCount:
+        return std::make_shared<Conditions::UnitTypeCount>(m_script->facts(), unit, comparison, number, false);
+    case Fact::UnitTypeCountTotal:
+        return std::make_shared<Conditions::UnitTypeCount>(m_script->facts(), unit, comparison, number, true);
+    default:
+        break;
+    }
+
+    WARN << "unimplemented condition" << type << unit << comparison << number;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const int number1, const RelOp comparison, const int number2)
+{
+    WARN << "unimplemented condition" << type << number1 << comparison << number2;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const int number1, const int number2)
+{
+    switch(type) {
+    case Fact::Goal:
+        return std::make_shared<Conditions::Goal>(number1, RelOp::Equal, number2);
+    default:
+        break;
+
+    }
+
+    WARN << "unimplemented condition" << type << number1 << number2;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const int number, const WallType wallType)
+{
+    WARN << "unimplemented condition" << type << number << wallType;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const int number)
+{
+    switch(type) {
+    case Fact::TimerTriggered:
+        return std::make_shared<Conditions::TimerTriggered>(m_script.get(), number);
+    default:
+        break;
+    }
+    WARN << "unimplemented condition" << type << number;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const ResearchItem research)
+{
+    switch (type) {
+    case Fact::CanResearchWithEscrow: // todo: handle escrow
+        return std::make_shared<Conditions::TechAvailableCondition>(m_script->facts(), research, true);
+    case Fact::CanResearch: // todo: handle cost
+    case Fact::ResearchAvailable:
+        return std::make_shared<Conditions::TechAvailableCondition>(m_script->facts(), research, false);
+    default:
+        break;
+    }
+
+    WARN << "unimplemented condition" << type << research;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const Unit unit)
+{
+    switch(type) {
+    case Fact::CanTrain:
+        return std::make_shared<Conditions::CanTrainOrBuildCondition>(m_script->facts(), unit, false);
+    default:
+        break;
+    }
+
+    WARN << "unimplemented condition" << type << unit;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact type, const VictoryConditionName condition)
+{
+    WARN << "unimplemented condition" << type << condition;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createCondition(const Fact fact, const RelOp comparison, const int number)
+{
+    genie::ResourceType type = genie::ResourceType::InvalidResource;
+    switch(fact) {
+    case Fact::PopulationHeadroom:
+        return std::make_shared<Conditions::PopulationHeadroomCondition>(m_script->facts(), comparison, number);
+    case Fact::AttackWarboatCount:
+    case Fact::AttackSoldierCount:
+    case Fact::DefendWarboatCount:
+    case Fact::DefendSoldierCount:
+    case Fact::WarboatCount:
+    case Fact::SoldierCount:
+        return std::make_shared<Conditions::CombatUnitsCount>(m_script->facts(), fact, comparison, number);
+    case Fact::HousingHeadroom:
+        type = genie::ResourceType::PopulationHeadroom;
+        break;
+    case Fact::StoneAmount:
+        type = genie::ResourceType::StoneStorage;
+        break;
+    case Fact::GoldAmount:
+        type = genie::ResourceType::GoldStorage;
+        break;
+    case Fact::FoodAmount:
+        type = genie::ResourceType::FoodStorage;
+        break;
+    case Fact::WoodAmount:
+        type = genie::ResourceType::WoodStorage;
+        break;
+    default:
+        break;
+    }
+
+    if (type != genie::ResourceType::InvalidResource) {
+        return std::make_shared<Conditions::ResourceValue>(m_script->facts(), type, comparison, number);
+    }
+
+    WARN << "unimplemented condition" << fact << comparison << number;
+    return nullptr;
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createAndCondition(std::shared_ptr<Condition> &condition1, std::shared_ptr<Condition> &condition2)
+{
+    WARN << "Creating and condition for" << condition1.get() << condition2.get();
+    return std::make_shared<Conditions::AndCondition>(condition1, condition2);
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createOrCondition(std::shared_ptr<Condition> &condition1, std::shared_ptr<Condition> &condition2)
+{
+    return std::make_shared<Conditions::OrCondition>(condition1, condition2);
+}
+
+std::shared_ptr<Condition> ScriptBuilder::createNotCondition(std::shared_ptr<Condition> &condition)
+{
+    WARN << "unimplemented not condition for" << condition.get();
+    return nullptr;
+}
+
+////////////// actions
+
+std::shared_ptr<Action> ScriptBuilder::createAction(const ActionType type)
+{
+    switch(type) {
+    case ActionType::DisableSelf:
+        return std::make_shared<Actions::DisableSelf>();
+    case ActionType::Resign:
+        return std::make_shared<Actions::Resign>();
+    default:
+        WARN << "unimplemented action" << type;
+        break;
+    }
+
+    return nullptr;
+}
+
+std::shared_ptr<Action> ScriptBuilder::createAction(const ActionType type, const std::string &string)
+{
+    switch(type) {
+    case ActionType::ChatLocalToSelf:
+        return std::make_shared<Actions::ShowDebugMessage>(string);
+    default:
+        WARN << "unimplemented action" << type << string;
+    }
+
+    return nullptr;
+}
+
+std::shared_ptr<Action> ScriptBuilder::createAction(const ActionType type, const int number1, const int number2)
+{
+    switch(type) {
+    case ActionType::SetGoal:
+        return std::make_shared<Actions::SetGoal>(number1, number2);
+    case ActionType::EnableTimer:
+        return std::make_shared<Actions::EnableTimer>(number1, number2);
+    default:
+        WARN << "unimplemented action" << type << number1 << number2;
+        break;
+    }
+
+    return nullptr;
+}
+
+std::shared_ptr<Action> ScriptBuilder::createAction(const ActionType type, const int number)
+{
+    switch(type) {
+    case ActionType::DisableTimer:
+        return std::make_shared<Actions::DisableTimer>(number);
+    default:
+        break;
+    }
+
+    WARN << "unimplemented action" << type << number;
+    return nullptr;
+}
+
+std::shared_ptr<Action> ScriptBuilder::createAction(const ActionType type, const int number, const WallType wallType)
+{
+    WARN << "unimplemented action" << type << number << wallType;
+    return nullptr;
+}
+
+std::shared_ptr<Action> ScriptBuilder::createAction(const ActionType type, const Age age)
+{
+    switch(type) {
+    case ActionType::Research:
+        return std::make_shared<Actions::Research>(age);
+    default:
+        WARN << "unimplemented action" << type << age;
+        break;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<Action> ScriptBuilder::createAction(const ActionType type, const Building building)
+{
+    switch(type) {
+    case ActionType::Build:
+        return std::make_shared<Actions::BuildBuilding>(building);
+    default:
+        WARN << "unimplemented action" << type << building;
+        break;
+    }
+
+    return nullptr;
+}
+
+std::shared_ptr<Action> ScriptBuilder::createAction(const ActionType type, const ResearchItem research)
+{
+    switch(type) {
+    case ActionType::Research:
+        return std::make_shared<Actions::Research>(research, m_script->m_player);
+    default:
+        WARN << "unimplemented action" << type << research;
+        break;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<Action> ScriptBuilder::createAction(const ActionType type, const Commodity commodity)
+{
+    switch(type) {
+    case ActionType::BuyCommodity:
+        return std::make_shared<Actions::BuyCommodity>(commodity, 100);
+    case ActionType::SellCommodity:
+        return std::make_shared<Actions::SellCommodity>(commodity, 100);
+    case ActionType::ReleaseEscrow:
+        return std::make_shared<Actions::ReleaseEscrow>(commodity);
+    default:
+        WARN << "unimplemented action" << type << commodity;
+        break;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<Action> ScriptBuilder::createAction(const ActionType type, const Unit unit)
+{
+    switch(type) {
+    case ActionType::Train:
+        return std::make_shared<Actions::TrainUnit>(unit, m_script->m_player);
+    default:
+        WARN << "unimplemented action" << type << unit;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<Action> ScriptBuilder::createAction(const ActionType type, const Commodity commodity, const int number)
+{
+    switch(type) {
+    case ActionType::SetEscrowPercentage:
+        return std::make_shared<Actions::SetEscrowPercent>(commodity, number);
+    case ActionType::CcAddResource:
+        return std::make_shared<Actions::CheatAddResource>(commodity, number);
+    default:
+        WARN << "unimplemented action" << type << commodity << number;
+        break;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<Action> ScriptBuilder::createAction(const ActionType type, const PlayerNumberType playernumber, const int number)
+{
+    WARN << "unimplemented action" << type << playernumber << number;
+    return nullptr;
+}
+
+std::shared_ptr<Action> ScriptBuilder::createAction(const ActionType type, const StrategicNumberName strategicNumber, const int number)
+{
+    switch(type) {
+    case ActionType::SetStrategicNumber:
+        return std::make_shared<Actions::SetStrategicNumber>(strategicNumber, number);
+    default:
+        WARN << "unimplemented action" << type << strategicNumber << number;
+        break;
+    }
+
+    return nullptr;
+}
+
+std::shared_ptr<Action> ScriptBuilder::createAction(const ActionType type, const PlayerNumberType playernumber, const Commodity commodity, const int number)
+{
+    WARN << "unimplemented action" << type << playernumber << commodity << number;
+    return nullptr;
+}
+
+std::shared_ptr<Action> ScriptBuilder::createAction(const ActionType type, const PlayerNumberType playernumber, const std::string &string)
+{
+    WARN << "unimplemented action" << type << playernumber << string;
+    return nullptr;
+}
+
+std::shared_ptr<Action> ScriptBuilder::createAction(const ActionType type, const PlayerNumberType playernumber, const DiplomaticStance stance)
+{
+    WARN << "unimplemented action" << type << playernumber << stance;
+    return nullptr;
+}
+
+std::shared_ptr<Action> ScriptBuilder::createAction(const ActionType type, const PlayerNumberType playernumber, const Commodity commodity)
+{
+    WARN << "unimplemented action" << type << playernumber << commodity;
+    return nullptr;
+}
+
+std::shared_ptr<Action> ScriptBuilder::createAction(const ActionType type, const DifficultyParameter difficulty, const int number)
+{
+    WARN << "unimplemented action" << type << difficulty << number;
+    return nullptr;
+}
+
+std::shared_ptr<Action> ScriptBuilder::createAction(const ActionType type, const PlayerNumberType playernumber, const int number1, const int number2)
+{
+    WARN << "unimplemented action" << type << playernumber << number1 << number2;
+    return nullptr;
+}
+
+
+} // namespace ai
@@ -1,29 +1,35 @@
 #pragma once
 
+#include "ai/CompiledScript.h"
 #include "ai/gen/enums.h"
 
 #include <string>
 #include <map>
+#include <initializer_list>
 #include <iostream>
 #include <memory>
 #include <vector>
 
-struct AiPlayer;
-
 namespace ai {
 
 struct Condition;
 struct Action;
-struct AiRule;
-struct AiScript;
 
+/// Driver for the parser, it doesn't create anything itself but records what
+/// the parser asks for into a CompiledScript. The conditions and actions it
+/// returns are just placeholders pointing into that.
+///
+/// Use ScriptCache instead of this directly, and ScriptBuilder to get
+/// something a player can run.
 class ScriptLoader {
 public:
-    ScriptLoader(AiPlayer *player);
+    ScriptLoader();
     virtual ~ScriptLoader();
 
     int parse(std::istream& in, std::ostream& out);
 
+    std::shared_ptr<const CompiledScript> result() const { return m_compiled; }
+
     std::shared_ptr<Condition> createCondition(const Fact type);
     std::shared_ptr<Condition> createCondition(const Fact type, const Age age);
     std::shared_ptr<Condition> createCondition(const Fact type, const Building building);
@@ -83,7 +89,13 @@ public:
     void addRule(const std::vector<std::shared_ptr<Condition>> &conditions, const std::vector<std::shared_ptr<Action>> &actions);
 
 private:
-    std::shared_ptr<AiScript> m_script;
+    std::shared_ptr<Condition> recordCondition(const CompiledScript::ConditionCall type, const std::initializer_list<int> arguments);
+    std::shared_ptr<Action> recordAction(const CompiledScript::ActionCall type, const std::initializer_list<int> arguments);
+    uint32_t recordedIndex(const std::shared_ptr<Condition> &condition);
+    int addString(const std::string &string);
+
+    std::shared_ptr<CompiledScript> m_compiled;
+    std::map<std::string, int> m_stringIndices;
 };
 
 }
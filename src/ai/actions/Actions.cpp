@@ -4,6 +4,7 @@
 #include "ai/AiScript.h"
 #include "ai/EnumLogDefs.h"
 #include "ai/AiPlayer.h"
+#include "ai/BasePlanner.h"
 #include "ai/Ids.h"
 
 #include "core/Logger.h"
@@ -16,6 +17,26 @@
 
 #include <algorithm>
 
+namespace {
+
+// Spread the production over all the buildings that can do it
+::Building *leastBusyBuilding(const Player *player, const int typeId)
+{
+    ::Building *ret = nullptr;
+    for (::Unit *unit : player->findUnitsByTypeID(typeId)) {
+        if (!unit->isBuilding() || unit->creationProgress() < 1.f) {
+            continue;
+        }
+        ::Building *building = static_cast<::Building*>(unit);
+        if (!ret || building->productionQueueLength() < ret->productionQueueLength()) {
+            ret = building;
+        }
+    }
+    return ret;
+}
+
+} // namespace
+
 void ai::Actions::SetStrategicNumber::execute(AiRule *rule)
 {
     rule->m_owner->strategicNumbers[m_strategicNumber] = m_targetValue;
@@ -28,14 +49,7 @@ ai::Action::~Action()
 
 void ai::Actions::DisableSelf::execute(ai::AiRule *rule)
 {
-    // goddamn msvc and their slow standard support
-    rule->m_owner->rules.erase(std::remove_if(
-        rule->m_owner->rules.begin(),
-        rule->m_owner->rules.end(),
-        [=](const std::shared_ptr<AiRule> &containedRule) {
-            return containedRule.get() == rule;
-        }
-    ), rule->m_owner->rules.end());
+    rule->m_owner->disableRule(rule);
 }
 
 ai::Actions::BuyCommodity::BuyCommodity(const Commodity commodity, const int amount) :
@@ -63,36 +77,29 @@ ai::Actions::BuyCommodity::BuyCommodity(const Commodity commodity, const int amo
         WARN << "Unhandled commodity for trade" << commodity;
         break;
     }
-
-    EventManager::registerListener(this, EventManager::TradingPriceChanged);
 }
 
 void ai::Actions::BuyCommodity::execute(AiRule *rule)
 {
-    Player *player = rule->m_owner->m_player;
-    const int goldAvailable = player->resourcesAvailable(genie::ResourceType::GoldStorage);
-    const int cost = m_tradingPrice * m_amount * 1.3;
-    const bool canTrade = goldAvailable >= cost;
-
-    if (!canTrade) {
-        WARN << "tried to trade without enough resources" << goldAvailable << cost;
-        return;
-    }
-    player->removeResource(genie::ResourceType::GoldStorage, cost);
-    player->addResource(m_resourceType, m_amount);
-    EventManager::resourceBought(m_resourceType, m_amount);
-}
-
-void ai::Actions::BuyCommodity::onTradingPriceChanged(const genie::ResourceType type, const int newPrice)
-{
-    if (type != m_resourceType) {
-        return;
-    }
-
-    m_tradingPrice = newPrice;
+    // The price the script saw when it decided to buy
+    const int cost = rule->m_owner->facts()->tradingPrice(m_resourceType) * m_amount * 1.3;
+    const genie::ResourceType resourceType = m_resourceType;
+    const int amount = m_amount;
+
+    rule->m_owner->queueCommand([=](AiPlayer *player) {
+        const int goldAvailable = player->resourcesAvailable(genie::ResourceType::GoldStorage);
+        if (goldAvailable < cost) {
+            WARN << "tried to trade without enough resources" << goldAvailable << cost;
+            return;
+        }
+        player->removeResource(genie::ResourceType::GoldStorage, cost);
+        player->addResource(resourceType, amount);
+        EventManager::resourceBought(resourceType, amount);
+    });
 }
 
-ai::Actions::SellCommodity::SellCommodity(const ai::Commodity commodity, const int amount)
+ai::Actions::SellCommodity::SellCommodity(const ai::Commodity commodity, const int amount) :
+    m_amount(amount)
 {
     if (amount % 100 != 0) {
         WARN << "Invalid amount to sell:" << amount;
@@ -116,33 +123,25 @@ ai::Actions::SellCommodity::SellCommodity(const ai::Commodity commodity, const i
         WARN << "Unhandled commodity for trade" << commodity;
         break;
     }
-
-    EventManager::registerListener(this, EventManager::TradingPriceChanged);
-}
-
-void ai::Actions::SellCommodity::onTradingPriceChanged(const genie::ResourceType type, const int newPrice)
-{
-    if (type != m_resourceType) {
-        return;
-    }
-
-    m_tradingPrice = newPrice;
 }
 
 void ai::Actions::SellCommodity::execute(ai::AiRule *rule)
 {
-    Player *player = rule->m_owner->m_player;
-    const int resourceAvailable = player->resourcesAvailable(m_resourceType);
-    const bool canTrade = resourceAvailable >= m_amount;
-
-    if (!canTrade) {
-        WARN << "tried to trade without enough resources" << resourceAvailable << m_amount;
-        return;
-    }
-    const int price = m_tradingPrice * m_amount * 0.7;
-    player->removeResource(m_resourceType, m_amount);
-    player->addResource(genie::ResourceType::GoldStorage, price);
-    EventManager::resourceSold(m_resourceType, m_amount);
+    // The price the script saw when it decided to sell
+    const int price = rule->m_owner->facts()->tradingPrice(m_resourceType) * m_amount * 0.7;
+    const genie::ResourceType resourceType = m_resourceType;
+    const int amount = m_amount;
+
+    rule->m_owner->queueCommand([=](AiPlayer *player) {
+        const int resourceAvailable = player->resourcesAvailable(resourceType);
+        if (resourceAvailable < amount) {
+            WARN << "tried to trade without enough resources" << resourceAvailable << amount;
+            return;
+        }
+        player->removeResource(resourceType, amount);
+        player->addResource(genie::ResourceType::GoldStorage, price);
+        EventManager::resourceSold(resourceType, amount);
+    });
 }
 
 ai::Actions::SetEscrowPercent::SetEscrowPercent(const Commodity commodity, const int targetValue) :
@@ -205,10 +204,12 @@ ai::Actions::ReleaseEscrow::ReleaseEscrow(const ai::Commodity commodity)
 
 void ai::Actions::ReleaseEscrow::execute(ai::AiRule *rule)
 {
-    AiPlayer *player = rule->m_owner->m_player;
-    const float newAmount = player->resourcesAvailableWithEscrow(m_resourceType);
-    player->m_reserves[m_resourceType] = 0;
-    player->setAvailableResource(m_resourceType, newAmount);
+    const genie::ResourceType resourceType = m_resourceType;
+    rule->m_owner->queueCommand([=](AiPlayer *player) {
+        const float newAmount = player->resourcesAvailableWithEscrow(resourceType);
+        player->m_reserves[resourceType] = 0;
+        player->setAvailableResource(resourceType, newAmount);
+    });
 }
 
 void ai::Actions::ShowDebugMessage::execute(ai::AiRule *rule)
@@ -223,12 +224,14 @@ ai::Actions::TrainUnit::TrainUnit(const ai::Unit unit, const Player *player) :
 
 void ai::Actions::TrainUnit::execute(ai::AiRule *rule)
 {
-    Player *player = rule->m_owner->m_player;
-    for (const int id : m_unitIds) {
-        if (tryTrain(player, id)) {
-            return;
+    // Copy, the rule might be gone when it runs
+    rule->m_owner->queueCommand([unitIds = m_unitIds](AiPlayer *player) {
+        for (const int id : unitIds) {
+            if (tryTrain(player, id)) {
+                return;
+            }
         }
-    }
+    });
 }
 
 bool ai::Actions::TrainUnit::tryTrain(Player *player, int unitId)
@@ -240,42 +243,36 @@ bool ai::Actions::TrainUnit::tryTrain(Player *player, int unitId)
         return false;
     }
 
-    // TODO: shared_ptr
-    ::Unit *creator = player->findUnitByTypeID(trainlocationId);
-    if (!creator) {
+    ::Building *building = leastBusyBuilding(player, trainlocationId);
+    if (!building) {
         WARN << "failed to find a training location for" << data.Name;
         return false;
     }
 
-    if (!creator->isBuilding()) {
-        WARN << "for now only buildings can create units..";
-        DBG << "fixme in case there's some other units that can train units";
-        return false;
-    }
-
-    ::Building *building = static_cast<::Building*>(creator);
     building->enqueueProduceUnit(&data); // yeah yeah pointers lol
 
     return true;
 }
 
 ai::Actions::BuildBuilding::BuildBuilding(const ai::Building building) :
-    m_unitIds(unitIds(building))
+    m_unitIds(unitIds(building)),
+    m_placementKind(BasePlanner::placementKind(building))
 {
 
 }
 
 void ai::Actions::BuildBuilding::execute(ai::AiRule *rule)
 {
-    Player *player = rule->m_owner->m_player;
-    for (const int id : m_unitIds) {
-        if (tryBuild(player, id)) {
-            return;
+    rule->m_owner->queueCommand([unitIds = m_unitIds, placementKind = m_placementKind](AiPlayer *player) {
+        for (const int id : unitIds) {
+            if (tryBuild(player, id, placementKind)) {
+                return;
+            }
         }
-    }
+    });
 }
 
-bool ai::Actions::BuildBuilding::tryBuild(Player *player, int unitId)
+bool ai::Actions::BuildBuilding::tryBuild(AiPlayer *player, int unitId, const BasePlanner::PlacementKind placementKind)
 {
     if (!player->canAffordUnit(unitId)) {
         return false;
@@ -288,6 +285,15 @@ bool ai::Actions::BuildBuilding::tryBuild(Player *player, int unitId)
         return false;
     }
 
+    BasePlanner *planner = player->basePlanner();
+    REQUIRE(planner, return false);
+
+    MapPos pos;
+    if (!planner->findPlacement(data, placementKind, &pos)) {
+        WARN << "Failed to find a place for" << data.Name;
+        return false;
+    }
+
     // TODO: shared_ptr
     std::vector<::Unit *> builders = player->findUnitsByTypeID(builderId);
     if (builders.empty()) {
@@ -296,20 +302,29 @@ bool ai::Actions::BuildBuilding::tryBuild(Player *player, int unitId)
     }
     ::Unit *builder = nullptr;
     Task task;
+    float builderDistance = 0.f;
 
+    // Whoever is closest
     for (::Unit *unit : builders) {
+        Task buildTask;
         for (const Task &potential : unit->actions.availableActions()) {
             if (potential.data->ActionType == genie::ActionType::Build) {
-                task = potential;
+                buildTask = potential;
                 break;
             }
         }
-        if (!task.data) {
+        if (!buildTask.data) {
+            continue;
+        }
+
+        const float distance = unit->position().distance(pos);
+        if (builder && distance >= builderDistance) {
             continue;
         }
 
         builder = unit;
-        break;
+        task = buildTask;
+        builderDistance = distance;
     }
 
     if (!builder) {
@@ -324,8 +339,6 @@ bool ai::Actions::BuildBuilding::tryBuild(Player *player, int unitId)
         return false;
     }
 
-    // TODO: find proper placement, for now just place it by the builder
-    MapPos pos = builder->position() + unit->clearanceSize() * 1.1; // meh, just some spacing
     builder->unitManager().add(unit, pos);
 
     buildingToPlace->setCreationProgress(0);
@@ -359,29 +372,32 @@ ai::Actions::Research::Research(const ai::Age age) :
 
 void ai::Actions::Research::execute(ai::AiRule *rule)
 {
-    Player *player = rule->m_owner->m_player;
-    if (!player->canAffordResearch(m_researchId)) {
+    rule->m_owner->queueCommand([researchId = m_researchId](AiPlayer *player) {
+        tryResearch(player, researchId);
+    });
+}
+
+void ai::Actions::Research::tryResearch(Player *player, const int researchId)
+{
+    if (!player->canAffordResearch(researchId)) {
         WARN << "Tried to research without enough resources";
         return;
     }
 
-    const genie::Tech *tech = &player->civilization.tech(m_researchId);
-    const int researchLocation = tech->ResearchLocation;
-    for (::Unit *unit : player->findUnitsByTypeID(researchLocation)) {
-        if (!unit->isBuilding()) {
-            DBG << "Can only research at buildings for now, sorry";
-            continue;
-        }
-        ::Building *building = static_cast<::Building*>(unit);
-        building->enqueueProduceResearch(tech);
+    const genie::Tech *tech = &player->civilization.tech(researchId);
+    ::Building *building = leastBusyBuilding(player, tech->ResearchLocation);
+    if (!building) {
+        WARN << "Failed to find a location to produce";
         return;
     }
-    WARN << "Failed to find a location to produce";
+    building->enqueueProduceResearch(tech);
 }
 
 void ai::Actions::Resign::execute(ai::AiRule *rule)
 {
-    rule->m_owner->m_player->resign();
+    rule->m_owner->queueCommand([](AiPlayer *player) {
+        player->resign();
+    });
 }
 
 void ai::Actions::DisableTimer::execute(ai::AiRule *rule)
@@ -422,5 +438,9 @@ ai::Actions::CheatAddResource::CheatAddResource(const ai::Commodity commodity, c
 
 void ai::Actions::CheatAddResource::execute(ai::AiRule *rule)
 {
-    rule->m_owner->m_player->addResource(m_resourceType, m_amount);
+    const genie::ResourceType resourceType = m_resourceType;
+    const int amount = m_amount;
+    rule->m_owner->queueCommand([=](AiPlayer *player) {
+        player->addResource(resourceType, amount);
+    });
 }
@@ -2,6 +2,7 @@
 
 #include "core/Types.h"
 #include "ai/gen/enums.h"
+#include "ai/BasePlanner.h"
 
 #include "global/EventListener.h"
 #include <genie/dat/ResourceType.h>
@@ -9,6 +10,8 @@
 #include <string>
 #include <unordered_set>
 
+struct AiPlayer;
+
 namespace ai {
 
 struct AiRule;
@@ -40,29 +43,25 @@ struct Resign : public Action
     void execute(AiRule *rule) override;
 };
 
-struct BuyCommodity : public Action, EventListener
+struct BuyCommodity : public Action
 {
     BuyCommodity(const Commodity commodity, const int amount);
 
     void execute(AiRule *rule) override;
-    void onTradingPriceChanged(const genie::ResourceType type, const int newPrice) override;
 
 private:
     genie::ResourceType m_resourceType = genie::ResourceType::InvalidResource;
-    int m_tradingPrice = 100;
     int m_amount;
 };
 
-struct SellCommodity : public Action, EventListener
+struct SellCommodity : public Action
 {
     SellCommodity(const Commodity commodity, const int amount);
 
     void execute(AiRule *rule) override;
-    void onTradingPriceChanged(const genie::ResourceType type, const int newPrice) override;
 
 private:
     genie::ResourceType m_resourceType = genie::ResourceType::InvalidResource;
-    int m_tradingPrice = 100;
     int m_amount;
 };
 
@@ -100,7 +99,7 @@ struct TrainUnit : public Action
     void execute(AiRule *rule) override;
 
 private:
-    bool tryTrain(Player *player, int unitId);
+    static bool tryTrain(Player *player, int unitId);
 
     const std::unordered_set<int> m_unitIds;
 };
@@ -112,9 +111,10 @@ struct BuildBuilding : public Action
     void execute(AiRule *rule) override;
 
 private:
-    bool tryBuild(Player *player, int unitId);
+    static bool tryBuild(AiPlayer *player, int unitId, const BasePlanner::PlacementKind placementKind);
 
     const std::unordered_set<int> m_unitIds;
+    const BasePlanner::PlacementKind m_placementKind;
 };
 
 
@@ -135,6 +135,8 @@ struct Research : public Action
     void execute(AiRule *rule) override;
 
 private:
+    static void tryResearch(Player *player, const int researchId);
+
     const int m_researchId;
 };
 
@@ -155,7 +157,7 @@ struct EnableTimer : public Action
     const Time m_duration;
 };
 
-struct CheatAddResource : public Action, EventListener
+struct CheatAddResource : public Action
 {
     CheatAddResource(const Commodity commodity, const int amount);
     void execute(AiRule *rule) override;
@@ -7,6 +7,8 @@
 #include "ai/EnumLogDefs.h"
 #include "ai/AiPlayer.h"
 
+#include <algorithm>
+
 namespace ai {
 
 Condition::~Condition()
@@ -16,10 +18,11 @@ Condition::~Condition()
 
 namespace Conditions {
 
-ResourceValue::ResourceValue(const genie::ResourceType type, const RelOp comparison, const int targetValue, int playerId) :
+ResourceValue::ResourceValue(FactTable *facts, const genie::ResourceType type, const RelOp comparison, const int targetValue) :
+    FactCondition(facts, { FactTable::ResourcesChanged }),
     m_type(type),
-    m_relOp(comparison),
-    m_playerId(playerId)
+    m_targetValue(targetValue),
+    m_relOp(comparison)
 {
     if (type == genie::ResourceType::CurrentAge) {
         switch(Age(targetValue)) {
@@ -40,410 +43,157 @@ ResourceValue::ResourceValue(const genie::ResourceType type, const RelOp compari
             break;
         }
     }
-
-    EventManager::registerListener(this, EventManager::PlayerResourceChanged);
 }
 
-UnitTypeCount::UnitTypeCount(const Unit type, const RelOp comparison, const int targetValue, Player *player) :
+UnitTypeCount::UnitTypeCount(FactTable *facts, const Unit type, const RelOp comparison, const int targetValue, const bool allPlayers) :
+    FactCondition(facts, { FactTable::UnitCountsChanged }),
     m_targetValue(targetValue),
     m_relOp(comparison),
-    m_playerId(player ? player->playerId : -1)
+    m_allPlayers(allPlayers)
 {
-    m_typeIds = unitIds(type, player ? civFromId(player->civilization.id()) : Civ::MyCiv);
+    m_typeIds = unitIds(type, allPlayers ? Civ::MyCiv : civFromId(facts->player()->civilization.id()));
+    watchTypes();
 }
 
-UnitTypeCount::UnitTypeCount(const Building type, const RelOp comparison, const int targetValue, int playerId) :
+UnitTypeCount::UnitTypeCount(FactTable *facts, const Building type, const RelOp comparison, const int targetValue, const bool allPlayers) :
+    FactCondition(facts, { FactTable::UnitCountsChanged }),
     m_targetValue(targetValue),
     m_relOp(comparison),
-    m_playerId(playerId)
+    m_allPlayers(allPlayers)
 {
     m_typeIds = unitIds(type);
+    watchTypes();
 }
 
-UnitTypeCount::UnitTypeCount(const WallType type, const RelOp comparison, const int targetValue, int playerId) :
+UnitTypeCount::UnitTypeCount(FactTable *facts, const WallType type, const RelOp comparison, const int targetValue, const bool allPlayers) :
+    FactCondition(facts, { FactTable::UnitCountsChanged }),
     m_targetValue(targetValue),
     m_relOp(comparison),
-    m_playerId(playerId)
+    m_allPlayers(allPlayers)
 {
     m_typeIds = unitIds(type);
-
-    EventManager::registerListener(this, EventManager::UnitCreated);
-    EventManager::registerListener(this, EventManager::UnitDestroyed);
-    EventManager::registerListener(this, EventManager::UnitChangedOwner);
-    EventManager::registerListener(this, EventManager::UnitCaptured);
-}
-
-void UnitTypeCount::onUnitCreated(::Unit *unit)
-{
-    if (!m_typeIds.count(unit->data()->ID)) {
-        return;
-    }
-    if (m_playerId != -1 && unit->playerId() != m_playerId) {
-        return;
-    }
-    m_unitCount++;
-    onValueChanged();
-}
-
-void UnitTypeCount::onUnitDying(::Unit *unit)
-{
-    if (!m_typeIds.count(unit->data()->ID)) {
-        return;
-    }
-    if (m_playerId != -1 && unit->playerId() != m_playerId) {
-        return;
-    }
-    m_unitCount--;
-    onValueChanged();
-}
-
-void UnitTypeCount::onUnitOwnerChanged(::Unit *unit, int oldPlayerId, int newPlayerId)
-{
-    if (!m_typeIds.count(unit->data()->ID)) {
-        return;
-    }
-    if (m_playerId != -1 && oldPlayerId == m_playerId) {
-        m_unitCount--;
-        onValueChanged();
-    }
-    if (newPlayerId == m_playerId) {
-        m_unitCount++;
-        onValueChanged();
-    }
+    watchTypes();
 }
 
-void UnitTypeCount::onUnitCaptured(::Unit *unit, int oldPlayerId, int newPlayerId)
+void UnitTypeCount::watchTypes()
 {
-    if (!m_typeIds.count(unit->data()->ID)) {
-        return;
-    }
-    if (m_playerId != -1 && oldPlayerId == m_playerId) {
-        m_unitCount--;
-        onValueChanged();
-    }
-    if (newPlayerId == m_playerId) {
-        m_unitCount++;
-        onValueChanged();
+    for (const int typeId : m_typeIds) {
+        m_facts->watchUnitCount(typeId);
     }
 }
 
-void UnitTypeCount::onValueChanged()
+bool UnitTypeCount::check() const
 {
-    bool satisfied = CompareCondition::actualCompare(int(m_targetValue), m_relOp, m_unitCount);
-    if (satisfied != m_isSatisfied) {
-        m_isSatisfied = satisfied;
-        emit(SatisfiedChanged);
+    int unitCount = 0;
+    for (const int typeId : m_typeIds) {
+        unitCount += m_facts->unitTypeCount(typeId, m_allPlayers);
     }
+    return CompareCondition::actualCompare(int(m_targetValue), m_relOp, unitCount);
 }
 
-PopulationHeadroomCondition::PopulationHeadroomCondition(const RelOp comparison, const int targetValue, int playerId) :
-    m_relOp(comparison),
-    m_targetValue(targetValue),
-    m_playerId(playerId)
-{
-    EventManager::registerListener(this, EventManager::PlayerResourceChanged);
-}
-
-void PopulationHeadroomCondition::onPlayerResourceChanged(Player *player, const genie::ResourceType resourceType, float newValue)
+Condition::Key UnitTypeCount::key() const
 {
-    if (player->playerId != m_playerId) {
-        return;
-    }
-    switch(resourceType) {
-    case genie::ResourceType::CurrentPopulation:
-        m_housingAvailable = player->resourcesAvailable(genie::ResourceType::PopulationHeadroom) + newValue;
-        break;
-    case genie::ResourceType::PopulationHeadroom:
-        m_housingAvailable = newValue + player->resourcesUsed(genie::ResourceType::CurrentPopulation);
-        break;
-    default:
-        return;
-    }
-
-    const int populationCap = player->resourcesAvailable(genie::ResourceType::CurrentPopulation) + player->resourcesUsed(genie::ResourceType::CurrentPopulation);
-
-    DBG << "housing available:" << m_housingAvailable << "pop cap" << populationCap;
-    m_currentValue = populationCap - m_housingAvailable;
-
-    bool satisfied = CompareCondition::actualCompare(m_targetValue, m_relOp, m_currentValue);
-    if (satisfied == m_isSatisfied) {
-        return;
-    }
-    m_isSatisfied = satisfied;
-    emit(SatisfiedChanged);
+    Key ret = { UnitTypeCountKey, int(m_relOp), m_targetValue, m_allPlayers };
+    const size_t first = ret.size();
+    ret.insert(ret.end(), m_typeIds.begin(), m_typeIds.end());
+    std::sort(ret.begin() + first, ret.end()); // unordered_set
+    return ret;
 }
 
-CanTrainOrBuildCondition::CanTrainOrBuildCondition(const Unit type, const Player *player, bool withEscrow) :
-    m_playerId(player->playerId),
+CanTrainOrBuildCondition::CanTrainOrBuildCondition(FactTable *facts, const Unit type, bool withEscrow) :
+    FactCondition(facts, { FactTable::AvailabilityChanged }),
     m_withEscrow(withEscrow)
 {
-    m_typeIds = unitIds(type, civFromId(player->civilization.id()));
-    EventManager::registerListener(this, EventManager::PlayerResourceChanged);
+    m_typeIds = unitIds(type, civFromId(facts->player()->civilization.id()));
+    watchTypes();
 }
 
-CanTrainOrBuildCondition::CanTrainOrBuildCondition(const Building type, const int playerId, bool withEscrow) :
-    m_playerId(playerId),
+CanTrainOrBuildCondition::CanTrainOrBuildCondition(FactTable *facts, const Building type, bool withEscrow) :
+    FactCondition(facts, { FactTable::AvailabilityChanged }),
     m_withEscrow(withEscrow)
 {
     m_typeIds = unitIds(type);
-    EventManager::registerListener(this, EventManager::PlayerResourceChanged);
-
+    watchTypes();
 }
 
-void CanTrainOrBuildCondition::onPlayerResourceChanged(Player *player, const genie::ResourceType resourceType, float newValue)
+void CanTrainOrBuildCondition::watchTypes()
 {
-    // todo: I'm lazy, add the rest that we want to ignore
-    switch(resourceType) {
-    case genie::ResourceType::InvalidResource:
-    case genie::ResourceType::ConversionRange:
-    case genie::ResourceType::CurrentAge:
-    case genie::ResourceType::RelicsCaptured:
-    case genie::ResourceType::RemarkableDiscovery:
-    case genie::ResourceType::MonumentsCaptured:
-    case genie::ResourceType::UnitsKilled:
-    case genie::ResourceType::PercentMapExplored:
-    case genie::ResourceType::Faith:
-    case genie::ResourceType::FaithRechargingRate:
-    case genie::ResourceType::FarmFoodAmount:
-    case genie::ResourceType::CivilianPopulation:
-    case genie::ResourceType::MilitaryPopulation:
-    case genie::ResourceType::HitPointsKilled:
-    case genie::ResourceType::HitPointsRazed:
-        DBG << "Ignoring resource type" << resourceType;
-        return;
-
-    default:
-        break;
+    for (const int typeId : m_typeIds) {
+        m_facts->watchTrainable(typeId);
     }
-
-//    bool satisfied = checkCanBuild(player);
-//    if (satisfied == m_isSatisfied) {
-//        return;
-//    }
-
-//    m_isSatisfied = satisfied;
-    emit(SatisfiedChanged);
 }
 
-bool CanTrainOrBuildCondition::checkCanBuild(const AiPlayer *player) const
+bool CanTrainOrBuildCondition::check() const
 {
-    for (const int id : m_typeIds) {
-        if (m_withEscrow) {
-            if (!player->canAffordUnitWithEscrow(id)) {
-                continue;
-            }
-        } else {
-            if (!player->canAffordUnit(id)) {
-                continue;
-            }
-        }
-        const genie::Unit &data = player->civilization.unitData(id);
-        int16_t trainlocationId = data.Creatable.TrainLocationID;
-        if (trainlocationId < 0) {
-            WARN << "Failed to find unit where" << data.Name << "is created";
-            continue;
-        }
-        if (!player->findUnitByTypeID(trainlocationId)) {
-            continue;
+    for (const int typeId : m_typeIds) {
+        if (m_facts->canTrainOrBuild(typeId, m_withEscrow)) {
+            return true;
         }
     }
     return false;
+}
 
+Condition::Key CanTrainOrBuildCondition::key() const
+{
+    Key ret = { CanTrainOrBuildKey, m_withEscrow };
+    const size_t first = ret.size();
+    ret.insert(ret.end(), m_typeIds.begin(), m_typeIds.end());
+    std::sort(ret.begin() + first, ret.end());
+    return ret;
 }
 
-TechAvailableCondition::TechAvailableCondition(ResearchItem tech, Player *player, bool withEscrow) :
-    m_playerId(player->playerId),
-    m_techId(researchId(tech, civFromId(player->civilization.id()))),
+TechAvailableCondition::TechAvailableCondition(FactTable *facts, ResearchItem tech, bool withEscrow) :
+    FactCondition(facts, { FactTable::AvailabilityChanged }),
+    m_techId(researchId(tech, civFromId(facts->player()->civilization.id()))),
     m_withEscrow(withEscrow)
 {
     if (m_techId == -1) {
         WARN << "Unhandled tech" << tech;
     }
-    EventManager::registerListener(this, EventManager::ResearchComplete);
+    m_facts->watchResearch(m_techId);
 }
 
-TechAvailableCondition::TechAvailableCondition(Age targetAge, int playerId, bool withEscrow) :
-    m_playerId(playerId),
+TechAvailableCondition::TechAvailableCondition(FactTable *facts, Age targetAge, bool withEscrow) :
+    FactCondition(facts, { FactTable::AvailabilityChanged }),
     m_techId(researchId(targetAge)),
     m_withEscrow(withEscrow)
 {
     if (m_techId == -1) {
         WARN << "Unhandled age" << targetAge;
     }
-    EventManager::registerListener(this, EventManager::ResearchComplete);
-    EventManager::registerListener(this, EventManager::PlayerResourceChanged);
-}
-
-void TechAvailableCondition::onResearchCompleted(Player *player, int researchId)
-{
-    // meh not efficient who cares
-    emit(SatisfiedChanged);
-}
-
-void TechAvailableCondition::onPlayerResourceChanged(Player *player, const genie::ResourceType resourceType, float newValue)
-{
-    // meh not efficient who cares FIXME TODO I guess
-    emit(SatisfiedChanged);
-}
-
-bool TechAvailableCondition::satisfied(AiRule *owner)
-{
-    AiPlayer *player = owner->m_owner->m_player;
-    bool canAfford = false;
-    if (m_withEscrow) {
-        canAfford = player->canAffordResearchWithEscrow(m_techId);
-    } else {
-        canAfford = player->canAffordResearch(m_techId);
-    }
-    return player->researchAvailable(m_techId) && canAfford;
+    m_facts->watchResearch(m_techId);
 }
 
-CombatUnitsCount::CombatUnitsCount(Fact type, const RelOp comparison, int targetNumber, const int playerId) :
-    m_playerId(playerId),
+CombatUnitsCount::CombatUnitsCount(FactTable *facts, Fact type, const RelOp comparison, int targetNumber) :
+    FactCondition(facts, { FactTable::CombatUnitsChanged }),
     m_type(type),
     m_comparison(comparison),
     m_targetValue(targetNumber)
 {
-    EventManager::registerListener(this, EventManager::UnitChangedGroup);
-}
-
-
-bool Conditions::CombatUnitsCount::satisfied(AiRule *owner)
-{
-    m_isSatisfied = actualCheck(owner->m_owner->m_player);
-    return m_isSatisfied;
-}
-
-void ai::Conditions::CombatUnitsCount::onUnitChangedGroup(::Unit *unit, int oldGroup, int newGroup)
-{
-    if (unit->playerId() != m_playerId) {
-        return;
-    }
-
     switch (m_type) {
-    case Fact::DefendWarboatCount:
     case Fact::DefendSoldierCount:
-    case Fact::AttackWarboatCount:
-    case Fact::AttackSoldierCount:
-        // We only care about those who are either new defenders or attackers (i. e. assigned a group)
-        if (oldGroup != 0 && newGroup != 0) {
-            return;
-        }
+        m_group = FactTable::Defending;
         break;
-    default:
-        break;
-    }
-
-
-    Player::Ptr player = unit->player().lock();
-    if (!player) {
-        WARN << "unit without player!";
-        emit(SatisfiedChanged);// just in case
-        return;
-    }
-
-    const bool satisfied = actualCheck(player.get());
-    if (satisfied != m_isSatisfied) {
-        m_isSatisfied = satisfied;
-        emit(SatisfiedChanged);
-    }
-}
-
-bool CombatUnitsCount::actualCheck(Player *player) const
-{
-    std::vector<int> unitGroupsToCheck;
-
-    switch (m_type) {
     case Fact::DefendWarboatCount:
-    case Fact::DefendSoldierCount:
-        unitGroupsToCheck.push_back(0);
+        m_unitType = FactTable::Warboats;
+        m_group = FactTable::Defending;
         break;
-    case Fact::AttackWarboatCount:
     case Fact::AttackSoldierCount:
-        for (int i=1; i< player->unitGroupCount(); i++) {
-            unitGroupsToCheck.push_back(i);
-        }
+        m_group = FactTable::Attacking;
+        break;
+    case Fact::AttackWarboatCount:
+        m_unitType = FactTable::Warboats;
+        m_group = FactTable::Attacking;
         break;
-    case Fact::WarboatCount:
     case Fact::SoldierCount:
-        for (int i=0; i< player->unitGroupCount(); i++) {
-            unitGroupsToCheck.push_back(i);
-        }
         break;
-    default:
-        WARN << "unhandled type" << m_type;
-        return false;
-    }
-
-    int unitCount = 0;
-    for (const int group : unitGroupsToCheck) {
-        for (const ::Unit *unit : player->unitsInGroup(group)) {
-            if (!checkType(unit->data())) {
-                continue;
-            }
-            unitCount++;
-        }
-    }
-
-    return CompareCondition::actualCompare(m_targetValue, m_comparison, unitCount);
-}
-
-bool CombatUnitsCount::checkType(const genie::Unit *unit) const
-{
-    if (unit->Type < genie::Unit::CombatantType) {
-        return false;
-    }
-    if (unit->CombatLevel != genie::Unit::SoldierCombatLevel) {
-        return false;
-    }
-
-    switch (m_type) {
-    case Fact::DefendWarboatCount:
-    case Fact::AttackWarboatCount:
     case Fact::WarboatCount:
-        return unit->Class == genie::Unit::Warship;
-
-    case Fact::DefendSoldierCount:
-    case Fact::AttackSoldierCount:
-    case Fact::SoldierCount:
+        m_unitType = FactTable::Warboats;
         break;
-
     default:
         WARN << "unhandled type" << m_type;
-        return false;
+        break;
     }
-
-    return true;
-
-    // Could do this, but we just check combatlevel above
-//    switch (unit->Class) {
-//    case genie::Unit::Archer:
-//    case genie::Unit::Infantry:
-//    case genie::Unit::Cavalry:
-//    case genie::Unit::Conquistador:
-//    case genie::Unit::WarElephant:
-//    case genie::Unit::ElephantArcher:
-//    case genie::Unit::Phalanx:
-//    case genie::Unit::Petard:
-//    case genie::Unit::CavalryArcher:
-//    case genie::Unit::HandCannoneer:
-//    case genie::Unit::TwoHandedSwordsman:
-//    case genie::Unit::Pikeman:
-//    case genie::Unit::Scout:
-//    case genie::Unit::Spearman:
-
-//    case genie::Unit::Raider:
-//    case genie::Unit::CavalryRaider:
-
-//    case genie::Unit::SiegeWeapon:
-//    case genie::Unit::UnpackedSiegeUnit: // HMM
-//    case genie::Unit::PackedUnit: // HMMM
-//    case genie::Unit::Hero: // HMMMM
-//        return true;
-
-//    default:
-//        return false;
-//    }
 }
 
 Goal::Goal(const int goalId, const RelOp comparison, const int targetValue) :
@@ -510,12 +260,11 @@ bool EscrowAmount::satisfied(AiRule *owner)
 
     return CompareCondition::actualCompare(m_targetValue, m_comparison, m_script->escrowAmount(m_resourceType));
 }
-
-TradingPrice::TradingPrice(const BuyOrSell type, const Commodity commodity, const RelOp comparison, const int targetValue) :
+TradingPrice::TradingPrice(FactTable *facts, const BuyOrSell type, const Commodity commodity, const RelOp comparison, const int targetValue) :
+    FactCondition(facts, { FactTable::TradingPricesChanged }),
     m_type(type),
     m_comparison(comparison),
-    m_targetValue(targetValue),
-    m_tradingPrice(type == Buy ? 130 : 70) // default values, should hopefully be updated immediately
+    m_targetValue(targetValue)
 {
     switch(commodity) {
     case Commodity::Food:
@@ -534,38 +283,30 @@ TradingPrice::TradingPrice(const BuyOrSell type, const Commodity commodity, cons
         WARN << "Unhandled commodity for trading price" << commodity;
         break;
     }
-
-    EventManager::registerListener(this, EventManager::TradingPriceChanged);
 }
 
-void TradingPrice::onTradingPriceChanged(const genie::ResourceType type, const int newPrice)
+bool TradingPrice::check() const
 {
-    if (type != m_resourceType) {
-        return;
+    if (m_resourceType == genie::ResourceType::InvalidResource) {
+        return false;
     }
 
+    int tradingPrice = m_facts->tradingPrice(m_resourceType);
     switch(m_type) {
     case Buy:
-        m_tradingPrice = newPrice * 1.3;
+        tradingPrice *= 1.3;
         break;
     case Sell:
-        m_tradingPrice = newPrice * 0.7;
+        tradingPrice *= 0.7;
         break;
     }
 
-    const bool satisfied = CompareCondition::actualCompare(m_tradingPrice, m_comparison, m_targetValue);
-
-    if (satisfied == m_isSatisfied) {
-        return;
-    }
-    m_isSatisfied = satisfied;
-    emit(SatisfiedChanged);
-
+    return CompareCondition::actualCompare(tradingPrice, m_comparison, m_targetValue);
 }
 
-CanTrade::CanTrade(const Commodity resource, const CanTrade::BuyOrSell type, const int playerId) :
-    m_type(type),
-    m_playerId(playerId)
+CanTrade::CanTrade(FactTable *facts, const Commodity resource, const CanTrade::BuyOrSell type) :
+    FactCondition(facts, { FactTable::ResourcesChanged, FactTable::TradingPricesChanged }),
+    m_type(type)
 {
     switch(resource) {
     case Commodity::Food:
@@ -584,76 +325,22 @@ CanTrade::CanTrade(const Commodity resource, const CanTrade::BuyOrSell type, con
         WARN << "Unhandled commodity for trade" << resource;
         break;
     }
-
-    EventManager::registerListener(this, EventManager::TradingPriceChanged);
 }
 
-void CanTrade::onPlayerResourceChanged(Player *player, const genie::ResourceType type, float newValue)
+bool CanTrade::check() const
 {
-    if (player->playerId != m_playerId) {
-        return;
-    }
-
-    switch(m_type) {
-    case Sell:
-        if (type != m_resourceType) {
-            return;
-        }
-        break;
-    case Buy:
-        if (type != genie::ResourceType::GoldStorage) {
-            return;
-        }
-        break;
-    default:
-        WARN << "Invalid cantrade rule";
-        break;
-    }
-
-    m_resourceAvailable = newValue;
-
-    actualCheck();
-}
-
-void CanTrade::onTradingPriceChanged(const genie::ResourceType type, const int newPrice)
-{
-    if (type != m_resourceType) {
-        return;
-    }
-
-    m_tradingPrice = newPrice;
-
-    actualCheck();
-}
-
-bool CanTrade::satisfied(AiRule *owner)
-{
-    if (!m_resourceAvailable) {
-        if (m_type == Buy) {
-            m_resourceAvailable = owner->m_owner->m_player->resourcesAvailable(genie::ResourceType::GoldStorage);
-        } else {
-            m_resourceAvailable = owner->m_owner->m_player->resourcesAvailable(m_resourceType);
-        }
+    if (m_resourceType == genie::ResourceType::InvalidResource) {
+        return false;
     }
-    return m_isSatisfied;
-}
 
-void CanTrade::actualCheck()
-{
-    bool canTrade = false;
+    const int tradingPrice = m_facts->tradingPrice(m_resourceType);
 
     // idk I think this is right lol, math is hard
     if (m_type == Buy) {
-        canTrade = m_resourceAvailable >= m_tradingPrice * 1.3;
+        return m_facts->resource(genie::ResourceType::GoldStorage) >= tradingPrice * 1.3;
     } else {
-        canTrade = m_resourceAvailable * 0.7 >= m_tradingPrice;
-    }
-
-    if (canTrade == m_isSatisfied) {
-        return;
+        return m_facts->resource(m_resourceType) * 0.7 >= tradingPrice;
     }
-    m_isSatisfied = canTrade;
-    emit(SatisfiedChanged);
 }
 
 TimerTriggered::TimerTriggered(AiScript *script, const int id) :
@@ -2,6 +2,7 @@
 
 #include "ai/AiRule.h"
 #include "ai/AiScript.h"
+#include "ai/FactTable.h"
 #include "ai/gen/enums.h"
 
 #include "core/SignalEmitter.h"
@@ -12,6 +13,8 @@
 
 #include <genie/dat/ResourceUsage.h>
 
+#include <initializer_list>
+
 namespace ai {
 
 struct AiScript;
@@ -22,8 +25,32 @@ struct Condition : public EventListener, public SignalEmitter<Condition>, public
         SignalCount
     };
 
+    /// What it checks, so rules checking the same thing can share one.
+    /// Empty if it can't be shared.
+    typedef std::vector<int> Key;
+
     virtual ~Condition();
     virtual bool satisfied(AiRule *owner) = 0;
+    virtual Key key() const { return {}; }
+
+protected:
+    /// First in the keys, so different kinds of conditions with the same numbers don't get mixed up
+    enum KeyKind {
+        ConstantKey,
+        CompareKey,
+        ResourceValueKey,
+        UnitTypeCountKey,
+        PopulationHeadroomKey,
+        CanTrainOrBuildKey,
+        TechAvailableKey,
+        CombatUnitsCountKey,
+        GoalKey,
+        EscrowAmountKey,
+        TradingPriceKey,
+        CanTradeKey,
+        DifficultyKey,
+        TimerTriggeredKey
+    };
 };
 
 namespace Conditions {
@@ -33,6 +60,7 @@ struct ConstantCondition : public Condition
 {
     ConstantCondition(const bool _value) : value(_value) {}
     bool satisfied(AiRule * /*owner*/) override { return value; }
+    Key key() const override { return { ConstantKey, value }; }
     const bool value;
 };
 
@@ -137,147 +165,142 @@ struct CompareCondition : public Condition
     {
         return actualCompare(m_value1, m_comparison, m_value2);
     }
+    Key key() const override { return { CompareKey, m_value1, int(m_comparison), m_value2 }; }
 
     const int m_value1, m_value2;
     const RelOp m_comparison;
 };
 
-struct ResourceValue : public Condition
+/// For the things that are kept in the player's FactTable, just checks it
+/// again when the table says something it cares about changed.
+struct FactCondition : public Condition
 {
-    ResourceValue(const genie::ResourceType type, const RelOp comparison, const int targetValue, int playerId);
-    ~ResourceValue() {
-//        DBG << "Resource value dying" << m_type << m_targetValue;
+    FactCondition(FactTable *facts, const std::initializer_list<FactTable::Signals> &signals) :
+        m_facts(facts)
+    {
+        for (const FactTable::Signals signal : signals) {
+            m_facts->connect(signal, this, &FactCondition::onFactsChanged);
+        }
     }
 
-    void onPlayerResourceChanged(Player *player, const genie::ResourceType type, float newValue) override
+    bool satisfied(AiRule * /*owner*/) override
     {
-        if (type != m_type) {
-            return;
-        }
-        if (player->playerId != m_playerId) {
-            return;
-        }
+        m_isSatisfied = check();
+        return m_isSatisfied;
+    }
 
-        bool isSatisfied = CompareCondition::actualCompare(int(m_targetValue), m_relOp, newValue);
+    void onFactsChanged()
+    {
+        const bool isSatisfied = check();
         if (isSatisfied == m_isSatisfied) {
             return;
         }
         m_isSatisfied = isSatisfied;
-
         emit(SatisfiedChanged);
     }
 
-    bool satisfied(AiRule *owner) override
+    virtual bool check() const = 0;
+
+    FactTable *m_facts;
+    bool m_isSatisfied = false;
+};
+
+struct ResourceValue : public FactCondition
+{
+    ResourceValue(FactTable *facts, const genie::ResourceType type, const RelOp comparison, const int targetValue);
+
+    bool check() const override
     {
-        m_isSatisfied = CompareCondition::actualCompare(int(m_targetValue), m_relOp, owner->m_owner->m_player->currentAge());
-        return m_isSatisfied;
+        return CompareCondition::actualCompare(int(m_targetValue), m_relOp, m_facts->resource(m_type));
     }
+    Key key() const override { return { ResourceValueKey, int(m_type), int(m_relOp), m_targetValue }; }
 
     genie::ResourceType m_type = genie::ResourceType::InvalidResource;
     int m_targetValue;
     const RelOp m_relOp;
-    bool m_isSatisfied = false;
-    const int m_playerId;
 };
 
-struct UnitTypeCount : public Condition
+struct UnitTypeCount : public FactCondition
 {
-    UnitTypeCount(const Unit type, const RelOp comparison, const int targetValue, Player *player);
-    UnitTypeCount(const Building type, const RelOp comparison, const int targetValue, int playerId);
-    UnitTypeCount(const WallType type, const RelOp comparison, const int targetValue, int playerId);
+    /// allPlayers is for the -total variants
+    UnitTypeCount(FactTable *facts, const Unit type, const RelOp comparison, const int targetValue, const bool allPlayers);
+    UnitTypeCount(FactTable *facts, const Building type, const RelOp comparison, const int targetValue, const bool allPlayers);
+    UnitTypeCount(FactTable *facts, const WallType type, const RelOp comparison, const int targetValue, const bool allPlayers);
 
-    bool satisfied(AiRule *owner) override
-    {
-        m_isSatisfied = CompareCondition::actualCompare(int(m_targetValue), m_relOp, m_unitCount);
-        return m_isSatisfied;
-    }
-    void onValueChanged();
+    bool check() const override;
+    Key key() const override;
 
     std::unordered_set<int> m_typeIds;
     int m_targetValue;
     const RelOp m_relOp;
-    bool m_isSatisfied = false;
-    int m_unitCount = 0;
+    const bool m_allPlayers;
 
-    const int m_playerId; // -1 == any player
-
-    void onUnitCreated(::Unit *unit) override;
-    void onUnitDying(::Unit *unit) override;
-    void onUnitOwnerChanged(::Unit *unit, int oldPlayerId, int newPlayerId) override;
-    void onUnitCaptured(::Unit *unit, int oldPlayerId, int newPlayerId) override;
+private:
+    void watchTypes();
 };
 
-struct PopulationHeadroomCondition : public Condition
+struct PopulationHeadroomCondition : public FactCondition
 {
-    PopulationHeadroomCondition(const RelOp comparison, const int targetValue, int playerId);
-
-    void onPlayerResourceChanged(Player *player, const genie::ResourceType resourceType, float newValue) override;
-
-    bool satisfied(AiRule *owner) override {
-        return CompareCondition::actualCompare(m_targetValue, m_relOp, m_currentValue);
+    PopulationHeadroomCondition(FactTable *facts, const RelOp comparison, const int targetValue) :
+        FactCondition(facts, { FactTable::PopulationChanged }),
+        m_relOp(comparison),
+        m_targetValue(targetValue)
+    {}
+
+    bool check() const override {
+        return CompareCondition::actualCompare(m_targetValue, m_relOp, m_facts->populationHeadroom());
     }
+    Key key() const override { return { PopulationHeadroomKey, int(m_relOp), m_targetValue }; }
 
     const RelOp m_relOp;
     const int m_targetValue;
-    const int m_playerId;
-
-    int m_housingAvailable = 0;
-
-    bool m_isSatisfied = false;
-    int m_currentValue = 0;
 };
 
-struct CanTrainOrBuildCondition : public Condition
+struct CanTrainOrBuildCondition : public FactCondition
 {
-    CanTrainOrBuildCondition(const Unit type, const Player *player, bool withEscrow);
-    CanTrainOrBuildCondition(const Building type, const int playerId, bool withEscrow);
+    CanTrainOrBuildCondition(FactTable *facts, const Unit type, bool withEscrow);
+    CanTrainOrBuildCondition(FactTable *facts, const Building type, bool withEscrow);
 
-    void onPlayerResourceChanged(Player *player, const genie::ResourceType resourceType, float newValue) override;
-    bool satisfied(AiRule *owner) override {
-        return checkCanBuild(owner->m_owner->m_player);
-    }
-    bool checkCanBuild(const AiPlayer *player) const;
+    bool check() const override;
+    Key key() const override;
 
-    const int m_playerId;
     std::unordered_set<int> m_typeIds;
-//    bool m_isSatisfied = false;
     bool m_withEscrow = false;
+
+private:
+    void watchTypes();
 };
 
-struct TechAvailableCondition : public Condition
+struct TechAvailableCondition : public FactCondition
 {
-    TechAvailableCondition(ResearchItem tech, Player *player, bool withEscrow);
-    TechAvailableCondition(Age targetAge, int playerId, bool withEscrow);
+    TechAvailableCondition(FactTable *facts, ResearchItem tech, bool withEscrow);
+    TechAvailableCondition(FactTable *facts, Age targetAge, bool withEscrow);
 
-    const int m_playerId;
     const int m_techId;
     const bool m_withEscrow;
 
-    bool m_isSatisfied = false;
-    void onResearchCompleted(Player *player, int researchId) override;
-    void onPlayerResourceChanged(Player *player, const genie::ResourceType resourceType, float newValue) override;
-
-    bool satisfied(AiRule *owner) override;
+    bool check() const override { return m_facts->canResearch(m_techId, m_withEscrow); }
+    Key key() const override { return { TechAvailableKey, m_techId, m_withEscrow }; }
 };
 
-struct CombatUnitsCount : public Condition
+struct CombatUnitsCount : public FactCondition
 {
-    CombatUnitsCount(Fact type, const RelOp comparison, int targetNumber, const int playerId);
+    CombatUnitsCount(FactTable *facts, Fact type, const RelOp comparison, int targetNumber);
 
-    const int m_playerId;
     const Fact m_type;
     const RelOp m_comparison;
     const int m_targetValue;
-    bool m_isSatisfied = false;
 
-    bool satisfied(AiRule *owner) override;
-    void onUnitChangedGroup(::Unit *unit, int oldGroup, int newGroup) override;
+    FactTable::CombatUnitType m_unitType = FactTable::Soldiers;
+    FactTable::CombatUnitGroup m_group = FactTable::AllGroups;
 
-private:
-    bool actualCheck(Player *player) const;
-    bool checkType(const genie::Unit *unit) const;
+    bool check() const override {
+        return CompareCondition::actualCompare(m_targetValue, m_comparison, m_facts->combatUnitCount(m_unitType, m_group));
+    }
+    Key key() const override { return { CombatUnitsCountKey, int(m_type), int(m_comparison), m_targetValue }; }
 };
 
+
 struct Goal : public Condition
 {
     Goal(const int goalId, const RelOp comparison, const int targetValue);
@@ -293,12 +316,14 @@ struct Goal : public Condition
     AiScript *m_script = nullptr;
 
     bool satisfied(AiRule *owner) override;
+    Key key() const override { return { GoalKey, m_goalId, int(m_comparison), m_targetValue }; }
 };
 
 struct EscrowAmount : public Condition
 {
     EscrowAmount(const Commodity commodity, const RelOp comparison, const int targetValue);
     bool satisfied(AiRule *owner) override;
+    Key key() const override { return { EscrowAmountKey, int(m_resourceType), int(m_comparison), m_targetValue }; }
 
     const RelOp m_comparison;
     const int m_targetValue;
@@ -311,46 +336,35 @@ struct EscrowAmount : public Condition
     AiScript *m_script = nullptr;
 };
 
-struct TradingPrice : public Condition
+struct TradingPrice : public FactCondition
 {
     enum BuyOrSell {
         Buy,
         Sell
     } m_type;
 
-    TradingPrice(const BuyOrSell type, const Commodity commodity, const RelOp comparison, const int targetValue);
+    TradingPrice(FactTable *facts, const BuyOrSell type, const Commodity commodity, const RelOp comparison, const int targetValue);
 
     const RelOp m_comparison;
     const int m_targetValue;
-    int m_tradingPrice;
     genie::ResourceType m_resourceType = genie::ResourceType::InvalidResource;
-    bool m_isSatisfied = false; // todo: this is reused by everything, put it in Condition
 
-    void onTradingPriceChanged(const genie::ResourceType type, const int newPrice) override;
-    bool satisfied(AiRule *owner) override { return m_isSatisfied; }
+    bool check() const override;
+    Key key() const override { return { TradingPriceKey, int(m_type), int(m_resourceType), int(m_comparison), m_targetValue }; }
 };
 
-struct CanTrade : public Condition
+struct CanTrade : public FactCondition
 {
     genie::ResourceType m_resourceType = genie::ResourceType::InvalidResource;
     enum BuyOrSell {
         Buy,
         Sell
     } m_type;
-    const int m_playerId;
-
-    CanTrade(const Commodity resource, const BuyOrSell type, const int playerId);
-
-    int m_tradingPrice = 100;
-    int m_resourceAvailable = 0;
-    bool m_isSatisfied = false;
-
-    void onPlayerResourceChanged(Player *player, const genie::ResourceType type, float newValue) override;
-    void onTradingPriceChanged(const genie::ResourceType type, const int newPrice) override;
 
-    bool satisfied(AiRule *owner) override;
+    CanTrade(FactTable *facts, const Commodity resource, const BuyOrSell type);
 
-    void actualCheck();
+    bool check() const override;
+    Key key() const override { return { CanTradeKey, int(m_resourceType), int(m_type) }; }
 };
 
 struct DifficultyCondition : public Condition
@@ -363,6 +377,7 @@ struct DifficultyCondition : public Condition
         const ai::DifficultyLevel playerLevel = owner->m_owner->m_player->difficultyLevel;
         return CompareCondition::actualCompare(int(m_requirement), m_comparison, int(playerLevel));
     }
+    Key key() const override { return { DifficultyKey, int(m_comparison), int(m_requirement) }; }
 
     const ai::RelOp m_comparison;
     const ai::DifficultyLevel m_requirement;
@@ -374,6 +389,7 @@ struct TimerTriggered : public Condition
 
     void onTimerExpired();
     bool satisfied(AiRule * owner) override;
+    Key key() const override { return { TimerTriggeredKey, m_id }; }
 
     AiScript *m_script;
     int m_id = -1;
@@ -9410,7 +9410,7 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     std::ifstream in(argv[1]);
-    ai::ScriptLoader parser(0);
+    ai::ScriptLoader parser;
     return parser.parse(in, std::cout);
 }
 #endif
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stddef.h>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "IdIndex.h"
+
+/// Set of things with a `handle` (units, basically), with constant time contains/add/remove.
+///
+/// The items themselves are in a plain vector, so iterating is just iterating a vector,
+/// and there's an index from handle to position in that vector.
+///
+/// Items are kept in the order they are added, except that removing one moves the last
+/// one into its place.
+template<typename TYPE>
+struct DenseSet {
+    using const_iterator = typename std::vector<TYPE>::const_iterator;
+
+    DenseSet() = default;
+    DenseSet(const std::vector<TYPE> &items) { assign(items); }
+
+    inline const_iterator begin() const { return m_items.begin(); }
+    inline const_iterator end() const { return m_items.end(); }
+
+    inline bool isEmpty() const { return m_items.size() == 0; }
+    inline size_t size() const { return m_items.size(); }
+
+    inline const TYPE &first() const { assert(!isEmpty()); return m_items[0]; }
+
+    /// In iteration order, for whoever wants to keep a copy
+    inline const std::vector<TYPE> &items() const { return m_items; }
+
+    inline bool contains(const TYPE &item) const {
+        if (!item) {
+            return false;
+        }
+        return indexOf(item->handle) != Invalid;
+    }
+
+    /// Only adds if it isn't there already, returns false if it was
+    inline bool add(const TYPE &item) {
+        if (indexOf(item->handle) != Invalid) {
+            return false;
+        }
+        m_index.set(item->handle, m_items.size());
+        m_items.push_back(item);
+        return true;
+    }
+
+    inline bool remove(const TYPE &item) {
+        const uint32_t handle = item->handle;
+        const uint32_t index = indexOf(handle);
+        if (index == Invalid) {
+            return false;
+        }
+
+        if (index != m_items.size() - 1) {
+            m_items[index] = std::move(m_items.back());
+            m_index.set(m_items[index]->handle, index);
+        }
+        m_items.pop_back();
+        m_index.erase(handle);
+
+        return true;
+    }
+
+    void clear() {
+        for (const TYPE &item : m_items) {
+            m_index.erase(item->handle);
+        }
+        m_items.clear();
+    }
+
+    void assign(const std::vector<TYPE> &items) {
+        clear();
+        m_items.reserve(items.size());
+        for (const TYPE &item : items) {
+            add(item);
+        }
+    }
+
+private:
+    static constexpr uint32_t Invalid = IdIndex::Invalid;
+
+    inline uint32_t indexOf(const uint32_t handle) const { return m_index.get(handle); }
+
+    std::vector<TYPE> m_items;
+    IdIndex m_index;
+};
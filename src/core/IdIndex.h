@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stddef.h>
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+/// Maps entity handles to a position in some array.
+/// The handles get reused so they stay small, but there can be big holes after
+/// a lot of things die. So it is split in pages and we only allocate the pages
+/// that actually have something in them, and free them again when they empty.
+struct IdIndex {
+    static constexpr uint32_t Invalid = UINT32_MAX;
+
+    inline uint32_t get(const size_t handle) const {
+        const size_t page = handle >> PageBits;
+        if (page >= m_pages.size() || !m_pages[page]) {
+            return Invalid;
+        }
+        return m_pages[page]->entries[handle & (PageSize - 1)];
+    }
+
+    inline void set(const size_t handle, const uint32_t value) {
+        if (value == Invalid) {
+            erase(handle);
+            return;
+        }
+
+        const size_t page = handle >> PageBits;
+        if (page >= m_pages.size()) {
+            m_pages.resize(page + 1);
+        }
+        if (!m_pages[page]) {
+            m_pages[page] = std::make_unique<Page>();
+        }
+
+        uint32_t &entry = m_pages[page]->entries[handle & (PageSize - 1)];
+        if (entry == Invalid) {
+            m_pages[page]->used++;
+        }
+        entry = value;
+    }
+
+    inline void erase(const size_t handle) {
+        const size_t page = handle >> PageBits;
+        if (page >= m_pages.size() || !m_pages[page]) {
+            return;
+        }
+
+        uint32_t &entry = m_pages[page]->entries[handle & (PageSize - 1)];
+        if (entry == Invalid) {
+            return;
+        }
+        entry = Invalid;
+
+        m_pages[page]->used--;
+        if (m_pages[page]->used > 0) {
+            return;
+        }
+
+        m_pages[page].reset();
+        while (!m_pages.empty() && !m_pages.back()) {
+            m_pages.pop_back();
+        }
+    }
+
+    /// Number of pages allocated, for tests and memory usage
+    size_t pageCount() const {
+        size_t count = 0;
+        for (const std::unique_ptr<Page> &page : m_pages) {
+            count += page != nullptr;
+        }
+        return count;
+    }
+
+private:
+    static constexpr size_t PageBits = 10;
+    static constexpr size_t PageSize = 1 << PageBits;
+
+    struct Page {
+        Page() { std::fill(std::begin(entries), std::end(entries), Invalid); }
+
+        uint32_t entries[PageSize];
+        uint32_t used = 0;
+    };
+
+    std::vector<std::unique_ptr<Page>> m_pages;
+};
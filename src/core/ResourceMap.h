@@ -18,12 +18,237 @@
 #pragma once
 
 #include <genie/dat/ResourceType.h>
-#include <unordered_map>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+#include <vector>
 #include "Logger.h"
+#include "Utility.h"
 
-typedef std::unordered_map<genie::ResourceType, float> ResourceMap;
 typedef std::pair<const genie::ResourceType, float> ResourceEntry;
 
+/// Replacement for the unordered_map we used to have, looked up in every gather tick and
+/// cost check so it shouldn't hash or allocate.
+/// The types we actually use all the time (food, wood, population, etc.) are the low IDs,
+/// those live in a plain array with a bitmask of which are set. The rest (basically only
+/// the civ starting values and the rare effect target) go in a small sorted vector.
+///
+/// Iteration only visits the entries that have been set, in order of type.
+///
+/// How many are in the array is a template parameter, so units (which mostly only
+/// carry food, wood, stone or gold) don't pay for the big array the players need.
+template<int DENSE_COUNT>
+class BasicResourceMap
+{
+    static_assert(DENSE_COUNT <= 64, "only have 64 bits in the mask");
+
+public:
+    static constexpr int DenseCount = DENSE_COUNT;
+
+    class const_iterator
+    {
+    public:
+        struct Arrow {
+            ResourceEntry entry;
+            const ResourceEntry *operator->() const noexcept { return &entry; }
+        };
+
+        inline ResourceEntry operator*() const noexcept {
+            if (m_index < DenseCount) {
+                return ResourceEntry(genie::ResourceType(m_index), m_map->m_dense[m_index]);
+            }
+            const SparseEntry &entry = m_map->m_sparse[m_index - DenseCount];
+            return ResourceEntry(entry.first, entry.second);
+        }
+        inline Arrow operator->() const noexcept { return Arrow{ **this }; }
+
+        inline const_iterator &operator++() noexcept {
+            m_index = m_map->nextIndex(m_index + 1);
+            return *this;
+        }
+
+        inline bool operator==(const const_iterator &other) const noexcept { return m_index == other.m_index; }
+        inline bool operator!=(const const_iterator &other) const noexcept { return m_index != other.m_index; }
+
+    private:
+        friend class BasicResourceMap;
+        const_iterator(const BasicResourceMap *map, const size_t index) : m_map(map), m_index(index) {}
+
+        const BasicResourceMap *m_map;
+        size_t m_index;
+    };
+
+    BasicResourceMap() = default;
+    BasicResourceMap(std::initializer_list<std::pair<genie::ResourceType, float>> entries) {
+        for (const std::pair<genie::ResourceType, float> &entry : entries) {
+            (*this)[entry.first] = entry.second;
+        }
+    }
+
+    /// Inserts a zero if it isn't there, like the map did
+    inline float &operator[](const genie::ResourceType type) {
+        const int index = int(type);
+        if (IS_LIKELY(isDense(index))) {
+            m_present |= uint64_t(1) << index;
+            return m_dense[index];
+        }
+
+        typename std::vector<SparseEntry>::iterator it = sparseLowerBound(type);
+        if (it == m_sparse.end() || it->first != type) {
+            it = m_sparse.insert(it, SparseEntry(type, 0.f));
+        }
+        return it->second;
+    }
+
+    /// Doesn't insert anything, 0 if not set
+    inline float value(const genie::ResourceType type) const noexcept {
+        const int index = int(type);
+        if (IS_LIKELY(isDense(index))) {
+            return m_dense[index]; // unset ones are always 0
+        }
+
+        typename std::vector<SparseEntry>::const_iterator it = sparseLowerBound(type);
+        if (it == m_sparse.end() || it->first != type) {
+            return 0.f;
+        }
+        return it->second;
+    }
+
+    inline bool contains(const genie::ResourceType type) const noexcept {
+        const int index = int(type);
+        if (IS_LIKELY(isDense(index))) {
+            return m_present & (uint64_t(1) << index);
+        }
+        typename std::vector<SparseEntry>::const_iterator it = sparseLowerBound(type);
+        return it != m_sparse.end() && it->first == type;
+    }
+
+    inline const_iterator find(const genie::ResourceType type) const noexcept {
+        if (!contains(type)) {
+            return end();
+        }
+        const int index = int(type);
+        if (isDense(index)) {
+            return const_iterator(this, index);
+        }
+        return const_iterator(this, DenseCount + (sparseLowerBound(type) - m_sparse.begin()));
+    }
+
+    inline const_iterator begin() const noexcept { return const_iterator(this, nextIndex(0)); }
+    inline const_iterator end() const noexcept { return const_iterator(this, DenseCount + m_sparse.size()); }
+
+    inline size_t size() const noexcept { return std::popcount(m_present) + m_sparse.size(); }
+    inline bool empty() const noexcept { return m_present == 0 && m_sparse.empty(); }
+
+    /// What is allocated outside of the object itself
+    size_t heapBytes() const noexcept { return m_sparse.capacity() * sizeof(SparseEntry); }
+
+    void clear() noexcept {
+        m_dense.fill(0.f);
+        m_present = 0;
+        m_sparse.clear();
+    }
+
+    ///////////////////
+    /// Bulk helpers, for cost checks and similar
+
+    /// If we have at least what is in the cost (after subtracting what is in use)
+    bool canAfford(const BasicResourceMap &cost, const BasicResourceMap &used) const noexcept {
+        for (uint64_t bits = cost.m_present; bits; bits &= bits - 1) {
+            const int index = std::countr_zero(bits);
+            if (m_dense[index] - used.m_dense[index] < cost.m_dense[index]) {
+                return false;
+            }
+        }
+        for (const SparseEntry &entry : cost.m_sparse) {
+            if (value(entry.first) - used.value(entry.first) < entry.second) {
+                return false;
+            }
+        }
+        return true;
+    }
+    bool canAfford(const BasicResourceMap &cost) const noexcept { return canAfford(cost, BasicResourceMap()); }
+
+    BasicResourceMap &operator+=(const BasicResourceMap &other) {
+        for (uint64_t bits = other.m_present; bits; bits &= bits - 1) {
+            const int index = std::countr_zero(bits);
+            m_dense[index] += other.m_dense[index];
+        }
+        m_present |= other.m_present;
+        for (const SparseEntry &entry : other.m_sparse) {
+            (*this)[entry.first] += entry.second;
+        }
+        return *this;
+    }
+
+    BasicResourceMap &operator-=(const BasicResourceMap &other) {
+        for (uint64_t bits = other.m_present; bits; bits &= bits - 1) {
+            const int index = std::countr_zero(bits);
+            m_dense[index] -= other.m_dense[index];
+        }
+        m_present |= other.m_present;
+        for (const SparseEntry &entry : other.m_sparse) {
+            (*this)[entry.first] -= entry.second;
+        }
+        return *this;
+    }
+
+    /// Overwrites whatever is set in the other one, leaves the rest alone
+    void overrideWith(const BasicResourceMap &other) {
+        for (uint64_t bits = other.m_present; bits; bits &= bits - 1) {
+            const int index = std::countr_zero(bits);
+            m_dense[index] = other.m_dense[index];
+        }
+        m_present |= other.m_present;
+        for (const SparseEntry &entry : other.m_sparse) {
+            (*this)[entry.first] = entry.second;
+        }
+    }
+
+private:
+    typedef std::pair<genie::ResourceType, float> SparseEntry;
+
+    static inline bool isDense(const int index) noexcept {
+        return unsigned(index) < unsigned(DenseCount);
+    }
+
+    inline typename std::vector<SparseEntry>::iterator sparseLowerBound(const genie::ResourceType type) {
+        return std::lower_bound(m_sparse.begin(), m_sparse.end(), type, [](const SparseEntry &entry, const genie::ResourceType t) {
+            return int(entry.first) < int(t);
+        });
+    }
+    inline typename std::vector<SparseEntry>::const_iterator sparseLowerBound(const genie::ResourceType type) const {
+        return std::lower_bound(m_sparse.begin(), m_sparse.end(), type, [](const SparseEntry &entry, const genie::ResourceType t) {
+            return int(entry.first) < int(t);
+        });
+    }
+
+    /// First set entry at or after index, dense ones first and then the sparse
+    inline size_t nextIndex(const size_t index) const noexcept {
+        if (index < DenseCount) {
+            const uint64_t remaining = m_present & (~uint64_t(0) << index);
+            if (remaining) {
+                return std::countr_zero(remaining);
+            }
+            return DenseCount;
+        }
+        return index;
+    }
+
+    std::array<float, DenseCount> m_dense{};
+    uint64_t m_present = 0;
+    std::vector<SparseEntry> m_sparse;
+};
+
+/// Up to and including MilitaryPopulation, for the players
+typedef BasicResourceMap<48> ResourceMap;
+
+/// Only food, wood, stone and gold in the array, for what units carry or contain
+typedef BasicResourceMap<4> UnitResourceMap;
+
 inline LogPrinter operator <<(LogPrinter os, const genie::ResourceType &type) {
     const char *separator = os.separator;
     os.separator = "";
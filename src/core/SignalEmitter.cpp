@@ -2,26 +2,28 @@
 
 SignalEmitterDeathDisconnecter::~SignalEmitterDeathDisconnecter()
 {
-    for (SignalReceiver *receiver : m_connectedReceivers) {
-        receiver->m_connectedEmitters.erase(this);
-    }
 }
 
 void SignalEmitterDeathDisconnecter::removeReceiver(SignalReceiver *receiver)
 {
-    receiver->m_connectedEmitters.erase(this);
-    m_connectedReceivers.erase(receiver);
+    std::erase(receiver->m_connectedEmitters, this);
 }
 
 void SignalEmitterDeathDisconnecter::addReceiver(SignalReceiver *receiver)
 {
-    receiver->m_connectedEmitters.insert(this);
-    m_connectedReceivers.insert(receiver);
+    std::vector<SignalEmitterDeathDisconnecter*> &emitters = receiver->m_connectedEmitters;
+    if (std::find(emitters.begin(), emitters.end(), this) == emitters.end()) {
+        emitters.push_back(this);
+    }
 }
 
 SignalReceiver::~SignalReceiver()
 {
-    for (SignalEmitterDeathDisconnecter *emitter : m_connectedEmitters) {
-        emitter->m_connectedReceivers.erase(this);
+    // Take it, disconnect() removes us from it
+    const std::vector<SignalEmitterDeathDisconnecter*> emitters = std::move(m_connectedEmitters);
+    m_connectedEmitters.clear();
+
+    for (SignalEmitterDeathDisconnecter *emitter : emitters) {
+        emitter->disconnect(this);
     }
 }
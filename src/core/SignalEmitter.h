@@ -1,31 +1,84 @@
 #pragma once
 
-#include <unordered_set>
-#include <functional>
 #include <algorithm>
 #include <array>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+#include <vector>
 
 /// Because the template magic fucks with my head:
 /// The only job of SignalReceiver is to disconnect from the SignalEmitter when a receiver is deleted.
 /// SignalEmitterDeathDisconnecter in turn is responsible for making sure SignalReceiver doesn't
 /// have any stale connections around when the SignalEmitter is destroyed.
+///
+/// Connections are just an object pointer and a member function pointer stored inline (see
+/// SignalDelegate), so connecting doesn't allocate per connection and emitting is a plain
+/// function pointer call per receiver. It's fine to connect, disconnect or delete receivers
+/// from inside a slot, those are only cleaned up when the outermost emit is done.
 
 template<class Emitter>
 struct SignalHolder;
 
 struct SignalReceiver;
 
+/// What std::function + std::bind used to do for us, but without the heap.
+/// Stores the function (normally a member function pointer) in a small inline
+/// buffer, and a static trampoline that knows the real types.
+class SignalDelegate
+{
+public:
+    // Member function pointers are two pointers on the ABIs we care about
+    static constexpr size_t StorageSize = 2 * sizeof(void*);
+
+    template<class Receiver, typename Function>
+    SignalDelegate(Receiver *receiver, Function function) noexcept :
+        m_object(receiver),
+        m_invoke(&invoke<Receiver, Function>)
+    {
+        static_assert(sizeof(Function) <= StorageSize, "Function too big for a signal delegate");
+        static_assert(std::is_trivially_copyable<Function>(), "Signal delegates can only store plain function pointers");
+        std::memcpy(m_storage, &function, sizeof(Function));
+    }
+
+    inline void operator()() const {
+        m_invoke(m_object, m_storage);
+    }
+
+private:
+    typedef void (*Invoker)(void *object, const unsigned char *storage);
+
+    template<class Receiver, typename Function>
+    static void invoke(void *object, const unsigned char *storage) {
+        Function function;
+        std::memcpy(&function, storage, sizeof(Function));
+        std::invoke(function, static_cast<Receiver*>(object));
+    }
+
+    void *m_object;
+    Invoker m_invoke;
+    alignas(void*) unsigned char m_storage[StorageSize];
+};
+
+struct SignalConnection
+{
+    SignalReceiver *receiver; // null if disconnected while emitting
+    SignalDelegate delegate;
+};
+
 struct SignalEmitterDeathDisconnecter
 {
     virtual ~SignalEmitterDeathDisconnecter();
 
+    /// Removes all connections to the receiver
+    virtual void disconnect(SignalReceiver *receiver) = 0;
+
 protected:
+    // The connections themselves are the list of receivers on our side,
+    // so these only update the receiver's list of emitters
     void removeReceiver(SignalReceiver *receiver);
     void addReceiver(SignalReceiver *receiver);
-
-protected:
-    friend struct SignalReceiver;
-    std::unordered_set<SignalReceiver*> m_connectedReceivers;
 };
 
 struct SignalReceiver
@@ -33,23 +86,25 @@ struct SignalReceiver
     virtual ~SignalReceiver();
 private:
     friend struct SignalEmitterDeathDisconnecter;
-    std::unordered_set<SignalEmitterDeathDisconnecter*> m_connectedEmitters;
-};
-
-struct SignalReceptacle
-{
-    SignalReceptacle(SignalReceiver *o, std::function<void()> f) : targetObject(o), targetFunction(f) {}
 
-    SignalReceiver *targetObject;
-    std::function<void()> targetFunction;
+    // Normally just a handful, so cheaper to scan than to hash
+    std::vector<SignalEmitterDeathDisconnecter*> m_connectedEmitters;
 };
 
-
 template<class Emitter>
 struct SignalEmitter
         : public SignalEmitterDeathDisconnecter
 {
     virtual ~SignalEmitter() {
+        if (d) {
+            for (const typename SignalHolder<Emitter>::ConnectionVector &receptacles : d->connections) {
+                for (const SignalConnection &connection : receptacles) {
+                    if (connection.receiver) {
+                        removeReceiver(connection.receiver);
+                    }
+                }
+            }
+        }
         delete d;
     }
 
@@ -63,29 +118,58 @@ struct SignalEmitter
              typename Function>
     void connect(const Signal sig, Receiver *receiver, Function func) {
         static_assert(std::is_enum<Signal>());
-        m_connectedReceivers.insert(receiver);
-        d->connections[sig].push_back({receiver, std::bind(func, receiver)});
+        if (!d) {
+            d = new SignalHolder<Emitter>();
+        }
+        d->connections[size_t(sig)].push_back({receiver, SignalDelegate(receiver, func)});
         addReceiver(receiver);
     }
 
     template< typename Signal, class Receiver>
     void disconnect(Signal sig, Receiver *receiver);
 
-    void disconnect(SignalReceiver *receiver);
+    void disconnect(SignalReceiver *receiver) override;
 
     template<typename Signal>
     void emit(const Signal sig);
 
 private:
-    SignalHolder<Emitter> *d = new SignalHolder<Emitter>();
+    // Created on the first connect, lots of emitters never get any
+    SignalHolder<Emitter> *d = nullptr;
 };
 
 template<class Emitter>
 struct SignalHolder {
-    typedef std::vector<SignalReceptacle> ReceptacleVector;
-    typedef std::array<ReceptacleVector, Emitter::Signals::SignalCount> SignalMap;
+    typedef std::vector<SignalConnection> ConnectionVector;
+    typedef std::array<ConnectionVector, Emitter::Signals::SignalCount> SignalMap;
 
     SignalMap connections;
+
+    // How many emits we're inside of, can't remove anything from the vectors until it's 0
+    int emitDepth = 0;
+    bool hasRemoved = false;
+
+    template<typename Predicate>
+    inline void remove(ConnectionVector &receptacles, const Predicate &shouldRemove) {
+        if (emitDepth > 0) {
+            for (SignalConnection &connection : receptacles) {
+                if (connection.receiver && shouldRemove(connection)) {
+                    connection.receiver = nullptr;
+                    hasRemoved = true;
+                }
+            }
+            return;
+        }
+
+        std::erase_if(receptacles, shouldRemove);
+    }
+
+    void removeDisconnected() {
+        for (ConnectionVector &receptacles : connections) {
+            std::erase_if(receptacles, [](const SignalConnection &connection) { return !connection.receiver; });
+        }
+        hasRemoved = false;
+    }
 };
 
 template<class Emitter>
@@ -94,8 +178,30 @@ void SignalEmitter<Emitter>::emit(const Signal sig)
 {
     static_assert(std::is_enum<Signal>());
 
-    for (const SignalReceptacle &receptacle : d->connections[sig]) {
-        receptacle.targetFunction();
+    if (!d) {
+        return;
+    }
+
+    typedef typename SignalHolder<Emitter>::ConnectionVector ConnectionVector;
+    const ConnectionVector &receptacles = d->connections[size_t(sig)];
+
+    // Anything connected while we're emitting doesn't get this one
+    const size_t count = receptacles.size();
+
+    d->emitDepth++;
+    for (size_t i=0; i<count; i++) {
+        if (!receptacles[i].receiver) {
+            continue;
+        }
+
+        // The delegate is done reading itself before calling the receiver, so it's
+        // fine if someone connects and reallocates the vector from in there
+        receptacles[i].delegate();
+    }
+    d->emitDepth--;
+
+    if (d->emitDepth == 0 && d->hasRemoved) {
+        d->removeDisconnected();
     }
 }
 
@@ -105,44 +211,35 @@ void SignalEmitter<Emitter>::disconnect(Signal sig, Receiver *receiver)
 {
     static_assert(std::is_enum<Signal>());
 
-    typedef typename SignalHolder<Emitter>::ReceptacleVector ReceptacleVector;
-
-    bool hasConnections = false;
+    if (!d) {
+        return;
+    }
 
-    for (size_t receptacleSig = 0; receptacleSig<d->connections.size(); receptacleSig++) {
-        ReceptacleVector &receptacles = d->connections[receptacleSig];
-        for (typename ReceptacleVector::iterator it = receptacles.begin(); it != receptacles.end();) {
-            if (it->targetObject != receiver) {
-                continue;
-            }
+    SignalReceiver *target = receiver;
+    d->remove(d->connections[size_t(sig)], [target](const SignalConnection &connection) {
+        return connection.receiver == target;
+    });
 
-            if (receptacleSig == sig) {
-                it = receptacles.erase(it);
-            } else {
-                hasConnections = true;
-                it++;
+    for (const typename SignalHolder<Emitter>::ConnectionVector &receptacles : d->connections) {
+        for (const SignalConnection &connection : receptacles) {
+            if (connection.receiver == target) {
+                return;
             }
         }
     }
-    if (!hasConnections) {
-        removeReceiver(receiver);
-    }
+    removeReceiver(target);
 }
 
 template<class Emitter>
 void SignalEmitter<Emitter>::disconnect(SignalReceiver *receiver)
 {
-    typedef typename SignalHolder<Emitter>::ReceptacleVector ReceptacleVector;
-
-    m_connectedReceivers.erase(receiver);
+    typedef typename SignalHolder<Emitter>::ConnectionVector ConnectionVector;
 
-    for (ReceptacleVector &receptacles : d->connections) {
-        for (typename ReceptacleVector::iterator it = receptacles.begin(); it != receptacles.end();) {
-            if (it->targetObject == receiver) {
-                it = receptacles.erase(it);
-            } else {
-                it++;
-            }
+    if (d) {
+        for (ConnectionVector &receptacles : d->connections) {
+            d->remove(receptacles, [receiver](const SignalConnection &connection) {
+                return connection.receiver == receiver;
+            });
         }
     }
 
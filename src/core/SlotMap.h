@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stddef.h>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "IdIndex.h"
+
+/// Storage for all the units/missiles/etc., in the order they were added.
+///
+/// Removing something only clears its slot (and keeps it alive until the next
+/// compact(), so it's safe to remove things while they are being updated), and
+/// then compact() squeezes out the holes in one go at a safe point in the tick.
+/// So if a lot of things die at the same time we don't shuffle everything for
+/// each one.
+///
+/// Iteration skips the holes, if you iterate over slots you need to check for null.
+template<typename TYPE>
+struct SlotMap {
+    struct const_iterator {
+        inline const TYPE &operator*() const { return *m_pos; }
+        inline const TYPE *operator->() const { return m_pos; }
+
+        inline const_iterator &operator++() {
+            m_pos++;
+            skipEmpty();
+            return *this;
+        }
+
+        inline bool operator==(const const_iterator &other) const { return m_pos == other.m_pos; }
+        inline bool operator!=(const const_iterator &other) const { return m_pos != other.m_pos; }
+
+    private:
+        friend struct SlotMap;
+        const_iterator(const TYPE *pos, const TYPE *end) : m_pos(pos), m_end(end) { skipEmpty(); }
+
+        inline void skipEmpty() {
+            while (m_pos != m_end && !*m_pos) {
+                m_pos++;
+            }
+        }
+
+        const TYPE *m_pos;
+        const TYPE *m_end;
+    };
+
+    inline const_iterator begin() const { return const_iterator(m_slots.data(), m_slots.data() + m_slots.size()); }
+    inline const_iterator end() const { return const_iterator(m_slots.data() + m_slots.size(), m_slots.data() + m_slots.size()); }
+
+    /// Number of things actually in it, not the number of slots
+    inline size_t size() const { return m_slots.size() - m_removed.size(); }
+    inline bool isEmpty() const { return size() == 0; }
+
+    /// For iterating with indices (e. g. when things might be added while iterating), can be null
+    inline size_t slotCount() const { return m_slots.size(); }
+    inline const TYPE &atSlot(const size_t slot) const { return m_slots[slot]; }
+
+    inline bool contains(const TYPE &item) const {
+        return item && m_index.get(item->handle) != IdIndex::Invalid;
+    }
+
+    /// Returns false if it is already in here
+    bool add(const TYPE &item) {
+        if (m_index.get(item->handle) != IdIndex::Invalid) {
+            return false;
+        }
+        m_index.set(item->handle, m_slots.size());
+        m_slots.push_back(item);
+        return true;
+    }
+
+    bool remove(const TYPE &item) {
+        if (!item) {
+            return false;
+        }
+
+        const uint32_t handle = item->handle;
+        const uint32_t slot = m_index.get(handle);
+        if (slot == IdIndex::Invalid) {
+            return false;
+        }
+
+        // Keep it alive until we compact, someone might be in the middle of calling it
+        m_removed.push_back(std::move(m_slots[slot]));
+        m_slots[slot] = nullptr;
+        m_index.erase(handle);
+
+        return true;
+    }
+
+    /// Gets rid of the holes, keeping the order of the rest.
+    /// Don't call while iterating.
+    void compact() {
+        if (m_removed.empty()) {
+            return;
+        }
+
+        size_t target = 0;
+        for (size_t i=0; i<m_slots.size(); i++) {
+            if (!m_slots[i]) {
+                continue;
+            }
+            if (i != target) {
+                m_index.set(m_slots[i]->handle, target);
+                m_slots[target] = std::move(m_slots[i]);
+            }
+            target++;
+        }
+        m_slots.resize(target);
+
+        m_removed.clear();
+    }
+
+private:
+    std::vector<TYPE> m_slots;
+    std::vector<TYPE> m_removed;
+    IdIndex m_index;
+};
@@ -0,0 +1,204 @@
+#include "TimerWheel.h"
+
+#include <algorithm>
+#include <bit>
+
+TimerWheel::TimerId TimerWheel::arm(const Time expiry, Callback callback)
+{
+    uint32_t index;
+    if (!m_freeTimers.empty()) {
+        index = m_freeTimers.back();
+        m_freeTimers.pop_back();
+    } else {
+        index = m_timers.size();
+        m_timers.emplace_back();
+    }
+
+    // Already passed, go off as soon as possible
+    Timer &timer = m_timers[index];
+    timer.expiry = std::max(expiry, m_now + 1);
+    timer.callback = std::move(callback);
+    insert(index);
+
+    return makeId(index, timer.generation);
+}
+
+bool TimerWheel::cancel(const TimerId id)
+{
+    if (!timerFor(id)) {
+        return false;
+    }
+
+    const uint32_t index = uint32_t(id);
+    unlink(index);
+    release(index);
+    return true;
+}
+
+bool TimerWheel::isArmed(const TimerId id) const noexcept
+{
+    return timerFor(id) != nullptr;
+}
+
+Time TimerWheel::expiryOf(const TimerId id) const noexcept
+{
+    const Timer *timer = timerFor(id);
+    if (!timer) {
+        return -1;
+    }
+    return timer->expiry;
+}
+
+void TimerWheel::advance(const Time time)
+{
+    while (m_now < time) {
+        if (m_count == 0) {
+            m_now = time;
+            break;
+        }
+
+        // Skip straight to the next millisecond where something happens,
+        // either a timer in the lowest level or the lowest level wrapping around
+        const int position = int(m_now & (SlotsPerLevel - 1));
+        const uint64_t ahead = position == SlotsPerLevel - 1 ? 0 : m_occupied[0] & (~uint64_t(0) << (position + 1));
+        Time next;
+        if (ahead) {
+            next = m_now - position + std::countr_zero(ahead);
+        } else {
+            next = (m_now | (SlotsPerLevel - 1)) + 1;
+        }
+
+        if (next > time) {
+            m_now = time;
+            break;
+        }
+
+        m_now = next - 1;
+        tick();
+    }
+}
+
+const TimerWheel::Timer *TimerWheel::timerFor(const TimerId id) const noexcept
+{
+    const uint32_t index = uint32_t(id);
+    const uint32_t generation = uint32_t(id >> 32);
+    if (index >= m_timers.size()) {
+        return nullptr;
+    }
+
+    const Timer &timer = m_timers[index];
+    if (timer.generation != generation || timer.slot == -1) {
+        return nullptr;
+    }
+    return &timer;
+}
+
+void TimerWheel::insert(const uint32_t index)
+{
+    static constexpr Time WheelRange = Time(1) << (SlotBits * LevelCount);
+
+    Timer &timer = m_timers[index];
+    const Time expiry = timer.expiry;
+    const Time delta = expiry - m_now;
+
+    int level = 0;
+    while (level < LevelCount - 1 && delta >= (Time(1) << (SlotBits * (level + 1)))) {
+        level++;
+    }
+
+    int slot;
+    if (delta < WheelRange) {
+        slot = (expiry >> (SlotBits * level)) & (SlotsPerLevel - 1);
+    } else {
+        // Further away than we can reach, put it in the last slot to be
+        // cascaded and it will get put back in where it should be then
+        slot = ((m_now >> (SlotBits * level)) - 1) & (SlotsPerLevel - 1);
+    }
+
+    const int slotIndex = level * SlotsPerLevel + slot;
+    timer.slot = slotIndex;
+    timer.previous = Invalid;
+    timer.next = m_slots[slotIndex];
+    if (timer.next != Invalid) {
+        m_timers[timer.next].previous = index;
+    }
+    m_slots[slotIndex] = index;
+    m_occupied[level] |= uint64_t(1) << slot;
+
+    m_count++;
+}
+
+void TimerWheel::unlink(const uint32_t index)
+{
+    Timer &timer = m_timers[index];
+    const int slotIndex = timer.slot;
+
+    if (timer.previous != Invalid) {
+        m_timers[timer.previous].next = timer.next;
+    } else {
+        m_slots[slotIndex] = timer.next;
+    }
+    if (timer.next != Invalid) {
+        m_timers[timer.next].previous = timer.previous;
+    }
+
+    if (m_slots[slotIndex] == Invalid) {
+        m_occupied[slotIndex / SlotsPerLevel] &= ~(uint64_t(1) << (slotIndex % SlotsPerLevel));
+    }
+
+    timer.previous = Invalid;
+    timer.next = Invalid;
+    timer.slot = -1;
+
+    m_count--;
+}
+
+void TimerWheel::release(const uint32_t index)
+{
+    Timer &timer = m_timers[index];
+    timer.callback = nullptr;
+    timer.generation++;
+    m_freeTimers.push_back(index);
+}
+
+void TimerWheel::cascade(const int level, const int slot)
+{
+    const int slotIndex = level * SlotsPerLevel + slot;
+
+    // Take out the whole list first, in case something ends up in the same slot again
+    uint32_t index = m_slots[slotIndex];
+    m_slots[slotIndex] = Invalid;
+    m_occupied[level] &= ~(uint64_t(1) << slot);
+
+    while (index != Invalid) {
+        const uint32_t next = m_timers[index].next;
+        m_count--;
+        insert(index);
+        index = next;
+    }
+}
+
+void TimerWheel::tick()
+{
+    m_now++;
+
+    // When a level wraps around, spread out the next slot of the level above.
+    // From the top down, so things can trickle all the way down to the lowest level.
+    int topLevel = 0;
+    while (topLevel + 1 < LevelCount && (m_now & ((Time(1) << (SlotBits * (topLevel + 1))) - 1)) == 0) {
+        topLevel++;
+    }
+    for (int level = topLevel; level > 0; level--) {
+        cascade(level, (m_now >> (SlotBits * level)) & (SlotsPerLevel - 1));
+    }
+
+    // The callbacks can arm and cancel timers, so take them out one by one
+    const int slotIndex = m_now & (SlotsPerLevel - 1);
+    while (m_slots[slotIndex] != Invalid) {
+        const uint32_t index = m_slots[slotIndex];
+        Callback callback = std::move(m_timers[index].callback);
+        unlink(index);
+        release(index);
+        callback();
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stddef.h>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "core/Types.h"
+
+/// Timers that go off at a given simulation time, for things like scenario
+/// trigger timers and AI script timers.
+///
+/// It's a hierarchical timing wheel: four levels of 64 slots, where a slot on
+/// the lowest level is a millisecond and each level above covers 64 times as
+/// much. Timers get put in the lowest level that reaches far enough, and when
+/// a level wraps around the next slot from the level above gets spread out
+/// over the levels below. So arming and cancelling is constant time, and
+/// advancing only touches the timers that are about to go off instead of
+/// looking at every timer on every tick.
+///
+/// The slots are intrusive linked lists of indices into one vector of timers,
+/// so cancelling just unlinks it.
+class TimerWheel
+{
+public:
+    /// 0 is never a valid id
+    typedef uint64_t TimerId;
+
+    typedef std::function<void()> Callback;
+
+    TimerWheel() { m_slots.fill(Invalid); }
+
+    TimerWheel(const TimerWheel &) = delete;
+    const TimerWheel &operator=(const TimerWheel &) = delete;
+
+    /// The callback is called from advance() when the time passes expiry.
+    /// If it is in the past it fires on the next advance().
+    TimerId arm(const Time expiry, Callback callback);
+
+    /// Returns false if it has already fired or been cancelled
+    bool cancel(const TimerId id);
+
+    bool isArmed(const TimerId id) const noexcept;
+
+    /// When it is going to fire, or -1 if it isn't armed
+    Time expiryOf(const TimerId id) const noexcept;
+
+    /// Fires everything with an expiry up to and including time, in order
+    void advance(const Time time);
+
+    /// The time we last advanced to
+    Time currentTime() const noexcept { return m_now; }
+
+    size_t size() const noexcept { return m_count; }
+
+private:
+    static constexpr int SlotBits = 6;
+    static constexpr int SlotsPerLevel = 1 << SlotBits;
+    static constexpr int LevelCount = 4;
+    static constexpr uint32_t Invalid = UINT32_MAX;
+
+    struct Timer {
+        Time expiry = 0;
+        Callback callback;
+
+        uint32_t previous = Invalid;
+        uint32_t next = Invalid;
+
+        uint32_t generation = 1; // so old ids don't cancel a new timer in the same place
+        int16_t slot = -1; // level * SlotsPerLevel + slot in level, -1 when not armed
+    };
+
+    static inline TimerId makeId(const uint32_t index, const uint32_t generation) noexcept {
+        return (TimerId(generation) << 32) | index;
+    }
+
+    /// null if it has already fired or been cancelled
+    const Timer *timerFor(const TimerId id) const noexcept;
+
+    void insert(const uint32_t index);
+    void unlink(const uint32_t index);
+    void release(const uint32_t index);
+
+    /// Moves everything in the slot down to the levels below
+    void cascade(const int level, const int slot);
+
+    /// Goes forward one millisecond, and fires what is due
+    void tick();
+
+    std::vector<Timer> m_timers;
+    std::vector<uint32_t> m_freeTimers;
+
+    std::array<uint32_t, LevelCount * SlotsPerLevel> m_slots;
+    std::array<uint64_t, LevelCount> m_occupied{}; // one bit per slot that has anything in it
+
+    Time m_now = 0;
+    size_t m_count = 0;
+};
@@ -215,6 +215,21 @@ struct MapPos {
         return std::sqrt(lengthSquared - alongDist * alongDist);
     }
 
+    /// Only in the x/y plane, and clamped to the ends of the segment (unlike distanceToLine)
+    float distanceToSegment(const MapPos &segmentStart, const MapPos &segmentEnd) const noexcept {
+        const float segmentX = segmentEnd.x - segmentStart.x;
+        const float segmentY = segmentEnd.y - segmentStart.y;
+        const float lengthSquared = segmentX * segmentX + segmentY * segmentY;
+
+        float along = 0.f;
+        if (IS_LIKELY(lengthSquared > 0.f)) {
+            along = ((x - segmentStart.x) * segmentX + (y - segmentStart.y) * segmentY) / lengthSquared;
+            along = std::clamp(along, 0.f, 1.f);
+        }
+
+        return std::hypot(segmentStart.x + along * segmentX - x, segmentStart.y + along * segmentY - y);
+    }
+
     float angleTo(const MapPos &other) const {
         return atan2(other.y - y, other.x - x);
     }
@@ -458,6 +458,22 @@ Config::Config(const std::string &applicationName)
     m_filePath += "/";
 #endif
     m_filePath += applicationName + ".cfg";
+
+#if defined(__linux__)
+    const char *cacheHome = getenv("XDG_CACHE_HOME");
+    if (cacheHome && strlen(cacheHome)) {
+        m_cachePath = cacheHome;
+    } else if (getenv("HOME")) {
+        m_cachePath = getenv("HOME");
+        m_cachePath += "/.cache";
+    }
+    if (!m_cachePath.empty()) {
+        m_cachePath += "/" + applicationName + "/";
+    }
+#elif defined(WIN32) || defined(__WIN32) || defined(__WIN32__)
+    m_cachePath = std::filesystem::current_path().string();
+    m_cachePath += "/cache/";
+#endif
 }
 
 Config &Config::Inst()
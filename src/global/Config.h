@@ -82,6 +82,10 @@ public:
 
     void printUsage(const std::string &programName);
 
+    /// Where we can put things that are slow to generate, ends with a /.
+    /// Might not exist yet.
+    const std::string &cachePath() const { return m_cachePath; }
+
 #if defined(__linux__)
     static std::string winePath();
 #endif
@@ -101,6 +105,7 @@ private:
     std::string m_dataPath;
     std::string m_scenarioFile;
     std::string m_filePath;
+    std::string m_cachePath;
     std::unordered_map<OptionType, std::string> m_values;
     std::unordered_map<std::string, OptionDefinition> m_knownOptions;
 };
@@ -3,6 +3,7 @@
 struct MapPos;
 struct Player;
 struct Unit;
+struct VisibilityDelta;
 
 #include <stdint.h>
 #include <string>
@@ -67,6 +68,9 @@ protected:
     virtual void onPlayerDefeated(Player *player)
         { (void)player; }
 
+    virtual void onDiplomacyChanged(Player *player, const int otherPlayerId)
+        { (void)player; (void)otherPlayerId; }
+
     virtual void onAiSignal(Player *player, int signalId)
         { (void)player; (void)signalId; }
 
@@ -91,13 +95,15 @@ protected:
     virtual void onTradingPriceChanged(const genie::ResourceType type, const int newPrice)
         { (void)type; (void)newPrice; }
 
-    virtual void onTileDiscovered(const int playerID, const int tileX, const int tileY)
-        { (void)playerID; (void)tileX; (void)tileY; }
-
-    virtual void onTileHidden(const int playerID, const int tileX, const int tileY)
-        { (void)playerID; (void)tileX; (void)tileY; }
+    /// All tiles that were discovered or hidden since the last tick, in one go
+    virtual void onVisibilityChanged(const int playerID, const VisibilityDelta &delta)
+        { (void)playerID; (void)delta; }
 
     virtual void onChatMessage(const int sourcePlayer, const int targetPlayer, const std::string &message)
         { (void)sourcePlayer; (void)targetPlayer; (void)message; }
+
+private:
+    // One bit per EventManager::EventType, so deregistering only looks where we are
+    uint32_t m_registeredEvents = 0;
 };
 
@@ -4,6 +4,9 @@
 
 #include "core/Types.h"
 
+#include <algorithm>
+#include <bit>
+
 EventManager::EventManager()
 {
 
@@ -18,13 +21,18 @@ EventManager *EventManager::instance()
 
 void EventManager::registerListener(EventListener *listener, const EventManager::EventType type)
 {
-    instance()->m_entityEventListeners[type].push_back(listener);
+    const uint32_t bit = 1u << type;
+    if (listener->m_registeredEvents & bit) {
+        return;
+    }
+    listener->m_registeredEvents |= bit;
+    instance()->m_listeners[type].push_back(listener);
 }
 
 void EventManager::deregisterListener(EventListener *listener)
 {
-    for (int type = 0; type<EventTypeCount; type++) {
-        deregisterListener(listener, EventType(type));
+    for (uint32_t bits = listener->m_registeredEvents; bits; bits &= bits - 1) {
+        deregisterListener(listener, EventType(std::countr_zero(bits)));
     }
 }
 
@@ -35,7 +43,33 @@ void EventManager::onListenerDestroyed(EventListener *listener)
 
 void EventManager::deregisterListener(EventListener *listener, const EventManager::EventType type)
 {
-    instance()->m_entityEventListeners[type].remove(listener);
+    const uint32_t bit = 1u << type;
+    if (!(listener->m_registeredEvents & bit)) {
+        return;
+    }
+    listener->m_registeredEvents &= ~bit;
+
+    EventManager *self = instance();
+    std::vector<EventListener*> &listeners = self->m_listeners[type];
+    std::vector<EventListener*>::iterator it = std::find(listeners.begin(), listeners.end(), listener);
+    REQUIRE(it != listeners.end(), return);
+
+    // Someone is going through them, so just mark it and clean up afterwards
+    if (self->m_callDepth > 0) {
+        *it = nullptr;
+        self->m_hasRemoved = true;
+        return;
+    }
+
+    listeners.erase(it);
+}
+
+void EventManager::removeDeregistered()
+{
+    for (std::vector<EventListener*> &listeners : m_listeners) {
+        std::erase(listeners, nullptr);
+    }
+    m_hasRemoved = false;
 }
 
 void EventManager::unitCreated(Unit *unit)
@@ -55,7 +89,7 @@ void EventManager::unitSelected(Unit *unit)
 
 void EventManager::unitDeselected(const Unit *unit)
 {
-    call(UnitSelected, [=](EventListener *l) { l->onUnitDeselected(unit); });
+    call(UnitDeselected, [=](EventListener *l) { l->onUnitDeselected(unit); });
 }
 
 void EventManager::unitOwnerChanged(Unit *unit, int oldPlayerId, int newPlayerId)
@@ -70,7 +104,7 @@ void EventManager::unitCaptured(Unit *unit, int oldPlayerId, int newPlayerId)
 
 void EventManager::unitMoved(Unit *unit, const MapPos &oldtile, const MapPos &newTile)
 {
-    call(UnitMoved, [=](EventListener *l) { l->onUnitMoved(unit, oldtile, newTile); });
+    call(UnitMoved, [&](EventListener *l) { l->onUnitMoved(unit, oldtile, newTile); });
 }
 
 void EventManager::unitGarrisoned(Unit *unit, Unit *garrisonedIn)
@@ -108,6 +142,11 @@ void EventManager::playerDefeated(Player *player)
     call(PlayerDefeated, [=](EventListener *l) { l->onPlayerDefeated(player); });
 }
 
+void EventManager::diplomacyChanged(Player *player, const int otherPlayerId)
+{
+    call(DiplomacyChanged, [=](EventListener *l) { l->onDiplomacyChanged(player, otherPlayerId); });
+}
+
 void EventManager::aiSignal(Player *player, int signalId)
 {
     call(AiSignal, [=](EventListener *l) { l->onAiSignal(player, signalId); });
@@ -148,14 +187,9 @@ void EventManager::tradingPriceChanged(const genie::ResourceType type, const int
     call(TradingPriceChanged, [=](EventListener *l) { l->onTradingPriceChanged(type, newPrice); });
 }
 
-void EventManager::tileDiscovered(int playerID, const int tileX, const int tileY)
-{
-    call(TileDiscovered, [=](EventListener *l) { l->onTileDiscovered(playerID, tileX, tileY); });
-}
-
-void EventManager::tileHidden(int playerID, const int tileX, const int tileY)
+void EventManager::visibilityChanged(const int playerID, const VisibilityDelta &delta)
 {
-    call(TileHidden, [=](EventListener *l) { l->onTileHidden(playerID, tileX, tileY); });
+    call(VisibilityChanged, [&](EventListener *l) { l->onVisibilityChanged(playerID, delta); });
 }
 
 void EventManager::sendChatMessage(const int sourcePlayer, const int targetPlayer, const std::string &message)
@@ -1,21 +1,26 @@
 #pragma once
 
 #include <array>
-#include <functional>
-#include <list>
+#include <cstdint>
 #include <string>
+#include <vector>
+
+#include "EventListener.h"
 
-struct EventListener;
 struct MapPos;
 struct Player;
 struct Unit;
+struct VisibilityDelta;
 
 namespace genie {
 enum class ResourceType : int16_t;
 }
 
-// Not scalable at all, so sue me
-// TODO: template magic to only subscribe to what you want
+/// Listeners are kept in a plain vector per event type, and calling them is
+/// just a loop with the call inlined. Listeners can register and deregister
+/// (or be deleted) while an event is being delivered, the removed ones are
+/// only cleaned out when the outermost delivery is done and don't get
+/// anything more in the meantime.
 class EventManager
 {
 public:
@@ -43,6 +48,7 @@ public:
         ResearchStarted,
         ResearchComplete,
         PlayerDefeated,
+        DiplomacyChanged,
         AiSignal,
         AttributeChanged,
         DiscoveredUnit,
@@ -54,14 +60,15 @@ public:
         ResourceBought,
         ResourceSold,
 
-        TileDiscovered,
-        TileHidden,
+        VisibilityChanged,
 
         ChatMessage,
 
         EventTypeCount
     };
 
+    static_assert(EventTypeCount <= 32, "EventListener keeps a bitmask of what it is registered for");
+
     static void registerListener(EventListener *listener, const EventType type);
     static void deregisterListener(EventListener *listener);
     static void deregisterListener(EventListener *listener, const EventType type);
@@ -83,6 +90,7 @@ public:
     static void researchStarted(Player *player, int researchId);
     static void researchCompleted(Player *player, int researchId);
     static void playerDefeated(Player *player);
+    static void diplomacyChanged(Player *player, const int otherPlayerId);
     static void aiSignal(Player *player, int signalId);
     static void attributeChanged(Player *player, int attributeId, float newValue);
     static void unitDiscovered(Player *player, Unit *unit);
@@ -94,23 +102,41 @@ public:
     static void resourceSold(const genie::ResourceType type, const int amount);
     static void tradingPriceChanged(const genie::ResourceType type, const int newPrice);
 
-    static void tileDiscovered(int playerID, const int tileX, const int tileY);
-    static void tileHidden(int playerID, const int tileX, const int tileY);
+    static void visibilityChanged(const int playerID, const VisibilityDelta &delta);
 
     static void sendChatMessage(const int sourcePlayer, const int targetPlayer, const std::string &message);
 
 private:
-    static void call(const EventType type, std::function<void(EventListener *listener)> function)
+    template<typename Function>
+    static inline void call(const EventType type, const Function &function)
     {
-        for (EventListener *listener : instance()->m_entityEventListeners[type]) {
-            function(listener);
+        EventManager *self = instance();
+        const std::vector<EventListener*> &listeners = self->m_listeners[type];
+
+        // Anyone registering while we're in here doesn't get this one
+        const size_t count = listeners.size();
+
+        self->m_callDepth++;
+        for (size_t i=0; i<count; i++) {
+            EventListener *listener = listeners[i];
+            if (listener) {
+                function(listener);
+            }
+        }
+        self->m_callDepth--;
+
+        if (self->m_callDepth == 0 && self->m_hasRemoved) {
+            self->removeDeregistered();
         }
     }
 
+    void removeDeregistered();
+
     EventManager();
     static EventManager *instance();
 
-    std::array<std::list<EventListener*>, EventTypeCount> m_entityEventListeners;
-
+    std::array<std::vector<EventListener*>, EventTypeCount> m_listeners;
+    int m_callDepth = 0;
+    bool m_hasRemoved = false;
 };
 
@@ -0,0 +1,296 @@
+#include "BuildabilityMap.h"
+
+#include <genie/dat/TerrainRestriction.h>
+#include <genie/dat/Unit.h>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#include "Map.h"
+#include "core/Logger.h"
+#include "resource/DataManager.h"
+
+BuildabilityMap::BuildabilityMap(const Map &map) :
+    m_map(map)
+{
+}
+
+BuildabilityMap::~BuildabilityMap()
+{
+}
+
+bool BuildabilityMap::canPlace(const genie::Unit &data, const int tileX, const int tileY)
+{
+    const Footprint footprint = footprintFor(data);
+    const int firstX = tileX + footprint.offsetX;
+    const int firstY = tileY + footprint.offsetY;
+    const int lastX = firstX + footprint.width - 1;
+    const int lastY = firstY + footprint.height - 1;
+
+    if (firstX < 0 || firstY < 0 || lastX >= m_map.columnCount() || lastY >= m_map.rowCount()) {
+        return false;
+    }
+
+    const Plane &plane = planeFor(data);
+
+    for (int y = firstY; y <= lastY; y++) {
+        const Row &row = plane.rows[y];
+        for (int word = firstX / WordBits; word <= lastX / WordBits; word++) {
+            const int first = std::max(firstX - word * WordBits, 0);
+            const int last = std::min(lastX - word * WordBits, WordBits - 1);
+            const uint64_t mask = (~uint64_t(0) >> (WordBits - 1 - last)) & (~uint64_t(0) << first);
+            if ((row[word] & mask) != mask) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+std::vector<MapPos> BuildabilityMap::findPlacements(const genie::Unit &data, const TileRect &region)
+{
+    std::vector<MapPos> ret;
+
+    const Footprint footprint = footprintFor(data);
+    if (footprint.width <= 0 || footprint.height <= 0 || footprint.width > WordBits) {
+        return ret;
+    }
+
+    const Plane &plane = planeFor(data);
+
+    // Each row only depends on the width, so erode them all once up front
+    std::array<Row, Constants::MAP_MAX_SIZE> eroded;
+    const int firstRow = std::max(region.firstY + footprint.offsetY, 0);
+    const int lastRow = std::min(region.lastY + footprint.offsetY + footprint.height - 1, m_map.rowCount() - 1);
+    for (int y = firstRow; y <= lastRow; y++) {
+        eroded[y] = erodeRow(plane.rows[y], footprint.width);
+    }
+
+    // And then it needs to fit in all the rows it covers
+    const int firstX = std::max(region.firstX + footprint.offsetX, 0);
+    const int lastX = std::min(region.lastX + footprint.offsetX, m_map.columnCount() - footprint.width);
+    for (int top = firstRow; top + footprint.height - 1 <= lastRow; top++) {
+        Row fits = eroded[top];
+        for (int y = top + 1; y < top + footprint.height; y++) {
+            for (int word = 0; word < WordsPerRow; word++) {
+                fits[word] &= eroded[y][word];
+            }
+        }
+
+        for (int word = firstX / WordBits; word < WordsPerRow && word * WordBits <= lastX; word++) {
+            for (uint64_t bits = fits[word]; bits; bits &= bits - 1) {
+                const int x = word * WordBits + std::countr_zero(bits);
+                if (x < firstX || x > lastX) {
+                    continue;
+                }
+
+                ret.emplace_back(
+                        (x - footprint.offsetX) * Constants::TILE_SIZE,
+                        (top - footprint.offsetY) * Constants::TILE_SIZE
+                    );
+            }
+        }
+    }
+
+    return ret;
+}
+
+void BuildabilityMap::onTerrainChanged(const int tileX, const int tileY)
+{
+    updateTile(tileX, tileY);
+}
+
+void BuildabilityMap::onMapRecreated()
+{
+    // Just build them again when someone needs them
+    m_planes.clear();
+
+    // The map tells the units to add theirs again
+    m_obstructions.fill(0);
+}
+
+void BuildabilityMap::addObstruction(const TileRect &tiles)
+{
+    for (int y = std::max(tiles.firstY, 0); y <= std::min(tiles.lastY, Constants::MAP_MAX_SIZE - 1); y++) {
+        for (int x = std::max(tiles.firstX, 0); x <= std::min(tiles.lastX, Constants::MAP_MAX_SIZE - 1); x++) {
+            uint16_t &count = m_obstructions[y * Constants::MAP_MAX_SIZE + x];
+            count++;
+            if (count == 1) {
+                updateTile(x, y);
+            }
+        }
+    }
+}
+
+void BuildabilityMap::removeObstruction(const TileRect &tiles)
+{
+    for (int y = std::max(tiles.firstY, 0); y <= std::min(tiles.lastY, Constants::MAP_MAX_SIZE - 1); y++) {
+        for (int x = std::max(tiles.firstX, 0); x <= std::min(tiles.lastX, Constants::MAP_MAX_SIZE - 1); x++) {
+            uint16_t &count = m_obstructions[y * Constants::MAP_MAX_SIZE + x];
+            REQUIRE(count > 0, continue);
+            count--;
+            if (count == 0) {
+                updateTile(x, y);
+            }
+        }
+    }
+}
+
+bool BuildabilityMap::isObstructed(const TileRect &tiles) const noexcept
+{
+    for (int y = std::max(tiles.firstY, 0); y <= std::min(tiles.lastY, Constants::MAP_MAX_SIZE - 1); y++) {
+        for (int x = std::max(tiles.firstX, 0); x <= std::min(tiles.lastX, Constants::MAP_MAX_SIZE - 1); x++) {
+            if (m_obstructions[y * Constants::MAP_MAX_SIZE + x] > 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool BuildabilityMap::isObstruction(const genie::Unit &data) noexcept
+{
+    if (data.Type >= genie::Unit::BuildingType) {
+        return true;
+    }
+
+    // Things that move get out of the way
+    if (data.Type >= genie::Unit::MovingType) {
+        return false;
+    }
+
+    // Trees, mines, etc.
+    switch (data.ObstructionType) {
+    case genie::Unit::PassableObstruction:
+    case genie::Unit::PassableObstruction2:
+    case genie::Unit::PassableNoOutlineObstruction:
+        return false;
+    default:
+        return true;
+    }
+}
+
+TileRect BuildabilityMap::obstructionTiles(const genie::Unit &data, const MapPos &position) noexcept
+{
+    const float tileX = position.x / Constants::TILE_SIZE;
+    const float tileY = position.y / Constants::TILE_SIZE;
+
+    TileRect tiles;
+    tiles.firstX = std::floor(tileX - data.Size.x);
+    tiles.firstY = std::floor(tileY - data.Size.y);
+    tiles.lastX = std::ceil(tileX + data.Size.x) - 1;
+    tiles.lastY = std::ceil(tileY + data.Size.y) - 1;
+    return tiles;
+}
+
+BuildabilityMap::Footprint BuildabilityMap::footprintFor(const genie::Unit &data) noexcept
+{
+    // Same as we always had, square and centered on the position tile
+    Footprint footprint;
+    footprint.width = data.ClearanceSize.x + data.Size.x;
+    footprint.height = footprint.width;
+    footprint.offsetX = -footprint.width / 2;
+    footprint.offsetY = -footprint.height / 2;
+    return footprint;
+}
+
+BuildabilityMap::Plane &BuildabilityMap::planeFor(const genie::Unit &data)
+{
+    for (const std::unique_ptr<Plane> &plane : m_planes) {
+        if (plane->terrainRestriction == data.TerrainRestriction && plane->placementTerrain == data.PlacementTerrain.first) {
+            return *plane;
+        }
+    }
+
+    std::unique_ptr<Plane> plane = std::make_unique<Plane>();
+    plane->terrainRestriction = data.TerrainRestriction;
+    plane->placementTerrain = data.PlacementTerrain.first;
+
+    const std::vector<float> &multipliers = DataManager::Inst().getTerrainRestriction(data.TerrainRestriction).PassableBuildableDmgMultiplier;
+    plane->buildableTerrain.resize(multipliers.size());
+    for (size_t i=0; i<multipliers.size(); i++) {
+        plane->buildableTerrain[i] = multipliers[i] != 0.f;
+    }
+
+    buildPlane(plane.get());
+
+    m_planes.push_back(std::move(plane));
+    return *m_planes.back();
+}
+
+void BuildabilityMap::buildPlane(Plane *plane)
+{
+    const int rows = std::min(m_map.rowCount(), Constants::MAP_MAX_SIZE);
+    const int cols = std::min(m_map.columnCount(), Constants::MAP_MAX_SIZE);
+
+    for (int y = 0; y < rows; y++) {
+        Row &row = plane->rows[y];
+        row.fill(0);
+        for (int x = 0; x < cols; x++) {
+            if (isBuildable(*plane, x, y)) {
+                row[x / WordBits] |= uint64_t(1) << (x % WordBits);
+            }
+        }
+    }
+}
+
+void BuildabilityMap::updateTile(const int tileX, const int tileY)
+{
+    if (IS_UNLIKELY(unsigned(tileX) >= unsigned(Constants::MAP_MAX_SIZE) || unsigned(tileY) >= unsigned(Constants::MAP_MAX_SIZE))) {
+        return;
+    }
+
+    const uint64_t bit = uint64_t(1) << (tileX % WordBits);
+    for (const std::unique_ptr<Plane> &plane : m_planes) {
+        uint64_t &word = plane->rows[tileY][tileX / WordBits];
+        if (isBuildable(*plane, tileX, tileY)) {
+            word |= bit;
+        } else {
+            word &= ~bit;
+        }
+    }
+}
+
+bool BuildabilityMap::isBuildable(const Plane &plane, const int tileX, const int tileY) const noexcept
+{
+    if (tileX >= m_map.columnCount() || tileY >= m_map.rowCount()) {
+        return false;
+    }
+
+    if (m_obstructions[tileY * Constants::MAP_MAX_SIZE + tileX] > 0) {
+        return false;
+    }
+
+    const int terrainId = m_map.getTileAt(tileX, tileY).terrainId;
+    if (plane.placementTerrain != -1 && terrainId != plane.placementTerrain) {
+        return false;
+    }
+
+    return size_t(terrainId) < plane.buildableTerrain.size() && plane.buildableTerrain[terrainId];
+}
+
+BuildabilityMap::Row BuildabilityMap::erodeRow(const Row &row, const int width) noexcept
+{
+    // Same trick as with morphological erosion, double the run length we
+    // check each time, so it's log2(width) shifts instead of width.
+    Row ret = row;
+    int covered = 1;
+    while (covered < width) {
+        const int shift = std::min(covered, width - covered);
+
+        Row shifted;
+        for (int word = 0; word < WordsPerRow; word++) {
+            shifted[word] = ret[word] >> shift;
+            if (word + 1 < WordsPerRow) {
+                shifted[word] |= ret[word + 1] << (WordBits - shift);
+            }
+        }
+        for (int word = 0; word < WordsPerRow; word++) {
+            ret[word] &= shifted[word];
+        }
+
+        covered += shift;
+    }
+    return ret;
+}
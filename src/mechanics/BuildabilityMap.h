@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stddef.h>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "core/Constants.h"
+#include "core/Types.h"
+
+class Map;
+
+namespace genie {
+class Unit;
+}
+
+/// A rectangle of tiles, inclusive
+struct TileRect
+{
+    int firstX = 0;
+    int firstY = 0;
+    int lastX = -1;
+    int lastY = -1;
+
+    inline bool isEmpty() const noexcept { return lastX < firstX || lastY < firstY; }
+
+    inline bool operator==(const TileRect &other) const noexcept {
+        return firstX == other.firstX && firstY == other.firstY && lastX == other.lastX && lastY == other.lastY;
+    }
+    inline bool operator!=(const TileRect &other) const noexcept { return !(*this == other); }
+};
+
+/// Where buildings can be placed, one bit per tile, with both the terrain and
+/// whatever is standing there (other buildings, trees, etc.) taken into account.
+///
+/// There's one set of bits per kind of terrain restriction, built the first time
+/// something asks for it and then kept up to date when terrain changes or
+/// something that blocks placement appears or goes away. So checking a placement
+/// is a couple of word compares per row instead of looking up every tile.
+class BuildabilityMap
+{
+public:
+    static constexpr int WordBits = 64;
+    static constexpr int WordsPerRow = (Constants::MAP_MAX_SIZE + WordBits - 1) / WordBits;
+
+    typedef std::array<uint64_t, WordsPerRow> Row;
+
+    BuildabilityMap(const Map &map);
+    ~BuildabilityMap();
+
+    BuildabilityMap(const BuildabilityMap &) = delete;
+    const BuildabilityMap &operator=(const BuildabilityMap &) = delete;
+
+    /// If the building fits with its position at the given tile
+    bool canPlace(const genie::Unit &data, const int tileX, const int tileY);
+
+    /// All the positions in the region (same tiles as canPlace() takes) where the building fits, in map coordinates
+    std::vector<MapPos> findPlacements(const genie::Unit &data, const TileRect &region);
+
+    /// Called by the map
+    void onTerrainChanged(const int tileX, const int tileY);
+    void onMapRecreated();
+
+    void addObstruction(const TileRect &tiles);
+    void removeObstruction(const TileRect &tiles);
+
+    /// If anything that blocks placement is standing on any of the tiles
+    bool isObstructed(const TileRect &tiles) const noexcept;
+
+    /// If units of this type block buildings from being placed on top of them
+    static bool isObstruction(const genie::Unit &data) noexcept;
+
+    /// The tiles a unit of this type covers at the given position
+    static TileRect obstructionTiles(const genie::Unit &data, const MapPos &position) noexcept;
+
+private:
+    struct Plane {
+        int terrainRestriction = -1;
+        int placementTerrain = -1;
+
+        std::vector<bool> buildableTerrain; // per terrain id
+        std::array<Row, Constants::MAP_MAX_SIZE> rows{};
+    };
+
+    /// The size of the building on the map, and where it starts relative to its position tile
+    struct Footprint {
+        int width = 0;
+        int height = 0;
+        int offsetX = 0;
+        int offsetY = 0;
+    };
+    static Footprint footprintFor(const genie::Unit &data) noexcept;
+
+    Plane &planeFor(const genie::Unit &data);
+    void buildPlane(Plane *plane);
+    void updateTile(const int tileX, const int tileY);
+    bool isBuildable(const Plane &plane, const int tileX, const int tileY) const noexcept;
+
+    /// Bit x is set if the x..x+width-1 are all set
+    static Row erodeRow(const Row &row, const int width) noexcept;
+
+    const Map &m_map;
+
+    std::vector<std::unique_ptr<Plane>> m_planes;
+
+    // Number of things standing on each tile that block placement
+    std::array<uint16_t, Constants::MAP_MAX_SIZE * Constants::MAP_MAX_SIZE> m_obstructions{};
+};
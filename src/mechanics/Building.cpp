@@ -2,7 +2,6 @@
 
 #include <genie/Types.h>
 #include <genie/dat/Research.h>
-#include <genie/dat/TerrainRestriction.h>
 #include <genie/dat/Unit.h>
 #include <genie/dat/unit/../ResourceUsage.h>
 #include <genie/dat/unit/Creatable.h>
@@ -19,7 +18,6 @@
 #include "core/Logger.h"
 #include "mechanics/Civilization.h"
 #include "mechanics/UnitManager.h"
-#include "resource/DataManager.h"
 #include "resource/LanguageManager.h"
 
 Building::Building(const genie::Unit &data_, const std::shared_ptr<Player> &player_, UnitManager &unitManager) :
@@ -31,13 +29,20 @@ Building::Building(const genie::Unit &data_, const std::shared_ptr<Player> &play
 Building::~Building()
 {
     Player::Ptr owner = player().lock();
-    if (owner) {
-        for (const std::unique_ptr<Product> &toAbort : m_productionQueue) {
+    if (owner && m_production) {
+        for (const std::unique_ptr<Product> &toAbort : m_production->queue) {
             for (const std::pair<const genie::ResourceType, float> &cost : toAbort->cost) {
                 owner->addResource(cost.first, cost.second);
             }
+            if (toAbort->type == Product::Unit) {
+                owner->onUnitProductionEnded(toAbort->unit()->ID);
+            }
+        }
+        m_production->queue.clear();
+
+        if (m_production->current && m_production->current->type == Product::Unit) {
+            owner->onUnitProductionEnded(m_production->current->unit()->ID);
         }
-        m_productionQueue.clear();
     }
 }
 
@@ -55,7 +60,7 @@ bool Building::ungarrison(const std::shared_ptr<Unit> &unit)
         if (garrisoned == unit) {
             // TOOD: find a nice position to put the unit
             // Works ish because the unit preserves the position it was at when getting garrisoned
-            unit->garrisonedIn.reset();
+            unit->setGarrisonedIn(nullptr);
             it = garrisonedUnits.erase(it);
             return true;
         }
@@ -99,11 +104,11 @@ bool Building::enqueueProduceUnit(const genie::Unit *data) noexcept
         return false;
     }
 
-    DBG << debugName << "enqueueing production of unit" << data->Name;
+    DBG << debugName() << "enqueueing production of unit" << data->Name;
 
     std::unique_ptr<Product> product = std::make_unique<Product>();
     product->type = Product::Unit;
-    product->unit = data;
+    product->unitSlot = owner->civilization.unitDataSlot(data->ID);
 
     for (const genie::Resource<short, short> &cost : data->Creatable.ResourceCosts) {
         if (!cost.Paid) {
@@ -115,9 +120,11 @@ bool Building::enqueueProduceUnit(const genie::Unit *data) noexcept
         product->cost[type] = cost.Amount;
     }
 
-    m_productionQueue.push_back(std::move(product));
+    wake();
+    production().queue.push_back(std::move(product));
+    owner->onUnitProductionQueued(data->ID);
 
-    if (!m_currentProduct) {
+    if (!m_production->current) {
         attemptStartProduction();
     }
 
@@ -164,9 +171,10 @@ bool Building::enqueueProduceResearch(const genie::Tech *data) noexcept
         product->cost[type] = r.Amount;
     }
 
-    m_productionQueue.push_back(std::move(product));
+    wake();
+    production().queue.push_back(std::move(product));
 
-    if (!m_currentProduct) {
+    if (!m_production->current) {
         attemptStartProduction();
     }
 
@@ -175,18 +183,28 @@ bool Building::enqueueProduceResearch(const genie::Tech *data) noexcept
 
 void Building::abortProduction(size_t index) noexcept
 {
-    if (m_currentProduct) {
+    if (!m_production) {
+        WARN << "index for abort" << index << "is out of range, nothing queued";
+        return;
+    }
+
+    if (m_production->current) {
         if (index == 0) {
-            m_currentProduct.reset();
+            Player::Ptr owner = player().lock();
+            if (owner && m_production->current->type == Product::Unit) {
+                owner->onUnitProductionEnded(m_production->current->unit()->ID);
+            }
+            m_production->current.reset();
+            freeProductionIfDone();
             return;
 
         }
         index--;
     }
 
-
-    if (index >= m_productionQueue.size()) {
-        WARN << "index for abort" << index << "is out of range" << m_productionQueue.size();
+    std::vector<std::unique_ptr<Product>> &queue = m_production->queue;
+    if (index >= queue.size()) {
+        WARN << "index for abort" << index << "is out of range" << queue.size();
         return;
     }
 
@@ -195,75 +213,87 @@ void Building::abortProduction(size_t index) noexcept
         WARN << "building owner went away";
         return;
     }
-    const Product &toAbort = *m_productionQueue.at(index);
+    const Product &toAbort = *queue.at(index);
 
     for (const std::pair<const genie::ResourceType, float> &cost : toAbort.cost) {
         owner->addResource(cost.first, cost.second);
     }
+    if (toAbort.type == Product::Unit) {
+        owner->onUnitProductionEnded(toAbort.unit()->ID);
+    }
 
-    m_productionQueue.erase(m_productionQueue.begin() + index);
+    queue.erase(queue.begin() + index);
+    freeProductionIfDone();
 }
 
 float Building::productionProgress() const noexcept
 {
-    if (!m_currentProduct) {
+    if (!m_production || !m_production->current) {
         return 0;
     }
 
+    const Product &current = *m_production->current;
     float maximum = 0;
-    if (m_currentProduct->type == Product::Unit) {
-        maximum = m_currentProduct->unit->Creatable.TrainTime;
+    if (current.type == Product::Unit) {
+        maximum = current.unit()->Creatable.TrainTime;
     } else {
-        maximum = m_currentProduct->tech->ResearchTime;
+        maximum = current.tech->ResearchTime;
     }
 
-    return std::min(m_productionProgress / maximum, 1.f);
+    return std::min(m_production->progress / maximum, 1.f);
 }
 
 int Building::productIcon(size_t index) noexcept
 {
-    if (m_currentProduct) {
+    if (!m_production) {
+        WARN << "index for icon" << index << "is out of range, nothing queued";
+        return 0;
+    }
+
+    const std::unique_ptr<Product> &current = m_production->current;
+    if (current) {
         if (index == 0) {
-            if (m_currentProduct->type == Product::Unit) {
-                return m_currentProduct->unit->IconID;
+            if (current->type == Product::Unit) {
+                return current->unit()->IconID;
             } else {
-                return m_currentProduct->tech->IconID;
+                return current->tech->IconID;
             }
         }
 
         index--;
     }
 
-
-    if (index >= m_productionQueue.size()) {
-        WARN << "index for abort" << index << "is out of range" << m_productionQueue.size();
+    const std::vector<std::unique_ptr<Product>> &queue = m_production->queue;
+    if (index >= queue.size()) {
+        WARN << "index for abort" << index << "is out of range" << queue.size();
         return 0;
     }
 
-    if (m_productionQueue[index]->type == Product::Unit) {
-        return m_productionQueue[index]->unit->IconID;
+    if (queue[index]->type == Product::Unit) {
+        return queue[index]->unit()->IconID;
     } else {
-        return m_productionQueue[index]->tech->IconID;
+        return queue[index]->tech->IconID;
     }
 }
 
 std::string Building::currentProductName() noexcept
 {
-    if (!m_currentProduct) {
-        if (m_productionQueue.empty()) {
+    if (!m_production) {
+        return "";
+    }
+
+    const Product *product = m_production->current.get();
+    if (!product) {
+        if (m_production->queue.empty()) {
             return "";
         }
-        if (m_productionQueue.front()->type == Product::Unit) {
-            return LanguageManager::Inst()->getString(m_productionQueue.front()->unit->LanguageDLLName);
-        } else {
-            return LanguageManager::Inst()->getString(m_productionQueue.front()->tech->LanguageDLLName);
-        }
+        product = m_production->queue.front().get();
     }
 
-    if (m_currentProduct->type == Product::Unit) {
-        return LanguageManager::Inst()->getString(m_currentProduct->unit->LanguageDLLName);
+    if (product->type == Product::Unit) {
+        return LanguageManager::Inst()->getString(product->unit()->LanguageDLLName);
     } else {
-        return LanguageManager::Inst()->getString(m_currentProduct->tech->LanguageDLLName);
+        return LanguageManager::Inst()->getString(product->tech->LanguageDLLName);
     }
 }
 
@@ -276,28 +306,33 @@ bool Building::update(Time time) noexcept
 
     bool updated = Unit::update(time);
 
-    if (m_currentProduct) {
+    if (!m_production) {
+        return updated;
+    }
+
+    if (m_production->current) {
         float productionTime = 0;
-        if (m_currentProduct->type == Product::Unit) {
-            productionTime = m_currentProduct->unit->Creatable.TrainTime;
+        if (m_production->current->type == Product::Unit) {
+            productionTime = m_production->current->unit()->Creatable.TrainTime;
         } else {
-            productionTime = m_currentProduct->tech->ResearchTime;
+            productionTime = m_production->current->tech->ResearchTime;
         }
 
-        m_productionProgress += deltaTime * 0.0015;
-        if (m_productionProgress >= productionTime) {
-            if (m_currentProduct->type == Product::Unit) {
+        m_production->progress += deltaTime * 0.0015;
+        if (m_production->progress >= productionTime) {
+            if (m_production->current->type == Product::Unit) {
                 finalizeUnit();
             } else {
                 finalizeResearch();
             }
 
-            m_currentProduct.reset();
-            m_productionProgress = 0;
+            m_production->current.reset();
+            m_production->progress = 0;
+            freeProductionIfDone();
         }
 
         updated = true;
-    } else if (!m_productionQueue.empty()) {
+    } else if (!m_production->queue.empty()) {
         attemptStartProduction();
         updated = true;
     }
@@ -305,6 +340,19 @@ bool Building::update(Time time) noexcept
     return updated;
 }
 
+bool Building::canSleep() const noexcept
+{
+    return !isProducing() && Unit::canSleep();
+}
+
+void Building::onWoken(const Time time) noexcept
+{
+    Unit::onWoken(time);
+
+    // Don't count the time we slept as production time
+    m_lastUpdateTime = time;
+}
+
 void Building::setPosition(const MapPos &pos, const bool initial)
 {
     std::shared_ptr<Map> map = m_map.lock();
@@ -318,41 +366,7 @@ bool Building::canPlace(const MapPos &position, const MapPtr &map, const genie::
     REQUIRE(map, return false);
     REQUIRE(data, return false);
 
-    std::vector<float> passable = DataManager::Inst().getTerrainRestriction(data->TerrainRestriction).PassableBuildableDmgMultiplier;
-
-    const int tileX = position.x / Constants::TILE_SIZE;
-    const int tileY = position.y / Constants::TILE_SIZE;
-
-    const int valid1 = data->PlacementTerrain.first;
-    const int valid2 = data->PlacementTerrain.first;
-
-    const int width = data->ClearanceSize.x + data->Size.x;
-    const int height = data->ClearanceSize.x + data->Size.x;
-
-    if (!map->isValidTile(tileX - width/2, tileY - width/2)) {
-        return false;
-    }
-
-    if (!map->isValidTile(tileX + width/2, tileY + height/2)) {
-        return false;
-    }
-
-    for (int dx = 0; dx < width; dx++) {
-        for (int dy = 0; dy < width; dy++) {
-            const int terrainId = map->getTileAt(tileX + dx - width/2, tileY + dy - height/2).terrainId;
-            if (valid1 != -1 && terrainId != valid1) {
-                return false;
-            }
-            if (valid2 != -1 && terrainId != valid2) {
-                return false;
-            }
-            if (!passable[terrainId]) {
-                return false;
-            }
-        }
-    }
-
-    return true;
+    return map->buildability().canPlace(*data, position.x / Constants::TILE_SIZE, position.y / Constants::TILE_SIZE);
 }
 
 void Building::finalizeUnit() noexcept
@@ -363,10 +377,12 @@ void Building::finalizeUnit() noexcept
         return;
     }
 
+    owner->onUnitProductionEnded(m_production->current->unit()->ID);
+
     waypoint.x = position().x + 24;
     waypoint.y = position().y + 24;
 
-    Unit::Ptr unit = UnitFactory::Inst().createUnit(m_currentProduct->unit->ID, owner, m_unitManager);
+    Unit::Ptr unit = UnitFactory::Inst().createUnit(m_production->current->unit()->ID, owner, m_unitManager);
     if (!unit) {
         WARN << "Failed to finalize unit";
         return;
@@ -380,7 +396,7 @@ void Building::finalizeUnit() noexcept
         WARN << "Lost our player";
     }
 
-    DBG << "Finalized" << unit->debugName;
+    DBG << "Finalized" << unit->debugName();
 }
 
 void Building::finalizeResearch() noexcept
@@ -390,13 +406,13 @@ void Building::finalizeResearch() noexcept
         WARN << "building owner went away";
         return;
     }
-    owner->applyResearch(m_currentProduct->tech->EffectID);
+    owner->applyResearch(m_production->current->tech->EffectID);
 
 }
 
 void Building::attemptStartProduction() noexcept
 {
-    if (m_productionQueue.empty()) {
+    if (!m_production || m_production->queue.empty()) {
         DBG << "empty queue";
         return;
     }
@@ -407,10 +423,10 @@ void Building::attemptStartProduction() noexcept
         return;
     }
 
-    const Product &product = *m_productionQueue.front();
+    const Product &product = *m_production->queue.front();
 
     if (product.type == Product::Unit) {
-        for (const genie::Resource<short, short> &cost : product.unit->Creatable.ResourceCosts) {
+        for (const genie::Resource<short, short> &cost : product.unit()->Creatable.ResourceCosts) {
             if (cost.Paid) {
                 continue;
             }
@@ -433,7 +449,22 @@ void Building::attemptStartProduction() noexcept
         }
     }
 
-    m_productionProgress = 0.f;
-    m_currentProduct = std::move(m_productionQueue.front());
-    m_productionQueue.erase(m_productionQueue.begin());
+    m_production->progress = 0.f;
+    m_production->current = std::move(m_production->queue.front());
+    m_production->queue.erase(m_production->queue.begin());
+}
+
+Building::Production &Building::production()
+{
+    if (!m_production) {
+        m_production = std::make_unique<Production>();
+    }
+    return *m_production;
+}
+
+void Building::freeProductionIfDone() noexcept
+{
+    if (m_production && !m_production->current && m_production->queue.empty()) {
+        m_production.reset();
+    }
 }
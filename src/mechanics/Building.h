@@ -36,15 +36,16 @@ struct Building : public Unit
     bool enqueueProduceUnit(const genie::Unit *data) noexcept;
     bool enqueueProduceResearch(const genie::Tech *data) noexcept;
     void abortProduction(size_t index) noexcept;
-    size_t productionQueueLength() const noexcept { return m_productionQueue.size() + (m_currentProduct != nullptr ? 1 : 0); }
+    size_t productionQueueLength() const noexcept { return m_production ? m_production->queue.size() + (m_production->current != nullptr ? 1 : 0) : 0; }
 
-    bool isResearching() const noexcept { return m_currentProduct && m_currentProduct->type == Product::Research; }
+    bool isResearching() const noexcept { return m_production && m_production->current && m_production->current->type == Product::Research; }
     bool isProducing() const noexcept { return productionQueueLength() > 0; }
     int productIcon(size_t index) noexcept;
     std::string currentProductName() noexcept;
     float productionProgress() const noexcept;
 
     bool update(Time time) noexcept override;
+    bool canSleep() const noexcept override;
 
     void setPosition(const MapPos &pos, const bool initial = false) override;
 
@@ -52,10 +53,14 @@ struct Building : public Unit
 
     static bool canPlace(const MapPos &pos, const MapPtr &map, const genie::Unit *data);
 
+protected:
+    void onWoken(const Time time) noexcept override;
+
 private:
     void finalizeUnit() noexcept;
     void finalizeResearch() noexcept;
     void attemptStartProduction() noexcept;
+    void freeProductionIfDone() noexcept;
 
     struct Product {
         enum {
@@ -66,15 +71,21 @@ private:
         ResourceMap cost;
 
         union {
-            const genie::Unit *unit = nullptr;
+            const genie::Unit *const *unitSlot = nullptr; // through the civilization, in case of upgrades while queued
             const genie::Tech *tech;
         };
-    };
 
-    std::vector<std::unique_ptr<Product>> m_productionQueue;
-    float m_productionProgress = 0.f;
+        const genie::Unit *unit() const noexcept { return *unitSlot; }
+    };
 
-    std::unique_ptr<Product> m_currentProduct;
+    /// Most buildings never produce anything, so only allocated while something is queued
+    struct Production {
+        std::vector<std::unique_ptr<Product>> queue;
+        std::unique_ptr<Product> current;
+        float progress = 0.f;
+    };
+    Production &production();
+    std::unique_ptr<Production> m_production;
 
     Time m_lastUpdateTime = 0;
 };
@@ -14,6 +14,8 @@
 #include <algorithm>
 #include <cstdint>
 
+#include "core/Utility.h"
+#include "mechanics/UnitActionHandler.h"
 #include "resource/DataManager.h"
 
 const genie::Unit Civilization::nullUnit;
@@ -22,6 +24,13 @@ Civilization::Civilization(const int civId) :
     m_civId(civId),
     m_data(DataManager::Inst().civilization(civId))
 {
+    // Never resized after this, the gaia override might have more units than us
+    size_t unitCount = 0;
+    for (const genie::Civ &civ : DataManager::Inst().civilizations()) {
+        unitCount = std::max(unitCount, civ.Units.size());
+    }
+    m_unitsData.resize(unitCount, nullptr);
+
     applyData(m_data);
 }
 
@@ -70,6 +79,31 @@ const std::vector<const genie::Unit *> &Civilization::swappableUnits(const uint1
     return m_taskSwapUnits[taskSwapGroup];
 }
 
+const std::shared_ptr<UnitTaskTable> &Civilization::taskTable(const uint32_t unitId)
+{
+    std::shared_ptr<UnitTaskTable> &table = m_taskTables[unitId];
+    if (!table) {
+        table = UnitTaskTable::create(unitData(unitId), *this);
+    }
+    return table;
+}
+
+void Civilization::invalidateTaskTables()
+{
+    // Someone might still be holding on to them, so tell them to get a new one
+    for (std::pair<const uint32_t, std::shared_ptr<UnitTaskTable>> &table : m_taskTables) {
+        table.second->isStale = true;
+    }
+    m_taskTables.clear();
+}
+
+void Civilization::invalidateDamageTable()
+{
+    // Anyone attacking us notices that the revision changed
+    m_unitDataRevision++;
+    m_damageTable.clear();
+}
+
 float Civilization::startingResource(const genie::ResourceType type) const
 {
     return m_data.Resources[int(type)];
@@ -77,23 +111,44 @@ float Civilization::startingResource(const genie::ResourceType type) const
 
 const genie::Unit &Civilization::unitData(uint32_t id) const
 {
-    if (id >= m_unitsData.size()) {
+    if (id >= m_unitsData.size() || !m_unitsData[id]) {
         WARN << "invalid unit id" << id;
-        static const genie::Unit nullUnit;
         return nullUnit;
     }
 
-    return m_unitsData[id];
+    return *m_unitsData[id];
+}
+
+const genie::Unit *const *Civilization::unitDataSlot(const uint32_t id) const
+{
+    if (id >= m_unitsData.size() || !m_unitsData[id]) {
+        WARN << "invalid unit id" << id;
+        static const genie::Unit *const nullSlot = &nullUnit;
+        return &nullSlot;
+    }
+
+    return &m_unitsData[id];
+}
+
+const std::vector<uint32_t> &Civilization::unitsOfClass(const int16_t classId) const
+{
+    std::unordered_map<int16_t, std::vector<uint32_t>>::const_iterator it = m_unitsByClass.find(classId);
+    if (it == m_unitsByClass.end()) {
+        static const std::vector<uint32_t> nullVector;
+        return nullVector;
+    }
+
+    return it->second;
 }
 
 void Civilization::enableUnit(const uint16_t id)
 {
-    if (id >= m_unitsData.size()) {
+    if (id >= m_unitsData.size() || !m_unitsData[id]) {
         WARN << "invalid unit id" << id;
         return;
     }
 
-    genie::Unit &unit = m_unitsData[id];
+    genie::Unit &unit = writableUnitData(id);
     unit.Enabled = true;
     if (unit.Creatable.TrainLocationID > 0) {
         m_creatableUnits[unit.Creatable.TrainLocationID].push_back(&unit);
@@ -124,11 +179,8 @@ void Civilization::applyUnitAttributeModifier(const genie::EffectCommand &effect
     if (effect.TargetUnit >= 0) {
         applyUnitAttributeModifier(effect, effect.TargetUnit);
     } else if (effect.UnitClassID >= 0) {
-        for (const genie::Unit &unitData : m_unitsData) {
-            if (unitData.Class != effect.UnitClassID) {
-                continue;
-            }
-            applyUnitAttributeModifier(effect, unitData.ID);
+        for (const uint32_t unitId : unitsOfClass(effect.UnitClassID)) {
+            applyUnitAttributeModifier(effect, unitId);
         }
     } else {
         WARN << "Can't apply effect with neither unit id or class id";
@@ -144,18 +196,35 @@ void Civilization::applyData(const genie::Civ &data)
 {
     DBG << "Applying for civ";
 
-    if (data.Units.size() > m_unitsData.size()) {
-        m_unitsData.resize(data.Units.size());
-    }
+    REQUIRE(data.Units.size() <= m_unitsData.size(), return);
 
     for (size_t i=0; i<data.Units.size(); i++) {
         if (data.Units[i].ID == -1) {
             continue;
         }
-        m_unitsData[i] = data.Units[i];
+
+        // We already have our own copy, just overwrite it
+        std::unordered_map<uint32_t, std::unique_ptr<genie::Unit>>::iterator modified = m_modifiedUnitsData.find(i);
+        if (modified != m_modifiedUnitsData.end()) {
+            *modified->second = data.Units[i];
+            continue;
+        }
+
+        m_unitsData[i] = &data.Units[i];
     }
 
-    for (const genie::Unit &unit : m_unitsData) {
+    invalidateTaskTables();
+    invalidateDamageTable();
+
+    m_unitsByClass.clear();
+    for (const genie::Unit *unitData : m_unitsData) {
+        if (!unitData) {
+            continue;
+        }
+        const genie::Unit &unit = *unitData;
+
+        m_unitsByClass[unit.Class].push_back(unit.ID);
+
         if (unit.Enabled && unit.Creatable.TrainLocationID > 0) {
             m_creatableUnits[unit.Creatable.TrainLocationID].push_back(&unit);
         }
@@ -197,15 +266,131 @@ void Civilization::applyData(const genie::Civ &data)
 
         m_startingResources[genie::ResourceType(i)] = data.Resources[i];
     }
+
+    updateTechDependencies();
+}
+
+void Civilization::updateTechDependencies()
+{
+    m_techDependencies = TechDependencies();
+
+    const auto addNode = [this](const genie::Tech &tech, const int techId, const bool isImplicit) {
+        TechDependencies::Node node;
+        node.techId = techId;
+        node.effectId = tech.EffectID;
+        node.isImplicit = isImplicit;
+
+        const uint32_t index = m_techDependencies.nodes.size();
+
+        std::vector<int> requirements;
+        for (const int reqId : tech.RequiredTechs) {
+            if (reqId == -1) {
+                continue;
+            }
+            if (std::find(requirements.begin(), requirements.end(), reqId) != requirements.end()) {
+                continue;
+            }
+            requirements.push_back(reqId);
+            m_techDependencies.dependants[reqId].push_back(index);
+        }
+        node.requirementCount = requirements.size();
+
+        m_techDependencies.nodes.push_back(node);
+    };
+
+    // Implicit research, applied automatically
+    const std::vector<genie::Tech> &techs = DataManager::Inst().allTechs();
+    for (size_t i=0; i<techs.size(); i++) {
+        const genie::Tech &tech = techs[i];
+        if (tech.ResearchLocation != -1) {
+            continue;
+        }
+        if (tech.EffectID == -1) {
+            continue;
+        }
+        if (tech.Civ != -1 && tech.Civ != m_civId) {
+            continue;
+        }
+        addNode(tech, i, true);
+    }
+
+    // Things that can be researched somewhere
+    for (const std::pair<const uint16_t, genie::Tech> &tech : m_techs) {
+        addNode(tech.second, tech.first, false);
+    }
+}
+
+genie::Unit &Civilization::writableUnitData(const uint32_t id)
+{
+    // The tasks depend on the unit data, simpler to throw away all of them (tech effects are rare)
+    if (!m_taskTables.empty()) {
+        invalidateTaskTables();
+    }
+    invalidateDamageTable();
+
+    std::unique_ptr<genie::Unit> &modified = m_modifiedUnitsData[id];
+    if (modified) {
+        return *modified;
+    }
+
+    const genie::Unit *original = m_unitsData[id];
+    modified = std::make_unique<genie::Unit>(*original);
+    const genie::Unit *copy = modified.get();
+    m_unitsData[id] = copy;
+
+    // Point the lists we have to our own copy
+    for (std::pair<const int16_t, std::vector<const genie::Unit*>> &creatable : m_creatableUnits) {
+        std::replace(creatable.second.begin(), creatable.second.end(), original, copy);
+    }
+    for (std::vector<const genie::Unit*> &group : m_taskSwapUnits) {
+        std::replace(group.begin(), group.end(), original, copy);
+    }
+
+    return *modified;
+}
+
+Civilization::MemoryUsage Civilization::memoryUsage() const
+{
+    // Not exact, but good enough to get an idea
+    const auto unitDataSize = [](const genie::Unit &unit) {
+        return sizeof(genie::Unit) +
+                unit.Combat.Attacks.capacity() * sizeof(genie::unit::AttackOrArmor) +
+                unit.Combat.Armours.capacity() * sizeof(genie::unit::AttackOrArmor);
+    };
+
+    MemoryUsage usage;
+    for (const genie::Unit *unit : m_unitsData) {
+        if (!unit) {
+            continue;
+        }
+        usage.unitCount++;
+        usage.fullCopyBytes += unitDataSize(*unit);
+    }
+
+    for (const std::pair<const uint32_t, std::unique_ptr<genie::Unit>> &modified : m_modifiedUnitsData) {
+        usage.modifiedUnitCount++;
+        usage.ownBytes += unitDataSize(*modified.second);
+    }
+
+    usage.ownBytes += m_unitsData.capacity() * sizeof(const genie::Unit*);
+
+    return usage;
+}
+
+void Civilization::printMemoryUsage() const
+{
+    const MemoryUsage usage = memoryUsage();
+    DBG << "Unit data for" << name() << ":" << usage.modifiedUnitCount << "of" << usage.unitCount << "units modified,"
+        << (usage.ownBytes / 1024) << "KiB used, full copy would be" << (usage.fullCopyBytes / 1024) << "KiB";
 }
 
 void Civilization::applyUnitAttributeModifier(const genie::EffectCommand &effect, uint32_t unitId)
 {
-    if (unitId >= m_unitsData.size()) {
+    if (unitId >= m_unitsData.size() || !m_unitsData[unitId]) {
         WARN << "invalid unit id" << unitId;
         return;
     }
-    genie::Unit &unitData = m_unitsData[unitId];
+    genie::Unit &unitData = writableUnitData(unitId);
 
     using genie::EffectCommand;
     switch (effect.AttributeID) {
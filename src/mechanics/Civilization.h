@@ -13,6 +13,35 @@
 
 #include "core/Logger.h"
 #include "core/ResourceMap.h"
+#include "mechanics/DamageTable.h"
+
+struct UnitTaskTable;
+
+/// Which techs depend on what, so when something gets researched we only need
+/// to look at the techs that require it instead of going through all of them.
+struct TechDependencies
+{
+    struct Node {
+        int techId = -1;
+        int effectId = -1;
+        int requirementCount = 0; // unique requirements, a tech with none never gets available
+        bool isImplicit = false; // applied automatically when the requirements are met (no research location)
+    };
+
+    std::vector<Node> nodes;
+
+    // Requirement ID -> index of nodes that require it
+    std::unordered_map<int, std::vector<uint32_t>> dependants;
+
+    const std::vector<uint32_t> &dependantsOf(const int requirementId) const {
+        static const std::vector<uint32_t> nullVector;
+        std::unordered_map<int, std::vector<uint32_t>>::const_iterator it = dependants.find(requirementId);
+        if (it == dependants.end()) {
+            return nullVector;
+        }
+        return it->second;
+    }
+};
 
 class Civilization
 {
@@ -28,11 +57,28 @@ public:
     const std::vector<const genie::Tech *> &researchAvailableAt(int16_t creator) const;
 
     const genie::Unit &unitData(uint32_t id) const;
+
+    /// Where unitData() for the type always is, for anything that keeps the data around.
+    /// What it points to changes when we make our own copy to modify it, so always go through it.
+    const genie::Unit *const *unitDataSlot(const uint32_t id) const;
+    const std::vector<uint32_t> &unitsOfClass(const int16_t classId) const;
     const genie::Tech &tech(const uint16_t id) const;
     const std::unordered_map<uint16_t, genie::Tech> &availableTechs() const { return m_techs; }
+    const TechDependencies &techDependencies() const { return m_techDependencies; }
 
     const std::vector<const genie::Unit *> &swappableUnits(const uint16_t taskSwapGroup) const;
 
+    /// Created the first time it is needed, and thrown away when the unit data is modified
+    const std::shared_ptr<UnitTaskTable> &taskTable(const uint32_t unitId);
+
+    /// How much damage one of our units does to the defender, looked up in a table that is thrown away when our unit data is modified
+    float damage(const genie::Unit &attacker, const genie::Unit &defender, const uint32_t defenderRevision, const DamageTable::Elevation elevation) {
+        return m_damageTable.damage(attacker, defender, defenderRevision, elevation);
+    }
+
+    /// Changes every time any of our unit data is modified
+    uint32_t unitDataRevision() const { return m_unitDataRevision; }
+
     const ResourceMap &startingResources() const { return m_startingResources; }
 
     const std::string &name() const { return m_data.Name; }
@@ -46,11 +92,27 @@ public:
     // This seems so wrong, but meh
     void setGaiaOverrideCiv(const int civId);
 
+    struct MemoryUsage {
+        size_t unitCount = 0;
+        size_t modifiedUnitCount = 0;
+        size_t fullCopyBytes = 0; // what it would cost to have our own copy of everything
+        size_t ownBytes = 0; // what we actually use
+    };
+    MemoryUsage memoryUsage() const;
+    void printMemoryUsage() const;
+
 private:
     void applyData(const genie::Civ &data);
+    void updateTechDependencies();
 
     void applyUnitAttributeModifier(const genie::EffectCommand &effect, uint32_t unitId);
 
+    /// Makes a private copy of the unit data the first time we need to modify it
+    genie::Unit &writableUnitData(const uint32_t id);
+
+    void invalidateTaskTables();
+    void invalidateDamageTable();
+
     std::unordered_map<int16_t, std::vector<const genie::Unit*>> m_creatableUnits;
     std::unordered_map<int16_t, std::vector<const genie::Tech*>> m_researchAvailable;
 
@@ -58,9 +120,23 @@ private:
 
     const int m_civId;
     const genie::Civ &m_data;
-    std::vector<genie::Unit> m_unitsData;
+
+    // Points to the data in the DataManager (shared by everyone), until we modify it.
+    // Sized once for the biggest civilization so the slots never move, whoever keeps
+    // unit data around reads it through them. Our copies go away with us.
+    std::vector<const genie::Unit*> m_unitsData;
+    std::unordered_map<uint32_t, std::unique_ptr<genie::Unit>> m_modifiedUnitsData;
+
+    std::unordered_map<uint32_t, std::shared_ptr<UnitTaskTable>> m_taskTables;
+
+    DamageTable m_damageTable;
+    uint32_t m_unitDataRevision = 0;
+
+    // So effects for a whole class don't need to look at all the units
+    std::unordered_map<int16_t, std::vector<uint32_t>> m_unitsByClass;
 
     std::unordered_map<uint16_t, genie::Tech> m_techs;
+    TechDependencies m_techDependencies;
     ResourceMap m_startingResources;
 };
 
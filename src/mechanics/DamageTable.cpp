@@ -0,0 +1,44 @@
+#include "DamageTable.h"
+
+#include <genie/dat/Unit.h>
+#include <genie/dat/unit/AttackOrArmor.h>
+#include <genie/dat/unit/Combat.h>
+#include <algorithm>
+
+float DamageTable::damage(const genie::Unit &attacker, const genie::Unit &defender, const uint32_t defenderRevision, const Elevation elevation)
+{
+    Key key;
+    key.attacker = &attacker;
+    key.defender = &defender;
+
+    std::unordered_map<Key, Entry, KeyHash>::iterator it = m_entries.find(key);
+    if (it != m_entries.end() && it->second.defenderRevision == defenderRevision) {
+        return it->second.damage[elevation];
+    }
+
+    Entry entry;
+    entry.damage[SameLevel] = calculateDamage(attacker, defender, 1.f);
+    entry.damage[HighGround] = calculateDamage(attacker, defender, HighGroundMultiplier);
+    entry.defenderRevision = defenderRevision;
+    m_entries[key] = entry;
+
+    return entry.damage[elevation];
+}
+
+float DamageTable::calculateDamage(const genie::Unit &attacker, const genie::Unit &defender, const float damageMultiplier) noexcept
+{
+    // Every attack class does at least one damage, even if the defender has no armour for it
+    float total = 0;
+    for (const genie::unit::AttackOrArmor &attack : attacker.Combat.Attacks) {
+        float damage = 0;
+        for (const genie::unit::AttackOrArmor &armor : defender.Combat.Armours) {
+            if (attack.Class != armor.Class) {
+                continue;
+            }
+
+            damage += std::max(attack.Amount - armor.Amount, 0);
+        }
+        total += std::max(damage * damageMultiplier, 1.f);
+    }
+    return total;
+}
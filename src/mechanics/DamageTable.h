@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stddef.h>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+namespace genie {
+class Unit;
+}
+
+/// How much damage one unit type does to another, so we don't have to match
+/// up the attack and armour classes on every single hit.
+///
+/// Keyed on the unit data itself, so the same type for different players
+/// (with different upgrades) gets different entries. The unit data is never
+/// deleted, so the pointers stay valid, but it can be modified in place by
+/// tech effects, so the owner clears the table when its own data changes and
+/// each entry remembers the revision of the defender's data it was made with.
+class DamageTable
+{
+public:
+    enum Elevation {
+        SameLevel,
+        HighGround,
+        ElevationCount
+    };
+
+    /// Attacking from higher up does more damage
+    static constexpr float HighGroundMultiplier = 3.f/2.f;
+
+    float damage(const genie::Unit &attacker, const genie::Unit &defender, const uint32_t defenderRevision, const Elevation elevation);
+
+    void clear() { m_entries.clear(); }
+    size_t size() const { return m_entries.size(); }
+
+    /// Does the actual lookups, for when there's no table to use
+    static float calculateDamage(const genie::Unit &attacker, const genie::Unit &defender, const float damageMultiplier) noexcept;
+
+private:
+    struct Key {
+        const genie::Unit *attacker = nullptr;
+        const genie::Unit *defender = nullptr;
+
+        inline bool operator==(const Key &other) const noexcept {
+            return attacker == other.attacker && defender == other.defender;
+        }
+    };
+
+    struct KeyHash {
+        inline size_t operator()(const Key &key) const noexcept {
+            const size_t hash = std::hash<const void*>()(key.attacker);
+            return hash ^ (std::hash<const void*>()(key.defender) + 0x9e3779b9 + (hash << 6) + (hash >> 2));
+        }
+    };
+
+    struct Entry {
+        float damage[ElevationCount] = {};
+        uint32_t defenderRevision = 0;
+    };
+
+    std::unordered_map<Key, Entry, KeyHash> m_entries;
+};
@@ -26,12 +26,37 @@
 #include <cmath>
 #include <memory>
 #include <string>
+#include <unordered_set>
+#include <vector>
 
 static size_t s_entityCount = 0;
 
+// Handles of entities that are gone, reused first so they stay small
+static std::vector<uint32_t> s_freeHandles;
+static uint32_t s_handleCount = 0;
+
+static uint32_t allocateHandle()
+{
+    if (s_freeHandles.empty()) {
+        return s_handleCount++;
+    }
+
+    const uint32_t handle = s_freeHandles.back();
+    s_freeHandles.pop_back();
+    return handle;
+}
+
+/// So we don't keep a copy of "Villager (83)" in every single villager
+static const std::string *internedName(const std::string &name)
+{
+    static std::unordered_set<std::string> names;
+    return &*names.insert(name).first;
+}
+
 Entity::Entity(const Entity::Type type_, const std::string &name) :
     id(s_entityCount++),
-    debugName(name + " #" + std::to_string(id)),
+    handle(allocateHandle()),
+    m_debugName(internedName(name)),
     m_type(type_)
 {
     m_renderer = std::make_unique<GraphicRender>();
@@ -46,6 +71,8 @@ Entity::~Entity()
         int tileY = m_position.y / Constants::TILE_SIZE;
         map->removeEntityAt(tileX, tileY, id);
     }
+
+    s_freeHandles.push_back(handle);
 }
 
 bool Entity::update(Time time) noexcept
@@ -88,7 +115,7 @@ void Entity::setPosition(const MapPos &pos, const bool initial)
 
     m_position = pos;
 
-    if (!isUnit() && !isMissile() && !isDecayingEntity() && !isDoppleganger()) {
+    if (!isUnit() && !isMissile() && !isDecayingEntity()) {
         return;
     }
     if (newTileX == oldTileX && newTileY == oldTileY) {
@@ -21,6 +21,7 @@
 #include "core/SignalEmitter.h"
 #include "core/Types.h"
 
+#include <cstdint>
 #include <memory>
 
 namespace genie {
@@ -53,6 +54,10 @@ struct Entity : std::enable_shared_from_this<Entity>
     const size_t id;
     int32_t spawnId = -1;
 
+    /// Small and reused when the entity is gone, so it can index plain arrays.
+    /// Only valid as long as you keep the entity alive, use the id to remember it.
+    const uint32_t handle;
+
     Entity() = delete;
 
     virtual ~Entity();
@@ -61,7 +66,12 @@ struct Entity : std::enable_shared_from_this<Entity>
 
     virtual GraphicRender &renderer() noexcept { return *m_renderer; }
 
-    const std::string debugName;
+    /// Only for logging, the name part is shared between all entities with the same name
+    struct DebugName {
+        const std::string &name;
+        const size_t id;
+    };
+    inline DebugName debugName() const noexcept { return { *m_debugName, id }; }
 
     bool isVisible = false;
 
@@ -78,14 +88,12 @@ struct Entity : std::enable_shared_from_this<Entity>
     inline bool isBuilding() const noexcept { return m_type >= Type::Building; }
     inline bool isMissile() const noexcept { return m_type == Type::Missile; }
     inline bool isDecayingEntity() const noexcept { return m_type == Type::Decaying; }
-    inline bool isDoppleganger() const noexcept { return m_type == Type::Doppleganger; }
 
 protected:
     enum class Type {
         None,
         MoveTargetMarker,
         Decaying,
-        Doppleganger, // units that we have seen, but have lost vision of (typically buildings)
         Missile,
         Unit,
         Building,
@@ -97,6 +105,7 @@ protected:
     std::weak_ptr<Map> m_map;
 
 private:
+    const std::string *const m_debugName;
     const Type m_type = Type::None;
 
     friend struct MoveTargetMarker;
@@ -105,6 +114,14 @@ private:
 
 
 
+inline LogPrinter operator <<(LogPrinter os, const Entity::DebugName &name) {
+    const char *separator = os.separator;
+    os.separator = "";
+    os << name.name << " #" << uint64_t(name.id) << separator;
+    os.separator = separator;
+    return os;
+}
+
 struct MoveTargetMarker
 {
     enum SpriteID {
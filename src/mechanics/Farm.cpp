@@ -106,7 +106,7 @@ void Farm::setTerrain(const Farm::TerrainTypes terrainToSet) noexcept
     }
 
     if (gotError) {
-        WARN << "Farm" << debugName << "size extends out of map from" << (tileX - width) << (tileY - width) << "to" << (tileX + width) << (tileY + width);
+        WARN << "Farm" << debugName() << "size extends out of map from" << (tileX - width) << (tileY - width) << "to" << (tileX + width) << (tileY + width);
     }
 
     m_currentTerrain = terrainToSet;
@@ -20,6 +20,9 @@
 
 #include "UnitFactory.h"
 #include "ScenarioController.h"
+#include "ai/AiScript.h"
+#include "ai/AiThread.h"
+#include "ai/ScriptBuilder.h"
 
 #include <Engine.h>
 #include "render/SfmlRenderTarget.h"
@@ -28,7 +31,9 @@
 #include "core/Constants.h"
 #include "core/Logger.h"
 #include "core/ResourceMap.h"
+#include "core/TimerWheel.h"
 #include "core/Types.h"
+#include "core/Utility.h"
 #include "debug/ISampleGame.h"
 #include "debug/SampleGameFactory.h"
 #include "debug/ISampleGame.h"
@@ -104,16 +109,35 @@ GameState::GameState(const std::shared_ptr<SfmlRenderTarget> &renderTarget)
 {
     m_unitManager = std::make_shared<UnitManager>();
     renderTarget_ = renderTarget;
+    m_timers = std::make_shared<TimerWheel>();
     m_scenarioController = std::make_unique<ScenarioController>(this);
+    m_aiThread = std::make_unique<ai::AiThread>();
 
     EventManager::registerListener(this, EventManager::ResourceBought);
     EventManager::registerListener(this, EventManager::ResourceSold);
+    EventManager::registerListener(this, EventManager::PlayerResourceChanged);
+    EventManager::registerListener(this, EventManager::DiplomacyChanged);
 }
 
 GameState::~GameState()
 {
 }
 
+std::shared_ptr<ai::AiScript> GameState::addAiScript(AiPlayer *player, const ai::CompiledScript &compiled)
+{
+    REQUIRE(player, return nullptr);
+
+    ai::ScriptBuilder builder(player, m_timers);
+    std::shared_ptr<ai::AiScript> script = builder.build(compiled);
+    if (!script) {
+        WARN << "Failed to build AI script";
+        return nullptr;
+    }
+    m_aiThread->addScript(script);
+
+    return script;
+}
+
 void GameState::setScenario(const std::shared_ptr<genie::ScnFile> &scenario)
 {
     scenario_ = scenario;
@@ -141,6 +165,11 @@ bool GameState::init()
         setupGame();
     }
 
+    for (const Player::Ptr &player : m_players) {
+        player->civilization.printMemoryUsage();
+    }
+    m_unitManager->printMemoryUsage();
+
     map_->updateMapData();
 
     return true;
@@ -151,10 +180,23 @@ bool GameState::update(Time time)
     bool updated = false;
 
     updated = m_unitManager->update(time) || updated;
+
+    // Only calls back the ones that actually went off
+    m_timers->advance(time);
+
+    // Applies what the scripts did last tick, reads the facts and the timers
+    // that just fired, and lets them think while we do the rest
+    m_aiThread->update(time);
+
     if (m_scenarioController) {
         updated = m_scenarioController->update(time) || updated;
     }
 
+    // Tell everyone what was discovered or hidden this tick, all at once
+    for (const Player::Ptr &player : m_players) {
+        player->visibility->flushChanges();
+    }
+
     //game_server_->update();
     //game_client_->update();
 
@@ -226,6 +268,81 @@ void GameState::onResourceSold(const genie::ResourceType type, const int amount)
     EventManager::tradingPriceChanged(type, m_tradingPrices[type]);
 }
 
+void GameState::onPlayerResourceChanged(Player *player, const genie::ResourceType type, float newValue)
+{
+    if (type != genie::ResourceType::RevealAlly || newValue <= 0) {
+        return;
+    }
+
+    shareAlliedVisibility(player);
+}
+
+void GameState::onDiplomacyChanged(Player *player, const int otherPlayerId)
+{
+    (void)player;
+    (void)otherPlayerId;
+
+    // Get everyone out of shared visibility with someone they're no longer allied with
+    for (const Player::Ptr &ours : m_players) {
+        for (const Player::Ptr &other : m_players) {
+            if (ours == other || !ours->visibility->isSharedWith(*other->visibility)) {
+                continue;
+            }
+            if (ours->isAllied(other->playerId) && other->isAllied(ours->playerId)) {
+                continue;
+            }
+
+            DBG << "Player" << ours->playerId << "stops sharing visibility";
+            ours->stopSharingVisibility();
+            break;
+        }
+    }
+
+    // And share again with whoever we're still (or now) allied with
+    for (const Player::Ptr &ours : m_players) {
+        if (ours->resourcesAvailable(genie::ResourceType::RevealAlly) > 0) {
+            shareAlliedVisibility(ours.get());
+        }
+    }
+}
+
+void GameState::shareAlliedVisibility(Player *player)
+{
+    // Cartography and friends, share the visibility with everyone we're allied with
+    for (const Player::Ptr &other : m_players) {
+        if (other.get() == player || other->playerId == UnitManager::GaiaID) {
+            continue;
+        }
+        if (player->visibility->isSharedWith(*other->visibility) || !canShareVisibility(player, other.get())) {
+            continue;
+        }
+
+        DBG << "Sharing visibility between" << player->playerId << "and" << other->playerId;
+        player->visibility->shareWith(*other->visibility);
+    }
+}
+
+bool GameState::canShareVisibility(Player *player, Player *other) const
+{
+    // Merging the visibility merges everyone already sharing with either side,
+    // so they all need to be allied with each other
+    for (const Player::Ptr &first : m_players) {
+        if (!first->visibility->isSharedWith(*player->visibility)) {
+            continue;
+        }
+        for (const Player::Ptr &second : m_players) {
+            if (!second->visibility->isSharedWith(*other->visibility)) {
+                continue;
+            }
+            if (!first->isAllied(second->playerId) || !second->isAllied(first->playerId)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
 void GameState::setTradingPrice(const genie::ResourceType type, const int newPrice)
 {
     m_tradingPrices[type] = newPrice;
@@ -32,6 +32,14 @@ struct Player;
 class Map;
 class UnitManager;
 class ScenarioController;
+class TimerWheel;
+struct AiPlayer;
+
+namespace ai {
+struct AiScript;
+class AiThread;
+struct CompiledScript;
+}
 
 using MapPtr = std::shared_ptr<Map>;
 
@@ -97,16 +105,26 @@ public:
     void onPlayerWin(int playerId);
     const std::unique_ptr<ScenarioController> &scenarioController() const { return m_scenarioController; }
 
+    /// Timers for scenario triggers and AI scripts, advanced with the game time
+    const std::shared_ptr<TimerWheel> &timers() const { return m_timers; }
+
+    /// Builds the script and runs it every tick on the AI thread, with its timers in our wheel
+    std::shared_ptr<ai::AiScript> addAiScript(AiPlayer *player, const ai::CompiledScript &compiled);
+
     int sellPrice(const genie::ResourceType type) { return (0.7 * m_tradingPrices[type]); }
     int buyPrice(const genie::ResourceType type) { return (1.3 * m_tradingPrices[type]); }
 
     void onResourceBought(const genie::ResourceType type, const int amount) override;
     void onResourceSold(const genie::ResourceType type, const int amount) override;
+    void onPlayerResourceChanged(Player *player, const genie::ResourceType type, float newValue) override;
+    void onDiplomacyChanged(Player *player, const int otherPlayerId) override;
 
     void setTradingPrice(const genie::ResourceType type, const int newPrice);
 
 private:
     void setupScenario();
+    void shareAlliedVisibility(Player *player);
+    bool canShareVisibility(Player *player, Player *other) const;
     void setupGame();
 
     GameState(const GameState &other) = delete;
@@ -126,8 +144,12 @@ private:
 
     GameType m_gameType = GameType::Default;
 
+    std::shared_ptr<TimerWheel> m_timers;
     std::unique_ptr<ScenarioController> m_scenarioController;
 
+    // After the timers, the scripts cancel theirs when they go away
+    std::unique_ptr<ai::AiThread> m_aiThread;
+
     std::unordered_map<genie::ResourceType, int> m_tradingPrices = {
         { genie::ResourceType::FoodStorage, 100 },
         { genie::ResourceType::WoodStorage, 100 },
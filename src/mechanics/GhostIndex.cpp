@@ -0,0 +1,78 @@
+#include "GhostIndex.h"
+
+#include "core/Logger.h"
+#include "core/Utility.h"
+
+#include <algorithm>
+
+void GhostIndex::add(const int playerID, const int tileX, const int tileY, const Ghost &ghost)
+{
+    REQUIRE(playerID >= 0, return);
+
+    if (size_t(playerID) >= m_cells.size()) {
+        m_cells.resize(playerID + 1);
+    }
+
+    m_cells[playerID][tileKey(tileX, tileY)].push_back(ghost);
+    m_count++;
+}
+
+bool GhostIndex::contains(const int playerID, const int tileX, const int tileY, const size_t originalUnitID) const
+{
+    for (const Ghost &ghost : at(playerID, tileX, tileY)) {
+        if (ghost.originalUnitID == originalUnitID) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void GhostIndex::removeAt(const int playerID, const int tileX, const int tileY)
+{
+    if (playerID < 0 || size_t(playerID) >= m_cells.size()) {
+        return;
+    }
+
+    std::unordered_map<uint32_t, Cell> &cells = m_cells[playerID];
+    std::unordered_map<uint32_t, Cell>::iterator it = cells.find(tileKey(tileX, tileY));
+    if (it == cells.end()) {
+        return;
+    }
+
+    m_count -= it->second.size();
+    cells.erase(it);
+}
+
+void GhostIndex::originalDied(const size_t originalUnitID, const int tileX, const int tileY, const int rubbleSpriteID)
+{
+    const uint32_t key = tileKey(tileX, tileY);
+
+    for (std::unordered_map<uint32_t, Cell> &cells : m_cells) {
+        std::unordered_map<uint32_t, Cell>::iterator it = cells.find(key);
+        if (it == cells.end()) {
+            continue;
+        }
+
+        Cell &cell = it->second;
+        if (rubbleSpriteID == -1) {
+            const size_t sizeBefore = cell.size();
+            cell.erase(std::remove_if(cell.begin(), cell.end(), [=](const Ghost &ghost) { return ghost.originalUnitID == originalUnitID; }), cell.end());
+            m_count -= sizeBefore - cell.size();
+
+            if (cell.empty()) {
+                cells.erase(it);
+            }
+            continue;
+        }
+
+        for (Ghost &ghost : cell) {
+            if (ghost.originalUnitID != originalUnitID || ghost.isRubble) {
+                continue;
+            }
+            ghost.spriteID = rubbleSpriteID;
+            ghost.frame = 0;
+            ghost.isRubble = true;
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "core/Types.h"
+
+#include <stddef.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/// The fog of war memory, what each player last saw of other players' stuff.
+/// Kept per player and per tile, so when a tile gets revealed we only look at
+/// the ghosts on that tile instead of going through all the static entities.
+///
+/// The ghosts aren't entities, just what we need to draw them again. The
+/// renderer sets up something drawable when it actually draws one.
+class GhostIndex
+{
+public:
+    struct Ghost {
+        MapPos position;
+        size_t originalUnitID = 0;
+        float angle = 0.f;
+        int16_t unitDataID = -1;
+        int16_t spriteID = -1; // what the unit looked like when we last saw it, or its rubble
+        uint16_t frame = 0;
+        uint8_t ownerID = 0;
+        uint8_t playerColor = 0;
+        bool isRubble = false;
+    };
+
+    typedef std::vector<Ghost> Cell;
+
+    void add(const int playerID, const int tileX, const int tileY, const Ghost &ghost);
+
+    bool contains(const int playerID, const int tileX, const int tileY, const size_t originalUnitID) const;
+
+    /// Removes everything the player remembers on the tile
+    void removeAt(const int playerID, const int tileX, const int tileY);
+
+    /// Everyone who remembers the unit on that tile now remembers the rubble instead,
+    /// or forgets it if it doesn't leave any
+    void originalDied(const size_t originalUnitID, const int tileX, const int tileY, const int rubbleSpriteID);
+
+    /// What the player remembers on the tile, can be empty
+    inline const Cell &at(const int playerID, const int tileX, const int tileY) const {
+        static const Cell empty;
+        if (playerID < 0 || size_t(playerID) >= m_cells.size()) {
+            return empty;
+        }
+        const std::unordered_map<uint32_t, Cell>::const_iterator it = m_cells[playerID].find(tileKey(tileX, tileY));
+        if (it == m_cells[playerID].end()) {
+            return empty;
+        }
+        return it->second;
+    }
+
+    size_t size() const { return m_count; }
+
+private:
+    static inline uint32_t tileKey(const int tileX, const int tileY) {
+        return (uint32_t(tileY) << 16) | uint32_t(tileX & 0xFFFF);
+    }
+
+    // Player ID -> tile -> ghosts, most tiles have none so don't store those
+    std::vector<std::unordered_map<uint32_t, Cell>> m_cells;
+    size_t m_count = 0;
+};
@@ -35,13 +35,17 @@
 
 #include <genie/script/scn/MapDescription.h>
 
-Map::Map() //: map_txt_(0)
+Map::Map() :
+    m_buildability(std::make_unique<BuildabilityMap>(*this))
 {
 //    DBG << DataManager::Inst().datFile().TerrainBlock.TileSizes.size();
 }
 
 void Map::setupBasic() noexcept
 {
+    m_buildability->onMapRecreated();
+    emit(Recreated);
+
     cols_ = 22;
     rows_ = 22;
 
@@ -81,6 +85,9 @@ void Map::setupBasic() noexcept
 
 void Map::setupAllunitsMap() noexcept
 {
+    m_buildability->onMapRecreated();
+    emit(Recreated);
+
     cols_ = 30;
     rows_ = 30;
 
@@ -136,6 +143,9 @@ void Map::setupAllunitsMap() noexcept
 
 void Map::create(const genie::ScnMap &mapDescription)
 {
+    m_buildability->onMapRecreated();
+    emit(Recreated);
+
     DBG << "tile count:" << mapDescription.tiles.size();
     DBG << "size:" << mapDescription.width << "x" << mapDescription.height;
     tiles_.clear();
@@ -233,6 +243,7 @@ void Map::setTileAt(unsigned col, unsigned row, unsigned id) noexcept
     }
 
     tiles_[index].terrainId = id;
+    m_buildability->onTerrainChanged(col, row);
     m_updated = true;
 }
 
@@ -245,6 +256,7 @@ bool Map::updateTileAt(const int col, const int row, unsigned id) noexcept
     }
 
     tiles_[index].terrainId = id;
+    m_buildability->onTerrainChanged(col, row);
     tiles_[index].frame = AssetManager::Inst()->getTerrain(tiles_[index].terrainId)->coordinatesToFrame(col, row);
     for (int col_ = std::max(col - 1, 0); col_ < std::min(col + 2, cols_); col_++) {
         for (int row_ = std::max(row - 1, 0); row_ < std::min(row + 2, rows_); row_++) {
@@ -335,7 +347,7 @@ void Map::addEntityAt(int col, int row, const EntityPtr &entity, int foundationT
     }
 
     if (gotError) {
-        WARN << "Unit" << entity->debugName << "size extends out of map from" << (col - width) << (row - width) << "to" << (col + width) << (row + width);
+        WARN << "Unit" << entity->debugName() << "size extends out of map from" << (col - width) << (row - width) << "to" << (col + width) << (row + width);
     }
 
     for (int col_ = std::max(col - 1, 0); col_ < std::min(col + width + 2, cols_); col_++) {
@@ -23,6 +23,7 @@
 #include <vector>
 #include <array>
 
+#include "BuildabilityMap.h"
 #include "MapTile.h"
 #include "core/Constants.h"
 #include "core/SignalEmitter.h"
@@ -51,6 +52,7 @@ public:
     enum Signals {
         UnitsChanged,
         TerrainChanged,
+        Recreated, // everything is forgotten, units need to tell it what they block again
         SignalCount
     };
 
@@ -138,6 +140,9 @@ public:
         return position.x >= 0 && position.y >= 0 && position.x < pixelWidth() && position.y < pixelHeight();
     }
 
+    /// Where buildings can be placed
+    BuildabilityMap &buildability() noexcept { return *m_buildability; }
+
     [[nodiscard]] MapPos snapPositionToGrid(const MapPos &position, const Size unitSize) noexcept; // how big is size? does it fit in a register, or should it be passed by reference? noone knows...
 private:
     void updateTileBlend(int tileX, int tileY) noexcept;
@@ -161,6 +166,8 @@ private:
     std::array<std::array<uint8_t, 8>, 8> m_blendmodeTable;
 
     bool m_updated = false;
+
+    std::unique_ptr<BuildabilityMap> m_buildability;
 };
 
 typedef std::shared_ptr<Map> MapPtr;
@@ -31,10 +31,14 @@ Missile::Missile(const genie::Unit &data, const Unit::Ptr &sourceUnit, const Map
     m_targetUnit(targetUnit),
     m_player(sourceUnit->player()),
     m_unitManager(sourceUnit->unitManager()),
-    m_data(data),
     m_targetPosition(target)
 {
-    m_attacks = sourceUnit->data()->Combat.Attacks;
+    // Through the civilization, so we see its tech effects
+    Player::Ptr owner = sourceUnit->player().lock();
+    REQUIRE(owner, return);
+    m_dataSlot = owner->civilization.unitDataSlot(data.ID);
+    m_sourceDataSlot = owner->civilization.unitDataSlot(sourceUnit->data()->ID);
+
     sourceUnit->activeMissiles++;
     defaultGraphics = AssetManager::Inst()->getGraphic(data.StandingGraphic.first);
     m_renderer->setSprite(defaultGraphics);
@@ -89,19 +93,19 @@ bool Missile::initialize()
 
     m_distanceLeft = position().distance(m_targetPosition);
     const float heightDifference = (position().z - m_targetPosition.z);
-    const float flightTime = m_distanceLeft / m_data.Speed;
+    const float flightTime = m_distanceLeft / data().Speed;
     float timeToApex = flightTime / 2;
 
     if (heightDifference > 0.f) {
-        timeToApex -= std::hypot(heightDifference/(m_data.Speed*2), heightDifference/(m_data.Speed*2));
+        timeToApex -= std::hypot(heightDifference/(data().Speed*2), heightDifference/(data().Speed*2));
     }
 
-    float arc = m_data.Missile.ProjectileArc;
+    float arc = data().Missile.ProjectileArc;
     if (arc < 0) {
         arc = std::abs(arc);
     }
-    m_zVelocity = m_data.Speed * arc;
-    m_zAcceleration = (m_zVelocity) / (m_data.Speed * timeToApex);
+    m_zVelocity = data().Speed * arc;
+    m_zAcceleration = (m_zVelocity) / (data().Speed * timeToApex);
 
     m_angle = position().angleTo(m_targetPosition);
     m_renderer->setAngle(position().toScreen().angleTo(m_targetPosition.toScreen()));
@@ -145,7 +149,7 @@ bool Missile::update(Time time) noexcept
     const float elapsed = time - m_previousUpdateTime;
     m_previousUpdateTime = time;
 
-    float movement = elapsed * m_data.Speed * 0.15;
+    float movement = elapsed * data().Speed * 0.15;
     m_distanceLeft -= movement;
 
     MapPos newPos = position();
@@ -164,10 +168,10 @@ bool Missile::update(Time time) noexcept
         return false;
     }
 
-    if (m_data.Moving.TrackingUnit != -1 && rand() % 100 < m_data.Moving.TrackingUnitDensity * 100 * 0.15) {
+    if (data().Moving.TrackingUnit != -1 && rand() % 100 < data().Moving.TrackingUnitDensity * 100 * 0.15) {
         m_previousSmokeTime = time;
         if (player) {
-            const genie::Unit &trailingData = player->civilization.unitData(m_data.Moving.TrackingUnit);
+            const genie::Unit &trailingData = player->civilization.unitData(data().Moving.TrackingUnit);
             DecayingEntity::Ptr trailingUnit = std::make_shared<DecayingEntity>(
                         trailingData.StandingGraphic.first,
                         0.f,
@@ -190,6 +194,11 @@ bool Missile::update(Time time) noexcept
 
     Unit::Ptr targetUnit = m_targetUnit.lock();
 
+    // Everything is tested against the whole path we travelled since the last update, so we don't
+    // skip over anything when we move fast (or the framerate is low)
+    const MapPos previousPos = position();
+    setPosition(newPos);
+
     if (m_blastType == DamageTargetOnly) {
         if (!targetUnit) {
             WARN << "lost target";
@@ -197,71 +206,23 @@ bool Missile::update(Time time) noexcept
             return true;
         }
 
-        // We need to test the intermediate, because otherwise the previous position and the next position are too far away
-        // Could use something more efficient (bresenham? some magic line intersection?), but not a hot path (for now)
-
-        float minDistance = distanceTo(newPos, targetUnit);
-        for (int i=1; i<= std::ceil(movement); i++) {
-            MapPos testPos = position();
-            testPos.x += i * cos(m_angle);
-            testPos.y += i * sin(m_angle);
-            testPos.z = newPos.z;
-
-            const float distance = distanceTo(targetUnit);
-            if (distance <= m_blastRadius)  {
-                minDistance = distance;
-                break;
-            }
-        }
-
-        setPosition(newPos);
+        const float minDistance = distanceTo(previousPos, newPos, targetUnit);
         if (minDistance > m_blastRadius)  {
             return true;
         }
 
-        Unit::Ptr sourceUnit = m_sourceUnit.lock();
+        if (!canHit(targetUnit)) {
+            die();
+            return true;
+        }
 
-        DBG << debugName << "from" << m_sourceUnit.lock()->debugName << "hit our target" << targetUnit->debugName;
+        DBG << debugName() << "from" << m_sourceUnit.lock()->debugName() << "hit our target" << targetUnit->debugName();
         DBG << minDistance << newPos.distance(targetUnit->position());
         DBG << targetUnit->position() << newPos;
 
         hitUnits.push_back(targetUnit);
     } else {
-        setPosition(newPos);
-        Unit::Ptr sourceUnit = m_sourceUnit.lock();
-        for (int dx = tileX-1; dx<=tileX+1; dx++) {
-            for (int dy = tileY-1; dy<=tileY+1; dy++) {
-                const std::vector<std::weak_ptr<Entity>> &entities = map->entitiesAt(dx, dy);
-                if (entities.empty()) {
-                    continue;
-                }
-
-                for (const std::weak_ptr<Entity> &entity : entities) {
-                    Unit::Ptr otherUnit = Unit::fromEntity(entity);
-                    if (IS_UNLIKELY(!otherUnit)) {
-                        continue;
-                    }
-
-                    if (IS_UNLIKELY(otherUnit == sourceUnit)) {
-                        continue;
-                    }
-
-                    if (newPos.z > otherUnit->data()->Size.z) {
-                        continue;
-                    }
-
-                    const float xSize = (otherUnit->data()->Size.x + m_data.Size.x + m_blastRadius) * Constants::TILE_SIZE;
-                    const float ySize = (otherUnit->data()->Size.y + m_data.Size.y + m_blastRadius) * Constants::TILE_SIZE;
-                    const float xDistance = std::abs(otherUnit->position().x - newPos.x);
-                    const float yDistance = std::abs(otherUnit->position().y - newPos.y);
-
-                    if (IS_UNLIKELY(xDistance < xSize && yDistance < ySize)) {
-                        hitUnits.push_back(otherUnit);
-                        break;
-                    }
-                }
-            }
-        }
+        findUnitsHitBetween(previousPos, newPos, &hitUnits);
     }
 
     if (hitUnits.empty()) {
@@ -273,24 +234,13 @@ bool Missile::update(Time time) noexcept
         die();
     }
 
-    int playerId = player ? player->playerId : -1;
     for (Unit::Ptr &hitUnit : hitUnits) {
-        if (m_blastType != DamageTrees && hitUnit->data()->Class == genie::Unit::Tree) {
-            continue;
-        }
-
-        if (m_data.Missile.HitMode && hitUnit->playerId() == playerId) {
-            continue;
-        }
-
-        float damageMultiplier = 1.f;
+        DamageTable::Elevation elevation = DamageTable::SameLevel;
         if (hitUnit->position().z < m_startingElevation) {
-            damageMultiplier = 3.f/2.f;
-        }
-        DBG << debugName << "hit a unit" << hitUnit->debugName << "damage multiplier" << damageMultiplier;
-        for (const genie::unit::AttackOrArmor &attack : m_attacks) {
-            hitUnit->receiveAttack(attack, damageMultiplier);
+            elevation = DamageTable::HighGround;
         }
+        DBG << debugName() << "hit a unit" << hitUnit->debugName() << "from high ground" << (elevation == DamageTable::HighGround);
+        hitUnit->receiveAttack(sourceData(), player, elevation);
     }
 
 
@@ -316,6 +266,84 @@ double Missile::distanceTo(const std::shared_ptr<Unit> &otherUnit) const noexcep
     return centreDistance - clearance;
 }
 
+double Missile::distanceTo(const MapPos &segmentStart, const MapPos &segmentEnd, const std::shared_ptr<Unit> &otherUnit) const noexcept
+{
+    const double centreDistance = otherUnit->position().distanceToSegment(segmentStart, segmentEnd);
+    const Size otherSize = otherUnit->clearanceSize();
+    const Size size = clearanceSize();
+    const double clearance = std::max(size.width, size.height) + std::max(otherSize.width, otherSize.height);
+    return centreDistance - clearance;
+}
+
+void Missile::findUnitsHitBetween(const MapPos &from, const MapPos &to, std::vector<Unit::Ptr> *hitUnits) const
+{
+    MapPtr map = m_map.lock();
+    REQUIRE(map, return);
+
+    Unit::Ptr sourceUnit = m_sourceUnit.lock();
+
+    // Can't hit anything taller than where we were at the lowest point
+    const float lowestZ = std::min(from.z, to.z);
+
+    const float ownRadius = std::max(data().Size.x, data().Size.y) + m_blastRadius;
+
+    // Biggest units are a couple of tiles, so look one tile (+ blast) outside of what we covered
+    const int margin = 1 + std::ceil(m_blastRadius);
+    const int firstX = std::max(int(std::min(from.x, to.x) / Constants::TILE_SIZE) - margin, 0);
+    const int firstY = std::max(int(std::min(from.y, to.y) / Constants::TILE_SIZE) - margin, 0);
+    const int lastX = std::min(int(std::max(from.x, to.x) / Constants::TILE_SIZE) + margin, map->columnCount() - 1);
+    const int lastY = std::min(int(std::max(from.y, to.y) / Constants::TILE_SIZE) + margin, map->rowCount() - 1);
+
+    // Always walk the tiles in the same order, so the result doesn't depend on anything but where we are
+    for (int tileY = firstY; tileY <= lastY; tileY++) {
+        for (int tileX = firstX; tileX <= lastX; tileX++) {
+            for (const std::weak_ptr<Entity> &entity : map->entitiesAt(tileX, tileY)) {
+                Unit::Ptr otherUnit = Unit::fromEntity(entity);
+                if (IS_UNLIKELY(!otherUnit)) {
+                    continue;
+                }
+
+                if (IS_UNLIKELY(otherUnit == sourceUnit)) {
+                    continue;
+                }
+
+                if (lowestZ > otherUnit->data()->Size.z) {
+                    continue;
+                }
+
+                if (!canHit(otherUnit)) {
+                    continue;
+                }
+
+                // Capsule (our path, with our size and blast) against the circle of the unit
+                const float radius = (ownRadius + std::max(otherUnit->data()->Size.x, otherUnit->data()->Size.y)) * Constants::TILE_SIZE;
+                if (otherUnit->position().distanceToSegment(from, to) >= radius) {
+                    continue;
+                }
+
+                if (std::find(hitUnits->begin(), hitUnits->end(), otherUnit) != hitUnits->end()) {
+                    continue;
+                }
+
+                hitUnits->push_back(otherUnit);
+            }
+        }
+    }
+}
+
+bool Missile::canHit(const std::shared_ptr<Unit> &otherUnit) const noexcept
+{
+    if (m_blastType != DamageTrees && otherUnit->data()->Class == genie::Unit::Tree) {
+        return false;
+    }
+
+    if (data().Missile.HitMode && otherUnit->playerId() == playerId) {
+        return false;
+    }
+
+    return true;
+}
+
 double Missile::distanceTo(const MapPos &sourcePosition, const std::shared_ptr<Unit> &otherUnit) const noexcept
 {
     const double centreDistance = sourcePosition.distance(otherUnit->position());
@@ -327,21 +355,21 @@ double Missile::distanceTo(const MapPos &sourcePosition, const std::shared_ptr<U
 
 Size Missile::clearanceSize() const noexcept
 {
-    return Size(m_data.Size.x * Constants::TILE_SIZE, m_data.Size.y * Constants::TILE_SIZE);
+    return Size(data().Size.x * Constants::TILE_SIZE, data().Size.y * Constants::TILE_SIZE);
 }
 
 Size Missile::tileSize() const
 {
-    return Size(m_data.Size);
+    return Size(data().Size);
 }
 
 void Missile::die()
 {
     m_isFlying = false;
-    m_renderer->setSprite(m_data.DyingGraphic);
+    m_renderer->setSprite(data().DyingGraphic);
 
     Player::Ptr player = m_player.lock();
-    if (player && m_data.DyingSound != -1) {
-        AudioPlayer::instance().playSound(m_data.DyingSound, player->civilization.id());
+    if (player && data().DyingSound != -1) {
+        AudioPlayer::instance().playSound(data().DyingSound, player->civilization.id());
     }
 }
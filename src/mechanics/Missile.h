@@ -1,7 +1,6 @@
 #pragma once
 
 #include "Entity.h"
-#include "genie/dat/unit/AttackOrArmor.h"
 #include "mechanics/Entity.h"
 
 namespace genie {
@@ -46,6 +45,9 @@ public:
     double distanceTo(const std::shared_ptr<Unit> &otherUnit) const noexcept;
     double distanceTo(const MapPos &sourcePosition, const std::shared_ptr<Unit> &otherUnit) const noexcept;
 
+    /// Closest distance to the other unit anywhere along the path from segmentStart to segmentEnd
+    double distanceTo(const MapPos &segmentStart, const MapPos &segmentEnd, const std::shared_ptr<Unit> &otherUnit) const noexcept;
+
     Size clearanceSize() const noexcept;
 
     Size tileSize() const override;
@@ -53,6 +55,11 @@ public:
 private:
     bool initialize();
 
+    bool canHit(const std::shared_ptr<Unit> &otherUnit) const noexcept;
+
+    /// Swept test of the path between the two positions against the units around it
+    void findUnitsHitBetween(const MapPos &from, const MapPos &to, std::vector<std::shared_ptr<Unit>> *hitUnits) const;
+
     void die();
 
     bool m_isFlying = true;
@@ -60,12 +67,15 @@ private:
     std::weak_ptr<Unit> m_targetUnit;
     std::weak_ptr<Player> m_player;
     UnitManager &m_unitManager;
-    const genie::Unit &m_data;
+    const genie::Unit &data() const noexcept { return **m_dataSlot; }
+    const genie::Unit &sourceData() const noexcept { return **m_sourceDataSlot; }
+
+    const genie::Unit *const *m_dataSlot = nullptr;
+    const genie::Unit *const *m_sourceDataSlot = nullptr; // we want to hit even if the source is dead
     MapPos m_targetPosition;
     Time m_previousUpdateTime = 0.f;
     Time m_previousSmokeTime = 0.f;
     BlastType m_blastType = DamageTargetOnly;
-    std::vector<genie::unit::AttackOrArmor> m_attacks;
 
     float m_blastRadius = 0.f;
 
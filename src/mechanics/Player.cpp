@@ -16,8 +16,6 @@
 #include "resource/DataManager.h"
 #include "mechanics/Map.h"
 
-//#define CHEAT_VISIBILITY 1
-
 Player::Player(const int id, const int civId, const std::shared_ptr<Map> &map, const ResourceMap &startingResources) :
     playerId(id),
     civilization(civId),
@@ -27,13 +25,10 @@ Player::Player(const int id, const int civId, const std::shared_ptr<Map> &map, c
     m_map(map)
 {
     // Override
-    for (const std::pair<const genie::ResourceType, float> &r : startingResources) {
-        m_resourcesAvailable[r.first] = r.second;
-    }
+    m_resourcesAvailable.overrideWith(startingResources);
 
     EventManager::registerListener(this, EventManager::DiscoveredUnit);
-    EventManager::registerListener(this, EventManager::TileDiscovered);
-    EventManager::registerListener(this, EventManager::TileHidden);
+    EventManager::registerListener(this, EventManager::VisibilityChanged);
     EventManager::registerListener(this, EventManager::UnitMoved);
 
     EventManager::registerListener(this, EventManager::UnitGarrisoned);
@@ -55,43 +50,8 @@ void Player::applyResearch(const int researchId)
         return;
     }
 
+    // Implicit research that depends on this gets applied when the effect gets activated
     applyTechEffect(DataManager::Inst().getTech(researchId).EffectID);
-
-    // Apply all implicit research
-    for (const genie::Tech &research : DataManager::Inst().allTechs()) {
-        if (research.ResearchLocation != -1) {
-            continue;
-        }
-        if (research.EffectID == -1) {
-            continue;
-        }
-        if (research.Civ != -1 && research.Civ != civilization.id()) {
-            continue;
-        }
-        if (m_activeTechs.count(research.EffectID)) {
-            continue;
-        }
-
-        bool requirementsSatisfied = false;
-        for (const int reqId : research.RequiredTechs) {
-            if (reqId == -1) {
-                continue;
-            }
-            if (m_activeTechs.count(reqId)) {
-                requirementsSatisfied = true;
-            } else {
-                requirementsSatisfied = false;
-                break;
-            }
-        }
-
-        if (!requirementsSatisfied) {
-            continue;
-        }
-
-        applyTechEffect(research.EffectID);
-    }
-    updateAvailableTechs();
 }
 
 void Player::applyTechEffect(const int effectId)
@@ -112,6 +72,45 @@ void Player::applyTechEffect(const int effectId)
     for (const genie::EffectCommand &command : effect.EffectCommands) {
         applyTechEffectCommand(command);
     }
+
+    onTechActivated(effectId);
+}
+
+void Player::onTechActivated(const int id)
+{
+    // Not available for research anymore if it is
+    m_currentlyAvailableTechs.erase(id);
+
+    const TechDependencies &dependencies = civilization.techDependencies();
+    if (IS_UNLIKELY(m_pendingRequirements.size() != dependencies.nodes.size())) {
+        updateAvailableTechs();
+        return;
+    }
+
+    for (const uint32_t index : dependencies.dependantsOf(id)) {
+        if (m_pendingRequirements[index] == 0) {
+            continue;
+        }
+
+        m_pendingRequirements[index]--;
+        if (m_pendingRequirements[index] == 0) {
+            onTechRequirementsSatisfied(dependencies.nodes[index]);
+        }
+    }
+}
+
+void Player::onTechRequirementsSatisfied(const TechDependencies::Node &node)
+{
+    if (node.isImplicit) {
+        applyTechEffect(node.effectId);
+        return;
+    }
+
+    if (m_activeTechs.count(node.techId)) {
+        return;
+    }
+
+    m_currentlyAvailableTechs[node.techId] = civilization.tech(node.techId);
 }
 
 void Player::applyTechEffectCommand(const genie::EffectCommand &effect)
@@ -120,14 +119,15 @@ void Player::applyTechEffectCommand(const genie::EffectCommand &effect)
     case genie::EffectCommand::ResourceModifier: {
         const genie::ResourceType resourceType = genie::ResourceType(effect.TargetUnit);
         if (effect.UnitClassID) {
-            m_resourcesAvailable[resourceType] += effect.Amount;
+            setAvailableResource(resourceType, resourcesAvailable(resourceType) + effect.Amount);
         } else {
-            m_resourcesAvailable[resourceType] = effect.Amount;
+            setAvailableResource(resourceType, effect.Amount);
         }
         break;
     }
     case genie::EffectCommand::EnableUnit:
         civilization.enableUnit(effect.TargetUnit);
+        m_unitDataVersion++; // our units read their data through the civilization, so nothing else to do
         break;
     case genie::EffectCommand::UpgradeUnit: {
         uint16_t fromUnitID = effect.TargetUnit;
@@ -136,10 +136,9 @@ void Player::applyTechEffectCommand(const genie::EffectCommand &effect)
             return;
         }
 
-        for (Unit *unit : m_units) {
-            if (unit->data()->ID != fromUnitID) {
-                continue;
-            }
+        // Copy, changing the data moves them to another type
+        const std::vector<Unit*> units = unitsOfType(fromUnitID);
+        for (Unit *unit : units) {
             unit->setUnitData(toUnitData);
         }
         break;
@@ -149,9 +148,11 @@ void Player::applyTechEffectCommand(const genie::EffectCommand &effect)
     case genie::EffectCommand::AbsoluteAttributeModifier:
     case genie::EffectCommand::RelativeAttributeModifier:
         civilization.applyUnitAttributeModifier(effect);
+        m_unitDataVersion++;
         break;
     case genie::EffectCommand::ResourceMultiplier:
         m_resourcesAvailable[genie::ResourceType(effect.TargetUnit)] *= effect.Amount;
+        m_resourcesVersion++;
         break;
     case genie::EffectCommand::TechCostModifier:
         WARN << "Disable tech cost modifier not implemented";
@@ -172,6 +173,7 @@ void Player::applyTechEffectCommand(const genie::EffectCommand &effect)
 void Player::setAge(const Age age)
 {
     m_resourcesAvailable[genie::ResourceType::CurrentAge] = age;
+    m_resourcesVersion++;
 
     genie::ResourceType effectResourceType;
     switch (age) {
@@ -229,7 +231,9 @@ void Player::addUnit(Unit *unit)
             break;
         }
     }
+    m_resourcesVersion++;
     m_units.insert(unit);
+    trackUnitType(unit);
     if (m_unitGroups.empty()) {
         m_unitGroups.resize(1);
     }
@@ -257,13 +261,15 @@ void Player::removeUnit(Unit *unit)
             break;
         }
     }
+    m_resourcesVersion++;
     m_units.erase(unit);
+    untrackUnitType(unit);
 
     int oldGroup = -1;
     for (size_t i=0; i<m_unitGroups.size(); i++) {
         if (m_unitGroups[i].erase(unit)) {
             if (oldGroup != -1) {
-                WARN << "Unit" << unit->debugName << "in multiple groups";
+                WARN << "Unit" << unit->debugName() << "in multiple groups";
             }
             oldGroup = i;
         }
@@ -291,7 +297,7 @@ void Player::setUnitGroup(Unit *unit, int group)
     for (size_t i=0; i<m_unitGroups.size(); i++) {
         if (m_unitGroups[i].erase(unit)) {
             if (oldGroup != -1) {
-                WARN << "Unit" << unit->debugName << "in multiple groups";
+                WARN << "Unit" << unit->debugName() << "in multiple groups";
             }
             oldGroup = i;
         }
@@ -315,7 +321,12 @@ void Player::setDiplomaticStance(const uint8_t playerId, const Player::Diplomati
     if (playerId >= m_diplomaticStances.size()) {
         m_diplomaticStances.resize(playerId + 1);
     }
+    if (m_diplomaticStances[playerId] == stance) {
+        return;
+    }
     m_diplomaticStances[playerId] = stance;
+
+    EventManager::diplomacyChanged(this, playerId);
 }
 
 bool Player::isAllied(uint8_t playerId)
@@ -329,9 +340,28 @@ bool Player::isAllied(uint8_t playerId)
     return m_diplomaticStances[playerId] == Allied;
 }
 
+void Player::stopSharingVisibility()
+{
+    if (!visibility->isShared()) {
+        return;
+    }
+
+    // Take what our units see out of the shared planes, and put it in our own
+    for (const Unit *unit : m_units) {
+        visibility->removeLineOfSight(unit->position().x / Constants::TILE_SIZE, unit->position().y / Constants::TILE_SIZE, unit->lineOfSight());
+    }
+
+    visibility->unshare();
+
+    for (const Unit *unit : m_units) {
+        visibility->addLineOfSight(unit->position().x / Constants::TILE_SIZE, unit->position().y / Constants::TILE_SIZE, unit->lineOfSight());
+    }
+}
+
 void Player::setAvailableResource(const genie::ResourceType type, float newValue)
 {
     m_resourcesAvailable[type] = newValue;
+    m_resourcesVersion++;
 
     EventManager::playerResourceChanged(this, type, newValue);
 }
@@ -351,51 +381,126 @@ void Player::sendTribute(const std::shared_ptr<Player> &player, const genie::Res
 
 Unit *Player::findUnitByTypeID(const int type) const
 {
-    for (Unit *unit : m_units) {
-        if (unit->data()->ID == type) {
-            return unit;
-        }
+    const std::vector<Unit*> &units = unitsOfType(type);
+    if (units.empty()) {
+        WARN << "Does not have a unit of type" << type;
+        return nullptr;
     }
 
-    WARN << "Does not have a unit of type" << type;
-
-    return nullptr;
+    return units.front();
 }
 
 std::vector<Unit *> Player::findUnitsByTypeID(const int type) const
 {
-    std::vector<Unit*> ret;
-    for (Unit *unit : m_units) {
-        if (unit->data()->ID == type) {
-            ret.push_back(unit);
-        }
-    }
+    return unitsOfType(type);
+}
 
-    return ret;
+const std::vector<Unit *> &Player::unitsOfType(const int typeId) const
+{
+    if (size_t(typeId) >= m_unitsByType.size()) {
+        static const std::vector<Unit*> none;
+        return none;
+    }
+    return m_unitsByType[typeId].units;
+}
 
+void Player::onUnitTypeChanged(Unit *unit)
+{
+    if (unit->ownerIndex.position == -1) { // not ours (yet)
+        return;
+    }
+    untrackUnitType(unit);
+    trackUnitType(unit);
 }
 
-void Player::onTileHidden(const int playerID, const int tileX, const int tileY)
+void Player::onUnitCompletionChanged(Unit *unit)
 {
-    if (playerID != this->playerId) {
+    if (unit->ownerIndex.position == -1) {
         return;
     }
 
-    std::shared_ptr<Map> map = this->m_map.lock();
-    REQUIRE(map, return);
-    for (const std::weak_ptr<Entity> &entity : map->entitiesAt(tileX, tileY)) {
-        Unit::Ptr unit = Unit::fromEntity(entity);
-        if (!unit) {
-            continue;
-        }
-        if (unit->playerId() == this->playerId) {
-            continue;
+    const bool underConstruction = unit->creationProgress() < 1.f;
+    if (underConstruction == unit->ownerIndex.underConstruction) {
+        return;
+    }
+
+    unitsOfTypeEntry(unit->ownerIndex.typeId).underConstruction += underConstruction ? 1 : -1;
+    unit->ownerIndex.underConstruction = underConstruction;
+}
+
+void Player::onUnitProductionQueued(const int typeId)
+{
+    REQUIRE(typeId >= 0, return);
+    unitsOfTypeEntry(typeId).inProduction++;
+}
+
+void Player::onUnitProductionEnded(const int typeId)
+{
+    REQUIRE(typeId >= 0, return);
+    UnitsOfType &entry = unitsOfTypeEntry(typeId);
+    REQUIRE(entry.inProduction > 0, return);
+    entry.inProduction--;
+}
+
+Player::UnitsOfType &Player::unitsOfTypeEntry(const int typeId)
+{
+    if (size_t(typeId) >= m_unitsByType.size()) {
+        m_unitsByType.resize(typeId + 1);
+    }
+    return m_unitsByType[typeId];
+}
+
+void Player::trackUnitType(Unit *unit)
+{
+    const genie::Unit *data = unit->data();
+    REQUIRE(data->ID >= 0, return);
+
+    Unit::OwnerIndex &index = unit->ownerIndex;
+    REQUIRE(index.position == -1, return);
+
+    UnitsOfType &entry = unitsOfTypeEntry(data->ID);
+    index.typeId = data->ID;
+    index.position = entry.units.size();
+    index.underConstruction = unit->creationProgress() < 1.f;
+    entry.units.push_back(unit);
+    if (index.underConstruction) {
+        entry.underConstruction++;
+    }
+
+    index.unitClass = data->Class;
+    if (index.unitClass >= 0) {
+        if (size_t(index.unitClass) >= m_unitClassCounts.size()) {
+            m_unitClassCounts.resize(index.unitClass + 1);
         }
-        EventManager::unitDisappeared(this, unit.get());
+        m_unitClassCounts[index.unitClass]++;
     }
 }
 
-void Player::onTileDiscovered(const int playerID, const int tileX, const int tileY)
+void Player::untrackUnitType(Unit *unit)
+{
+    Unit::OwnerIndex &index = unit->ownerIndex;
+    if (index.position == -1) {
+        return;
+    }
+
+    UnitsOfType &entry = unitsOfTypeEntry(index.typeId);
+    REQUIRE(size_t(index.position) < entry.units.size() && entry.units[index.position] == unit, return);
+
+    entry.units[index.position] = entry.units.back();
+    entry.units[index.position]->ownerIndex.position = index.position;
+    entry.units.pop_back();
+    if (index.underConstruction) {
+        entry.underConstruction--;
+    }
+
+    if (index.unitClass >= 0) {
+        m_unitClassCounts[index.unitClass]--;
+    }
+
+    index = Unit::OwnerIndex();
+}
+
+void Player::onVisibilityChanged(const int playerID, const VisibilityDelta &delta)
 {
     if (playerID != this->playerId) {
         return;
@@ -403,16 +508,32 @@ void Player::onTileDiscovered(const int playerID, const int tileX, const int til
 
     std::shared_ptr<Map> map = this->m_map.lock();
     REQUIRE(map, return);
-    for (const std::weak_ptr<Entity> &entity : map->entitiesAt(tileX, tileY)) {
-        Unit::Ptr unit = Unit::fromEntity(entity);
-        if (!unit) {
-            continue;
+
+    delta.forEachHidden([&](const int tileX, const int tileY) {
+        for (const std::weak_ptr<Entity> &entity : map->entitiesAt(tileX, tileY)) {
+            Unit::Ptr unit = Unit::fromEntity(entity);
+            if (!unit) {
+                continue;
+            }
+            if (unit->playerId() == this->playerId) {
+                continue;
+            }
+            EventManager::unitDisappeared(this, unit.get());
         }
-        if (unit->playerId() == this->playerId) {
-            continue;
+    });
+
+    delta.forEachDiscovered([&](const int tileX, const int tileY) {
+        for (const std::weak_ptr<Entity> &entity : map->entitiesAt(tileX, tileY)) {
+            Unit::Ptr unit = Unit::fromEntity(entity);
+            if (!unit) {
+                continue;
+            }
+            if (unit->playerId() == this->playerId) {
+                continue;
+            }
+            EventManager::unitDiscovered(this, unit.get());
         }
-        EventManager::unitDiscovered(this, unit.get());
-    }
+    });
 }
 
 void Player::onUnitMoved(Unit *unit, const MapPos &oldTile, const MapPos &newTile)
@@ -468,31 +589,33 @@ void Player::onUnitCreated(Unit *unit)
 
 void Player::updateAvailableTechs()
 {
+    // Start from scratch, after this it is kept up to date in onTechActivated()
     m_currentlyAvailableTechs.clear();
 
-    std::unordered_map<uint16_t, genie::Tech>::const_iterator it;
-    for (it = civilization.availableTechs().begin(); it != civilization.availableTechs().end(); it++) {
-        if (m_activeTechs.count(it->first)) {
-            continue;
-        }
+    const TechDependencies &dependencies = civilization.techDependencies();
+    m_pendingRequirements.assign(dependencies.nodes.size(), 0);
 
-        bool requirementsSatisfied = false;
-        for (const int reqId : it->second.RequiredTechs) {
-            if (reqId == -1) {
-                continue;
-            }
-            if (m_activeTechs.count(reqId)) {
-                requirementsSatisfied = true;
-            } else {
-                requirementsSatisfied = false;
-                break;
-            }
+    for (size_t i=0; i<dependencies.nodes.size(); i++) {
+        const TechDependencies::Node &node = dependencies.nodes[i];
+        m_pendingRequirements[i] = node.requirementCount;
+    }
+
+    for (const int activeId : m_activeTechs) {
+        for (const uint32_t index : dependencies.dependantsOf(activeId)) {
+            m_pendingRequirements[index]--;
         }
+    }
 
-        if (!requirementsSatisfied) {
-            continue;
+    // Collect first, applying implicit research modifies m_activeTechs
+    std::vector<uint32_t> satisfied;
+    for (size_t i=0; i<dependencies.nodes.size(); i++) {
+        if (dependencies.nodes[i].requirementCount > 0 && m_pendingRequirements[i] == 0) {
+            satisfied.push_back(i);
         }
-        m_currentlyAvailableTechs[it->first] = it->second;
+    }
+
+    for (const uint32_t index : satisfied) {
+        onTechRequirementsSatisfied(dependencies.nodes[index]);
     }
 }
 
@@ -532,14 +655,7 @@ bool Player::canAffordUnit(const int unitId) const
         return false;
     }
 
-    for (const std::pair<const genie::ResourceType, float> &cost : resourcesNeeded(unit)) {
-        const int available = resourcesAvailable(cost.first) - resourcesUsed(cost.first);
-        if (available < cost.second) {
-            return false;
-        }
-    }
-
-    return true;
+    return m_resourcesAvailable.canAfford(resourcesNeeded(unit), m_resourcesUsed);
 }
 
 void Player::payForUnit(const int unitId)
@@ -558,116 +674,3 @@ void Player::payForUnit(const int unitId)
         removeResource(type, cost.Amount);
     }
 }
-
-namespace {
-enum Direction : uint8_t {
-    West = 1 << 0,
-    South = 1 << 1,
-    East = 1 << 2,
-    North = 1 << 3,
-
-    NorthWest = 1 << 4,
-    NorthEast = 1 << 5,
-    SouthEast = 1 << 6,
-    SouthWest = 1 << 7,
-};
-
-struct EdgeTileLut {
-    constexpr EdgeTileLut() : values{}
-    {
-        const uint8_t uninitialized = -1;
-
-        for (size_t i=0; i<values.size(); i++) {
-            values[i] = uninitialized;
-        }
-
-        uint8_t tileNum = 0;
-        for (size_t edge=0; edge<values.size(); edge++) {
-            const bool west      = (edge & West);
-            const bool south     = (edge & South);
-            const bool east      = (edge & East);
-            const bool north     = (edge & North);
-            const bool southWest = (edge & SouthWest);
-            const bool southEast = (edge & SouthEast);
-            const bool northWest = (edge & NorthWest);
-            const bool northEast = (edge & NorthEast);
-
-            if (southWest && (west || north)) {
-                continue;
-            }
-            if (southEast && (east || north)) {
-                continue;
-            }
-            if (northEast && (east || south)) {
-                continue;
-            }
-            if (northWest && (west || south)) {
-                continue;
-            }
-
-            values[edge] = tileNum++;
-        }
-
-        for (size_t edge=0; edge<values.size(); edge++) {
-            if (values[edge] != uninitialized) {
-                continue;
-            }
-
-            uint8_t aliasEdge = edge & (NorthWest | NorthEast | SouthEast |  SouthWest);
-
-            if (edge & SouthWest) {
-                aliasEdge &= ~North;
-                aliasEdge &= ~West;
-            }
-
-            if (edge & SouthEast) {
-                aliasEdge &= ~North;
-                aliasEdge &= ~East;
-            }
-
-            if (edge & NorthEast) {
-                aliasEdge &= ~South;
-                aliasEdge &= ~East;
-            }
-
-            if (edge & NorthWest) {
-                aliasEdge &= ~South;
-                aliasEdge &= ~West;
-            }
-
-            values[edge] = values[aliasEdge];
-        }
-    }
-
-    std::array<uint8_t, 256> values;
-};
-} // anonymous namespace
-
-VisibilityMap::VisibilityMap(int playerID) :
-    m_playerId(playerID)
-{
-#ifdef CHEAT_VISIBILITY
-    m_visibility.fill(Visible);
-#else
-    m_visibility.fill(Unexplored);
-#endif
-}
-
-int VisibilityMap::edgeTileNum(const int tileX, const int tileY, const Visibility type) const
-{
-    static constexpr EdgeTileLut edgetileLut;
-
-    uint8_t edges = 0;
-
-    if (visibilityAt(tileX - 1, tileY + 0, type) <= type) { edges |= SouthWest; }
-    if (visibilityAt(tileX + 1, tileY + 0, type) <= type) { edges |= NorthEast; }
-    if (visibilityAt(tileX + 0, tileY - 1, type) <= type) { edges |= NorthWest; }
-    if (visibilityAt(tileX + 0, tileY + 1, type) <= type) { edges |= SouthEast; }
-
-    if (visibilityAt(tileX - 1, tileY - 1, type) <= type) { edges |= West; }
-    if (visibilityAt(tileX - 1, tileY + 1, type) <= type) { edges |= North; }
-    if (visibilityAt(tileX + 1, tileY - 1, type) <= type) { edges |= South; }
-    if (visibilityAt(tileX + 1, tileY + 1, type) <= type) { edges |= East; }
-
-    return edgetileLut.values[edges];
-}
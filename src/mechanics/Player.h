@@ -1,10 +1,9 @@
 #pragma once
 
 #include <stddef.h>
-#include <array>
-#include <limits>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 
 #include "core/Constants.h"
@@ -14,6 +13,7 @@
 #include "global/EventManager.h"
 #include "global/EventListener.h"
 #include "mechanics/Civilization.h"
+#include "mechanics/VisibilityMap.h"
 
 struct Unit;
 class Map;
@@ -22,97 +22,6 @@ namespace genie {
 class EffectCommand;
 }
 
-struct VisibilityMap
-{
-    bool isDirty = true; // needs re-render
-
-    enum Visibility : int {
-        Unexplored = std::numeric_limits<int>::min(),
-        Explored = 0,
-        Visible
-    };
-
-    VisibilityMap(int playerID);
-
-    inline Visibility visibilityAt(const MapPos &pos) const {
-        return visibilityAt(pos.x / Constants::TILE_SIZE, pos.y / Constants::TILE_SIZE);
-    }
-
-    inline Visibility visibilityAt(const int tileX, const int tileY, const Visibility def = Unexplored) const {
-        const size_t index = tileY * Constants::MAP_MAX_SIZE + tileX;
-        if (IS_UNLIKELY(index >= m_visibility.size())) {
-            return def;
-        }
-
-        if (m_visibility[index] > 0) {
-            return Visible;
-        } else if (m_visibility[index] == Unexplored) {
-            return Unexplored;
-        } else {
-            return Explored;
-        }
-    }
-
-    void setExplored(const int tileX, const int tileY) {
-        const size_t index = tileY * Constants::MAP_MAX_SIZE + tileX;
-        if (IS_UNLIKELY(index >= m_visibility.size())) {
-            return;
-        }
-        m_visibility[index] = Explored;
-        isDirty = true;
-
-        EventManager::tileDiscovered(m_playerId, tileX, tileY);
-    }
-
-    void addUnitLookingAt(const int tileX, const int tileY) {
-        const size_t index = tileY * Constants::MAP_MAX_SIZE + tileX;
-        if (IS_UNLIKELY(index >= m_visibility.size())) {
-            return;
-        }
-
-        if (m_visibility[index] == Unexplored) {
-            m_visibility[index] = Visible;
-            isDirty = true;
-        } else {
-            m_visibility[index]++;
-
-            if (m_visibility[index] == Visible) {
-                isDirty = true;
-            }
-        }
-
-        if (m_visibility[index] == Visible) {
-            EventManager::tileDiscovered(m_playerId, tileX, tileY);
-        }
-    }
-
-    void removeUnitLookingAt(const int tileX, const int tileY) {
-        const size_t index = tileY * Constants::MAP_MAX_SIZE + tileX;
-        if (IS_UNLIKELY(index >= m_visibility.size())) {
-            return;
-        }
-
-        if (IS_UNLIKELY(m_visibility[index] == Unexplored)) {
-            return;
-        }
-
-        if (m_visibility[index] == Visible) {
-            isDirty = true;
-        }
-
-        m_visibility[index]--;
-
-        if (m_visibility[index] == Explored) {
-            EventManager::tileHidden(m_playerId, tileX, tileY);
-        }
-    }
-    int edgeTileNum(const int tileX, const int tileY, const Visibility type) const;
-
-private:
-    int m_playerId;
-    std::array<int, Constants::MAP_MAX_SIZE * Constants::MAP_MAX_SIZE> m_visibility;
-};
-
 struct Player : public EventListener
 {
     enum Age {
@@ -149,6 +58,7 @@ struct Player : public EventListener
     ///////////////////
     /// Tech
     bool researchAvailable(const int researchId) { return m_currentlyAvailableTechs.count(researchId); }
+    const std::unordered_set<int> &activeTechs() const { return m_activeTechs; }
     void applyResearch(const int researchId);
     void applyTechEffect(const int effectId);
     void applyTechEffectCommand(const genie::EffectCommand &effect);
@@ -166,6 +76,28 @@ struct Player : public EventListener
     void addUnit(Unit *unit);
     void removeUnit(Unit *unit);
 
+    /// All we have of a type, including the ones still being built
+    int unitCount(const int typeId) const {
+        return size_t(typeId) < m_unitsByType.size() ? m_unitsByType[typeId].units.size() : 0;
+    }
+    int completedUnitCount(const int typeId) const {
+        return size_t(typeId) < m_unitsByType.size() ? m_unitsByType[typeId].units.size() - m_unitsByType[typeId].underConstruction : 0;
+    }
+    /// Queued or being trained in a building, so not an actual unit yet
+    int unitsInProduction(const int typeId) const {
+        return size_t(typeId) < m_unitsByType.size() ? m_unitsByType[typeId].inProduction : 0;
+    }
+    int unitClassCount(const int unitClass) const {
+        return size_t(unitClass) < m_unitClassCounts.size() ? m_unitClassCounts[unitClass] : 0;
+    }
+    const std::vector<Unit*> &unitsOfType(const int typeId) const;
+
+    // Called by Unit and Building to keep the counts above up to date
+    void onUnitTypeChanged(Unit *unit);
+    void onUnitCompletionChanged(Unit *unit);
+    void onUnitProductionQueued(const int typeId);
+    void onUnitProductionEnded(const int typeId); // either finished or aborted
+
     void setUnitGroup(Unit *unit, int group);
     int canSeeUnitsFor(const int otherID);
 
@@ -174,6 +106,10 @@ struct Player : public EventListener
     void setDiplomaticStance(const uint8_t playerId, const DiplomaticStance stance);
     bool isAllied(uint8_t playerId);
 
+    /// Gets our own visibility back when we share it with someone we're no longer allied with,
+    /// we keep what we have explored but only see what our own units see
+    void stopSharingVisibility();
+
     ////////////////////
     /// Resources
     void removeResource(const genie::ResourceType type, float amount) {
@@ -185,21 +121,21 @@ struct Player : public EventListener
     void setAvailableResource(const genie::ResourceType type, float newValue);
 
     float resourcesAvailable(const genie::ResourceType type) const {
-        ResourceMap::const_iterator it = m_resourcesAvailable.find(type);
-        if (it == m_resourcesAvailable.end()) {
-            return 0.f;
-        }
-
-        return it->second;
+        return m_resourcesAvailable.value(type);
     }
 
     float resourcesUsed(const genie::ResourceType type) const {
-        ResourceMap::const_iterator it = m_resourcesUsed.find(type);
-        if (it == m_resourcesUsed.end()) {
-            return 0.f;
-        }
-        return it->second;
+        return m_resourcesUsed.value(type);
     }
+
+    const ResourceMap &availableResources() const { return m_resourcesAvailable; }
+
+    /// Changes every time the available or used resources change, so stuff
+    /// computed from them can be cached until then
+    uint32_t resourcesVersion() const noexcept { return m_resourcesVersion; }
+
+    /// Changes when tech effects modify the unit data (costs etc.)
+    uint32_t unitDataVersion() const noexcept { return m_unitDataVersion; }
     void sendTribute(const std::shared_ptr<Player> &player, const genie::ResourceType type, const int amount);
 
     static constexpr int UngroupedGroupID = 0;
@@ -218,25 +154,43 @@ struct Player : public EventListener
     Unit *findUnitByTypeID(const int type) const;
     std::vector<Unit*> findUnitsByTypeID(const int type) const;
 
-    void onTileHidden(const int playerID, const int tileX, const int tileY) override;
-    void onTileDiscovered(const int playerID, const int tileX, const int tileY) override;
+    std::shared_ptr<Map> map() const { return m_map.lock(); }
+
+    void onVisibilityChanged(const int playerID, const VisibilityDelta &delta) override;
     void onUnitMoved(Unit *unit, const MapPos &oldTile, const MapPos &newTile) override;
     void onUnitGarrisoned(Unit *unit, Unit *garrisonedIn) override;
     void onUnitDying(Unit *unit) override;
     void onUnitCreated(Unit *unit) override;
 
 private:
+    struct UnitsOfType {
+        std::vector<Unit*> units; // the Unit knows where it is in here, so removing is just a swap
+        int underConstruction = 0;
+        int inProduction = 0;
+    };
+
     ResourceMap resourcesNeeded(const genie::Unit &unit) const;
 
+    UnitsOfType &unitsOfTypeEntry(const int typeId);
+    void trackUnitType(Unit *unit);
+    void untrackUnitType(Unit *unit);
+
     void updateAvailableTechs();
+    void onTechActivated(const int id);
+    void onTechRequirementsSatisfied(const TechDependencies::Node &node);
 
     // group 0 == ungrouped
     std::vector<std::unordered_set<Unit*>> m_unitGroups;
 
     ResourceMap m_resourcesUsed;
     ResourceMap m_resourcesAvailable;
+    uint32_t m_resourcesVersion = 0;
+    uint32_t m_unitDataVersion = 0;
     std::unordered_set<Unit*> m_units;
+    std::vector<UnitsOfType> m_unitsByType; // indexed by unit id
+    std::vector<int> m_unitClassCounts;
     std::unordered_set<int> m_activeTechs;
+    std::vector<uint8_t> m_pendingRequirements; // per node in the civilization's TechDependencies
     std::vector<DiplomaticStance> m_diplomaticStances;
     std::unordered_map<int, genie::Tech> m_currentlyAvailableTechs;
 
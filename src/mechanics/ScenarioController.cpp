@@ -39,13 +39,25 @@
 #include "mechanics/UnitManager.h"
 
 ScenarioController::ScenarioController(GameState *gameState) :
+    m_timers(gameState->timers()),
     m_gameState(gameState)
 {
 }
 
+ScenarioController::~ScenarioController()
+{
+    for (uint32_t triggerIndex = 0; triggerIndex < m_triggers.size(); triggerIndex++) {
+        stopTimers(triggerIndex);
+    }
+}
+
 void ScenarioController::setScenario(const std::shared_ptr<genie::ScnFile> &scenario)
 {
+    for (uint32_t triggerIndex = 0; triggerIndex < m_triggers.size(); triggerIndex++) {
+        stopTimers(triggerIndex);
+    }
     m_triggers.clear();
+    buildIndexes();
 
     if (!scenario) {
         EventManager::deregisterListener(this);
@@ -276,6 +288,8 @@ void ScenarioController::setScenario(const std::shared_ptr<genie::ScnFile> &scen
         m_triggers.emplace_back(winTrigger);
     }
 
+    buildIndexes();
+
     EventManager::registerListener(this, EventManager::UnitCreated);
     EventManager::registerListener(this, EventManager::UnitMoved);
     EventManager::registerListener(this, EventManager::UnitSelected);
@@ -285,35 +299,158 @@ void ScenarioController::setScenario(const std::shared_ptr<genie::ScnFile> &scen
     EventManager::registerListener(this, EventManager::AttributeChanged);
 }
 
-bool ScenarioController::update(Time time)
+void ScenarioController::buildIndexes()
 {
-    bool updated = false;
-    const Time elapsed = time - m_lastUpdateTime;
-    m_lastUpdateTime = time;
-    for (Trigger &trigger : m_triggers) {
-        if (!trigger.enabled) {
+    m_createdConditions.clear();
+    m_dyingConditions.clear();
+    m_selectedConditions.clear();
+    m_areaConditions.clear();
+    m_attributeConditions.clear();
+    m_changedTriggers.clear();
+
+    for (uint32_t triggerIndex = 0; triggerIndex < m_triggers.size(); triggerIndex++) {
+        Trigger &trigger = m_triggers[triggerIndex];
+        trigger.isQueued = false;
+
+        for (uint32_t conditionIndex = 0; conditionIndex < trigger.conditions.size(); conditionIndex++) {
+            ConditionRef ref;
+            ref.trigger = triggerIndex;
+            ref.condition = conditionIndex;
+
+            const genie::TriggerCondition &data = trigger.conditions[conditionIndex].data;
+            switch(data.type) {
+            case genie::TriggerCondition::OwnObjects:
+                m_createdConditions.add(ref, data);
+                break;
+            case genie::TriggerCondition::OwnFewerObjects:
+                m_createdConditions.add(ref, data);
+                m_dyingConditions.add(ref, data);
+                break;
+            case genie::TriggerCondition::DestroyObject:
+                m_dyingConditions.add(ref, data);
+                break;
+            case genie::TriggerCondition::ObjectSelected:
+                m_selectedConditions.add(ref, data);
+                break;
+            case genie::TriggerCondition::ObjectsInArea: {
+                // WARNING: flipped x and y
+                const MapRect area(MapPos(data.areaFrom.y, data.areaFrom.x), MapPos(data.areaTo.y, data.areaTo.x));
+                m_areaConditions.add(ref, area);
+                break;
+            }
+            case genie::TriggerCondition::AccumulateAttribute:
+                m_attributeConditions[data.resource].push_back(ref);
+                break;
+            default:
+                break;
+            }
+        }
+
+        // Need to check everything at least once, e. g. those without any conditions
+        if (trigger.enabled) {
+            startTimers(triggerIndex);
+            markChanged(triggerIndex);
+        }
+    }
+
+    if (!m_triggers.empty()) {
+        DBG << "Indexed" << m_triggers.size() << "triggers," << m_createdConditions.size() << "created,"
+            << m_dyingConditions.size() << "dying," << m_selectedConditions.size() << "selected,"
+            << m_areaConditions.size() << "area and" << m_attributeConditions.size() << "attribute conditions";
+    }
+}
+
+void ScenarioController::markChanged(const uint32_t triggerIndex)
+{
+    Trigger &trigger = m_triggers[triggerIndex];
+    if (trigger.isQueued) {
+        return;
+    }
+    trigger.isQueued = true;
+    m_changedTriggers.push_back(triggerIndex);
+}
+
+void ScenarioController::setTriggerEnabled(const uint32_t triggerIndex, const bool enabled)
+{
+    Trigger &trigger = m_triggers[triggerIndex];
+    if (trigger.enabled == enabled) {
+        return;
+    }
+    trigger.enabled = enabled;
+
+    if (enabled) {
+        startTimers(triggerIndex);
+        markChanged(triggerIndex);
+    } else {
+        stopTimers(triggerIndex);
+    }
+}
+
+void ScenarioController::startTimers(const uint32_t triggerIndex)
+{
+    std::vector<Condition> &conditions = m_triggers[triggerIndex].conditions;
+    for (uint32_t conditionIndex = 0; conditionIndex < conditions.size(); conditionIndex++) {
+        Condition &condition = conditions[conditionIndex];
+        if (condition.data.type != genie::TriggerCondition::Timer || condition.timer || condition.amountRequired <= 0) {
             continue;
         }
 
-        bool conditionsSatisfied = true;
-        for (Condition &condition : trigger.conditions) {
-            if (condition.data.type == genie::TriggerCondition::Timer) {
-                condition.amountRequired -= elapsed;
-            }
+        // amountRequired is what is left of it
+        const Time expiry = m_timers->currentTime() + Time(condition.amountRequired);
+        condition.timer = m_timers->arm(expiry, [this, triggerIndex, conditionIndex]() {
+            Condition &expired = m_triggers[triggerIndex].conditions[conditionIndex];
+            expired.timer = 0;
+            expired.amountRequired = 0;
+            markChanged(triggerIndex);
+        });
+    }
+}
 
-            if (condition.amountRequired > 0) {
-                conditionsSatisfied = false;
-            }
+void ScenarioController::stopTimers(const uint32_t triggerIndex)
+{
+    for (Condition &condition : m_triggers[triggerIndex].conditions) {
+        if (!condition.timer) {
+            continue;
         }
 
-        if (!conditionsSatisfied) {
+        // Keep what's left for when it gets enabled again
+        condition.amountRequired = std::max(m_timers->expiryOf(condition.timer) - m_timers->currentTime(), Time(0));
+        m_timers->cancel(condition.timer);
+        condition.timer = 0;
+    }
+}
+
+bool ScenarioController::update(Time time)
+{
+    (void)time; // The timers are advanced by the game state, and call us back
+
+    if (m_changedTriggers.empty()) {
+        return false;
+    }
+
+    // Effects might enable other triggers, those are checked in the next update
+    m_checkingTriggers.clear();
+    std::swap(m_checkingTriggers, m_changedTriggers);
+
+    // Same order as when we went through all of them
+    std::sort(m_checkingTriggers.begin(), m_checkingTriggers.end());
+
+    bool updated = false;
+    for (const uint32_t triggerIndex : m_checkingTriggers) {
+        Trigger &trigger = m_triggers[triggerIndex];
+        trigger.isQueued = false;
+
+        if (!trigger.isSatisfied()) {
             continue;
         }
 
         updated = true;
 
-        if (!trigger.looping) {
-            trigger.enabled = false;
+        if (trigger.looping) {
+            // Still satisfied, so fires again next time
+            markChanged(triggerIndex);
+        } else {
+            setTriggerEnabled(triggerIndex, false);
         }
 
         for (const genie::TriggerEffect &effect : trigger.effects) {
@@ -342,7 +479,7 @@ void ScenarioController::handleTriggerEffect(const genie::TriggerEffect &effect)
             return;
         }
         DBG << "enabling trigger" << m_triggers[effect.trigger].name;
-        m_triggers[triggerIndex].enabled = true;
+        setTriggerEnabled(triggerIndex, true);
         break;
     }
     case genie::TriggerEffect::DeactivateTrigger: {
@@ -352,7 +489,7 @@ void ScenarioController::handleTriggerEffect(const genie::TriggerEffect &effect)
             return;
         }
         DBG << "disabling trigger" << m_triggers[effect.trigger].name;
-        m_triggers[triggerIndex].enabled = false;
+        setTriggerEnabled(triggerIndex, false);
         break;
     }
 
@@ -412,14 +549,14 @@ void ScenarioController::handleTriggerEffect(const genie::TriggerEffect &effect)
             WARN << "Failed to create unit";
             return;
         }
-        DBG << "Created" << unit->debugName;
+        DBG << "Created" << unit->debugName();
         m_gameState->unitManager()->add(unit, location);
         break;
     }
     case genie::TriggerEffect::RemoveObject: {
         DBG << "Removing unit" << effect;
         forEachMatchingUnit(effect, [this](const Unit::Ptr &unit) {
-            DBG << "Removing unit" << unit->debugName;
+            DBG << "Removing unit" << unit->debugName();
             m_gameState->unitManager()->remove(unit);
         });
         break;
@@ -432,7 +569,7 @@ void ScenarioController::handleTriggerEffect(const genie::TriggerEffect &effect)
         targetPos *= Constants::TILE_SIZE;
 
         forEachMatchingUnit(effect, [this, &targetPos](const Unit::Ptr &unit) {
-            DBG << "Tasking object" << unit->debugName;
+            DBG << "Tasking object" << unit->debugName();
             m_gameState->unitManager()->moveUnitTo(unit, targetPos);
         });
         break;
@@ -440,7 +577,7 @@ void ScenarioController::handleTriggerEffect(const genie::TriggerEffect &effect)
     case genie::TriggerEffect::DamageObject: {
         DBG << "Damaging object" << effect;
         forEachMatchingUnit(effect, [&](const Unit::Ptr &unit) {
-            DBG << "Damaging unit" << unit->debugName << "for" << effect.amount;
+            DBG << "Damaging unit" << unit->debugName() << "for" << effect.amount;
             unit->takeDamage(effect.amount);
         });
         break;
@@ -448,7 +585,7 @@ void ScenarioController::handleTriggerEffect(const genie::TriggerEffect &effect)
     case genie::TriggerEffect::ChangeObjectHP: {
         forEachMatchingUnit(effect, [&](const Unit::Ptr &unit) {
             const float deltaHP = effect.amount - unit->healthLeft();
-            DBG << "Changing unit HP" << unit->debugName << "for" << effect.amount;
+            DBG << "Changing unit HP" << unit->debugName() << "for" << effect.amount;
             unit->takeDamage(deltaHP);
         });
         break;
@@ -484,7 +621,7 @@ void ScenarioController::handleTriggerEffect(const genie::TriggerEffect &effect)
     }
     case genie::TriggerEffect::HD_HealObject: {
         forEachMatchingUnit(effect, [&](const Unit::Ptr &unit) {
-            DBG << "Healing" << unit->debugName << "for" << effect.amount;
+            DBG << "Healing" << unit->debugName() << "for" << effect.amount;
             unit->takeDamage(-effect.amount);
         });
         break;
@@ -597,7 +734,7 @@ void ScenarioController::forEachMatchingUnit(const genie::TriggerEffect &effect,
         }
         foundUnits = true;
         if (!checkUnitMatchingEffect(unit, effect)) {
-            DBG << "Unit" << unit->debugName << "Not matching";
+            DBG << "Unit" << unit->debugName() << "Not matching";
             continue;
         }
         foundMatching = true;
@@ -615,111 +752,98 @@ void ScenarioController::forEachMatchingUnit(const genie::TriggerEffect &effect,
 
 void ScenarioController::onUnitCreated(Unit *unit)
 {
-    for (Trigger &trigger : m_triggers) {
-        if (!trigger.enabled) {
-            continue;
+    m_createdConditions.forEachCandidate(unit->spawnId, unit->data()->ID, unit->playerId(), [&](const ConditionRef &ref) {
+        if (!m_triggers[ref.trigger].enabled) {
+            return;
         }
 
-        for (Condition &condition : trigger.conditions) {
-            switch(condition.data.type) {
-            case genie::TriggerCondition::OwnObjects:
-                if (condition.checkUnitMatching(unit)) {
-                    condition.amountRequired--;
-                }
-                continue;
-            case genie::TriggerCondition::OwnFewerObjects:
-                if (condition.checkUnitMatching(unit)) {
-                    condition.amountRequired++;
-                }
-                break;
-            default:
-                continue;
-            }
+        Condition &condition = conditionAt(ref);
+        if (!condition.checkUnitMatching(unit)) {
+            return;
         }
-    }
+
+        switch(condition.data.type) {
+        case genie::TriggerCondition::OwnObjects:
+            condition.amountRequired--;
+            break;
+        case genie::TriggerCondition::OwnFewerObjects:
+            condition.amountRequired++;
+            break;
+        default:
+            return;
+        }
+        markChanged(ref.trigger);
+    });
 }
 
 void ScenarioController::onUnitMoved(Unit *unit, const MapPos &oldTile, const MapPos &newTile)
 {
-    for (Trigger &trigger : m_triggers) {
-        if (!trigger.enabled) {
-            continue;
+    // Moved out of required area, so it must be one around where it was
+    m_areaConditions.forEachCandidate(oldTile, [&](const ConditionRef &ref, const MapRect &conditionRect) {
+        if (!m_triggers[ref.trigger].enabled) {
+            return;
+        }
+        if (!conditionRect.contains(oldTile) || conditionRect.contains(newTile)) {
+            return;
         }
 
-        for (Condition &condition : trigger.conditions) {
-            switch(condition.data.type) {
-            case genie::TriggerCondition::BringObjectToArea:
-                WARN << "TODO: move objects to area" << condition.data;
-                continue;
-            case genie::TriggerCondition::ObjectsInArea:
-                break;
-            default:
-                continue;
-            }
-
-            if (!condition.checkUnitMatching(unit)) {
-                continue;
-            }
+        Condition &condition = conditionAt(ref);
+        if (!condition.checkUnitMatching(unit)) {
+            return;
+        }
 
-            // WARNING: flipped x and y
-            const MapRect conditionRect(MapPos(condition.data.areaFrom.y, condition.data.areaFrom.x),
-                                        MapPos(condition.data.areaTo.y, condition.data.areaTo.x)
-                );
+        DBG << unit->debugName() << "moved to" << newTile << "out of" << conditionRect;
+        condition.amountRequired++;
+        markChanged(ref.trigger);
+    });
 
-            // Moved out of required area
-            if (conditionRect.contains(oldTile) && !conditionRect.contains(newTile))  {
-                DBG << unit->debugName << "moved to" << newTile << "out of" << conditionRect;
-                condition.amountRequired++;
-                continue;
-            }
+    // Moved into area
+    m_areaConditions.forEachCandidate(newTile, [&](const ConditionRef &ref, const MapRect &conditionRect) {
+        if (!m_triggers[ref.trigger].enabled) {
+            return;
+        }
+        if (conditionRect.contains(oldTile) || !conditionRect.contains(newTile)) {
+            return;
+        }
 
-            // Moved into area
-            if (!conditionRect.contains(oldTile) && conditionRect.contains(newTile))  {
-                DBG << unit->debugName << "moved to" << newTile << "into" << conditionRect;
-                condition.amountRequired--;
-                continue;
-            }
+        Condition &condition = conditionAt(ref);
+        if (!condition.checkUnitMatching(unit)) {
+            return;
         }
-    }
 
+        DBG << unit->debugName() << "moved to" << newTile << "into" << conditionRect;
+        condition.amountRequired--;
+        markChanged(ref.trigger);
+    });
 }
 
 void ScenarioController::onUnitSelected(Unit *unit)
 {
     // Don't check for trigger enabled here, the player might select before trigger is enabled
-    for (Trigger &trigger : m_triggers) {
-        for (Condition &condition : trigger.conditions) {
-            switch(condition.data.type) {
-            case genie::TriggerCondition::ObjectSelected:
-                if (condition.checkUnitMatching(unit)) {
-                    condition.amountRequired--;
-                    DBG << "select condition match" << unit->spawnId << unit->debugName << unit->id << condition.data << condition.amountRequired;
-                }
-                break;
-            default:
-                continue;
-            }
+    m_selectedConditions.forEachCandidate(unit->spawnId, unit->data()->ID, unit->playerId(), [&](const ConditionRef &ref) {
+        Condition &condition = conditionAt(ref);
+        if (!condition.checkUnitMatching(unit)) {
+            return;
         }
-    }
+
+        condition.amountRequired--;
+        markChanged(ref.trigger);
+        DBG << "select condition match" << unit->spawnId << unit->debugName() << condition.data << condition.amountRequired;
+    });
 }
 
 void ScenarioController::onUnitDeselected(const Unit *unit)
 {
     // Don't check for trigger enabled here, the player might select before trigger is enabled
-    for (Trigger &trigger : m_triggers) {
-        for (Condition &condition : trigger.conditions) {
-            switch(condition.data.type) {
-            case genie::TriggerCondition::ObjectSelected:
-                if (condition.checkUnitMatching(unit)) {
-                    condition.amountRequired++;
-                    DBG << "deselect condition match" << unit->spawnId << unit->debugName << unit->id << condition.data << condition.amountRequired;
-                }
-                break;
-            default:
-                continue;
-            }
+    m_selectedConditions.forEachCandidate(unit->spawnId, unit->data()->ID, unit->playerId(), [&](const ConditionRef &ref) {
+        Condition &condition = conditionAt(ref);
+        if (!condition.checkUnitMatching(unit)) {
+            return;
         }
-    }
+
+        condition.amountRequired++;
+        DBG << "deselect condition match" << unit->spawnId << unit->debugName() << condition.data << condition.amountRequired;
+    });
 }
 
 void ScenarioController::onPlayerDefeated(Player *player)
@@ -730,54 +854,53 @@ void ScenarioController::onPlayerDefeated(Player *player)
 
 void ScenarioController::onAttributeChanged(Player *player, int attributeId, float newValue)
 {
-    for (Trigger &trigger : m_triggers) {
-        if (!trigger.enabled) {
+    std::unordered_map<int, std::vector<ConditionRef>>::const_iterator it = m_attributeConditions.find(attributeId);
+    if (it == m_attributeConditions.end()) {
+        return;
+    }
+
+    for (const ConditionRef &ref : it->second) {
+        if (!m_triggers[ref.trigger].enabled) {
             continue;
         }
 
-        for (Condition &condition : trigger.conditions) {
-            if (condition.data.type != genie::TriggerCondition::AccumulateAttribute) {
-                continue;
-            }
-            if (condition.data.resource != attributeId) {
-                continue;
-            }
-            if (condition.data.sourcePlayer != -1 && condition.data.sourcePlayer != player->playerId) {
-                continue;
-            }
-
-            condition.amountRequired += newValue;
+        Condition &condition = conditionAt(ref);
+        if (condition.data.sourcePlayer != -1 && condition.data.sourcePlayer != player->playerId) {
+            continue;
         }
+
+        condition.amountRequired += newValue;
+        markChanged(ref.trigger);
     }
 }
 
 void ScenarioController::onUnitDying(Unit *unit)
 {
-    DBG << "unit died" << unit->debugName << unit->spawnId;
-    for (Trigger &trigger : m_triggers) {
-        if (!trigger.enabled) {
-            continue;
+    DBG << "unit died" << unit->debugName() << unit->spawnId;
+    m_dyingConditions.forEachCandidate(unit->spawnId, unit->data()->ID, unit->playerId(), [&](const ConditionRef &ref) {
+        if (!m_triggers[ref.trigger].enabled) {
+            return;
         }
 
-        for (Condition &condition : trigger.conditions) {
-            switch(condition.data.type) {
-            case genie::TriggerCondition::DestroyObject:
-                if (condition.checkUnitMatching(unit)) {
-                    condition.amountRequired--;
-                    DBG << "destroy condition match" << unit->spawnId << unit->debugName << unit->id << condition.data << condition.amountRequired;
-                }
-                break;
-            case genie::TriggerCondition::OwnFewerObjects:
-                if (condition.checkUnitMatching(unit)) {
-                    condition.amountRequired--;
-                    DBG << "fewer condition match" << unit->spawnId << unit->debugName << unit->id << condition.data << condition.amountRequired;
-                }
-                break;
-            default:
-                continue;
-            }
+        Condition &condition = conditionAt(ref);
+        if (!condition.checkUnitMatching(unit)) {
+            return;
         }
-    }
+
+        switch(condition.data.type) {
+        case genie::TriggerCondition::DestroyObject:
+            condition.amountRequired--;
+            DBG << "destroy condition match" << unit->spawnId << unit->debugName() << condition.data << condition.amountRequired;
+            break;
+        case genie::TriggerCondition::OwnFewerObjects:
+            condition.amountRequired--;
+            DBG << "fewer condition match" << unit->spawnId << unit->debugName() << condition.data << condition.amountRequired;
+            break;
+        default:
+            return;
+        }
+        markChanged(ref.trigger);
+    });
 }
 
 bool ScenarioController::Condition::checkUnitMatching(const Unit *unit) const
@@ -2,11 +2,14 @@
 
 #include "global/EventListener.h"
 #include "core/Logger.h"
+#include "core/TimerWheel.h"
 #include "core/Types.h"
+#include "mechanics/TriggerConditionIndex.h"
 
 #include <genie/script/scn/Trigger.h>
 
 #include <functional>
+#include <unordered_map>
 
 class GameState;
 class Engine;
@@ -34,11 +37,15 @@ class ScenarioController : public EventListener
         }
         const genie::TriggerCondition data;
 
+        /// For timers, armed while the trigger is enabled
+        TimerWheel::TimerId timer = 0;
+
         bool checkUnitMatching(const Unit *unit) const;
     };
 
     struct Trigger {
         bool enabled = false;
+        bool isQueued = false; // in the list of triggers to check in the next update
 
         Trigger (const genie::Trigger &d) :
             effects(d.effects),
@@ -77,6 +84,7 @@ class ScenarioController : public EventListener
 
 public:
     ScenarioController(GameState *gameState);
+    ~ScenarioController();
 
     void setScenario(const std::shared_ptr<genie::ScnFile> &scenario);
     bool update(Time time);
@@ -98,9 +106,32 @@ private:
     void handleTriggerEffect(const genie::TriggerEffect &effect);
     void forEachMatchingUnit(const genie::TriggerEffect &effect, const std::function<void(const std::shared_ptr<Unit> &)> &action);
 
-    // Todo: put these in an std::array based on type, so we don't have to loop over all
+    /// Sorts the conditions of all the triggers into the indexes below, the triggers can't change after this
+    void buildIndexes();
+
+    /// Something changed that might make it satisfied, so check it in the next update
+    void markChanged(const uint32_t triggerIndex);
+
+    /// Timer conditions only count down while the trigger is enabled
+    void setTriggerEnabled(const uint32_t triggerIndex, const bool enabled);
+    void startTimers(const uint32_t triggerIndex);
+    void stopTimers(const uint32_t triggerIndex);
+
+    inline Condition &conditionAt(const ConditionRef &ref) { return m_triggers[ref.trigger].conditions[ref.condition]; }
+
     std::vector<Trigger> m_triggers;
-    Time m_lastUpdateTime = 0;
+    std::shared_ptr<TimerWheel> m_timers;
+
+    // So the events only look at the conditions they can affect
+    UnitConditionIndex m_createdConditions;
+    UnitConditionIndex m_dyingConditions;
+    UnitConditionIndex m_selectedConditions;
+    AreaConditionIndex m_areaConditions;
+    std::unordered_map<int, std::vector<ConditionRef>> m_attributeConditions; // by attribute id
+
+    // And update only checks the triggers where something changed
+    std::vector<uint32_t> m_changedTriggers;
+    std::vector<uint32_t> m_checkingTriggers;
 
     GameState *m_gameState = nullptr; // ugly raw pointer, but owned by gamestate, so sue me
     Engine *m_engine = nullptr; // samesies
@@ -0,0 +1,58 @@
+#include "TriggerConditionIndex.h"
+
+#include <genie/script/scn/Trigger.h>
+#include <algorithm>
+
+void UnitConditionIndex::add(const ConditionRef &ref, const genie::TriggerCondition &condition)
+{
+    // Same order as the most specific first in checkUnitMatching()
+    if (condition.setObject > -1) {
+        m_bySpawnId[condition.setObject].push_back(ref);
+    } else if (condition.object > -1) {
+        m_byUnitType[condition.object].push_back(ref);
+    } else if (condition.sourcePlayer > -1) {
+        m_byPlayer[condition.sourcePlayer].push_back(ref);
+    } else {
+        m_any.push_back(ref);
+    }
+
+    m_count++;
+}
+
+void UnitConditionIndex::clear()
+{
+    m_bySpawnId.clear();
+    m_byUnitType.clear();
+    m_byPlayer.clear();
+    m_any.clear();
+    m_count = 0;
+}
+
+void AreaConditionIndex::add(const ConditionRef &ref, const MapRect &area)
+{
+    // Contains() is exclusive, so this covers everything it can contain
+    const int firstX = std::max(int(area.x) / CellSize, 0);
+    const int firstY = std::max(int(area.y) / CellSize, 0);
+    const int lastX = std::min(int(area.x + area.width) / CellSize, CellsPerRow - 1);
+    const int lastY = std::min(int(area.y + area.height) / CellSize, CellsPerRow - 1);
+
+    Entry entry;
+    entry.ref = ref;
+    entry.area = area;
+
+    for (int y = firstY; y <= lastY; y++) {
+        for (int x = firstX; x <= lastX; x++) {
+            m_cells[y * CellsPerRow + x].push_back(entry);
+        }
+    }
+
+    m_count++;
+}
+
+void AreaConditionIndex::clear()
+{
+    for (std::vector<Entry> &cell : m_cells) {
+        cell.clear();
+    }
+    m_count = 0;
+}
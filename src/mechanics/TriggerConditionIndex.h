@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stddef.h>
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "core/Constants.h"
+#include "core/Types.h"
+
+namespace genie {
+class TriggerCondition;
+}
+
+/// Where a trigger condition lives, index of the trigger and the condition in it
+struct ConditionRef
+{
+    uint32_t trigger = 0;
+    uint32_t condition = 0;
+};
+
+/// Trigger conditions that look at units, sorted by the most specific thing they
+/// require (a specific unit, a unit type, a player), so an event for a unit only
+/// needs to look at the conditions that can possibly match it.
+///
+/// It only narrows it down, the caller still needs to check if it actually matches.
+struct UnitConditionIndex
+{
+    void add(const ConditionRef &ref, const genie::TriggerCondition &condition);
+    void clear();
+
+    size_t size() const noexcept { return m_count; }
+
+    template<typename Function>
+    void forEachCandidate(const int spawnId, const int unitTypeId, const int playerId, Function &&function) const {
+        if (m_count == 0) {
+            return;
+        }
+
+        visitBucket(m_bySpawnId, spawnId, function);
+        visitBucket(m_byUnitType, unitTypeId, function);
+        visitBucket(m_byPlayer, playerId, function);
+
+        for (const ConditionRef &ref : m_any) {
+            function(ref);
+        }
+    }
+
+private:
+    typedef std::unordered_map<int, std::vector<ConditionRef>> Buckets;
+
+    template<typename Function>
+    static void visitBucket(const Buckets &buckets, const int key, Function &function) {
+        if (buckets.empty()) {
+            return;
+        }
+        Buckets::const_iterator it = buckets.find(key);
+        if (it == buckets.end()) {
+            return;
+        }
+        for (const ConditionRef &ref : it->second) {
+            function(ref);
+        }
+    }
+
+    Buckets m_bySpawnId;
+    Buckets m_byUnitType;
+    Buckets m_byPlayer;
+    std::vector<ConditionRef> m_any;
+    size_t m_count = 0;
+};
+
+/// Conditions for an area of the map, put in coarse cells of tiles so a unit
+/// moving only looks at the areas around where it is.
+struct AreaConditionIndex
+{
+    static constexpr int CellSize = 8; // in tiles
+    static constexpr int CellsPerRow = (Constants::MAP_MAX_SIZE + CellSize - 1) / CellSize;
+
+    struct Entry {
+        ConditionRef ref;
+        MapRect area; // in tiles
+    };
+
+    void add(const ConditionRef &ref, const MapRect &area);
+    void clear();
+
+    size_t size() const noexcept { return m_count; }
+
+    /// All the areas that might contain the tile
+    template<typename Function>
+    void forEachCandidate(const MapPos &tile, Function &&function) const {
+        if (m_count == 0) {
+            return;
+        }
+
+        const int cellX = int(tile.x) / CellSize;
+        const int cellY = int(tile.y) / CellSize;
+        if (IS_UNLIKELY(unsigned(cellX) >= unsigned(CellsPerRow) || unsigned(cellY) >= unsigned(CellsPerRow))) {
+            return;
+        }
+
+        for (const Entry &entry : m_cells[cellY * CellsPerRow + cellX]) {
+            function(entry.ref, entry.area);
+        }
+    }
+
+private:
+    std::array<std::vector<Entry>, CellsPerRow * CellsPerRow> m_cells;
+    size_t m_count = 0;
+};
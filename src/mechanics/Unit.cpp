@@ -51,10 +51,8 @@
 #include "resource/Sprite.h"
 #include "render/GraphicRender.h"
 
-template<> struct std::hash<std::pair<int, int>> {
-    std::size_t operator()(const std::pair<int, int> &point) const noexcept { return point.first ^ point.second; }
-};
-
+const std::vector<Unit::Annex> Unit::s_noAnnexes;
+const genie::Unit *const Unit::s_noData = nullptr;
 
 std::shared_ptr<Unit> Unit::fromEntity(const EntityPtr &entity) noexcept
 {
@@ -78,7 +76,7 @@ Unit::Unit(const genie::Unit &data_, const std::shared_ptr<Player> &player_, Uni
     m_renderer->setCivId(player_->civilization.id());
 
     setUnitData(data_);
-    m_creationProgress = m_data->Creatable.TrainTime;
+    m_creationProgress = data()->Creatable.TrainTime;
 
     player_->addUnit(this);
 }
@@ -93,7 +91,7 @@ Unit::Unit(const genie::Unit &data_, const std::shared_ptr<Player> &player_, Uni
     m_renderer->setPlayerColor(player_->playerColor);
 
     setUnitData(data_);
-    m_creationProgress = m_data->Creatable.TrainTime;
+    m_creationProgress = data()->Creatable.TrainTime;
 
     player_->addUnit(this);
 }
@@ -103,12 +101,17 @@ Unit::~Unit()
     Player::Ptr owner = m_player.lock();
     if (owner) {
         // TODO: don't do that here
-        forEachVisibleTile([&](const int tileX, const int tileY) {
-            owner->visibility->removeUnitLookingAt(tileX, tileY);
-        });
+        owner->visibility->removeLineOfSight(position().x / Constants::TILE_SIZE, position().y / Constants::TILE_SIZE, m_lineOfSight);
 
         owner->removeUnit(this);
     }
+
+    if (!m_obstructedTiles.isEmpty()) {
+        MapPtr map = m_map.lock();
+        if (map) {
+            map->buildability().removeObstruction(m_obstructedTiles);
+        }
+    }
 }
 
 void Unit::setAngle(const float angle) noexcept
@@ -131,7 +134,7 @@ bool Unit::update(Time time) noexcept
 
     m_prevTime = time;
 
-    for (Annex &annex : annexes) {
+    for (const Annex &annex : annexes()) {
         updated = annex.unit->update(time) || updated;
     }
 
@@ -166,6 +169,79 @@ bool Unit::update(Time time) noexcept
     return Entity::update(time) || updated;
 }
 
+void Unit::wake() noexcept
+{
+    if (IS_LIKELY(!m_dormant)) {
+        return;
+    }
+
+    m_unitManager.wakeUnit(this, m_unitManager.currentTime());
+}
+
+bool Unit::canSleep() const noexcept
+{
+    if (isVisible) {
+        return false;
+    }
+
+    // Dying and corpses need to finish the animation and get cleaned up
+    if (m_damageTaken >= data()->HitPoints) {
+        return false;
+    }
+
+    if (actions.m_currentAction || !actions.m_actionQueue.empty()) {
+        return false;
+    }
+
+    if (activeMissiles > 0 || creationProgress() < 1.f) {
+        return false;
+    }
+
+    for (const Annex &annex : annexes()) {
+        if (!annex.unit->canSleep()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void Unit::onWoken(const Time time) noexcept
+{
+    m_prevTime = time;
+
+    // Pick up the animation where it would have been if we kept updating it
+    m_renderer->syncToClock(time);
+
+    for (const Annex &annex : annexes()) {
+        annex.unit->onWoken(time);
+    }
+}
+
+Unit::RareState &Unit::rareState()
+{
+    if (!m_rare) {
+        m_rare = std::make_unique<RareState>();
+    }
+    return *m_rare;
+}
+
+void Unit::setAnnexes(std::vector<Annex> &&newAnnexes)
+{
+    if (newAnnexes.empty() && !m_rare) {
+        return;
+    }
+    rareState().annexes = std::move(newAnnexes);
+}
+
+void Unit::setGarrisonedIn(const std::shared_ptr<Building> &building)
+{
+    if (!building && !m_rare) {
+        return;
+    }
+    rareState().garrisonedIn = building;
+}
+
 void Unit::setPlayer(const std::shared_ptr<Player> &newPlayer)
 {
     REQUIRE(newPlayer, return);
@@ -178,25 +254,35 @@ void Unit::setPlayer(const std::shared_ptr<Player> &newPlayer)
         return;
     }
 
+    // Who is an enemy changes
+    wake();
+
+    if (oldPlayer) {
+        oldPlayer->removeUnit(this);
+    }
+
+    const int tileX = position().x / Constants::TILE_SIZE;
+    const int tileY = position().y / Constants::TILE_SIZE;
+
     if (oldPlayer && m_lineOfSight) {
-        forEachVisibleTile([&](const int tileX, const int tileY) {
-            oldPlayer->visibility->removeUnitLookingAt(tileX, tileY);
-        });
+        oldPlayer->visibility->removeLineOfSight(tileX, tileY, m_lineOfSight);
     }
 
+    const int oldPlayerId = m_playerId;
     m_player = newPlayer;
     m_playerId = newPlayer->playerId;
     m_renderer->setPlayerColor(newPlayer->playerColor);
     actions.clearActionQueue();
 
+    newPlayer->addUnit(this);
+    EventManager::unitCaptured(this, oldPlayerId, m_playerId);
+
     m_lineOfSight = data()->LineOfSight;
 
     // TODO merf, don't really want this to happen here, maybe use events?
-    forEachVisibleTile([&](const int tileX, const int tileY) {
-        newPlayer->visibility->addUnitLookingAt(tileX, tileY);
-    });
+    newPlayer->visibility->addLineOfSight(tileX, tileY, m_lineOfSight);
 
-    for (const Annex &annex : annexes) {
+    for (const Annex &annex : annexes()) {
         annex.unit->setPlayer(newPlayer);
     }
 }
@@ -205,7 +291,7 @@ ScreenRect Unit::screenRect() const noexcept
 {
     ScreenRect ret = m_renderer->rect();
 
-    for (const Annex &annex : annexes) {
+    for (const Annex &annex : annexes()) {
         ScreenRect annexRect = annex.unit->screenRect();
         if (annexRect.isEmpty()) {
             continue;
@@ -227,7 +313,7 @@ bool Unit::containsCursorPos(const ScreenPos &pos) const noexcept
         return true;
     }
 
-    for (const Annex &annex : annexes) {
+    for (const Annex &annex : annexes()) {
         if (annex.unit->containsCursorPos(pos + annex.offset.toScreen())) {
             return true;
         }
@@ -237,17 +323,26 @@ bool Unit::containsCursorPos(const ScreenPos &pos) const noexcept
 
 void Unit::setCreationProgress(float progress) noexcept
 {
-    if (m_data->Type == genie::Unit::BuildingType) {
-        if (m_creationProgress < m_data->Creatable.TrainTime && progress >= m_data->Creatable.TrainTime) {
+    const bool wasCompleted = m_creationProgress >= data()->Creatable.TrainTime;
+
+    if (data()->Type == genie::Unit::BuildingType) {
+        if (m_creationProgress < data()->Creatable.TrainTime && progress >= data()->Creatable.TrainTime) {
             m_renderer->setSprite(defaultGraphics);
-        } else if (m_creationProgress == m_data->Creatable.TrainTime && progress < m_data->Creatable.TrainTime) {
-            m_renderer->setSprite(m_data->Building.ConstructionGraphicID);
+        } else if (m_creationProgress == data()->Creatable.TrainTime && progress < data()->Creatable.TrainTime) {
+            m_renderer->setSprite(data()->Building.ConstructionGraphicID);
         }
     }
 
-    m_creationProgress = std::min(progress, float(m_data->Creatable.TrainTime));
+    m_creationProgress = std::min(progress, float(data()->Creatable.TrainTime));
 
-    if (m_data->Type == genie::Unit::BuildingType && progress < m_data->Creatable.TrainTime) {
+    if (wasCompleted != (m_creationProgress >= data()->Creatable.TrainTime)) {
+        Player::Ptr owner = m_player.lock();
+        if (owner) {
+            owner->onUnitCompletionChanged(this);
+        }
+    }
+
+    if (data()->Type == genie::Unit::BuildingType && progress < data()->Creatable.TrainTime) {
         m_renderer->setAngle(M_PI_2 + 2. * M_PI * (creationProgress()));
     } else {
         m_renderer->setAngle(m_angle); // blarf
@@ -261,29 +356,27 @@ void Unit::increaseCreationProgress(float progress) noexcept
 
 float Unit::creationProgress() const noexcept
 {
-    if (IS_UNLIKELY(m_data->Creatable.TrainTime == 0)) {
+    if (IS_UNLIKELY(data()->Creatable.TrainTime == 0)) {
         return 1;
     }
 
-    return m_creationProgress / float(m_data->Creatable.TrainTime);
+    return m_creationProgress / float(data()->Creatable.TrainTime);
 }
 
-void Unit::receiveAttack(const genie::unit::AttackOrArmor &attack, const float damageMultiplier) noexcept
+void Unit::receiveAttack(const genie::Unit &attackerData, const Player::Ptr &attacker, const DamageTable::Elevation elevation) noexcept
 {
     if (hitpointsLeft() <= 0) {
         return;
     }
 
     float newDamage = 0;
-    for (const genie::unit::AttackOrArmor &armor : m_data->Combat.Armours) {
-        if (attack.Class != armor.Class) {
-            continue;
-        }
-
-        newDamage += std::max(attack.Amount - armor.Amount, 0);
+    Player::Ptr owner = m_player.lock();
+    if (IS_LIKELY(attacker && owner)) {
+        newDamage = attacker->civilization.damage(attackerData, *data(), owner->civilization.unitDataRevision(), elevation);
+    } else {
+        const float multiplier = elevation == DamageTable::HighGround ? DamageTable::HighGroundMultiplier : 1.f;
+        newDamage = DamageTable::calculateDamage(attackerData, *data(), multiplier);
     }
-    newDamage *= damageMultiplier;
-    newDamage = std::max(newDamage, 1.f);
     m_damageTaken += newDamage;
     onDamageTaken();
 }
@@ -300,6 +393,8 @@ void Unit::takeDamage(const float amount)
 
 void Unit::onDamageTaken()
 {
+    wake();
+
     if (hitpointsLeft() <= 0) {
         kill();
     } else {
@@ -333,10 +428,12 @@ void Unit::onDamageTaken()
 
 void Unit::kill() noexcept
 {
+    wake();
+
     m_damageTaken = data()->HitPoints;
 
     m_renderer->setPlaySounds(true);
-    m_renderer->setSprite(m_data->DyingGraphic);
+    m_renderer->setSprite(data()->DyingGraphic);
 
     if (data()->DyingSound != -1) {
         Player::Ptr owner = m_player.lock();
@@ -348,7 +445,7 @@ void Unit::kill() noexcept
 
 bool Unit::isDying() const noexcept
 {
-    if (m_damageTaken < m_data->HitPoints) {
+    if (m_damageTaken < data()->HitPoints) {
         return false;
     }
 
@@ -358,7 +455,7 @@ bool Unit::isDying() const noexcept
     }
 
     // If it is a gatherable resource, check if there is any left
-    if (m_data->CanBeGathered) {
+    if (data()->CanBeGathered) {
         for (const ResourceEntry resource : resources) {
             if (resource.second > 0) {
                 return false;
@@ -372,7 +469,7 @@ bool Unit::isDying() const noexcept
 
 bool Unit::isDead() const noexcept
 {
-    if (m_damageTaken < m_data->HitPoints) {
+    if (m_damageTaken < data()->HitPoints) {
         return false;
     }
 
@@ -381,7 +478,7 @@ bool Unit::isDead() const noexcept
         return false;
     }
 
-    if (m_data->CanBeGathered) {
+    if (data()->CanBeGathered) {
         for (const ResourceEntry &resource : resources) {
             if (resource.second > 0) {
                 return false;
@@ -399,11 +496,25 @@ Size Unit::selectionSize() const noexcept
 
 void Unit::setMap(const MapPtr &newMap) noexcept
 {
-    for (Annex &annex : annexes) {
+    for (const Annex &annex : annexes()) {
         annex.unit->setMap(newMap);
     }
 
+    // What we block is counted per map, so move it over
+    const bool obstructing = !m_obstructedTiles.isEmpty();
+    if (obstructing) {
+        MapPtr oldMap = m_map.lock();
+        if (oldMap) {
+            oldMap->buildability().removeObstruction(m_obstructedTiles);
+        }
+        m_obstructedTiles = TileRect();
+    }
+
     Entity::setMap(newMap);
+
+    if (obstructing) {
+        updateObstruction();
+    }
 }
 
 void Unit::setPosition(const MapPos &pos, const bool initial)
@@ -412,6 +523,9 @@ void Unit::setPosition(const MapPos &pos, const bool initial)
         return;
     }
 
+    // Get out of the dormant lists before we move
+    wake();
+
     Player::Ptr owner = player().lock();
 
 
@@ -428,17 +542,9 @@ void Unit::setPosition(const MapPos &pos, const bool initial)
         m_lineOfSight = data()->LineOfSight;
     }
 
-    // TODO merf, don't really want this to happen here, maybe use events?
-    std::unordered_set<std::pair<int, int>> tilesHidden;
-    if (switchedTile && !initial && owner) {
-        forEachVisibleTile([&](const int tileX, const int tileY) {
-            tilesHidden.insert({tileX, tileY});
-        });
-    }
-
     Entity::setPosition(pos, initial);
 
-    for (Annex &annex : annexes) {
+    for (const Annex &annex : annexes()) {
         annex.unit->setPosition(pos + annex.offset, initial);
     }
 
@@ -446,29 +552,30 @@ void Unit::setPosition(const MapPos &pos, const bool initial)
         m_unitManager.onCombatantUnitsMoved();
     }
 
+    if (switchedTile || initial) {
+        m_unitManager.onUnitChangedTile(this, newTilePosition);
+    }
+
+    updateObstruction();
+
     if (!owner) {
         WARN << "No player set!";
         return;
     }
 
-    std::unordered_set<std::pair<int, int>> newVisibleTiles;
     if (switchedTile) {
-        // Now we can update it with the current data, we have collected what we saw last time
+        // Now we can update it with the current data, only the tiles that differ are touched
+        const int oldLineOfSight = m_lineOfSight;
         m_lineOfSight = data()->LineOfSight;
-        forEachVisibleTile([&](const int tileX, const int tileY) {
-            const std::pair<int, int> tile(tileX, tileY);
-            if (tilesHidden.count(tile)) {
-                tilesHidden.erase(tile);
-            } else {
-                newVisibleTiles.insert(tile);
-            }
-        });
 
-        for (const std::pair<int, int> &tile : tilesHidden) {
-            owner->visibility->removeUnitLookingAt(tile.first, tile.second);
-        }
-        for (const std::pair<int, int> &tile : newVisibleTiles) {
-            owner->visibility->addUnitLookingAt(tile.first, tile.second);
+        // TODO merf, don't really want this to happen here, maybe use events?
+        if (initial) {
+            owner->visibility->addLineOfSight(newTilePosition.x, newTilePosition.y, m_lineOfSight);
+        } else {
+            owner->visibility->moveLineOfSight(
+                        oldTilePosition.x, oldTilePosition.y, oldLineOfSight,
+                        newTilePosition.x, newTilePosition.y, m_lineOfSight
+                    );
         }
     }
 }
@@ -480,11 +587,22 @@ int Unit::foundationTerrain() const
 
 void Unit::setUnitData(const genie::Unit &data_) noexcept
 {
-    m_data = &data_;
+    Player::Ptr owner = m_player.lock();
+    REQUIRE(owner, return);
+
+    const bool typeChanged = data() && data()->ID != data_.ID;
+    m_dataSlot = owner->civilization.unitDataSlot(data_.ID);
+
+    if (typeChanged) {
+        owner->onUnitTypeChanged(this);
+
+        // Might be a different size now
+        updateObstruction();
+    }
 
-    defaultGraphics = AssetManager::Inst()->getGraphic(m_data->StandingGraphic.first);
-    if (m_data->Moving.WalkingGraphic >= 0) {
-        m_movingGraphics = AssetManager::Inst()->getGraphic(m_data->Moving.WalkingGraphic);
+    defaultGraphics = AssetManager::Inst()->getGraphic(data()->StandingGraphic.first);
+    if (data()->Moving.WalkingGraphic >= 0) {
+        m_movingGraphics = AssetManager::Inst()->getGraphic(data()->Moving.WalkingGraphic);
     }
 
     if (!defaultGraphics) {
@@ -492,19 +610,58 @@ void Unit::setUnitData(const genie::Unit &data_) noexcept
     }
 
     m_renderer->setSprite(defaultGraphics);
+}
 
-    actions.m_autoTargetTasks.tasks.clear();
-    for (const Task &task : actions.availableActions()) {
-        if (!task.data->EnableTargeting) {
-            continue;
+void Unit::updateObstruction() noexcept
+{
+    MapPtr map = m_map.lock();
+    if (!map) {
+        return;
+    }
+
+    TileRect tiles;
+    if (BuildabilityMap::isObstruction(*data())) {
+        tiles = BuildabilityMap::obstructionTiles(*data(), position());
+    }
+
+    if (tiles == m_obstructedTiles) {
+        return;
+    }
+
+    map->buildability().removeObstruction(m_obstructedTiles);
+    map->buildability().addObstruction(tiles);
+    m_obstructedTiles = tiles;
+}
+
+void Unit::reregisterObstruction() noexcept
+{
+    for (const Annex &annex : annexes()) {
+        annex.unit->reregisterObstruction();
+    }
+
+    m_obstructedTiles = TileRect();
+    updateObstruction();
+}
+
+size_t Unit::heapMemoryUsage() const noexcept
+{
+    size_t bytes = m_renderer->memoryUsage();
+    bytes += actions.m_actionQueue.capacity() * sizeof(ActionPtr);
+    bytes += resources.heapBytes();
+
+    if (m_rare) {
+        bytes += sizeof(RareState) + m_rare->annexes.capacity() * sizeof(Annex);
+        for (const Annex &annex : m_rare->annexes) {
+            bytes += sizeof(Unit) + annex.unit->heapMemoryUsage();
         }
-        actions.m_autoTargetTasks.add(task);
     }
+
+    return bytes;
 }
 
 bool Unit::canMatchGenieUnitID(const int otherID) const
 {
-    const int myID = m_data->ID;
+    const int myID = data()->ID;
     if (otherID == myID) {
         return true;
     }
@@ -512,7 +669,7 @@ bool Unit::canMatchGenieUnitID(const int otherID) const
     Player::Ptr owner = m_player.lock();
     REQUIRE(owner, return false);
 
-    for (const genie::Unit *swappable : owner->civilization.swappableUnits(m_data->Action.TaskSwapGroup)) {
+    for (const genie::Unit *swappable : owner->civilization.swappableUnits(data()->Action.TaskSwapGroup)) {
         if (swappable->ID == otherID) {
             return true;
         }
@@ -531,7 +688,7 @@ MapRect Unit::mapRect() const noexcept
     // I don't take into account height (as in Z), idk lol
     MapRect ret(position() / Constants::TILE_SIZE, tileSize());
 
-    for (const Annex &annex : annexes) {
+    for (const Annex &annex : annexes()) {
         MapRect annexRect = annex.unit->mapRect();
         if (annexRect.isEmpty()) {
             continue;
@@ -566,20 +723,6 @@ float Unit::tallness() const noexcept
     return data()->Size.z * Constants::TILE_SIZE;
 }
 
-void Unit::forEachVisibleTile(const std::function<void (const int, const int)> &action)
-{
-    const int los = m_lineOfSight;
-    const int tileXOffset = position().x / Constants::TILE_SIZE;
-    const int tileYOffset = position().y / Constants::TILE_SIZE;
-    for (int y=-los; y<= los; y++) {
-        for (int x=-los; x<= los; x++) {
-            if (x*x + y*y < los*los) {
-                action(x + tileXOffset, y + tileYOffset);
-            }
-        }
-    }
-}
-
 float Unit::hitpointsLeft() const noexcept
 {
     return std::max((data()->HitPoints * creationProgress() - m_damageTaken), 0.f);
@@ -598,7 +741,7 @@ float Unit::healthLeft() const noexcept
 void Unit::updateGraphic()
 {
     if (hitpointsLeft() <= 0 && !isDying()) {
-        m_renderer->setSprite(m_data->DyingGraphic);
+        m_renderer->setSprite(data()->DyingGraphic);
         return;
     }
 
@@ -617,7 +760,7 @@ void Unit::updateGraphic()
 
     switch (actions.m_currentAction->type) {
     case IAction::Type::Move:
-        for (const genie::Task &task : DataManager::Inst().getTasks(m_data->ID)) {
+        for (const genie::Task &task : DataManager::Inst().getTasks(data()->ID)) {
             if (task.ActionType != genie::ActionType::GatherRebuild && task.ActionType != genie::ActionType::Hunt) {
                 continue;
             }
@@ -672,78 +815,9 @@ void Unit::updateGraphic()
     }
 
     if (!graphic || !graphic->isValid()) {
-        DBG << "No graphic" << actions.m_currentAction->type << debugName;
+        DBG << "No graphic" << actions.m_currentAction->type << debugName();
         graphic = defaultGraphics;
     }
 
     m_renderer->setSprite(graphic);
 }
-
-DopplegangerEntity::Ptr DopplegangerEntity::fromEntity(const std::shared_ptr<Entity> &entity)
-{
-    if (!entity) {
-        return nullptr;
-    }
-    if (!entity->isDoppleganger()) {
-        return nullptr;
-    }
-    return std::static_pointer_cast<DopplegangerEntity>(entity);
-}
-
-DopplegangerEntity::DopplegangerEntity(const Unit::Ptr &originalUnit) :
-    StaticEntity(Type::Doppleganger, "Doppleganger for " + originalUnit->debugName, Size(originalUnit->data()->Size)),
-    ownerID(originalUnit->playerId()),
-    originalUnitData(originalUnit->data()),
-    m_unitManager(originalUnit->unitManager()),
-    m_originalUnit(originalUnit)
-{
-    const genie::Unit *data = originalUnit->data();
-    if (data->CreateDoppelgangerOnDeath == genie::Unit::DoppelgangerWhenDying) {
-        m_dyingGraphic = data->DyingGraphic;
-    }
-    m_deadGraphic = originalUnit->data()->Building.DestructionRubbleGraphicID;
-
-    m_renderer = originalUnit->renderer().copy();
-}
-
-bool DopplegangerEntity::update(Time /*time*/) noexcept
-{
-    if (m_isRubble || !isVisible) {
-        return false;
-    }
-
-    Unit::Ptr originalUnit = m_originalUnit.lock();
-    if (!originalUnit || (originalUnit->isDead())) {
-        if (m_deadGraphic != -1) {
-            m_renderer->setSprite(m_deadGraphic);
-            m_isRubble = true;
-        }
-        return true;
-    }
-
-    return false;
-}
-
-bool DopplegangerEntity::shouldBeRemoved() const noexcept
-{
-    // We are rubble, we stay forever
-    if (m_isRubble) {
-        return false;
-    }
-
-    Unit::Ptr originalUnit = m_originalUnit.lock();
-    if (!originalUnit) {
-        // shouldn't really happen
-        if (m_deadGraphic == -1) {
-            return true;
-        }
-        return false;
-    }
-
-    if (originalUnit->isVisible && !originalUnit->isDead()) {
-        return true;
-    }
-
-    return false;
-}
-
@@ -27,6 +27,8 @@
 #include <unordered_set>
 #include <vector>
 
+#include "BuildabilityMap.h"
+#include "DamageTable.h"
 #include "Entity.h"
 #include "UnitActionHandler.h"
 #include "core/Constants.h"
@@ -136,12 +138,18 @@ struct Unit : public Entity
     } stance = Stance::Aggressive;
 
     UnitActionHandler actions;
-    std::vector<Annex> annexes;
-    std::weak_ptr<Building> garrisonedIn;
-    ResourceMap resources;
+    UnitResourceMap resources;
     int activeMissiles = 0;
     Time lastAttackTime = 0;
 
+    /// Where we are counted in our owner's per-type lists, only touched by Player
+    struct OwnerIndex {
+        int typeId = -1;
+        int unitClass = -1;
+        int position = -1;
+        bool underConstruction = false;
+    } ownerIndex;
+
     // No copy, no default constructor
     Unit() = delete;
     Unit(const Unit &unit) = delete;
@@ -209,13 +217,35 @@ struct Unit : public Entity
     // Called every tick
     bool update(Time time) noexcept override;
 
+    /// Things stacked on top of a building (e. g. the top of a town center), hardly anything has them
+    const std::vector<Annex> &annexes() const noexcept { return m_rare ? m_rare->annexes : s_noAnnexes; }
+    void setAnnexes(std::vector<Annex> &&newAnnexes);
+
+    std::shared_ptr<Building> garrisonedIn() const noexcept { return m_rare ? m_rare->garrisonedIn.lock() : nullptr; }
+    void setGarrisonedIn(const std::shared_ptr<Building> &building);
+
     // Owners and stuff
     int playerId() const { return m_playerId; }
     const std::weak_ptr<Player> &player() const { return m_player; }
     void setPlayer(const std::shared_ptr<Player> &newPlayer);
 
+    // What we've added to the owner's visibility, in tiles
+    int lineOfSight() const noexcept { return m_lineOfSight; }
+
     UnitManager &unitManager() const noexcept { return m_unitManager; }
 
+    ////////////////////////////////
+    // Dormancy, for idle units nobody is looking at
+
+    /// Not updated every tick, until something wakes it up
+    bool isDormant() const noexcept { return m_dormant; }
+
+    /// Put it back in the normal update loop, if it was dormant
+    void wake() noexcept;
+
+    /// If there is nothing going on with this unit that needs to be updated every tick
+    virtual bool canSleep() const noexcept;
+
     ///////////////////////////////
     /// Hitpoints and similar stuff
 
@@ -234,8 +264,8 @@ struct Unit : public Entity
     /// Percentage of health left
     float healthLeft() const noexcept;
 
-    /// Increase received damage taking the kind of attack and damage multiplier into account
-    void receiveAttack(const genie::unit::AttackOrArmor &attack, const float damageMultiplier) noexcept;
+    /// Increase received damage by what the attacking unit type does to our type, attacker can be null
+    void receiveAttack(const genie::Unit &attackerData, const std::shared_ptr<Player> &attacker, const DamageTable::Elevation elevation) noexcept;
 
     /// Take damage, or heal if amount is negative, without any modifiers
     void takeDamage(const float amount); // negative == heal
@@ -256,27 +286,32 @@ struct Unit : public Entity
     ////////////////////////////////
     /// Unit data stuff
 
-    /// Set the base genie unit data
+    /// Set the base genie unit data, we read it through our owner's civilization so we see any tech effects
     void setUnitData(const genie::Unit &data_) noexcept;
 
     /// Retrieve the current genie unit data
     const genie::Unit *data() const {
-        return m_data;
+        return *m_dataSlot;
     }
 
+    /// Approximately what this unit has allocated outside of the object itself
+    size_t heapMemoryUsage() const noexcept;
+
     // Checking task swap IDs
     bool canMatchGenieUnitID(const int otherID) const;
     // TODO: need basically the same for all attributes
 
 protected:
     friend struct UnitActionHandler;
-
-    void forEachVisibleTile(const std::function<void(const int, const int)> &action);
+    friend class UnitManager;
 
     Unit(const genie::Unit &data_, const std::shared_ptr<Player> &player_, UnitManager &unitManager, const Type m_type);
     void updateGraphic();
 
-    const genie::Unit *m_data = nullptr;
+    /// Called by the unit manager when it goes back into the update loop
+    virtual void onWoken(const Time time) noexcept;
+
+    const genie::Unit *const *m_dataSlot = &s_noData;
 
     // Because we use it often
     SpritePtr m_movingGraphics;
@@ -294,36 +329,36 @@ protected:
     // Need to store it since it can change
     int m_lineOfSight = 0;
 
-private:
-    void onDamageTaken();
-};
-
-struct DopplegangerEntity : public StaticEntity
-{
-    const int ownerID;
-    const genie::Unit *const originalUnitData = nullptr;
-
-    typedef std::shared_ptr<DopplegangerEntity> Ptr;
-    static Ptr fromEntity(const std::shared_ptr<Entity> &entity);
+    // Dormancy state, managed by the unit manager
+    bool m_dormant = false;
+    Time m_nextSleepCheck = 0;
+    struct {
+        int firstX = 0, firstY = 0;
+        int lastX = -1, lastY = -1;
+    } m_watchedCells; // where we are registered to be woken by enemies walking by
 
-    DopplegangerEntity(const Unit::Ptr &originalUnit);
+    // The tiles we keep buildings from being placed on, if any
+    TileRect m_obstructedTiles;
 
-    bool update(Time time) noexcept override;
-    bool shouldBeRemoved() const noexcept override;
+private:
+    void onDamageTaken();
+    void updateObstruction() noexcept;
 
+    /// When the map has forgotten what we block
+    void reregisterObstruction() noexcept;
 
-private:
-    void onOriginalGone();
-    UnitManager &m_unitManager;
+    /// Stuff most units never use, so only allocated for the ones that need it
+    struct RareState {
+        std::vector<Annex> annexes;
+        std::weak_ptr<Building> garrisonedIn;
+    };
+    RareState &rareState();
+    std::unique_ptr<RareState> m_rare;
 
-    bool m_wasVisible = true;
-    bool m_isRubble = false;
-    std::weak_ptr<Unit> m_originalUnit;
-    int m_deadGraphic = -1;
-    int m_dyingGraphic = -1; // TODO: haven't found a unit where this is used
+    static const std::vector<Annex> s_noAnnexes;
+    static const genie::Unit *const s_noData;
 };
 
-
 inline LogPrinter operator <<(LogPrinter os, const Unit::Stance &stance)
 {
     const char *separator = os.separator;
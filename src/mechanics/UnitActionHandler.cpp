@@ -8,54 +8,150 @@
 
 #include "resource/DataManager.h"
 
+#include <algorithm>
+
 UnitActionHandler::UnitActionHandler(Unit *unit) :
     m_unit(unit)
 {
 
 }
 
-TaskSet UnitActionHandler::availableActions() const noexcept
+namespace {
+
+bool targetDiplomacyMatches(const genie::Task *action, Player &ownPlayer, const Unit &target)
 {
-    const genie::Unit *data = m_unit->m_data;
+    switch (action->TargetDiplomacy) {
+    case genie::Task::TargetSelf:
+        return target.playerId() == ownPlayer.playerId;
+    case genie::Task::TargetNeutralsEnemies: // TODO: neutrals
+        return target.playerId() != ownPlayer.playerId;
+    case genie::Task::TargetGaiaOnly:
+        return target.playerId() == UnitManager::GaiaID;
+    case genie::Task::TargetSelfAllyGaia:
+        return target.playerId() == ownPlayer.playerId || target.playerId() == UnitManager::GaiaID || ownPlayer.isAllied(target.playerId());
+    case genie::Task::TargetGaiaNeutralEnemies:
+    case genie::Task::TargetOthers:
+        return target.playerId() != ownPlayer.playerId && !ownPlayer.isAllied(target.playerId());
+    case genie::Task::TargetAnyDiplo:
+    case genie::Task::TargetAnyDiplo2:
+    default:
+        return true;
+    }
+}
 
-    TaskSet tasks;
-    for (const genie::Task &task : DataManager::Inst().getTasks(data->ID)) {
+const std::vector<uint16_t> &indicesFor(const std::unordered_map<int, std::vector<uint16_t>> &map, const int key)
+{
+    std::unordered_map<int, std::vector<uint16_t>>::const_iterator it = map.find(key);
+    if (it == map.end()) {
+        static const std::vector<uint16_t> nullVector;
+        return nullVector;
+    }
+    return it->second;
+}
+
+} // namespace
+
+void TaskTargetLookup::build(const TaskSet &tasks)
+{
+    for (size_t i=0; i<tasks.size(); i++) {
+        const genie::Task *action = tasks.tasks[i].data;
+
+        if (action->ActionType == genie::ActionType::Garrison) {
+            continue;
+        }
+
+        if (action->ActionType == genie::ActionType::Build) {
+            buildTasks.push_back(i);
+        }
+
+        if (action->UnitID != -1) {
+            byUnitId[action->UnitID].push_back(i);
+        }
+
+        if (action->ClassID != -1) {
+            byClass[action->ClassID].push_back(i);
+        }
+    }
+
+    for (size_t i=0; i<tasks.size(); i++) {
+        const genie::Task *action = tasks.tasks[i].data;
+        if (action->ActionType != genie::ActionType::Combat) {
+            continue;
+        }
+        if (action->TargetDiplomacy != genie::Task::TargetGaiaNeutralEnemies && action->TargetDiplomacy != genie::Task::TargetNeutralsEnemies) {
+            continue;
+        }
+        genericCombatTasks.push_back(i);
+    }
+}
+
+UnitTaskTable::Ptr UnitTaskTable::create(const genie::Unit &data, const Civilization &civilization)
+{
+    UnitTaskTable::Ptr table = std::make_shared<UnitTaskTable>();
+    table->unitId = data.ID;
+
+    for (const genie::Task &task : DataManager::Inst().getTasks(data.ID)) {
 
         // TODO: some units (archery range) have a combat task, but no attacks
         // Could be if it needs garrisoned units?
-        if (task.ActionType == genie::ActionType::Combat && data->Combat.Attacks.empty()) {
+        if (task.ActionType == genie::ActionType::Combat && data.Combat.Attacks.empty()) {
             continue;
         }
 
-        tasks.add(Task(&task, data->ID));
+        table->tasks.add(Task(&task, data.ID));
+    }
+
+    if (data.Action.TaskSwapGroup) {
+        for (const genie::Unit *swappable : civilization.swappableUnits(data.Action.TaskSwapGroup)) {
+            for (const genie::Task &task : DataManager::Inst().getTasks(swappable->ID)) {
+                if (task.ActionType == genie::ActionType::Combat && data.Combat.Attacks.empty()) {
+                    continue;
+                }
+                table->tasks.add(Task(&task, swappable->ID));
+            }
+        }
+    }
+
+    for (const Task &task : table->tasks) {
+        if (!task.data->EnableTargeting) {
+            continue;
+        }
+        table->autoTargetTasks.add(task);
     }
 
-    if (!data->Action.TaskSwapGroup) {
-        return tasks;
+    table->lookup.build(table->tasks);
+    table->autoTargetLookup.build(table->autoTargetTasks);
+
+    return table;
+}
+
+const UnitTaskTable &UnitActionHandler::taskTable() const noexcept
+{
+    const genie::Unit *data = m_unit->data();
+
+    if (m_taskTable && !m_taskTable->isStale && m_taskTable->unitId == data->ID) {
+        return *m_taskTable;
     }
 
     Player::Ptr owner = m_unit->player().lock();
     if (!owner) {
         WARN << "Lost our player";
-        return {};
-    }
-
-    for (const genie::Unit *swappable : owner->civilization.swappableUnits(data->Action.TaskSwapGroup)) {
-        for (const genie::Task &task : DataManager::Inst().getTasks(swappable->ID)) {
-            if (task.ActionType == genie::ActionType::Combat && data->Combat.Attacks.empty()) {
-                continue;
-            }
-            tasks.add(Task(&task, swappable->ID));
-        }
+        static const UnitTaskTable nullTable;
+        return nullTable;
     }
 
-    return tasks;
+    m_taskTable = owner->civilization.taskTable(data->ID);
+    return *m_taskTable;
+}
 
+const TaskSet &UnitActionHandler::availableActions() const noexcept
+{
+    return taskTable().tasks;
 }
 
 Task UnitActionHandler::findAnyTask(const genie::ActionType &type, int targetUnit) noexcept
 {
-    TaskSet available = availableActions();
+    const TaskSet &available = availableActions();
     for (const Task &task : available) {
         if (task.data->ActionType == type && task.data->UnitID == targetUnit) {
             return task;
@@ -69,81 +165,55 @@ Task UnitActionHandler::findAnyTask(const genie::ActionType &type, int targetUni
     }
 
     return Task();
-
 }
 
 Task UnitActionHandler::findTaskWithTarget(const std::shared_ptr<Unit> &target)
 {
-    return findMatchingTask(m_unit->player().lock(), target, availableActions());
+    const UnitTaskTable &table = taskTable();
+    return findMatchingTask(m_unit->player().lock(), target, table.tasks, table.lookup);
 }
 
-Task UnitActionHandler::findMatchingTask(const std::shared_ptr<Player> &ownPlayer, const std::shared_ptr<Unit> &target, const TaskSet &potentials)
+Task UnitActionHandler::findMatchingTask(const std::shared_ptr<Player> &ownPlayer, const std::shared_ptr<Unit> &target, const TaskSet &potentials, const TaskTargetLookup &lookup)
 {
     REQUIRE(ownPlayer, return Task());
 
-    Task matched;
-    for (const Task &task : potentials) {
-        const genie::Task *action = task.data;
-
-        switch (action->TargetDiplomacy) {
-        case genie::Task::TargetSelf:
-            if (target->playerId() != ownPlayer->playerId) {
-                continue;
-            }
-            break;
-        case genie::Task::TargetNeutralsEnemies: // TODO: neutrals
-            if (target->playerId() == ownPlayer->playerId) {
-                continue;
-            }
-            break;
-
-        case genie::Task::TargetGaiaOnly:
-            if (target->playerId() != UnitManager::GaiaID) {
-                continue;
+    // We want the first task (in the order of the tasks) that applies to the target.
+    // Each list is already sorted, so just keep the lowest match from any of them.
+    size_t first = potentials.tasks.size();
+    const auto findFirst = [&](const std::vector<uint16_t> &indices) {
+        for (const uint16_t index : indices) {
+            if (index >= first) {
+                return;
             }
-            break;
-        case genie::Task::TargetSelfAllyGaia:
-            if (target->playerId() != ownPlayer->playerId && target->playerId() != UnitManager::GaiaID && !ownPlayer->isAllied(target->playerId())) {
-                continue;
-            }
-            break;
-        case genie::Task::TargetGaiaNeutralEnemies:
-        case genie::Task::TargetOthers:
-            if (target->playerId() == ownPlayer->playerId) {
-                continue;
+            if (targetDiplomacyMatches(potentials.tasks[index].data, *ownPlayer, *target)) {
+                first = index;
+                return;
             }
-            if (ownPlayer->isAllied(target->playerId())) {
-                continue;
-            }
-            break;
-        case genie::Task::TargetAnyDiplo:
-        case genie::Task::TargetAnyDiplo2:
-        default:
-            break;
         }
+    };
 
-        if (action->ActionType == genie::ActionType::Garrison) {
-            continue;
-        }
-
-        if (target->creationProgress() < 1) {
-            if (action->ActionType == genie::ActionType::Build) {
-                matched = task;
-                break;
+    if (target->creationProgress() < 1) {
+        findFirst(lookup.buildTasks);
+    } else {
+        const genie::Unit *targetData = target->data();
+        findFirst(indicesFor(lookup.byUnitId, targetData->ID));
+
+        // Same as canMatchGenieUnitID()
+        Player::Ptr targetOwner = target->player().lock();
+        if (targetOwner && targetData->Action.TaskSwapGroup) {
+            for (const genie::Unit *swappable : targetOwner->civilization.swappableUnits(targetData->Action.TaskSwapGroup)) {
+                if (swappable->ID != targetData->ID) {
+                    findFirst(indicesFor(lookup.byUnitId, swappable->ID));
+                }
             }
-
-            continue;
         }
 
-        if (target->canMatchGenieUnitID(action->UnitID)) {
-            matched = task;
-            break;
-        }
+        findFirst(indicesFor(lookup.byClass, targetData->Class));
+    }
 
-        if (action->ClassID == target->data()->Class) {
-            matched = task;
-            break;
-        }
+    Task matched;
+    if (first < potentials.tasks.size()) {
+        matched = potentials.tasks[first];
     }
 
     if (matched.isValid()) {
@@ -152,27 +222,15 @@ Task UnitActionHandler::findMatchingTask(const std::shared_ptr<Player> &ownPlaye
     }
 
     // Try more generic targeting
-    for (const Task &task : potentials) {
-        const genie::Task *action = task.data;
-        if (action->ActionType != genie::ActionType::Combat) {
-            continue;
-        }
-        if (action->TargetDiplomacy != genie::Task::TargetGaiaNeutralEnemies && action->TargetDiplomacy != genie::Task::TargetNeutralsEnemies) {
-            continue;
-        }
-        if (ownPlayer->playerId == target->playerId()) {
-            continue;
-        }
-
-        if (target->data()->Type < genie::Unit::CombatantType) {
-            continue;
-        }
-
-        matched = task;
-        break;
+    if (ownPlayer->playerId == target->playerId()) {
+        return matched;
+    }
+    if (target->data()->Type < genie::Unit::CombatantType) {
+        return matched;
     }
 
-    if (matched.isValid()) {
+    if (!lookup.genericCombatTasks.empty()) {
+        matched = potentials.tasks[lookup.genericCombatTasks.front()];
         matched.target = target;
     }
 
@@ -182,7 +240,12 @@ Task UnitActionHandler::findMatchingTask(const std::shared_ptr<Player> &ownPlaye
 
 Task UnitActionHandler::checkForAutoTargets()
 {
-    if (m_unit->stance != Unit::Stance::Aggressive || m_autoTargetTasks.size() == 0 || m_currentAction) {
+    if (m_unit->stance != Unit::Stance::Aggressive || m_currentAction) {
+        return {};
+    }
+
+    const UnitTaskTable &table = taskTable();
+    if (table.autoTargetTasks.isEmpty()) {
         return {};
     }
 
@@ -192,7 +255,7 @@ Task UnitActionHandler::checkForAutoTargets()
         return {};
     }
 
-    const genie::Unit *data = m_unit->m_data;
+    const genie::Unit *data = m_unit->data();
 
     const int los = data->LineOfSight;
 
@@ -230,7 +293,7 @@ Task UnitActionHandler::checkForAutoTargets()
                     continue;
                 }
 
-                const Task potentialTask = findMatchingTask(m_unit->player().lock(), other, m_autoTargetTasks);
+                const Task potentialTask = findMatchingTask(m_unit->player().lock(), other, table.autoTargetTasks, table.autoTargetLookup);
                 if (!potentialTask.data) {
                     continue;
                 }
@@ -257,7 +320,7 @@ Task UnitActionHandler::checkForAutoTargets()
         return {};
     }
 
-    DBG << "found auto task" << newTask.data->actionTypeName() << "for" << m_unit->debugName;
+    DBG << "found auto task" << newTask.data->actionTypeName() << "for" << m_unit->debugName();
     newTask.target = target;
     return newTask;
 }
@@ -268,14 +331,14 @@ void UnitActionHandler::removeAction(const ActionPtr &action)
         if (!m_actionQueue.empty()) {
             DBG << "changing action to queued one" << m_actionQueue.front()->type;
             setCurrentAction(m_actionQueue.front());
-            m_actionQueue.pop_front();
+            m_actionQueue.erase(m_actionQueue.begin());
         } else {
             setCurrentAction(nullptr);
             DBG << "no actions queued";
         }
     } else {
         // fuck stl
-        std::deque<ActionPtr>::iterator it = std::find(m_actionQueue.begin(), m_actionQueue.end(), action);
+        std::vector<ActionPtr>::iterator it = std::find(m_actionQueue.begin(), m_actionQueue.end(), action);
 
         if (it != std::end(m_actionQueue)) {
             m_actionQueue.erase(it);
@@ -292,7 +355,7 @@ void UnitActionHandler::clearActionQueue() noexcept
 
 int UnitActionHandler::taskGraphicId(const genie::ActionType taskType, const IAction::UnitState state)
 {
-    const genie::Unit *data = m_unit->m_data;
+    const genie::Unit *data = m_unit->data();
 
     for (const genie::Task &task : DataManager::Inst().getTasks(data->ID)) {
         if (task.ActionType != taskType/* &&
@@ -333,7 +396,8 @@ int UnitActionHandler::taskGraphicId(const genie::ActionType taskType, const IAc
 
 void UnitActionHandler::prependAction(const ActionPtr &action) noexcept
 {
-    m_actionQueue.push_front(std::move(m_currentAction));
+    m_unit->wake();
+    m_actionQueue.insert(m_actionQueue.begin(), std::move(m_currentAction));
     m_currentAction = action;
     m_unit->updateGraphic();
 }
@@ -349,6 +413,10 @@ void UnitActionHandler::queueAction(const ActionPtr &action) noexcept
 
 void UnitActionHandler::setCurrentAction(const ActionPtr &action) noexcept
 {
+    if (action) {
+        m_unit->wake();
+    }
+
     m_currentAction = action;
 
 
@@ -358,7 +426,7 @@ void UnitActionHandler::setCurrentAction(const ActionPtr &action) noexcept
         return;
     }
 
-    if (action && action->requiredUnitID != -1 && action->requiredUnitID != m_unit->m_data->ID) {
+    if (action && action->requiredUnitID != -1 && action->requiredUnitID != m_unit->data()->ID) {
         m_unit->setUnitData(owner->civilization.unitData(action->requiredUnitID));
     }
 
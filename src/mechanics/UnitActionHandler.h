@@ -4,10 +4,16 @@
 
 #include <memory>
 #include <utility>
-#include <deque>
+#include <unordered_map>
+#include <vector>
 
 using ActionPtr = std::shared_ptr<IAction>;
 struct Player;
+class Civilization;
+
+namespace genie {
+class Unit;
+}
 
 struct TaskSet {
     using iterator = std::vector<Task>::iterator;
@@ -54,18 +60,47 @@ struct TaskSet {
     std::vector<Task> tasks;
 };
 
+/// So we don't have to test every task to find the one that applies to a target.
+/// Indices into the TaskSet it was built from, in the same order as the tasks.
+struct TaskTargetLookup
+{
+    void build(const TaskSet &tasks);
+
+    std::unordered_map<int, std::vector<uint16_t>> byUnitId;
+    std::unordered_map<int, std::vector<uint16_t>> byClass;
+    std::vector<uint16_t> buildTasks; // when the target isn't finished
+    std::vector<uint16_t> genericCombatTasks; // fallback for attacking anything
+};
+
+/// The tasks for a unit type, only computed once per civilization and unit type.
+/// The civilization marks it as stale when a tech effect modifies the unit.
+struct UnitTaskTable
+{
+    typedef std::shared_ptr<UnitTaskTable> Ptr;
+    static Ptr create(const genie::Unit &data, const Civilization &civilization);
+
+    int unitId = -1;
+    bool isStale = false;
+
+    TaskSet tasks;
+    TaskTargetLookup lookup;
+
+    TaskSet autoTargetTasks; // the ones with EnableTargeting
+    TaskTargetLookup autoTargetLookup;
+};
+
 
 struct UnitActionHandler
 {
     UnitActionHandler(Unit *unit);
 
-    TaskSet availableActions() const noexcept;
+    const TaskSet &availableActions() const noexcept;
 
     Task findAnyTask(const genie::ActionType &type, int targetUnit) noexcept;
     Task findTaskWithTarget(const std::shared_ptr<Unit> &target);
-    static Task findMatchingTask(const std::shared_ptr<Player> &ownPlayer, const std::shared_ptr<Unit> &target, const TaskSet &potentials);
+    static Task findMatchingTask(const std::shared_ptr<Player> &ownPlayer, const std::shared_ptr<Unit> &target, const TaskSet &potentials, const TaskTargetLookup &lookup);
 
-    bool hasAutoTargets() const noexcept { return m_autoTargetTasks.size() > 0; }
+    bool hasAutoTargets() const noexcept { return taskTable().autoTargetTasks.size() > 0; }
     Task checkForAutoTargets() ;
 
     int taskGraphicId(const genie::ActionType taskType, const IAction::UnitState state);
@@ -79,11 +114,17 @@ struct UnitActionHandler
     const ActionPtr &currentAction() const noexcept { return m_currentAction; }
 
     ActionPtr m_currentAction;
-    std::deque<ActionPtr> m_actionQueue;
 
-    TaskSet m_autoTargetTasks;
+    // Almost always empty or just a couple, and a deque allocates a big block up front for every unit
+    std::vector<ActionPtr> m_actionQueue;
+
     bool autoConvert = false;
 
 private:
+    const UnitTaskTable &taskTable() const noexcept;
+
     Unit *m_unit;
+
+    // Owned by the civilization, but keep it alive while someone is using it
+    mutable UnitTaskTable::Ptr m_taskTable;
 };
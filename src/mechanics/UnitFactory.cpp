@@ -102,7 +102,7 @@ void UnitFactory::handleDefaultAction(const Unit::Ptr &unit, const Task &task)
         unit->actions.autoConvert =true;
         break;
     default:
-        WARN << "unhandled default action" << task.data->actionTypeName() << "for" << unit->debugName;
+        WARN << "unhandled default action" << task.data->actionTypeName() << "for" << unit->debugName();
     }
 
 }
@@ -202,7 +202,7 @@ Unit::Ptr UnitFactory::createUnit(const int ID, const Player::Ptr &owner, UnitMa
     }
 
     if (!unit->renderer().sprite()) {
-        WARN << "Failed to load graphics for" << unit->debugName;
+        WARN << "Failed to load graphics for" << unit->debugName();
         return nullptr;
     }
 
@@ -221,13 +221,15 @@ Unit::Ptr UnitFactory::createUnit(const int ID, const Player::Ptr &owner, UnitMa
     }
 
     if (gunit.Type >= genie::Unit::BuildingType) {
+        std::vector<Unit::Annex> annexes;
+
         if (gunit.Building.StackUnitID >= 0) {
             const genie::Unit &stackData = owner->civilization.unitData(gunit.Building.StackUnitID);
             owner->applyResearch(gunit.Building.TechID);
 
             Unit::Annex annex;
             annex.unit = std::make_shared<Unit>(stackData, owner, unitManager);
-            unit->annexes.push_back(annex);
+            annexes.push_back(annex);
         }
 
         for (const genie::unit::BuildingAnnex &annexData : gunit.Building.Annexes) {
@@ -240,11 +242,12 @@ Unit::Ptr UnitFactory::createUnit(const int ID, const Player::Ptr &owner, UnitMa
             Unit::Annex annex;
             annex.offset = MapPos(annexData.Misplacement.first * -48, annexData.Misplacement.second * -48);
             annex.unit = std::make_shared<Unit>(stackGUnit, owner, unitManager);
-            unit->annexes.push_back(annex);
+            annexes.push_back(annex);
         }
 
-        if (!unit->annexes.empty()) {
-            std::reverse(unit->annexes.begin(), unit->annexes.end());
+        if (!annexes.empty()) {
+            std::reverse(annexes.begin(), annexes.end());
+            unit->setAnnexes(std::move(annexes));
         }
     }
 
@@ -310,54 +313,3 @@ DecayingEntity::Ptr UnitFactory::createCorpseFor(const Unit::Ptr &unit)
 
 }
 
-std::shared_ptr<DopplegangerEntity> UnitFactory::createDopplegangerFor(const std::shared_ptr<Unit> &unit)
-{
-    REQUIRE(unit, return nullptr);
-
-    DopplegangerEntity::Ptr doppleganger = std::make_shared<DopplegangerEntity>(unit);
-    DBG << "Created doppleganger";
-    doppleganger->setMap(unit->map());
-    doppleganger->setPosition(unit->position());
-
-    return doppleganger;
-
-}
-
-std::shared_ptr<DecayingEntity> UnitFactory::createCorpseFor(const std::shared_ptr<DopplegangerEntity> &doppleganger)
-{
-    REQUIRE(doppleganger, return nullptr);
-    REQUIRE(doppleganger->originalUnitData, return nullptr);
-
-    const genie::Unit *data = doppleganger->originalUnitData;
-    if (data->DeadUnitID == -1) {
-        return nullptr;
-    }
-
-    float decayTime = data->ResourceDecay * data->ResourceCapacity;
-
-    for (const genie::Unit::ResourceStorage &r : data->ResourceStorages) {
-        if (r.Type == int(genie::ResourceType::CorpseDecayTime)) {
-            decayTime = r.Amount;
-            break;
-        }
-    }
-
-    // I don't think this is really correct, but it works better
-    if (data->ResourceDecay == -1 || (data->ResourceDecay != 0 && data->ResourceCapacity == 0)) {
-        DBG << "decaying forever";
-        decayTime = std::numeric_limits<float>::infinity();
-    }
-
-    DecayingEntity::Ptr corpse = std::make_shared<DecayingEntity>(
-                data->StandingGraphic.first,
-                decayTime,
-                Size(data->Size)
-                );
-    corpse->renderer().setPlayerColor(doppleganger->renderer().playerColor());
-    corpse->setMap(doppleganger->map());
-    corpse->setPosition(doppleganger->position());
-    corpse->renderer().setAngle(doppleganger->renderer().angle());
-
-    return corpse;
-}
-
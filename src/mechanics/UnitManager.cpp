@@ -26,6 +26,7 @@
 #include "Player.h"
 #include "Farm.h"
 #include "UnitFactory.h"
+#include "VisibilityMap.h"
 #include "actions/ActionAttack.h"
 #include "actions/ActionMove.h"
 #include "audio/AudioPlayer.h"
@@ -34,6 +35,7 @@
 #include "core/Utility.h"
 #include "global/EventManager.h"
 #include "mechanics/Player.h"
+#include "render/GraphicRender.h"
 #include "resource/Sprite.h"
 #include "Map.h"
 
@@ -42,17 +44,18 @@
 #include <genie/dat/unit/Action.h>
 
 #include <algorithm>
+#include <cstdlib>
 #include <utility>
 
 namespace genie {
 class Tech;
 }  // namespace genie
 
-UnitManager::UnitManager()
+UnitManager::UnitManager() :
+    m_dormantWatchers(WatcherCellsPerRow * WatcherCellsPerRow)
 {
     EventManager::registerListener(this, EventManager::ResearchComplete);
-    EventManager::registerListener(this, EventManager::TileHidden);
-    EventManager::registerListener(this, EventManager::TileDiscovered);
+    EventManager::registerListener(this, EventManager::VisibilityChanged);
     EventManager::registerListener(this, EventManager::DiscoveredUnit);
 //    EventManager::registerListener(this, EventManager::PlayerResourceChanged); // TODO auto actions that cost things
 }
@@ -69,7 +72,8 @@ void UnitManager::add(const Unit::Ptr &unit, const MapPos &position)
     }
     unit->setMap(m_map);
     unit->setPosition(position, true);
-    m_units.push_back(unit);
+    m_units.add(unit);
+    m_activeUnits.add(unit);
     if (unit->actions.hasAutoTargets()) {
         // stl is shit
         m_unitsWithActions.add(unit);
@@ -88,10 +92,15 @@ void UnitManager::remove(const Unit::Ptr &unit)
 
     m_unitsWithActions.remove(unit);
 
-    UnitVector::iterator it = std::find(m_units.begin(), m_units.end(), unit);
-    if (it != m_units.end()) {
+    if (unit->isDormant()) {
+        removeDormantWatcher(unit.get());
+        unit->m_dormant = false;
+    }
+    m_activeUnits.remove(unit);
+
+    if (m_units.contains(unit)) {
         EventManager::unitDying(unit.get()); // not sure about this, but whatever
-        m_units.erase(it);
+        m_units.remove(unit);
     }
 
     // Check if the human player saw it, and in that case notify it
@@ -107,7 +116,7 @@ void UnitManager::remove(const Unit::Ptr &unit)
 void UnitManager::onUnitMoved(Unit *unit, const MapPos &oldTile, const MapPos &newTile)
 {
     if (unit->playerId() == m_humanPlayerID) {
-        DBG << "Was human player" << unit->debugName;
+        DBG << "Was human player" << unit->debugName();
         return;
     }
 
@@ -130,10 +139,18 @@ void UnitManager::onUnitMoved(Unit *unit, const MapPos &oldTile, const MapPos &n
     }
 }
 
-void UnitManager::onTileHidden(const int playerID, const int tileX, const int tileY)
+void UnitManager::onVisibilityChanged(const int playerID, const VisibilityDelta &delta)
+{
+    delta.forEachHidden([&](const int tileX, const int tileY) {
+        createDopplegangersAt(playerID, tileX, tileY);
+    });
+
+    removeDiscoveredDopplegangers(playerID, delta);
+}
+
+void UnitManager::createDopplegangersAt(const int playerID, const int tileX, const int tileY)
 {
     ///TODO: use unitdiscovered/unitdisappeared
-    // TODO: this should be tracked by player? just care for the human for now
     std::vector<std::weak_ptr<Entity>> entities = m_map->entitiesAt(tileX, tileY);
     for (const std::weak_ptr<Entity> &e : entities) {
         Unit::Ptr unit = Unit::fromEntity(e);
@@ -152,53 +169,35 @@ void UnitManager::onTileHidden(const int playerID, const int tileX, const int ti
             continue;
         }
 
-        DBG << "Creating doppleganger at" << tileX << tileY << "for" << unit->debugName;
-        addStaticEntity(UnitFactory::createDopplegangerFor(unit));
+        // Already remember it
+        if (m_ghosts.contains(playerID, tileX, tileY, unit->id)) {
+            continue;
+        }
+
+        // Just what we need to draw it again
+        GhostIndex::Ghost ghost;
+        ghost.position = unit->position();
+        ghost.originalUnitID = unit->id;
+        ghost.angle = unit->angle();
+        ghost.unitDataID = unit->data()->ID;
+        ghost.spriteID = unit->renderer().spriteId();
+        ghost.frame = unit->renderer().currentFrame();
+        ghost.ownerID = unit->playerId();
+        ghost.playerColor = unit->renderer().playerColor();
+
+        DBG << "Creating doppleganger at" << tileX << tileY << "for" << unit->debugName();
+        m_ghosts.add(playerID, tileX, tileY, ghost);
         unit->isVisible = true;
     }
 }
 
-void UnitManager::onTileDiscovered(const int playerID, const int tileX, const int tileY)
+void UnitManager::removeDiscoveredDopplegangers(const int playerID, const VisibilityDelta &delta)
 {
-    std::unordered_set<StaticEntity::Ptr>::iterator staticEntityIterator = m_staticEntities.begin();
-    while (staticEntityIterator != m_staticEntities.end()) {
-        const StaticEntity::Ptr &entity = *staticEntityIterator;
-
-        const MapPos tilePos = entity->position() / Constants::TILE_SIZE;
-        if (tilePos.x != tileX || tilePos.y != tileY) {
-            staticEntityIterator++;
-            continue;
-        }
-        if (!entity->isDoppleganger()) {
-            staticEntityIterator++;
-            continue;
-        }
-
-        DopplegangerEntity::Ptr doppleganger = DopplegangerEntity::fromEntity(entity);
-        if (doppleganger->ownerID == playerID) {
-            staticEntityIterator++;
-            continue;
-        }
-
-        bool visibleByAll = true;
-        for (const std::weak_ptr<Player> &weakPlayer : m_players) {
-            Player::Ptr player = weakPlayer.lock();
-            REQUIRE(player, continue);
-
-            if (!player->canSeeUnitsFor(playerID)) {
-                visibleByAll = false;
-                break;
-            }
-        }
-
-        // If someone still only see the doppleganger, keep it
-        if (!visibleByAll) {
-            staticEntityIterator++;
-        } else {
-            // TODO: visibility of corpses
-            staticEntityIterator = m_staticEntities.erase(staticEntityIterator);
-        }
-    }
+    // Only look at what this player remembers on the tiles it can see now
+    delta.forEachDiscovered([&](const int tileX, const int tileY) {
+        // TODO: visibility of corpses
+        m_ghosts.removeAt(playerID, tileX, tileY);
+    });
 }
 
 void UnitManager::onUnitDiscovered(Player *player, Unit *unit)
@@ -241,10 +240,18 @@ bool UnitManager::update(Time time)
 {
     bool updated = false;
 
+    // Anything woken while we update starts at this tick, not the last one
+    m_currentTime = time;
+
     if (m_unitsMoved) {
         m_unitsMoved = false;
 
         for (const Unit::Ptr &unit : m_unitsWithActions) {
+            // Gets woken if an enemy comes close
+            if (unit->isDormant()) {
+                continue;
+            }
+
             Task task = unit->actions.checkForAutoTargets();
             if (!task.data) {
                 continue;
@@ -259,35 +266,39 @@ bool UnitManager::update(Time time)
     }
 
     // Update missiles (siege rockthings, arrows, etc.)
-    std::unordered_set<Missile::Ptr>::iterator missileIterator = m_missiles.begin();
-    while (missileIterator != m_missiles.end()) {
-        const Missile::Ptr &missile = *missileIterator;
+    for (size_t i=0; i<m_missiles.slotCount(); i++) {
+        const Missile::Ptr &missile = m_missiles.atSlot(i);
+        if (!missile) {
+            continue;
+        }
         updated = missile->update(time) || updated;
         if (!missile->isFlying() && !missile->isExploding()) {
-            missileIterator = m_missiles.erase(missileIterator);
+            m_missiles.remove(missile);
             updated = true;
-        } else {
-            missileIterator++;
         }
     }
 
-    // Update decaying entities (smoke stuff from siege, corpses, etc.) as well as the doppelgangers
-    std::unordered_set<StaticEntity::Ptr>::iterator staticEntityIterator = m_staticEntities.begin();
-    while (staticEntityIterator != m_staticEntities.end()) {
-        const StaticEntity::Ptr &entity = *staticEntityIterator;
+    // Update decaying entities (smoke stuff from siege, corpses, etc.)
+    for (size_t i=0; i<m_staticEntities.slotCount(); i++) {
+        const StaticEntity::Ptr &entity = m_staticEntities.atSlot(i);
+        if (!entity) {
+            continue;
+        }
         updated = entity->update(time) || updated;
         if (entity->shouldBeRemoved()) {
-            staticEntityIterator = m_staticEntities.erase(staticEntityIterator);
+            m_staticEntities.remove(entity);
             updated = true;
-        } else {
-            staticEntityIterator++;
         }
     }
 
     // Clean up dead units
-    UnitVector::iterator unitIterator = m_units.begin();
-    while (unitIterator != m_units.end()) {
-        const Unit::Ptr &unit = *unitIterator;
+    // Index based and not a reference, units can be created or woken while we update
+    // Dormant units can't die without being woken up first, so we only need to check the active ones
+    for (size_t i=0; i<m_activeUnits.slotCount(); i++) {
+        const Unit::Ptr unit = m_activeUnits.atSlot(i);
+        if (!unit) {
+            continue;
+        }
 
         const bool isDead = unit->isDead();
         const bool isDying = unit->isDying();
@@ -305,18 +316,30 @@ bool UnitManager::update(Time time)
 
             DecayingEntity::Ptr corpse = UnitFactory::Inst().createCorpseFor(unit);
             if (corpse) {
-                m_staticEntities.insert(corpse);
+                m_staticEntities.add(corpse);
                 updated = true;
             }
 
-            unitIterator = m_units.erase(unitIterator);
+            // Whoever remembers it now remembers the rubble
+            const MapPos tile = unit->position() / Constants::TILE_SIZE;
+            m_ghosts.originalDied(unit->id, tile.x, tile.y, unit->data()->Building.DestructionRubbleGraphicID);
+
+            m_units.remove(unit);
+            m_activeUnits.remove(unit);
         } else {
             // Update the living units that are left
             updated = unit->update(time) || updated;
-            unitIterator++;
+
+            trySleep(unit, time);
         }
     }
 
+    // Safe to shuffle things around now
+    m_units.compact();
+    m_activeUnits.compact();
+    m_missiles.compact();
+    m_staticEntities.compact();
+
     Time deltaTime = time - m_lastUpdateTime;
     m_lastUpdateTime = time;
 
@@ -342,6 +365,206 @@ bool UnitManager::update(Time time)
     return updated;
 }
 
+void UnitManager::trySleep(const Unit::Ptr &unit, const Time time)
+{
+    // Don't need to check this every tick
+    if (time < unit->m_nextSleepCheck) {
+        return;
+    }
+    unit->m_nextSleepCheck = time + SleepCheckInterval;
+
+    if (!unit->canSleep()) {
+        return;
+    }
+
+    if (m_selectedUnits.contains(unit)) {
+        return;
+    }
+
+    if (hasHostilesInSight(*unit)) {
+        return;
+    }
+
+    unit->m_dormant = true;
+    addDormantWatcher(unit.get());
+    m_activeUnits.remove(unit);
+}
+
+void UnitManager::wakeUnit(Unit *unit, const Time time)
+{
+    REQUIRE(unit, return);
+
+    if (!unit->m_dormant) {
+        return;
+    }
+
+    unit->m_dormant = false;
+    removeDormantWatcher(unit);
+
+    // So it doesn't go straight back to sleep
+    unit->m_nextSleepCheck = time + SleepCheckInterval;
+    unit->onWoken(time);
+
+    m_activeUnits.add(Unit::fromEntity(unit->shared_from_this()));
+}
+
+bool UnitManager::isHostile(const Unit &watcher, const Unit &other) const
+{
+    if (other.playerId() == watcher.playerId()) {
+        return false;
+    }
+
+    // Sheep and deer walking around shouldn't wake anyone
+    if (other.playerId() == GaiaID) {
+        return false;
+    }
+
+    // But gaia (wolves etc.) should notice everyone else
+    if (watcher.playerId() == GaiaID) {
+        return true;
+    }
+
+    Player::Ptr owner = watcher.player().lock();
+    if (!owner) {
+        return false;
+    }
+
+    return !owner->isAllied(other.playerId());
+}
+
+bool UnitManager::hasHostilesInSight(const Unit &unit) const
+{
+    if (!m_map) {
+        return false;
+    }
+
+    const int tileX = unit.position().x / Constants::TILE_SIZE;
+    const int tileY = unit.position().y / Constants::TILE_SIZE;
+    const LosStencil &stencil = LosStencil::forRadius(unit.m_lineOfSight);
+
+    const int firstY = std::max(tileY - stencil.radius, 0);
+    const int lastY = std::min(tileY + stencil.radius, m_map->rowCount() - 1);
+    for (int y = firstY; y <= lastY; y++) {
+        const int halfWidth = stencil.halfWidth(y - tileY);
+        if (halfWidth < 0) {
+            continue;
+        }
+
+        const int firstX = std::max(tileX - halfWidth, 0);
+        const int lastX = std::min(tileX + halfWidth, m_map->columnCount() - 1);
+        for (int x = firstX; x <= lastX; x++) {
+            for (const std::weak_ptr<Entity> &entity : m_map->entitiesAt(x, y)) {
+                const Unit::Ptr other = Unit::fromEntity(entity);
+                if (other && isHostile(unit, *other)) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+void UnitManager::addDormantWatcher(Unit *unit)
+{
+    const int radius = unit->m_lineOfSight;
+    if (radius <= 0) {
+        return;
+    }
+
+    const int tileX = unit->position().x / Constants::TILE_SIZE;
+    const int tileY = unit->position().y / Constants::TILE_SIZE;
+
+    unit->m_watchedCells.firstX = std::clamp(tileX - radius, 0, Constants::MAP_MAX_SIZE - 1) / WatcherCellSize;
+    unit->m_watchedCells.firstY = std::clamp(tileY - radius, 0, Constants::MAP_MAX_SIZE - 1) / WatcherCellSize;
+    unit->m_watchedCells.lastX = std::clamp(tileX + radius, 0, Constants::MAP_MAX_SIZE - 1) / WatcherCellSize;
+    unit->m_watchedCells.lastY = std::clamp(tileY + radius, 0, Constants::MAP_MAX_SIZE - 1) / WatcherCellSize;
+
+    for (int y = unit->m_watchedCells.firstY; y <= unit->m_watchedCells.lastY; y++) {
+        for (int x = unit->m_watchedCells.firstX; x <= unit->m_watchedCells.lastX; x++) {
+            m_dormantWatchers[y * WatcherCellsPerRow + x].push_back(unit);
+        }
+    }
+}
+
+void UnitManager::removeDormantWatcher(Unit *unit)
+{
+    for (int y = unit->m_watchedCells.firstY; y <= unit->m_watchedCells.lastY; y++) {
+        for (int x = unit->m_watchedCells.firstX; x <= unit->m_watchedCells.lastX; x++) {
+            std::vector<Unit*> &watchers = m_dormantWatchers[y * WatcherCellsPerRow + x];
+            std::vector<Unit*>::iterator it = std::find(watchers.begin(), watchers.end(), unit);
+            if (it == watchers.end()) {
+                continue;
+            }
+            *it = watchers.back();
+            watchers.pop_back();
+        }
+    }
+
+    unit->m_watchedCells.lastX = -1;
+    unit->m_watchedCells.lastY = -1;
+}
+
+void UnitManager::onUnitChangedTile(Unit *unit, const MapPos &newTile)
+{
+    const int tileX = newTile.x;
+    const int tileY = newTile.y;
+    if (IS_UNLIKELY(unsigned(tileX) >= unsigned(Constants::MAP_MAX_SIZE) || unsigned(tileY) >= unsigned(Constants::MAP_MAX_SIZE))) {
+        return;
+    }
+
+    const std::vector<Unit*> &watchers = m_dormantWatchers[(tileY / WatcherCellSize) * WatcherCellsPerRow + tileX / WatcherCellSize];
+    if (IS_LIKELY(watchers.empty())) {
+        return;
+    }
+
+    // Waking them modifies the list
+    std::vector<Unit*> toWake;
+    for (Unit *watcher : watchers) {
+        if (!isHostile(*watcher, *unit)) {
+            continue;
+        }
+
+        const int dx = tileX - int(watcher->position().x / Constants::TILE_SIZE);
+        const int dy = tileY - int(watcher->position().y / Constants::TILE_SIZE);
+        if (std::abs(dx) > LosStencil::forRadius(watcher->m_lineOfSight).halfWidth(dy)) {
+            continue;
+        }
+
+        toWake.push_back(watcher);
+    }
+
+    for (Unit *watcher : toWake) {
+        wakeUnit(watcher, m_currentTime);
+    }
+}
+
+UnitManager::MemoryUsage UnitManager::memoryUsage() const
+{
+    // Not exact, the control block size is a guess and we don't count the actions
+    static constexpr size_t controlBlockSize = 2 * sizeof(void*);
+
+    MemoryUsage usage;
+    for (const Unit::Ptr &unit : m_units) {
+        usage.unitCount++;
+        usage.objectBytes += (unit->isBuilding() ? sizeof(Building) : sizeof(Unit)) + controlBlockSize;
+        usage.heapBytes += unit->heapMemoryUsage();
+    }
+    return usage;
+}
+
+void UnitManager::printMemoryUsage() const
+{
+    const MemoryUsage usage = memoryUsage();
+    DBG << "sizeof(Unit)" << sizeof(Unit) << "sizeof(Building)" << sizeof(Building) << "sizeof(GraphicRender)" << sizeof(GraphicRender);
+    if (!usage.unitCount) {
+        return;
+    }
+    DBG << usage.unitCount << "units," << (usage.objectBytes / usage.unitCount) << "bytes per unit in the objects,"
+        << (usage.heapBytes / usage.unitCount) << "bytes per unit on the heap,"
+        << ((usage.objectBytes + usage.heapBytes) / 1024) << "KiB total";
+}
+
 bool UnitManager::onLeftClick(const ScreenPos &screenPos, const CameraPtr &camera)
 {
     Player::Ptr humanPlayer = m_humanPlayer.lock();
@@ -472,7 +695,7 @@ void UnitManager::onRightClick(const ScreenPos &screenPos, const CameraPtr &came
                 }
 
                 if (!unit->canMatchGenieUnitID(task.unitId)) {
-                    WARN << "could not match genie unit id" << unit->debugName;
+                    WARN << "could not match genie unit id" << unit->debugName();
                     continue;
                 }
 
@@ -698,13 +921,13 @@ void UnitManager::selectUnits(const ScreenRect &selectionRect, const CameraPtr &
     }
 
     for (const Unit::Ptr &unit : newlySelected) {
-        DBG << "Selected" << unit->debugName << unit->id;
+        DBG << "Selected" << unit->debugName();
         EventManager::unitSelected(unit.get());
     }
 
     for (const Unit::Ptr &unit : previouslySelected) {
         if (!newlySelected.contains(unit)) {
-            DBG << "Deselected" << unit->debugName << unit->id;
+            DBG << "Deselected" << unit->debugName();
             EventManager::unitDeselected(unit.get());
         }
     }
@@ -720,13 +943,28 @@ void UnitManager::selectUnits(const ScreenRect &selectionRect, const CameraPtr &
         const Unit::Ptr mostVisibleUnit = *std::min_element(newSelection.begin(), newSelection.end(), MapPositionSorter());
         setSelectedUnits({std::move(mostVisibleUnit)});
     } else {
-        setSelectedUnits(std::move(newSelection.units));
+        setSelectedUnits(newSelection.items());
     }
 }
 
 void UnitManager::setMap(const MapPtr &map)
 {
+    if (m_map) {
+        m_map->disconnect(Map::Recreated, this);
+    }
+
     m_map = map;
+
+    if (m_map) {
+        m_map->connect(Map::Recreated, this, &UnitManager::onMapRecreated);
+    }
+}
+
+void UnitManager::onMapRecreated()
+{
+    for (const Unit::Ptr &unit : m_units) {
+        unit->reregisterObstruction();
+    }
 }
 
 void UnitManager::updateAvailableActions()
@@ -745,10 +983,9 @@ void UnitManager::updateAvailableActions()
 
 void UnitManager::forEachUnitAt(const ScreenPos &position, const CameraPtr camera, const std::function<bool(const Unit::Ptr &)> &action)
 {
-    std::reverse_iterator<UnitVector::const_iterator> unitIterator;
-    for (unitIterator = m_units.rbegin(); unitIterator != m_units.rend(); unitIterator++) {
-        Unit::Ptr unit = *unitIterator;
-        if (!unit->isVisible) {
+    for (size_t i=m_units.slotCount(); i-- > 0;) {
+        Unit::Ptr unit = m_units.atSlot(i);
+        if (!unit || !unit->isVisible) {
             continue;
         }
 
@@ -763,7 +1000,7 @@ void UnitManager::forEachUnitAt(const ScreenPos &position, const CameraPtr camer
 
 void UnitManager::setSelectedUnits(const UnitVector &units)
 {
-    m_selectedUnits.units = units;
+    m_selectedUnits.assign(units);
     m_buildingsToPlace.clear();
     m_availableActionsChanged = true;
 
@@ -865,10 +1102,9 @@ Unit::Ptr UnitManager::unitAt(const ScreenPos &pos, const CameraPtr &camera, con
 {
     Player::Ptr humanPlayer = m_humanPlayer.lock();
 
-    std::reverse_iterator<UnitVector::const_iterator> unitIterator;
-    for (unitIterator = m_units.rbegin(); unitIterator != m_units.rend(); unitIterator++) {
-        Unit::Ptr unit = *unitIterator;
-        if (!unit->isVisible) {
+    for (size_t i=m_units.slotCount(); i-- > 0;) {
+        Unit::Ptr unit = m_units.atSlot(i);
+        if (!unit || !unit->isVisible) {
             continue;
         }
 
@@ -1002,7 +1238,7 @@ void UnitManager::placeBuilding(const UnplacedBuilding &building)
     if (building.graphic->sprite()) {
         unit->setAngle(building.graphic->sprite()->orientationToAngle(building.orientation));
     } else {
-        WARN << "No graphic set for" << buildingToPlace->debugName;
+        WARN << "No graphic set for" << buildingToPlace->debugName();
     }
     DBG << unit->angle();
 
@@ -1031,7 +1267,7 @@ void UnitManager::playSound(const Unit::Ptr &unit)
 {
     const int id = unit->data()->SelectionSound;
     if (id < 0) {
-        DBG << "no selection sound for" << unit->debugName;
+        DBG << "no selection sound for" << unit->debugName();
         return;
     }
 
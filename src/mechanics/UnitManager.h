@@ -20,8 +20,11 @@
 #include <memory>
 #include <unordered_set>
 
+#include "GhostIndex.h"
 #include "Unit.h"
 
+#include "core/DenseSet.h"
+#include "core/SlotMap.h"
 #include "global/EventListener.h"
 #include "render/IRenderTarget.h"
 
@@ -86,49 +89,9 @@ struct MapPositionSorter
 typedef std::vector<std::shared_ptr<Unit>> UnitVector;
 //typedef std::unordered_set<std::shared_ptr<Unit>> UnitSet;
 
-/// STL's API design is a flying, then crashing, shitshow.
-/// should probably make it templated idk idc
-struct UnitSet {
-    using iterator = std::vector<std::shared_ptr<Unit>>::iterator;
-    using const_iterator = std::vector<std::shared_ptr<Unit>>::const_iterator;
+typedef DenseSet<std::shared_ptr<Unit>> UnitSet;
 
-    inline iterator begin() { return units.begin(); }
-    inline iterator end() { return units.end(); }
-
-    inline const_iterator begin() const { return units.begin(); }
-    inline const_iterator end() const { return units.end(); }
-
-    inline bool isEmpty() const { return units.empty(); }
-    size_t size() const { return units.size(); }
-
-    const std::shared_ptr<Unit> &first() const { return units[0]; }
-
-    bool contains(const std::shared_ptr<Unit> &unit) const {
-        return std::find(units.begin(), units.end(), unit) != units.end();
-    }
-
-    // STL sucks, so let's wrap it
-    inline void add(const std::shared_ptr<Unit> &unit) {
-        const std::vector<std::shared_ptr<Unit>>::const_iterator it = std::find(units.begin(), units.end(), unit);
-        if (it != units.end()) {
-            return;
-        }
-        units.push_back(unit);
-    }
-
-    inline bool remove(const std::shared_ptr<Unit> &unit) {
-        const std::vector<std::shared_ptr<Unit>>::const_iterator it = std::find(units.begin(), units.end(), unit);
-        if (it == units.end()) {
-            return false;
-        }
-        units.erase(it);
-        return true;
-    }
-
-    std::vector<std::shared_ptr<Unit>> units;
-};
-
-class UnitManager : public EventListener, public SignalEmitter<UnitManager>
+class UnitManager : public EventListener, public SignalEmitter<UnitManager>, public SignalReceiver
 {
 public:
     enum Signals {
@@ -153,7 +116,6 @@ public:
 
     void add(const Unit::Ptr &unit, const MapPos &position);
     void remove(const Unit::Ptr &unit);
-    void remove(const DopplegangerEntity::Ptr &unit);
 
     bool init();
 
@@ -176,9 +138,10 @@ public:
     void setSelectedUnits(const UnitVector &units);
     const UnitSet &selected() const { return m_selectedUnits; }
 
-    const UnitVector &units() const { return m_units; }
-    const std::unordered_set<std::shared_ptr<Missile>> &missiles() const { return m_missiles; }
-    const std::unordered_set<StaticEntity::Ptr> &staticEntities() const { return m_staticEntities; }
+    const SlotMap<Unit::Ptr> &units() const { return m_units; }
+    const SlotMap<std::shared_ptr<Missile>> &missiles() const { return m_missiles; }
+    const SlotMap<StaticEntity::Ptr> &staticEntities() const { return m_staticEntities; }
+    const GhostIndex &ghosts() const { return m_ghosts; }
     const std::vector<UnplacedBuilding> &buildingsToPlace() const { return m_buildingsToPlace; }
     const MoveTargetMarker::Ptr &moveTargetMarker() const { return m_moveTargetMarker; }
 
@@ -198,19 +161,39 @@ public:
 
     State state() const { return m_state; }
 
-    void addMissile(const std::shared_ptr<Missile> &missile) { m_missiles.insert(missile); }
-    void addStaticEntity(const StaticEntity::Ptr &entity) { if (entity) m_staticEntities.insert(entity); }
+    void addMissile(const std::shared_ptr<Missile> &missile) { m_missiles.add(missile); }
+    void addStaticEntity(const StaticEntity::Ptr &entity) { if (entity) m_staticEntities.add(entity); }
 
     void onCombatantUnitsMoved() { m_unitsMoved = true; }
 
+    /// Puts a dormant unit back into the update loop, with its clock synced to the given time
+    void wakeUnit(Unit *unit, const Time time);
+
+    /// The time of the update we're in, or the last one if we're not updating
+    Time currentTime() const noexcept { return m_currentTime; }
+
+    /// Wakes up any dormant enemies that can see the new tile
+    void onUnitChangedTile(Unit *unit, const MapPos &newTile);
+
     int targetBlinkTimeLeft(int unitID) const noexcept;
 
+    struct MemoryUsage {
+        size_t unitCount = 0;
+        size_t objectBytes = 0; // the unit objects themselves, including the shared_ptr control block
+        size_t heapBytes = 0; // what the units have allocated in addition
+    };
+    MemoryUsage memoryUsage() const;
+    void printMemoryUsage() const;
+
 private:
     void onResearchCompleted(Player * /*player*/, int /*researchId*/) override { m_availableActionsChanged = true; }
     void onUnitMoved(Unit *unit, const MapPos &oldTile, const MapPos &newTile) override;
-    void onTileHidden(const int playerID, const int tileX, const int tileY) override;
-    void onTileDiscovered(const int playerID, const int tileX, const int tileY) override;
+    void onVisibilityChanged(const int playerID, const VisibilityDelta &delta) override;
     void onUnitDiscovered(Player *player, Unit *unit) override;
+    void onMapRecreated();
+
+    void createDopplegangersAt(const int playerID, const int tileX, const int tileY);
+    void removeDiscoveredDopplegangers(const int playerID, const VisibilityDelta &delta);
 
     void updateBuildingToPlace();
     void placeBuilding(const UnplacedBuilding &building);
@@ -219,6 +202,12 @@ private:
     Unit::Ptr unitAt(const ScreenPos &pos, const CameraPtr &camera, const PlayerAlignment alignment) const;
     void forEachUnitAt(const ScreenPos &position, const CameraPtr camera, const std::function<bool(const Unit::Ptr&)> &action);
 
+    void trySleep(const Unit::Ptr &unit, const Time time);
+    bool hasHostilesInSight(const Unit &unit) const;
+    bool isHostile(const Unit &watcher, const Unit &other) const;
+    void addDormantWatcher(Unit *unit);
+    void removeDormantWatcher(Unit *unit);
+
     void playSound(const Unit::Ptr &unit);
     const Task taskForPosition(const Unit::Ptr &unit, const ScreenPos &pos, const CameraPtr &camera) const noexcept;
 
@@ -227,11 +216,22 @@ private:
     MapPtr m_map;
 
     /// Units (and similar)
-    std::unordered_set<std::shared_ptr<Missile>> m_missiles;
-    std::unordered_set<StaticEntity::Ptr> m_staticEntities;
-    UnitVector m_units;
+    // Holes are squeezed out at the end of update()
+    SlotMap<std::shared_ptr<Missile>> m_missiles;
+    SlotMap<StaticEntity::Ptr> m_staticEntities;
+    GhostIndex m_ghosts; // what each player remembers seeing under the fog of war
+    SlotMap<Unit::Ptr> m_units;
     MoveTargetMarker::Ptr m_moveTargetMarker;
 
+    /// The units that are updated every tick, i. e. not dormant
+    SlotMap<Unit::Ptr> m_activeUnits;
+
+    /// Dormant units, per block of tiles they can see, so they can be woken when enemies come close
+    static constexpr Time SleepCheckInterval = 1000; // ms between checking if an active unit can go dormant
+    static constexpr int WatcherCellSize = 8;
+    static constexpr int WatcherCellsPerRow = (Constants::MAP_MAX_SIZE + WatcherCellSize - 1) / WatcherCellSize;
+    std::vector<std::vector<Unit*>> m_dormantWatchers;
+
     /// Players info
     std::vector<std::weak_ptr<Player>> m_players;
     std::weak_ptr<Player> m_humanPlayer;
@@ -252,6 +252,7 @@ private:
     bool m_unitsMoved = true;
     bool m_availableActionsChanged = true; // Because we might get a bunch of events in a single update, do it only once
     Time m_lastUpdateTime = 0;
+    Time m_currentTime = 0;
 };
 
 inline LogPrinter operator <<(LogPrinter os, const UnitManager::State state)
@@ -0,0 +1,417 @@
+#include "VisibilityMap.h"
+
+#include <algorithm>
+#include <bit>
+
+#include "core/Logger.h"
+#include "global/EventManager.h"
+
+//#define CHEAT_VISIBILITY 1
+
+const LosStencil &LosStencil::forRadius(int radius)
+{
+    // Not thread safe, but nothing touching the visibility is
+    static std::vector<std::unique_ptr<LosStencil>> cache;
+
+    radius = std::clamp(radius, 0, Constants::MAP_MAX_SIZE);
+    if (size_t(radius) >= cache.size()) {
+        cache.resize(radius + 1);
+    }
+
+    std::unique_ptr<LosStencil> &stencil = cache[radius];
+    if (stencil) {
+        return *stencil;
+    }
+
+    stencil = std::make_unique<LosStencil>();
+    stencil->radius = radius;
+    stencil->halfWidths.resize(2 * radius + 1, -1);
+
+    const int radiusSquared = radius * radius;
+    for (int y=-radius; y<=radius; y++) {
+        int halfWidth = -1;
+        while ((halfWidth + 1) * (halfWidth + 1) + y * y < radiusSquared) {
+            halfWidth++;
+        }
+        stencil->halfWidths[y + radius] = halfWidth;
+    }
+
+    return *stencil;
+}
+
+VisibilityMap::VisibilityMap(int playerID) :
+    m_playerId(playerID),
+    m_planes(std::make_shared<Planes>())
+{
+    m_planes->maps.push_back(this);
+
+#ifdef CHEAT_VISIBILITY
+    m_planes->visible.fill(std::numeric_limits<uint64_t>::max());
+    m_planes->explored.fill(std::numeric_limits<uint64_t>::max());
+#endif
+}
+
+VisibilityMap::~VisibilityMap()
+{
+    std::vector<VisibilityMap*> &maps = m_planes->maps;
+    maps.erase(std::remove(maps.begin(), maps.end(), this), maps.end());
+}
+
+void VisibilityMap::setExplored(const int tileX, const int tileY)
+{
+    if (IS_UNLIKELY(unsigned(tileX) >= unsigned(Constants::MAP_MAX_SIZE) || unsigned(tileY) >= unsigned(Constants::MAP_MAX_SIZE))) {
+        return;
+    }
+    const int word = tileX / WordBits;
+    const uint64_t bit = uint64_t(1) << (tileX % WordBits);
+
+    m_planes->explored[tileY * WordsPerRow + word] |= bit;
+    m_planes->isDirty = true;
+
+    rowChanged(tileY);
+}
+
+void VisibilityMap::addLineOfSight(const int tileX, const int tileY, const int radius)
+{
+    moveLineOfSight(tileX, tileY, 0, tileX, tileY, radius);
+}
+
+void VisibilityMap::removeLineOfSight(const int tileX, const int tileY, const int radius)
+{
+    moveLineOfSight(tileX, tileY, radius, tileX, tileY, 0);
+}
+
+void VisibilityMap::moveLineOfSight(const int oldTileX, const int oldTileY, const int oldRadius, const int newTileX, const int newTileY, const int newRadius)
+{
+    if (oldTileX == newTileX && oldTileY == newTileY && oldRadius == newRadius) {
+        return;
+    }
+
+    const LosStencil &oldStencil = LosStencil::forRadius(oldRadius);
+    const LosStencil &newStencil = LosStencil::forRadius(newRadius);
+
+    const int firstRow = std::max(std::min(oldTileY - oldStencil.radius, newTileY - newStencil.radius), 0);
+    const int lastRow = std::min(std::max(oldTileY + oldStencil.radius, newTileY + newStencil.radius), Constants::MAP_MAX_SIZE - 1);
+
+    RowMask oldMask, newMask, added, removed;
+    for (int row = firstRow; row <= lastRow; row++) {
+        const int oldHalfWidth = oldStencil.halfWidth(row - oldTileY);
+        const int newHalfWidth = newStencil.halfWidth(row - newTileY);
+
+        // Nothing changed in this row
+        if (oldHalfWidth == newHalfWidth && (oldTileX == newTileX || oldHalfWidth < 0)) {
+            continue;
+        }
+
+        if (oldHalfWidth >= 0) {
+            spanMask(oldTileX - oldHalfWidth, oldTileX + oldHalfWidth, &oldMask);
+        } else {
+            oldMask.fill(0);
+        }
+        if (newHalfWidth >= 0) {
+            spanMask(newTileX - newHalfWidth, newTileX + newHalfWidth, &newMask);
+        } else {
+            newMask.fill(0);
+        }
+
+        for (int word = 0; word < WordsPerRow; word++) {
+            added[word] = newMask[word] & ~oldMask[word];
+            removed[word] = oldMask[word] & ~newMask[word];
+        }
+
+        updateRow(row, added, removed);
+    }
+}
+
+void VisibilityMap::shareWith(VisibilityMap &other)
+{
+    if (isSharedWith(other)) {
+        return;
+    }
+
+    // Get rid of what is pending, so the flushed planes are what each side has seen
+    flushChanges();
+    other.flushChanges();
+
+    std::shared_ptr<Planes> ours = m_planes;
+    std::shared_ptr<Planes> theirs = other.m_planes;
+
+    for (size_t i=0; i<ours->visible.size(); i++) {
+        ours->visible[i] |= theirs->visible[i];
+        ours->explored[i] |= theirs->explored[i];
+    }
+
+    for (size_t i=0; i<ours->lookers.size(); i++) {
+        ours->lookers[i] += theirs->lookers[i];
+    }
+
+    const std::vector<VisibilityMap*> ourMaps = ours->maps;
+    const std::vector<VisibilityMap*> theirMaps = theirs->maps;
+    for (VisibilityMap *map : theirMaps) {
+        map->m_planes = ours;
+        ours->maps.push_back(map);
+    }
+    theirs->maps.clear();
+    ours->isDirty = true;
+
+    // Each side only gets told about what the other side brought in
+    sendChanges(*ours, theirs->flushedVisible, theirs->flushedExplored, 0, Constants::MAP_MAX_SIZE - 1, theirMaps);
+    sendChanges(*ours, ours->flushedVisible, ours->flushedExplored, 0, Constants::MAP_MAX_SIZE - 1, ourMaps);
+
+    ours->flushedVisible = ours->visible;
+    ours->flushedExplored = ours->explored;
+}
+
+void VisibilityMap::unshare()
+{
+    if (!isShared()) {
+        return;
+    }
+
+    std::shared_ptr<Planes> shared = m_planes;
+    std::vector<VisibilityMap*> &sharedMaps = shared->maps;
+    sharedMaps.erase(std::remove(sharedMaps.begin(), sharedMaps.end(), this), sharedMaps.end());
+    shared->isDirty = true;
+
+    // Not flushed, so the next flush tells each side what it lost compared
+    // to what it was told last time
+    m_planes = std::make_shared<Planes>();
+    m_planes->maps.push_back(this);
+    m_planes->explored = shared->explored;
+    m_planes->flushedVisible = shared->flushedVisible;
+    m_planes->flushedExplored = shared->flushedExplored;
+    m_planes->changedFirstRow = 0;
+    m_planes->changedLastRow = Constants::MAP_MAX_SIZE - 1;
+}
+
+void VisibilityMap::flushChanges()
+{
+    Planes &planes = *m_planes;
+    if (planes.changedLastRow < planes.changedFirstRow) {
+        return;
+    }
+
+    const int firstRow = planes.changedFirstRow;
+    const int lastRow = planes.changedLastRow;
+    planes.changedFirstRow = Constants::MAP_MAX_SIZE;
+    planes.changedLastRow = -1;
+
+    // Copy, in case a listener does something that makes us share with someone else
+    const std::vector<VisibilityMap*> maps = planes.maps;
+    sendChanges(planes, planes.flushedVisible, planes.flushedExplored, firstRow, lastRow, maps);
+
+    for (int row = firstRow; row <= lastRow; row++) {
+        for (int word = 0; word < WordsPerRow; word++) {
+            const size_t index = row * WordsPerRow + word;
+            planes.flushedVisible[index] = planes.visible[index];
+            planes.flushedExplored[index] = planes.explored[index];
+        }
+    }
+}
+
+void VisibilityMap::sendChanges(Planes &planes, const VisibilityDelta::Plane &oldVisible, const VisibilityDelta::Plane &oldExplored, const int firstRow, const int lastRow, const std::vector<VisibilityMap*> &maps)
+{
+    VisibilityDelta &delta = planes.delta;
+
+    // Clear what was left from last time
+    for (int row = delta.firstRow; row <= delta.lastRow; row++) {
+        for (int word = 0; word < WordsPerRow; word++) {
+            const size_t index = row * WordsPerRow + word;
+            delta.discovered[index] = 0;
+            delta.hidden[index] = 0;
+            delta.explored[index] = 0;
+        }
+    }
+
+    delta.firstRow = firstRow;
+    delta.lastRow = lastRow;
+
+    bool hasChanges = false;
+    for (int row = firstRow; row <= lastRow; row++) {
+        for (int word = 0; word < WordsPerRow; word++) {
+            const size_t index = row * WordsPerRow + word;
+
+            delta.discovered[index] = planes.visible[index] & ~oldVisible[index];
+            delta.hidden[index] = oldVisible[index] & ~planes.visible[index];
+            delta.explored[index] = planes.explored[index] & ~oldExplored[index];
+
+            hasChanges = hasChanges || delta.discovered[index] || delta.hidden[index] || delta.explored[index];
+        }
+    }
+
+    // E. g. a unit walking back and forth across a tile boundary in a single tick
+    if (!hasChanges) {
+        return;
+    }
+
+    for (const VisibilityMap *map : maps) {
+        EventManager::visibilityChanged(map->m_playerId, delta);
+    }
+}
+
+void VisibilityMap::spanMask(int first, int last, RowMask *mask) noexcept
+{
+    first = std::max(first, 0);
+    last = std::min(last, Constants::MAP_MAX_SIZE - 1);
+
+    for (int word = 0; word < WordsPerRow; word++) {
+        const int wordStart = word * WordBits;
+        const int from = std::max(first, wordStart) - wordStart;
+        const int to = std::min(last, wordStart + WordBits - 1) - wordStart;
+        if (from > to) {
+            (*mask)[word] = 0;
+            continue;
+        }
+
+        (*mask)[word] = (~uint64_t(0) >> (WordBits - 1 - to)) & (~uint64_t(0) << from);
+    }
+}
+
+void VisibilityMap::updateRow(const int tileY, const RowMask &added, const RowMask &removed)
+{
+    Planes &planes = *m_planes;
+    uint16_t *lookers = &planes.lookers[tileY * Constants::MAP_MAX_SIZE];
+
+    for (int word = 0; word < WordsPerRow; word++) {
+        const size_t index = tileY * WordsPerRow + word;
+
+        uint64_t discovered = 0;
+        for (uint64_t bits = added[word]; bits; bits &= bits - 1) {
+            const int bit = std::countr_zero(bits);
+            if (lookers[word * WordBits + bit]++ == 0) {
+                discovered |= uint64_t(1) << bit;
+            }
+        }
+
+        uint64_t hidden = 0;
+        for (uint64_t bits = removed[word]; bits; bits &= bits - 1) {
+            const int bit = std::countr_zero(bits);
+            uint16_t &count = lookers[word * WordBits + bit];
+            if (IS_UNLIKELY(count == 0)) {
+                continue;
+            }
+            if (--count == 0) {
+                hidden |= uint64_t(1) << bit;
+            }
+        }
+
+        if (!discovered && !hidden) {
+            continue;
+        }
+
+        planes.visible[index] = (planes.visible[index] | discovered) & ~hidden;
+        planes.explored[index] |= discovered;
+        planes.isDirty = true;
+
+        rowChanged(tileY);
+    }
+}
+
+void VisibilityMap::rowChanged(const int tileY)
+{
+    m_planes->changedFirstRow = std::min(m_planes->changedFirstRow, tileY);
+    m_planes->changedLastRow = std::max(m_planes->changedLastRow, tileY);
+}
+
+namespace {
+enum Direction : uint8_t {
+    West = 1 << 0,
+    South = 1 << 1,
+    East = 1 << 2,
+    North = 1 << 3,
+
+    NorthWest = 1 << 4,
+    NorthEast = 1 << 5,
+    SouthEast = 1 << 6,
+    SouthWest = 1 << 7,
+};
+
+struct EdgeTileLut {
+    constexpr EdgeTileLut() : values{}
+    {
+        const uint8_t uninitialized = -1;
+
+        for (size_t i=0; i<values.size(); i++) {
+            values[i] = uninitialized;
+        }
+
+        uint8_t tileNum = 0;
+        for (size_t edge=0; edge<values.size(); edge++) {
+            const bool west      = (edge & West);
+            const bool south     = (edge & South);
+            const bool east      = (edge & East);
+            const bool north     = (edge & North);
+            const bool southWest = (edge & SouthWest);
+            const bool southEast = (edge & SouthEast);
+            const bool northWest = (edge & NorthWest);
+            const bool northEast = (edge & NorthEast);
+
+            if (southWest && (west || north)) {
+                continue;
+            }
+            if (southEast && (east || north)) {
+                continue;
+            }
+            if (northEast && (east || south)) {
+                continue;
+            }
+            if (northWest && (west || south)) {
+                continue;
+            }
+
+            values[edge] = tileNum++;
+        }
+
+        for (size_t edge=0; edge<values.size(); edge++) {
+            if (values[edge] != uninitialized) {
+                continue;
+            }
+
+            uint8_t aliasEdge = edge & (NorthWest | NorthEast | SouthEast |  SouthWest);
+
+            if (edge & SouthWest) {
+                aliasEdge &= ~North;
+                aliasEdge &= ~West;
+            }
+
+            if (edge & SouthEast) {
+                aliasEdge &= ~North;
+                aliasEdge &= ~East;
+            }
+
+            if (edge & NorthEast) {
+                aliasEdge &= ~South;
+                aliasEdge &= ~East;
+            }
+
+            if (edge & NorthWest) {
+                aliasEdge &= ~South;
+                aliasEdge &= ~West;
+            }
+
+            values[edge] = values[aliasEdge];
+        }
+    }
+
+    std::array<uint8_t, 256> values;
+};
+} // anonymous namespace
+
+int VisibilityMap::edgeTileNum(const int tileX, const int tileY, const Visibility type) const
+{
+    static constexpr EdgeTileLut edgetileLut;
+
+    uint8_t edges = 0;
+
+    if (visibilityAt(tileX - 1, tileY + 0, type) <= type) { edges |= SouthWest; }
+    if (visibilityAt(tileX + 1, tileY + 0, type) <= type) { edges |= NorthEast; }
+    if (visibilityAt(tileX + 0, tileY - 1, type) <= type) { edges |= NorthWest; }
+    if (visibilityAt(tileX + 0, tileY + 1, type) <= type) { edges |= SouthEast; }
+
+    if (visibilityAt(tileX - 1, tileY - 1, type) <= type) { edges |= West; }
+    if (visibilityAt(tileX - 1, tileY + 1, type) <= type) { edges |= North; }
+    if (visibilityAt(tileX + 1, tileY - 1, type) <= type) { edges |= South; }
+    if (visibilityAt(tileX + 1, tileY + 1, type) <= type) { edges |= East; }
+
+    return edgetileLut.values[edges];
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <stddef.h>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "core/Constants.h"
+#include "core/Types.h"
+#include "core/Utility.h"
+
+/// A circular line of sight, stored as one horizontal span per row.
+/// Same shape as we always had (x² + y² < r²), just precomputed once per radius.
+struct LosStencil
+{
+    int radius = 0;
+
+    /// Index 0 is the row at -radius, the span for a row is [-halfWidth, halfWidth], -1 if empty
+    std::vector<int16_t> halfWidths;
+
+    inline int halfWidth(const int rowOffset) const noexcept {
+        if (rowOffset < -radius || rowOffset > radius) {
+            return -1;
+        }
+        return halfWidths[rowOffset + radius];
+    }
+
+    static const LosStencil &forRadius(int radius);
+};
+
+/// What changed in a visibility map since the last flush, one bit per tile.
+/// Sent once per tick instead of an event per tile.
+struct VisibilityDelta
+{
+    static constexpr int WordBits = 64;
+    static constexpr int WordsPerRow = (Constants::MAP_MAX_SIZE + WordBits - 1) / WordBits;
+
+    typedef std::array<uint64_t, WordsPerRow * Constants::MAP_MAX_SIZE> Plane;
+
+    Plane discovered{}; // became visible
+    Plane hidden{}; // not visible anymore
+    Plane explored{}; // explored for the first time
+
+    // Only rows in this range can have changes
+    int firstRow = Constants::MAP_MAX_SIZE;
+    int lastRow = -1;
+
+    inline bool isDiscovered(const int tileX, const int tileY) const noexcept { return isSet(discovered, tileX, tileY); }
+    inline bool isHidden(const int tileX, const int tileY) const noexcept { return isSet(hidden, tileX, tileY); }
+
+    template<typename Function>
+    void forEachDiscovered(Function &&function) const { forEachTile(discovered, function); }
+
+    template<typename Function>
+    void forEachHidden(Function &&function) const { forEachTile(hidden, function); }
+
+private:
+    inline bool isSet(const Plane &plane, const int tileX, const int tileY) const noexcept {
+        if (IS_UNLIKELY(tileY < firstRow || tileY > lastRow || unsigned(tileX) >= unsigned(Constants::MAP_MAX_SIZE))) {
+            return false;
+        }
+        return plane[tileY * WordsPerRow + tileX / WordBits] & (uint64_t(1) << (tileX % WordBits));
+    }
+
+    template<typename Function>
+    void forEachTile(const Plane &plane, Function &function) const {
+        for (int row = firstRow; row <= lastRow; row++) {
+            for (int word = 0; word < WordsPerRow; word++) {
+                for (uint64_t bits = plane[row * WordsPerRow + word]; bits; bits &= bits - 1) {
+                    function(word * WordBits + std::countr_zero(bits), row);
+                }
+            }
+        }
+    }
+};
+
+/// Visibility is stored as bit planes, one bit per tile, 64 tiles per word.
+/// We keep a count of how many units are looking at each tile so we know when
+/// a tile goes dark, but that is only touched for the tiles that actually change
+/// (so when moving only the edges of the stencil).
+///
+/// Players on the same team with shared vision share the same planes.
+struct VisibilityMap
+{
+    enum Visibility : int {
+        Unexplored = std::numeric_limits<int>::min(),
+        Explored = 0,
+        Visible
+    };
+
+    static constexpr int WordBits = VisibilityDelta::WordBits;
+    static constexpr int WordsPerRow = VisibilityDelta::WordsPerRow;
+
+    typedef std::array<uint64_t, WordsPerRow> RowMask;
+
+    VisibilityMap(int playerID);
+    ~VisibilityMap();
+
+    VisibilityMap(const VisibilityMap &) = delete;
+    const VisibilityMap &operator=(const VisibilityMap &) = delete;
+
+    inline Visibility visibilityAt(const MapPos &pos) const {
+        return visibilityAt(pos.x / Constants::TILE_SIZE, pos.y / Constants::TILE_SIZE);
+    }
+
+    inline Visibility visibilityAt(const int tileX, const int tileY, const Visibility def = Unexplored) const {
+        if (IS_UNLIKELY(unsigned(tileX) >= unsigned(Constants::MAP_MAX_SIZE) || unsigned(tileY) >= unsigned(Constants::MAP_MAX_SIZE))) {
+            return def;
+        }
+
+        const size_t word = tileY * WordsPerRow + tileX / WordBits;
+        const uint64_t bit = uint64_t(1) << (tileX % WordBits);
+
+        if (m_planes->visible[word] & bit) {
+            return Visible;
+        } else if (m_planes->explored[word] & bit) {
+            return Explored;
+        } else {
+            return Unexplored;
+        }
+    }
+
+    void setExplored(const int tileX, const int tileY);
+
+    /// A unit at the given tile with the given line of sight started looking
+    void addLineOfSight(const int tileX, const int tileY, const int radius);
+
+    /// A unit at the given tile with the given line of sight stopped looking
+    void removeLineOfSight(const int tileX, const int tileY, const int radius);
+
+    /// Only updates the tiles that differ between the old and the new stencil
+    void moveLineOfSight(const int oldTileX, const int oldTileY, const int oldRadius, const int newTileX, const int newTileY, const int newRadius);
+
+    /// Merges the other map into ours, after this both see what the other sees (e. g. when researching cartography)
+    void shareWith(VisibilityMap &other);
+    bool isSharedWith(const VisibilityMap &other) const { return m_planes == other.m_planes; }
+    bool isShared() const { return m_planes->maps.size() > 1; }
+
+    /// Gets our own planes again, with what has been explored but nothing visible.
+    /// Whoever calls this needs to move the line of sight of their units over.
+    void unshare();
+
+    /// Sends what changed since the last time to the listeners, called once per tick
+    void flushChanges();
+
+    bool isDirty() const { return m_planes->isDirty; } // needs re-render
+    void flushDirty() { m_planes->isDirty = false; }
+
+    int edgeTileNum(const int tileX, const int tileY, const Visibility type) const;
+
+private:
+    struct Planes {
+        VisibilityDelta::Plane visible{};
+        VisibilityDelta::Plane explored{};
+
+        // What it looked like the last time we sent the changes
+        VisibilityDelta::Plane flushedVisible{};
+        VisibilityDelta::Plane flushedExplored{};
+        int changedFirstRow = Constants::MAP_MAX_SIZE;
+        int changedLastRow = -1;
+
+        VisibilityDelta delta;
+
+        // Number of units looking at each tile, only valid where visible
+        std::array<uint16_t, Constants::MAP_MAX_SIZE * Constants::MAP_MAX_SIZE> lookers{};
+
+        // Everyone sharing these planes (more than one with shared team vision)
+        std::vector<VisibilityMap*> maps;
+
+        bool isDirty = true;
+    };
+
+    static void spanMask(int first, int last, RowMask *mask) noexcept;
+
+    void updateRow(const int tileY, const RowMask &added, const RowMask &removed);
+    void rowChanged(const int tileY);
+
+    static void sendChanges(Planes &planes, const VisibilityDelta::Plane &oldVisible, const VisibilityDelta::Plane &oldExplored, const int firstRow, const int lastRow, const std::vector<VisibilityMap*> &maps);
+
+    const int m_playerId;
+    std::shared_ptr<Planes> m_planes;
+};
@@ -114,6 +114,43 @@ bool GraphicRender::update(Time time, const bool isVisible) noexcept
     return isVisible && (updated || m_frameChanged);
 }
 
+void GraphicRender::syncToClock(const Time time) noexcept
+{
+    for (GraphicDelta &delta : m_deltas) {
+        delta.graphic->syncToClock(time);
+    }
+    if (m_damageOverlay) {
+        m_damageOverlay->syncToClock(time);
+    }
+
+    if (!m_sprite || !m_sprite->framerate() || m_sprite->runOnce() || m_sprite->frameCount() < 2) {
+        return;
+    }
+
+    const Time frameTime = m_sprite->framerate() / 0.0015;
+    if (frameTime <= 0) {
+        return;
+    }
+    const Time loopTime = frameTime * m_sprite->frameCount() + Time(m_sprite->replayDelay() / 0.0015);
+
+    const Time phase = time % loopTime;
+    m_currentFrame = std::min<Time>(phase / frameTime, m_sprite->frameCount() - 1);
+    m_lastFrameTime = time - (phase - m_currentFrame * frameTime);
+    m_frameChanged = true;
+}
+
+size_t GraphicRender::memoryUsage() const noexcept
+{
+    size_t bytes = sizeof(GraphicRender) + m_deltas.capacity() * sizeof(GraphicDelta);
+    for (const GraphicDelta &delta : m_deltas) {
+        bytes += delta.graphic->memoryUsage();
+    }
+    if (m_damageOverlay) {
+        bytes += m_damageOverlay->memoryUsage();
+    }
+    return bytes;
+}
+
 inline bool GraphicRender::isValid() const noexcept
 {
     return m_sprite && m_sprite->isValid();
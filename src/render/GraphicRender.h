@@ -78,6 +78,12 @@ public:
     virtual ~GraphicRender() = default;
 
     bool update(Time time, const bool isVisible) noexcept;
+
+    /// Jumps to where a looping animation would be at this time if we had been updating it all along
+    void syncToClock(const Time time) noexcept;
+
+    /// Roughly how much memory this uses, including deltas and overlays
+    size_t memoryUsage() const noexcept;
     inline bool isValid() const noexcept;
 
     virtual void render(IRenderTarget &renderTarget, const ScreenPos screenPos, const RenderType renderpass) noexcept;
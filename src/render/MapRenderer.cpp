@@ -134,8 +134,8 @@ void MapRenderer::display()
         return;
     }
 
-    if (!m_textureTarget || m_textureTarget->getSize() != renderTarget_->getSize() || m_visibilityMap->isDirty) {
-        m_visibilityMap->isDirty = false;
+    if (!m_textureTarget || m_textureTarget->getSize() != renderTarget_->getSize() || m_visibilityMap->isDirty()) {
+        m_visibilityMap->flushDirty();
 
         updateTexture();
     }
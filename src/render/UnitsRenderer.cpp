@@ -35,14 +35,12 @@ void UnitsRenderer::begin(const std::shared_ptr<IRenderTarget> &renderTarget)
             missile->isVisible = false;
         }
         for (const StaticEntity::Ptr &entity : unitManager->staticEntities()) {
-            if (!entity->isDoppleganger()) {
-                entity->isVisible = false;
-            }
+            entity->isVisible = false;
         }
     }
 }
 
-void UnitsRenderer::render(const std::shared_ptr<IRenderTarget> &renderTarget, const std::vector<std::shared_ptr<Entity>> &visible)
+void UnitsRenderer::render(const std::shared_ptr<IRenderTarget> &renderTarget, const std::vector<std::shared_ptr<Entity>> &visible, const TileRange &visibleTiles)
 {
     std::shared_ptr<VisibilityMap> visibilityMap = m_visibilityMap.lock();
     std::shared_ptr<UnitManager> unitManager = m_unitManager.lock();
@@ -68,12 +66,13 @@ void UnitsRenderer::render(const std::shared_ptr<IRenderTarget> &renderTarget, c
         if (entity->isUnit()) {
             Unit::Ptr unit = Unit::fromEntity(entity);
 
-            if (unit->garrisonedIn.lock() != nullptr) {
+            if (unit->garrisonedIn()) {
                 continue;
             }
 
             if (visibility == VisibilityMap::Visible) {
                 entity->isVisible = true;
+                unit->wake(); // needs to animate now
                 visibleUnits.push_back(unit);
                 entity->renderer().render(*renderTarget, camera->absoluteScreenPos(entity->position()), RenderType::Shadow);
 
@@ -85,6 +84,7 @@ void UnitsRenderer::render(const std::shared_ptr<IRenderTarget> &renderTarget, c
             }
 
             entity->isVisible = true;
+            unit->wake();
 
             entity->renderer().render(*renderTarget, camera->absoluteScreenPos(entity->position()), RenderType::InTheShadows);
 
@@ -108,24 +108,7 @@ void UnitsRenderer::render(const std::shared_ptr<IRenderTarget> &renderTarget, c
             continue;
         }
 
-        if (entity->isDoppleganger()) {
-            Player::Ptr humanPlayer = unitManager->humanPlayer();
-            REQUIRE(humanPlayer, continue);
-
-            DopplegangerEntity::Ptr doppleganger = DopplegangerEntity::fromEntity(entity);
-
-            // Don't render the unit if it can see the real unit
-            if (humanPlayer->canSeeUnitsFor(doppleganger->ownerID)) {
-                continue;
-            }
-
-            entity->renderer().render(*renderTarget, camera->absoluteScreenPos(entity->position()), RenderType::InTheShadows);
-        }
-
         if (entity->isDecayingEntity()) {
-            if (entity->isDoppleganger()) {
-                DBG << entity->debugName;
-            }
             if (visibility == VisibilityMap::Visible) {
                 entity->renderer().render(*renderTarget, camera->absoluteScreenPos(entity->position()), RenderType::Base);
             } else {
@@ -135,6 +118,8 @@ void UnitsRenderer::render(const std::shared_ptr<IRenderTarget> &renderTarget, c
             entity->isVisible = true;
         }
     }
+    renderGhosts(*renderTarget, *unitManager, visibleTiles);
+
     std::sort(visibleUnits.begin(), visibleUnits.end(), MapPositionSorter());
 
     for (const Unit::Ptr &unit : visibleUnits) {
@@ -284,6 +269,57 @@ void UnitsRenderer::render(const std::shared_ptr<IRenderTarget> &renderTarget, c
     }
 }
 
+void UnitsRenderer::renderGhosts(IRenderTarget &renderTarget, UnitManager &unitManager, const TileRange &visibleTiles)
+{
+    Player::Ptr humanPlayer = unitManager.humanPlayer();
+    REQUIRE(humanPlayer, return);
+
+    const MapPtr &map = unitManager.map();
+    REQUIRE(map, return);
+
+    CameraPtr camera = renderTarget.camera();
+    const GhostIndex &ghosts = unitManager.ghosts();
+
+    for (int col = visibleTiles.firstCol; col < visibleTiles.lastCol; col++) {
+        for (int row = visibleTiles.firstRow; row < visibleTiles.lastRow; row++) {
+            // Only what the human player remembers
+            for (const GhostIndex::Ghost &ghost : ghosts.at(humanPlayer->playerId, col, row)) {
+                // Don't render it if we can see the real unit
+                if (humanPlayer->canSeeUnitsFor(ghost.ownerID)) {
+                    continue;
+                }
+                if (!ghost.isRubble && isDrawnAt(*map, col, row, ghost.originalUnitID)) {
+                    continue;
+                }
+
+                // Only set up something we can draw now that we need it
+                if (!m_ghostRenderer) {
+                    m_ghostRenderer = std::make_unique<GraphicRender>();
+                }
+                m_ghostRenderer->setPlayerColor(ghost.playerColor);
+                if (!m_ghostRenderer->setSprite(ghost.spriteID)) {
+                    continue;
+                }
+                m_ghostRenderer->setAngle(ghost.angle);
+                m_ghostRenderer->setCurrentFrame(ghost.frame);
+                m_ghostRenderer->render(renderTarget, camera->absoluteScreenPos(ghost.position), RenderType::InTheShadows);
+            }
+        }
+    }
+}
+
+bool UnitsRenderer::isDrawnAt(const Map &map, const int col, const int row, const size_t unitID)
+{
+    for (const std::weak_ptr<Entity> &e : map.entitiesAt(col, row)) {
+        Unit::Ptr unit = Unit::fromEntity(e);
+        if (unit && unit->id == unitID) {
+            return unit->isVisible && !unit->isDead();
+        }
+    }
+
+    return false;
+}
+
 void UnitsRenderer::display(const std::shared_ptr<IRenderTarget> &renderTarget)
 {
     std::shared_ptr<UnitManager> unitManager = m_unitManager.lock();
@@ -1,12 +1,14 @@
 #pragma once
 
 #include "core/Types.h"
+#include "GraphicRender.h"
 
 #include <memory>
 #include <vector>
 
 class IRenderTarget;
 struct Entity;
+class Map;
 struct MoveTargetMarker;
 struct Player;
 struct VisibilityMap;
@@ -15,14 +17,26 @@ class UnitManager;
 class UnitsRenderer
 {
 public:
+    /// The tiles on screen, last ones not included
+    struct TileRange {
+        int firstCol = 0;
+        int lastCol = 0;
+        int firstRow = 0;
+        int lastRow = 0;
+    };
+
     void begin(const std::shared_ptr<IRenderTarget> &renderTarget);
-    void render(const std::shared_ptr<IRenderTarget> &renderTarget, const std::vector<std::shared_ptr<Entity> > &visible);
+    void render(const std::shared_ptr<IRenderTarget> &renderTarget, const std::vector<std::shared_ptr<Entity> > &visible, const TileRange &visibleTiles);
     void display(const std::shared_ptr<IRenderTarget> &renderTarget);
 
     void setUnitManager(const std::shared_ptr<UnitManager> &unitManager);
     void setVisibilityMap(const std::weak_ptr<VisibilityMap> &visibilityMap) { m_visibilityMap = visibilityMap; }
 
 private:
+    void renderGhosts(IRenderTarget &renderTarget, UnitManager &unitManager, const TileRange &visibleTiles);
+    static bool isDrawnAt(const Map &map, const int col, const int row, const size_t unitID);
+
+    std::unique_ptr<GraphicRender> m_ghostRenderer; // reused for everything we remember under the fog
     std::weak_ptr<VisibilityMap> m_visibilityMap;
     std::shared_ptr<IRenderTarget> m_outlineOverlay;
     std::weak_ptr<Player> m_player;
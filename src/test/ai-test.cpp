@@ -1,4 +1,6 @@
-#include "ai/ScriptLoader.h"
+#include "ai/CompiledScript.h"
+#include "ai/ScriptBuilder.h"
+#include "ai/AiScript.h"
 
 #include "ai/AiPlayer.h"
 
@@ -10,11 +12,12 @@ int main(int argc, char *argv[]) {
            std::cerr << "pass file" << std::endl;
            return 1;
        }
-       std::ifstream in;
-       in.open(argv[1]);
-       std::cout << in.good() << std::endl;
+       std::shared_ptr<const ai::CompiledScript> compiled = ai::ScriptCache::load(argv[1]);
+       if (!compiled) {
+           return 1;
+       }
+       std::cout << compiled->rules.size() << " rules" << std::endl;
        AiPlayer player(0, 1, {});
-       ai::ScriptLoader parser(&player);
-       return parser.parse(in, std::cout);
+       ai::ScriptBuilder builder(&player);
+       return builder.build(*compiled) ? 0 : 1;
 }
-
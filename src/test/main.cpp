@@ -1,23 +1,63 @@
 #include <genie/script/ScnFile.h>
+#include <genie/script/scn/Trigger.h>
 #include <genie/util/Utility.h>
 #include <genie/util/Logger.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
 #include <memory>
+#include <sstream>
 #include <string>
+#include <unordered_set>
 
+#include "ai/AiPlayer.h"
+#include "ai/AiRule.h"
+#include "ai/AiScript.h"
+#include "ai/AiThread.h"
+#include "ai/BasePlanner.h"
+#include "ai/CompiledScript.h"
+#include "ai/FactTable.h"
+#include "ai/ScriptBuilder.h"
+#include "ai/actions/Actions.h"
+#include "ai/conditions/Conditions.h"
+#include "core/DenseSet.h"
 #include "core/Logger.h"
+#include "core/SignalEmitter.h"
+#include "core/TimerWheel.h"
 #include "global/Config.h"
+#include "global/EventListener.h"
+#include "global/EventManager.h"
+#include "mechanics/BuildabilityMap.h"
 #include "mechanics/Map.h"
 #include "mechanics/MapTile.h"
+#include "mechanics/Player.h"
+#include "mechanics/TriggerConditionIndex.h"
+#include "mechanics/Unit.h"
+#include "mechanics/UnitFactory.h"
+#include "mechanics/UnitManager.h"
 #include "resource/AssetManager.h"
 #include "resource/DataManager.h"
 #include "resource/LanguageManager.h"
 #include "resource/TerrainSprite.h"
 
-void testLoadTiles()
+// So main() can fail if anything is broken
+static int s_failedChecks = 0;
+
+static bool check(const bool ok, const char *condition, const int line)
 {
-    DBG << "Testing map rendering speed";
+    if (!ok) {
+        WARN << "Check failed:" << condition << "at line" << line;
+        s_failedChecks++;
+    }
+    return ok;
+}
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
 
+genie::ScnFilePtr loadTestScenario()
+{
     genie::CpxFile cpxFile;
     std::string campaignPath = genie::util::resolvePathCaseInsensitive(Config::Inst().getValue(Config::GamePath) + "/Campaign/xcam3.cpx");
     if (campaignPath.empty()) {
@@ -25,12 +65,22 @@ void testLoadTiles()
     }
     if (campaignPath.empty()) {
         WARN << "Failed to find campaign file";
-        return;
+        return nullptr;
     }
     cpxFile.setFileName(campaignPath);
     cpxFile.load();
 
-    genie::ScnFilePtr scenarioFile = cpxFile.getScnFile(0);
+    return cpxFile.getScnFile(0);
+}
+
+void testLoadTiles()
+{
+    DBG << "Testing map rendering speed";
+
+    genie::ScnFilePtr scenarioFile = loadTestScenario();
+    if (!scenarioFile) {
+        return;
+    }
 
     Map map;
     map.create(scenarioFile->map);
@@ -65,6 +115,1285 @@ void testLoadTiles()
 
 }
 
+void testSpawnUnits()
+{
+    DBG << "Testing unit spawning speed";
+
+    genie::ScnFilePtr scenarioFile = loadTestScenario();
+    if (!scenarioFile) {
+        return;
+    }
+
+    std::shared_ptr<Map> map = std::make_shared<Map>();
+    map->create(scenarioFile->map);
+
+    std::shared_ptr<UnitManager> unitManager = std::make_shared<UnitManager>();
+    unitManager->setMap(map);
+
+    // Just use whatever the scenario has for the first player
+    const int civId = scenarioFile->playerData.resourcesPlusPlayerInfo[0].civilizationID;
+    Player::Ptr player = std::make_shared<Player>(1, civId, map);
+    unitManager->setPlayers({player});
+
+    std::vector<int> unitIds;
+    for (size_t playerNum = 0; playerNum < scenarioFile->playerUnits.size(); playerNum++) {
+        for (const genie::ScnUnit &scnunit : scenarioFile->playerUnits[playerNum].units) {
+            unitIds.push_back(scnunit.objectID);
+        }
+    }
+    if (!CHECK(!unitIds.empty())) {
+        return;
+    }
+
+    DBG << "Timing spawning 5000 units," << unitIds.size() << "different";
+
+    {
+        TIME_THIS;
+        for (int i=0; i<5000; i++) {
+            Unit::Ptr unit = UnitFactory::createUnit(unitIds[i % unitIds.size()], player, *unitManager);
+            if (!unit) {
+                continue;
+            }
+            const MapPos position((i % map->columnCount()) * Constants::TILE_SIZE, ((i / map->columnCount()) % map->rowCount()) * Constants::TILE_SIZE);
+            unitManager->add(unit, position);
+        }
+    }
+
+    DBG << "Units spawned:" << unitManager->units().size();
+    CHECK(!unitManager->units().isEmpty());
+    unitManager->printMemoryUsage();
+
+    // Spawning applies the research of the units, check that what got available
+    // incrementally is the same as what a full scan of all the techs says
+    const std::unordered_set<int> &activeTechs = player->activeTechs();
+    const auto requirementsMet = [&](const genie::Tech &tech) {
+        bool hasRequirements = false;
+        for (const int reqId : tech.RequiredTechs) {
+            if (reqId == -1) {
+                continue;
+            }
+            if (!activeTechs.count(reqId)) {
+                return false;
+            }
+            hasRequirements = true;
+        }
+        return hasRequirements;
+    };
+
+    int wrongResearch = 0;
+    for (const std::pair<const uint16_t, genie::Tech> &tech : player->civilization.availableTechs()) {
+        const bool expected = requirementsMet(tech.second) && !activeTechs.count(tech.first);
+        if (player->researchAvailable(tech.first) != expected) {
+            WARN << "Research" << tech.first << "available:" << player->researchAvailable(tech.first) << "expected" << expected;
+            wrongResearch++;
+        }
+    }
+    CHECK(wrongResearch == 0);
+
+    // And that the implicit research got applied
+    int missedImplicit = 0;
+    const std::vector<genie::Tech> &techs = DataManager::Inst().allTechs();
+    for (const genie::Tech &tech : techs) {
+        if (tech.ResearchLocation != -1 || tech.EffectID == -1) {
+            continue;
+        }
+        if (tech.Civ != -1 && tech.Civ != civId) {
+            continue;
+        }
+        if (requirementsMet(tech) && !activeTechs.count(tech.EffectID)) {
+            WARN << "Implicit research with effect" << tech.EffectID << "wasn't applied";
+            missedImplicit++;
+        }
+    }
+    CHECK(missedImplicit == 0);
+}
+
+void testUnitSleeping()
+{
+    DBG << "Testing dormant units waking up";
+
+    genie::ScnFilePtr scenarioFile = loadTestScenario();
+    if (!scenarioFile) {
+        return;
+    }
+
+    std::shared_ptr<Map> map = std::make_shared<Map>();
+    map->create(scenarioFile->map);
+
+    std::shared_ptr<UnitManager> unitManager = std::make_shared<UnitManager>();
+    unitManager->setMap(map);
+
+    // Not allied, so they are hostile to each other
+    Player::Ptr sleeperOwner = std::make_shared<Player>(1, 1, map);
+    Player::Ptr intruderOwner = std::make_shared<Player>(2, 1, map);
+    unitManager->setPlayers({sleeperOwner, intruderOwner});
+
+    // 4 is the archer, doesn't do anything on its own
+    Unit::Ptr sleeper = UnitFactory::createUnit(4, sleeperOwner, *unitManager);
+    Unit::Ptr otherSleeper = UnitFactory::createUnit(4, sleeperOwner, *unitManager);
+    Unit::Ptr friendly = UnitFactory::createUnit(4, sleeperOwner, *unitManager);
+    Unit::Ptr intruder = UnitFactory::createUnit(4, intruderOwner, *unitManager);
+    if (!CHECK(sleeper && otherSleeper && friendly && intruder)) {
+        return;
+    }
+
+    // Far enough apart that they can't see each other
+    unitManager->add(sleeper, MapPos(10 * Constants::TILE_SIZE, 10 * Constants::TILE_SIZE));
+    unitManager->add(otherSleeper, MapPos(10 * Constants::TILE_SIZE, 60 * Constants::TILE_SIZE));
+    unitManager->add(friendly, MapPos(60 * Constants::TILE_SIZE, 10 * Constants::TILE_SIZE));
+    unitManager->add(intruder, MapPos(60 * Constants::TILE_SIZE, 60 * Constants::TILE_SIZE));
+
+    unitManager->update(1000);
+    if (!CHECK(sleeper->isDormant() && otherSleeper->isDormant())) {
+        return;
+    }
+
+    // Our own units walking by shouldn't wake it
+    friendly->setPosition(MapPos(12 * Constants::TILE_SIZE, 10 * Constants::TILE_SIZE));
+    CHECK(sleeper->isDormant());
+
+    // Neither should a hostile moving around far away
+    intruder->setPosition(MapPos(62 * Constants::TILE_SIZE, 60 * Constants::TILE_SIZE));
+    CHECK(sleeper->isDormant());
+    CHECK(otherSleeper->isDormant());
+
+    // Walk into the same watcher cell, right next to it
+    intruder->setPosition(MapPos(12 * Constants::TILE_SIZE, 12 * Constants::TILE_SIZE));
+    CHECK(!sleeper->isDormant());
+    CHECK(otherSleeper->isDormant());
+
+    // Getting hurt wakes it up even if it can't see who did it
+    otherSleeper->takeDamage(1);
+    CHECK(!otherSleeper->isDormant());
+}
+
+void testUnitSetMembership()
+{
+    DBG << "Testing unit set membership speed";
+
+    // Doesn't need real units, only something with a handle
+    struct FakeUnit {
+        FakeUnit(uint32_t handle_) : handle(handle_) {}
+        const uint32_t handle;
+    };
+    typedef std::shared_ptr<FakeUnit> FakeUnitPtr;
+
+    const int lookups = 1000000;
+
+    for (const size_t count : {10, 100, 1000}) {
+        std::vector<FakeUnitPtr> units;
+        for (size_t i=0; i<count; i++) {
+            // Space the handles a bit out, like when there's other stuff alive in between
+            units.push_back(std::make_shared<FakeUnit>(i * 7 + 1000));
+        }
+
+        DenseSet<FakeUnitPtr> set(units);
+        std::vector<FakeUnitPtr> vector = units;
+
+        size_t found = 0;
+
+        DBG << lookups << "lookups in dense set with" << count << "units";
+        {
+            TIME_THIS;
+            for (int i=0; i<lookups; i++) {
+                found += set.contains(units[(i * 31) % count]);
+            }
+        }
+
+        DBG << lookups << "lookups in plain vector with" << count << "units";
+        {
+            TIME_THIS;
+            for (int i=0; i<lookups; i++) {
+                const FakeUnitPtr &unit = units[(i * 31) % count];
+                found += std::find(vector.begin(), vector.end(), unit) != vector.end();
+            }
+        }
+
+        DBG << "removing and re-adding" << count << "units";
+        {
+            TIME_THIS;
+            for (const FakeUnitPtr &unit : units) {
+                set.remove(unit);
+            }
+            for (const FakeUnitPtr &unit : units) {
+                set.add(unit);
+            }
+        }
+
+        if (!CHECK(found == lookups * 2 && set.size() == count)) {
+            WARN << "Dense set is broken, found" << found << "size" << set.size();
+        }
+    }
+
+    // When a lot of things are gone the pages for them need to go away
+    IdIndex index;
+    for (uint32_t handle=0; handle<100000; handle++) {
+        index.set(handle, handle);
+        CHECK(index.get(handle) == handle);
+        if (handle >= 10) {
+            index.erase(handle - 10);
+        }
+    }
+    CHECK(index.get(5) == IdIndex::Invalid);
+    CHECK(index.pageCount() == 1);
+}
+
+void testPlacementQueries()
+{
+    DBG << "Testing building placement query speed";
+
+    genie::ScnFilePtr scenarioFile = loadTestScenario();
+    if (!scenarioFile) {
+        return;
+    }
+
+    std::shared_ptr<Map> map = std::make_shared<Map>();
+    map->create(scenarioFile->map);
+    BuildabilityMap &buildability = map->buildability();
+
+    // 70 is the house, small and placed a lot
+    const genie::Unit &house = DataManager::Inst().civilization(1).Units[70];
+    const auto fitsAt = [&](const MapPos &pos) {
+        return buildability.canPlace(house, pos.x / Constants::TILE_SIZE, pos.y / Constants::TILE_SIZE);
+    };
+
+    DBG << "Timing checking every tile one by one";
+    size_t fitting = 0;
+    {
+        TIME_THIS;
+        for (int row = 0; row < map->rowCount(); row++) {
+            for (int col = 0; col < map->columnCount(); col++) {
+                fitting += buildability.canPlace(house, col, row);
+            }
+        }
+    }
+
+    TileRect wholeMap;
+    wholeMap.lastX = map->columnCount() - 1;
+    wholeMap.lastY = map->rowCount() - 1;
+
+    DBG << "Timing finding all placements in one go";
+    std::vector<MapPos> placements;
+    {
+        TIME_THIS;
+        placements = buildability.findPlacements(house, wholeMap);
+    }
+
+    if (!CHECK(placements.size() == fitting)) {
+        WARN << "Placement queries disagree, one by one" << fitting << "batched" << placements.size();
+    }
+    CHECK(std::all_of(placements.begin(), placements.end(), fitsAt));
+    if (!CHECK(!placements.empty())) {
+        return;
+    }
+
+    // Block a single tile under one of them, after eroding all the placements
+    // that would cover it should be gone and nothing else
+    const MapPos blockedPos = placements[placements.size() / 2];
+    TileRect blocked = BuildabilityMap::obstructionTiles(house, blockedPos);
+    blocked.firstX = blocked.lastX;
+    blocked.firstY = blocked.lastY;
+    buildability.addObstruction(blocked);
+    CHECK(buildability.isObstructed(blocked));
+
+    const auto covers = [&](const MapPos &pos) {
+        const TileRect tiles = BuildabilityMap::obstructionTiles(house, pos);
+        return blocked.lastX >= tiles.firstX && blocked.lastX <= tiles.lastX && blocked.lastY >= tiles.firstY && blocked.lastY <= tiles.lastY;
+    };
+
+    size_t wrong = 0;
+    size_t stillFitting = 0;
+    for (const MapPos &pos : placements) {
+        const bool fits = fitsAt(pos);
+        wrong += fits == covers(pos);
+        stillFitting += fits;
+    }
+    CHECK(wrong == 0);
+    CHECK(!fitsAt(blockedPos));
+    CHECK(buildability.findPlacements(house, wholeMap).size() == stillFitting);
+
+    buildability.removeObstruction(blocked);
+    CHECK(!buildability.isObstructed(blocked));
+    CHECK(buildability.findPlacements(house, wholeMap) == placements);
+
+    // A house standing there should keep blocking when the map is recreated,
+    // and take it along when it moves to another map
+    std::shared_ptr<UnitManager> unitManager = std::make_shared<UnitManager>();
+    unitManager->setMap(map);
+    Player::Ptr player = std::make_shared<Player>(1, 1, map);
+    unitManager->setPlayers({player});
+
+    Unit::Ptr blocker = UnitFactory::createUnit(70, player, *unitManager);
+    if (!CHECK(blocker != nullptr)) {
+        return;
+    }
+    unitManager->add(blocker, blockedPos);
+    const TileRect blockerTiles = BuildabilityMap::obstructionTiles(house, blocker->position());
+    CHECK(buildability.isObstructed(blockerTiles));
+
+    map->create(scenarioFile->map);
+    CHECK(buildability.isObstructed(blockerTiles));
+
+    std::shared_ptr<Map> otherMap = std::make_shared<Map>();
+    otherMap->create(scenarioFile->map);
+    blocker->setMap(otherMap);
+    CHECK(!buildability.isObstructed(blockerTiles));
+    CHECK(otherMap->buildability().isObstructed(blockerTiles));
+
+    blocker->setMap(map);
+    CHECK(buildability.isObstructed(blockerTiles));
+    CHECK(!otherMap->buildability().isObstructed(blockerTiles));
+}
+
+void testBasePlanner()
+{
+    DBG << "Testing base planner placement speed";
+
+    genie::ScnFilePtr scenarioFile = loadTestScenario();
+    if (!scenarioFile) {
+        return;
+    }
+
+    std::shared_ptr<Map> map = std::make_shared<Map>();
+    map->create(scenarioFile->map);
+    BuildabilityMap &buildability = map->buildability();
+
+    const genie::Unit &house = DataManager::Inst().civilization(1).Units[70];
+    const genie::Unit &townCenter = DataManager::Inst().civilization(1).Units[109];
+
+    // Where it goes, and with a free tile all around it
+    const auto isGoodPlacement = [&](const MapPos &pos) {
+        if (!buildability.canPlace(house, pos.x / Constants::TILE_SIZE, pos.y / Constants::TILE_SIZE)) {
+            return false;
+        }
+        TileRect surroundings = BuildabilityMap::obstructionTiles(house, pos);
+        surroundings.firstX--;
+        surroundings.firstY--;
+        surroundings.lastX++;
+        surroundings.lastY++;
+        return !buildability.isObstructed(surroundings);
+    };
+
+    // Put the town center in the middle, the houses go around it
+    TileRect middle;
+    middle.firstX = map->columnCount() / 2 - 8;
+    middle.firstY = map->rowCount() / 2 - 8;
+    middle.lastX = middle.firstX + 16;
+    middle.lastY = middle.firstY + 16;
+    const std::vector<MapPos> townCenterSpots = buildability.findPlacements(townCenter, middle);
+    if (!CHECK(!townCenterSpots.empty())) {
+        return;
+    }
+
+    std::shared_ptr<UnitManager> unitManager = std::make_shared<UnitManager>();
+    unitManager->setMap(map);
+    Player::Ptr player = std::make_shared<Player>(1, 1, map);
+    unitManager->setPlayers({player});
+
+    Unit::Ptr townCenterUnit = UnitFactory::createUnit(109, player, *unitManager);
+    if (!CHECK(townCenterUnit != nullptr)) {
+        return;
+    }
+    unitManager->add(townCenterUnit, townCenterSpots.front());
+    const MapPos townCenterTile = townCenterUnit->position() / Constants::TILE_SIZE;
+
+    ai::BasePlanner planner(map, 1);
+    MapPos position;
+
+    DBG << "Timing first placement, scores everything";
+    bool found = false;
+    {
+        TIME_THIS;
+        found = planner.findPlacement(house, ai::BasePlanner::Housing, &position);
+    }
+    if (!CHECK(found)) {
+        return;
+    }
+    if (!CHECK(isGoodPlacement(position))) {
+        WARN << "Planner placed a house where it doesn't fit" << position;
+    }
+
+    // Houses want to be 8 tiles from the town center, and the best cells are
+    // within half a cell of that so the house can't be much further off
+    const MapPos houseTile = position / Constants::TILE_SIZE;
+    const float distance = std::hypot(houseTile.x - townCenterTile.x, houseTile.y - townCenterTile.y);
+    if (!CHECK(std::abs(distance - 8.f) <= ai::BasePlanner::CellSize * 1.5f)) {
+        WARN << "House is" << distance << "tiles from the town center";
+    }
+
+    DBG << "Timing 1000 more placements, nothing changed";
+    size_t moved = 0;
+    {
+        TIME_THIS;
+        for (int i = 0; i < 1000; i++) {
+            MapPos again;
+            planner.findPlacement(house, ai::BasePlanner::Housing, &again);
+            moved += again != position;
+        }
+    }
+    CHECK(moved == 0);
+
+    // Once the house is built there the next one has to go somewhere else
+    Unit::Ptr houseUnit = UnitFactory::createUnit(70, player, *unitManager);
+    if (!CHECK(houseUnit != nullptr)) {
+        return;
+    }
+    unitManager->add(houseUnit, position);
+
+    MapPos nextPosition;
+    if (CHECK(planner.findPlacement(house, ai::BasePlanner::Housing, &nextPosition))) {
+        CHECK(nextPosition != position);
+        CHECK(isGoodPlacement(nextPosition));
+    }
+}
+
+void testTriggerConditionIndex()
+{
+    DBG << "Testing trigger condition index";
+
+    // Something like a big custom map with lots of triggers
+    const int conditionCount = 1000;
+    const int events = 2000;
+
+    std::vector<genie::TriggerCondition> conditions;
+    std::vector<MapRect> areas;
+    UnitConditionIndex unitIndex;
+    AreaConditionIndex areaIndex;
+    for (int i=0; i<conditionCount; i++) {
+        genie::TriggerCondition condition;
+        condition.setObject = -1;
+        condition.object = (i % 3 == 0) ? -1 : i % 50;
+        condition.sourcePlayer = (i % 5 == 0) ? -1 : i % 8;
+
+        const MapRect area((i * 37) % 190, (i * 53) % 190, 10, 10);
+
+        ConditionRef ref;
+        ref.condition = i;
+        unitIndex.add(ref, condition);
+        areaIndex.add(ref, area);
+
+        conditions.push_back(condition);
+        areas.push_back(area);
+    }
+
+    const auto matches = [&](const int conditionIndex, const int unitType, const int playerId) {
+        const genie::TriggerCondition &condition = conditions[conditionIndex];
+        return (condition.object == -1 || condition.object == unitType) && (condition.sourcePlayer == -1 || condition.sourcePlayer == playerId);
+    };
+
+    // The index can hand out candidates that don't match, but it has to hand
+    // out every one that does, and only once
+    int wrongUnitEvents = 0;
+    for (int i=0; i<events; i++) {
+        const int unitType = i % 60;
+        const int playerId = i % 8;
+
+        std::vector<int> expected;
+        for (int conditionIndex = 0; conditionIndex < conditionCount; conditionIndex++) {
+            if (matches(conditionIndex, unitType, playerId)) {
+                expected.push_back(conditionIndex);
+            }
+        }
+
+        std::vector<int> found;
+        unitIndex.forEachCandidate(-1, unitType, playerId, [&](const ConditionRef &ref) {
+            if (matches(ref.condition, unitType, playerId)) {
+                found.push_back(ref.condition);
+            }
+        });
+        std::sort(found.begin(), found.end());
+
+        if (found != expected) {
+            wrongUnitEvents++;
+        }
+    }
+    if (!CHECK(wrongUnitEvents == 0)) {
+        WARN << "Unit condition index is wrong for" << wrongUnitEvents << "of" << events << "events";
+    }
+
+    int wrongMoveEvents = 0;
+    for (int i=0; i<events; i++) {
+        const MapPos tile((i * 7) % 200, (i * 13) % 200);
+
+        std::vector<int> expected;
+        for (size_t areaNum = 0; areaNum < areas.size(); areaNum++) {
+            if (areas[areaNum].contains(tile)) {
+                expected.push_back(areaNum);
+            }
+        }
+
+        std::vector<int> found;
+        areaIndex.forEachCandidate(tile, [&](const ConditionRef &ref, const MapRect &area) {
+            if (area.contains(tile)) {
+                found.push_back(ref.condition);
+            }
+        });
+        std::sort(found.begin(), found.end());
+
+        if (found != expected) {
+            wrongMoveEvents++;
+        }
+    }
+    if (!CHECK(wrongMoveEvents == 0)) {
+        WARN << "Area condition index is wrong for" << wrongMoveEvents << "of" << events << "events";
+    }
+
+    // And nothing left after clearing
+    unitIndex.clear();
+    areaIndex.clear();
+    int leftOver = 0;
+    unitIndex.forEachCandidate(-1, 1, 1, [&](const ConditionRef &) { leftOver++; });
+    areaIndex.forEachCandidate(MapPos(50, 50), [&](const ConditionRef &, const MapRect &) { leftOver++; });
+    CHECK(leftOver == 0);
+}
+
+struct TestEmitter : public SignalEmitter<TestEmitter>
+{
+    enum Signals {
+        Changed,
+        SignalCount
+    };
+
+    void changed() { emit(Changed); }
+};
+
+struct TestReceiver : public SignalReceiver
+{
+    void onChanged() { count++; }
+
+    void onChangedDisconnect() {
+        count++;
+        emitter->disconnect(this);
+    }
+
+    int count = 0;
+    TestEmitter *emitter = nullptr;
+};
+
+struct TestOrderedReceiver : public SignalReceiver
+{
+    void onChanged() {
+        order->push_back(id);
+
+        if (disconnectOther) {
+            emitter->disconnect(TestEmitter::Changed, disconnectOther);
+            disconnectOther = nullptr;
+        }
+        if (connectOther) {
+            emitter->connect(TestEmitter::Changed, connectOther, &TestOrderedReceiver::onChanged);
+            connectOther = nullptr;
+        }
+        if (deleteOther) {
+            deleteOther->reset();
+            deleteOther = nullptr;
+        }
+    }
+
+    int id = 0;
+    std::vector<int> *order = nullptr;
+    TestEmitter *emitter = nullptr;
+    TestOrderedReceiver *disconnectOther = nullptr;
+    TestOrderedReceiver *connectOther = nullptr;
+    std::unique_ptr<TestOrderedReceiver> *deleteOther = nullptr;
+};
+
+void testSignalEmitter()
+{
+    DBG << "Testing signal emitter";
+
+    // Like all the conditions connected to the fact table
+    const int receiverCount = 1000;
+    const int emits = 10000;
+
+    std::vector<TestReceiver> receivers(receiverCount);
+
+    DBG << "Timing connecting" << receiverCount << "receivers, like it was with std::function and std::bind";
+    std::vector<std::function<void()>> functions;
+    {
+        TIME_THIS;
+        for (TestReceiver &receiver : receivers) {
+            functions.push_back(std::bind(&TestReceiver::onChanged, &receiver));
+        }
+    }
+
+    DBG << "Timing connecting" << receiverCount << "receivers";
+    TestEmitter emitter;
+    {
+        TIME_THIS;
+        for (TestReceiver &receiver : receivers) {
+            emitter.connect(TestEmitter::Changed, &receiver, &TestReceiver::onChanged);
+        }
+    }
+
+    DBG << "Timing" << emits << "emits with std::function";
+    {
+        TIME_THIS;
+        for (int i=0; i<emits; i++) {
+            for (const std::function<void()> &function : functions) {
+                function();
+            }
+        }
+    }
+
+    DBG << "Timing" << emits << "emits";
+    {
+        TIME_THIS;
+        for (int i=0; i<emits; i++) {
+            emitter.changed();
+        }
+    }
+
+    // Once for each of the timed loops
+    int wrongCounts = 0;
+    for (const TestReceiver &receiver : receivers) {
+        wrongCounts += receiver.count != emits * 2;
+    }
+    CHECK(wrongCounts == 0);
+
+    // Disconnecting from inside the slot
+    TestEmitter selfDisconnecting;
+    TestReceiver first, second;
+    first.emitter = &selfDisconnecting;
+    selfDisconnecting.connect(TestEmitter::Changed, &first, &TestReceiver::onChangedDisconnect);
+    selfDisconnecting.connect(TestEmitter::Changed, &second, &TestReceiver::onChanged);
+    selfDisconnecting.changed();
+    selfDisconnecting.changed();
+    CHECK(first.count == 1);
+    CHECK(second.count == 2);
+
+    // Deleted receivers shouldn't be called
+    {
+        TestReceiver temporary;
+        selfDisconnecting.connect(TestEmitter::Changed, &temporary, &TestReceiver::onChanged);
+    }
+    selfDisconnecting.changed();
+    CHECK(second.count == 3);
+
+    // In the order they connected, and what the earlier ones do to the later
+    // ones while emitting takes effect right away, except that new ones wait
+    // for the next emit
+    TestEmitter ordered;
+    std::vector<int> order;
+    std::vector<TestOrderedReceiver> orderedReceivers(5);
+    TestOrderedReceiver late;
+    std::unique_ptr<TestOrderedReceiver> deleted = std::make_unique<TestOrderedReceiver>();
+    for (size_t i=0; i<orderedReceivers.size(); i++) {
+        orderedReceivers[i].id = i;
+        orderedReceivers[i].order = &order;
+        orderedReceivers[i].emitter = &ordered;
+        ordered.connect(TestEmitter::Changed, &orderedReceivers[i], &TestOrderedReceiver::onChanged);
+    }
+    late.id = 5;
+    late.order = &order;
+    deleted->id = 6;
+    deleted->order = &order;
+    ordered.connect(TestEmitter::Changed, deleted.get(), &TestOrderedReceiver::onChanged);
+
+    orderedReceivers[1].disconnectOther = &orderedReceivers[3];
+    orderedReceivers[2].connectOther = &late;
+    orderedReceivers[4].deleteOther = &deleted;
+
+    ordered.changed();
+    if (!CHECK(order == std::vector<int>({ 0, 1, 2, 4 }))) {
+        WARN << "Got" << order.size() << "signals";
+    }
+
+    order.clear();
+    ordered.changed();
+    if (!CHECK(order == std::vector<int>({ 0, 1, 2, 4, 5 }))) {
+        WARN << "Got" << order.size() << "signals";
+    }
+}
+
+void testTimerWheel()
+{
+    DBG << "Testing timer wheel";
+
+    // Around where each level wraps, where they get cascaded down to the level
+    // below, and further away than the wheel reaches
+    const std::vector<Time> delays = {
+        1, 63, 64, 65, 127, 128,
+        4095, 4096, 4097, 4160,
+        262143, 262144, 262145, 266304,
+        16777215, 16777216, 16777217, 20000000, 40000000
+    };
+    const Time end = 50000000;
+
+    // Both from the start and from somewhere not lined up with anything, and
+    // both advancing every tick and skipping far ahead
+    for (const Time start : {Time(0), Time(1000003)}) {
+        for (const Time step : {Time(20), Time(100000), end}) {
+            TimerWheel wheel;
+            wheel.advance(start);
+
+            std::vector<Time> firedAt(delays.size(), -1);
+            for (size_t i=0; i<delays.size(); i++) {
+                wheel.arm(start + delays[i], [&, i]() { firedAt[i] = wheel.currentTime(); });
+            }
+
+            int cancelledFired = 0;
+            const TimerWheel::TimerId cancelled = wheel.arm(start + 300000, [&]() { cancelledFired++; });
+            CHECK(wheel.isArmed(cancelled));
+            CHECK(wheel.cancel(cancelled));
+            CHECK(!wheel.cancel(cancelled));
+
+            for (Time time = start; time < start + end; time += step) {
+                wheel.advance(time);
+            }
+            wheel.advance(start + end);
+
+            int wrong = 0;
+            for (size_t i=0; i<delays.size(); i++) {
+                if (firedAt[i] != start + delays[i]) {
+                    WARN << "Timer due at" << start + delays[i] << "fired at" << firedAt[i] << "advancing by" << step;
+                    wrong++;
+                }
+            }
+            CHECK(wrong == 0);
+            CHECK(cancelledFired == 0);
+            CHECK(wheel.size() == 0);
+        }
+    }
+}
+
+// Counts how many times the rule it is in fired
+struct TestCountingAction : public ai::Action
+{
+    TestCountingAction(int *counter) : m_counter(counter) {}
+    void execute(ai::AiRule * /*rule*/) override { (*m_counter)++; }
+    int *m_counter;
+};
+
+void testRuleNetwork()
+{
+    DBG << "Testing AI rule network";
+
+    // Lots of rules checking a handful of things, like real scripts
+    const int ruleCount = 1000;
+    const int goalCount = 10;
+    const int rounds = 100;
+
+    AiPlayer player(1, 1, nullptr);
+    ai::AiScript script(&player);
+
+    int fired = 0;
+    for (int i=0; i<ruleCount; i++) {
+        std::shared_ptr<ai::AiRule> rule = std::make_shared<ai::AiRule>(&script);
+        rule->addAction(std::make_shared<TestCountingAction>(&fired));
+        script.addRule(rule, {
+            std::make_shared<ai::Conditions::Goal>(i % goalCount, ai::RelOp::Equal, 1),
+            std::make_shared<ai::Conditions::Goal>((i + 1) % goalCount, ai::RelOp::Equal, 0),
+        });
+    }
+
+    if (!CHECK(script.ruleNetwork().factCount() == goalCount * 2)) {
+        WARN << "Conditions weren't merged," << script.ruleNetwork().factCount() << "facts for" << ruleCount << "rules";
+    }
+
+    DBG << rounds << "rounds of goal changes with" << ruleCount << "rules";
+    {
+        TIME_THIS;
+        Time time = 0;
+        for (int round = 0; round < rounds; round++) {
+            for (int goal = 0; goal < goalCount; goal++) {
+                script.setGoal(goal, 1);
+                script.update(time++);
+                script.setGoal(goal, 0);
+                script.update(time++);
+            }
+        }
+    }
+
+    // Each rule fires once per round, when its first goal is set and the next isn't
+    if (!CHECK(fired == rounds * ruleCount)) {
+        WARN << "Fired" << fired << "expected" << rounds * ruleCount;
+    }
+}
+
+struct TestFactReceiver : public SignalReceiver
+{
+    void onChanged() { count++; }
+    int count = 0;
+};
+
+void testFactTable()
+{
+    DBG << "Testing AI fact table";
+
+    // Like all the "food-amount > x" rules in scripts
+    const int ruleCount = 1000;
+    const int thresholdCount = 50;
+    const int ticks = 100;
+    const int changesPerTick = 100;
+
+    AiPlayer player(1, 1, nullptr);
+    ai::AiScript script(&player);
+
+    int fired = 0;
+    for (int i=0; i<ruleCount; i++) {
+        std::shared_ptr<ai::AiRule> rule = std::make_shared<ai::AiRule>(&script);
+        rule->addAction(std::make_shared<TestCountingAction>(&fired));
+        const int threshold = (i % thresholdCount) * (ticks * changesPerTick / thresholdCount);
+        script.addRule(rule, {
+            std::make_shared<ai::Conditions::ResourceValue>(script.facts(), genie::ResourceType::FoodStorage, ai::RelOp::LessThan, threshold),
+        });
+    }
+
+    DBG << ticks << "ticks with" << changesPerTick << "resource changes each and" << ruleCount << "rules";
+    {
+        TIME_THIS;
+        for (int tick = 0; tick < ticks; tick++) {
+            for (int i=0; i<changesPerTick; i++) {
+                player.addResource(genie::ResourceType::FoodStorage, 1);
+            }
+            script.update(tick);
+        }
+    }
+
+    // Every threshold gets passed once
+    if (!CHECK(fired == ruleCount)) {
+        WARN << "Fired" << fired << "expected" << ruleCount;
+    }
+
+    ai::FactTable *facts = script.facts();
+    if (!CHECK(facts->resource(genie::ResourceType::FoodStorage) == ticks * changesPerTick)) {
+        WARN << "Published food" << facts->resource(genie::ResourceType::FoodStorage) << "expected" << ticks * changesPerTick;
+    }
+
+    TestFactReceiver receiver;
+    facts->connect(ai::FactTable::ResourcesChanged, &receiver, &TestFactReceiver::onChanged);
+
+    // Nothing visible until it is published, like when the script runs on the AI thread
+    player.addResource(genie::ResourceType::FoodStorage, 50);
+    facts->collect();
+    CHECK(facts->resource(genie::ResourceType::FoodStorage) == ticks * changesPerTick);
+    CHECK(receiver.count == 0);
+
+    facts->publish();
+    CHECK(facts->resource(genie::ResourceType::FoodStorage) == ticks * changesPerTick + 50);
+    CHECK(receiver.count == 1);
+
+    // Nothing new, so nothing gets emitted
+    facts->update();
+    CHECK(receiver.count == 1);
+}
+
+void testAffordabilityCache()
+{
+    DBG << "Testing AI affordability cache";
+
+    const int checks = 100000;
+    const int villagerId = 83;
+
+    AiPlayer player(1, 1, nullptr);
+    const genie::Unit &villager = player.civilization.unitData(villagerId);
+
+    // Plenty of everything else, so only the food decides
+    for (const genie::Unit::ResourceStorage &res : villager.ResourceStorages) {
+        if (res.Type >= 0) {
+            player.setAvailableResource(genie::ResourceType(res.Type), 1000);
+        }
+    }
+    int foodCost = 0;
+    for (const genie::Resource<short, short> &res : villager.Creatable.ResourceCosts) {
+        if (!res.Paid) {
+            continue;
+        }
+        if (genie::ResourceType(res.Type) == genie::ResourceType::FoodStorage) {
+            foodCost += res.Amount;
+        } else {
+            player.setAvailableResource(genie::ResourceType(res.Type), 1000);
+        }
+    }
+    if (!CHECK(foodCost > 0)) {
+        return;
+    }
+
+    player.setAvailableResource(genie::ResourceType::FoodStorage, foodCost);
+    CHECK(player.canAffordUnitWithEscrow(villagerId));
+
+    DBG << checks << "checks without anything changing";
+    int affordable = 0;
+    {
+        TIME_THIS;
+        for (int i=0; i<checks; i++) {
+            affordable += player.canAffordUnitWithEscrow(villagerId);
+        }
+    }
+    CHECK(affordable == checks);
+
+    // Starting from nothing, it can afford it from when the food reaches the cost
+    DBG << checks << "checks with the food changing every time";
+    player.setAvailableResource(genie::ResourceType::FoodStorage, 0);
+    affordable = 0;
+    {
+        TIME_THIS;
+        for (int i=0; i<checks; i++) {
+            player.addResource(genie::ResourceType::FoodStorage, 1);
+            affordable += player.canAffordUnitWithEscrow(villagerId);
+        }
+    }
+    if (!CHECK(affordable == checks - foodCost + 1)) {
+        WARN << "Could afford" << affordable << "times, expected" << checks - foodCost + 1;
+    }
+
+    // Has to notice every way it changes, right at the cost
+    player.setAvailableResource(genie::ResourceType::FoodStorage, foodCost);
+    CHECK(player.canAffordUnitWithEscrow(villagerId));
+    player.removeResource(genie::ResourceType::FoodStorage, 1);
+    CHECK(!player.canAffordUnitWithEscrow(villagerId));
+    player.addResource(genie::ResourceType::FoodStorage, 1);
+    CHECK(player.canAffordUnitWithEscrow(villagerId));
+    player.setAvailableResource(genie::ResourceType::FoodStorage, 0);
+    CHECK(!player.canAffordUnitWithEscrow(villagerId));
+
+    // The escrow counts too
+    player.m_reserves[genie::ResourceType::FoodStorage] = foodCost;
+    player.setAvailableResource(genie::ResourceType::FoodStorage, 0);
+    CHECK(player.canAffordUnitWithEscrow(villagerId));
+    player.m_reserves[genie::ResourceType::FoodStorage] = 0;
+    player.setAvailableResource(genie::ResourceType::FoodStorage, 0);
+    CHECK(!player.canAffordUnitWithEscrow(villagerId));
+}
+
+void testScriptCache()
+{
+    DBG << "Testing AI script cache";
+
+    const int ruleCount = 500;
+    const int playerCount = 8;
+
+    std::string source;
+    for (int i=0; i<ruleCount; i++) {
+        source += "(defrule (goal " + std::to_string(i % 20) + " 1) (food-amount > " + std::to_string(i) + ")\n";
+        source += "    => (set-goal " + std::to_string(i % 20) + " 0) (chat-local-to-self \"rule " + std::to_string(i % 10) + "\"))\n";
+    }
+
+    std::shared_ptr<const ai::CompiledScript> compiled;
+    {
+        TIME_THIS;
+        compiled = ai::ScriptCache::compile(source);
+    }
+    if (!CHECK(compiled != nullptr && compiled->rules.size() == ruleCount)) {
+        return;
+    }
+
+    // Everyone loading the same script gets the same one
+    for (int i=1; i<playerCount; i++) {
+        CHECK(ai::ScriptCache::compile(source) == compiled);
+    }
+
+    std::stringstream file;
+    compiled->write(file);
+    ai::CompiledScript readBack;
+    if (CHECK(readBack.read(file))) {
+        CHECK(readBack.conditions.size() == compiled->conditions.size());
+        CHECK(readBack.actions.size() == compiled->actions.size());
+        CHECK(readBack.strings == compiled->strings);
+    }
+
+    // A broken cache file should just get compiled again, and not make us allocate everything
+    const std::string written = file.str();
+    std::stringstream truncated(written.substr(0, written.size() / 2));
+    std::string corrupt = written;
+    std::fill_n(corrupt.begin() + 2 * sizeof(uint32_t), sizeof(uint32_t), char(0xff)); // the condition count
+    std::stringstream corrupted(corrupt);
+    ai::CompiledScript broken;
+    CHECK(!broken.read(truncated));
+    CHECK(!broken.read(corrupted));
+
+    // Same thing, but through the files on disk
+    const std::string smallSource = "(defrule (food-amount > 100) => (chat-local-to-self \"cache test\"))\n";
+    const std::string cacheFile = ai::ScriptCache::cacheFilePath(ai::ScriptCache::hash(smallSource));
+    if (cacheFile.empty()) {
+        WARN << "No cache directory, can't test the cache files";
+    } else {
+        std::string goodFile;
+        {
+            // Make sure it is there and valid, it might be left from an earlier run
+            std::shared_ptr<const ai::CompiledScript> small = ai::ScriptCache::compile(smallSource);
+            CHECK(small != nullptr && small->rules.size() == 1);
+
+            std::ifstream in(cacheFile, std::ios::binary);
+            std::ostringstream contents;
+            contents << in.rdbuf();
+            goodFile = contents.str();
+        } // Nobody using it anymore, so it has to come from disk again
+
+        std::string stale = goodFile;
+        const uint32_t oldVersion = ai::CompiledScript::FormatVersion + 1;
+        std::memcpy(stale.data() + sizeof(uint32_t), &oldVersion, sizeof(uint32_t));
+
+        std::string scribbled = goodFile;
+        std::fill(scribbled.begin() + 2 * sizeof(uint32_t), scribbled.end(), char(0xff));
+
+        for (const std::string &bad : { stale, scribbled, goodFile.substr(0, goodFile.size() / 2) }) {
+            {
+                std::ofstream out(cacheFile, std::ios::binary | std::ios::trunc);
+                out << bad;
+            }
+
+            std::shared_ptr<const ai::CompiledScript> recompiled = ai::ScriptCache::compile(smallSource);
+            if (!CHECK(recompiled != nullptr && recompiled->rules.size() == 1)) {
+                continue;
+            }
+
+            // And the bad file got replaced with a good one
+            std::ifstream in(cacheFile, std::ios::binary);
+            ai::CompiledScript stored;
+            CHECK(stored.read(in));
+            CHECK(stored.rules.size() == 1);
+        }
+    }
+
+    DBG << "Building" << ruleCount << "rules for" << playerCount << "players";
+    {
+        TIME_THIS;
+        for (int i=0; i<playerCount; i++) {
+            AiPlayer player(i + 1, 1, nullptr);
+            ai::ScriptBuilder builder(&player);
+            CHECK(builder.build(*compiled) != nullptr);
+        }
+    }
+}
+
+// What ended up being done in the game, when and by who
+struct TestAiCommandLog
+{
+    struct Entry {
+        Time time;
+        int player;
+        int rule;
+
+        bool operator==(const Entry &other) const {
+            return time == other.time && player == other.player && rule == other.rule;
+        }
+    };
+
+    Time now = 0;
+    std::vector<Entry> entries;
+};
+
+struct TestLoggingAction : public ai::Action
+{
+    TestLoggingAction(TestAiCommandLog *log, const int player, const int rule) : m_log(log), m_player(player), m_rule(rule) {}
+
+    void execute(ai::AiRule *rule) override {
+        TestAiCommandLog *log = m_log;
+        const int player = m_player, ruleNum = m_rule;
+        rule->m_owner->queueCommand([log, player, ruleNum](AiPlayer * /*player*/) {
+            log->entries.push_back({log->now, player, ruleNum});
+        });
+    }
+
+    TestAiCommandLog *m_log;
+    const int m_player;
+    const int m_rule;
+};
+
+void testAiThread()
+{
+    DBG << "Testing AI thread";
+
+    const int ruleCount = 200;
+    const int thresholdCount = 50;
+    const int ticks = 100;
+    const int changesPerTick = 100;
+
+    enum TestTimers {
+        RepeatingTimer = 1,
+        DisabledTimer = 2,
+    };
+    enum TestRules {
+        RepeatingTimerRule = -1,
+        DisabledTimerRule = -2,
+    };
+
+    for (const int playerCount : { 1, 7 }) {
+        // No threads runs it all on the main thread, that's what the workers have to match
+        std::vector<TestAiCommandLog::Entry> reference;
+
+        for (const int threadCount : { 0, 1, 3 }) {
+            // Like the game, where the wheel is advanced on the main thread
+            std::shared_ptr<TimerWheel> timers = std::make_shared<TimerWheel>();
+            TestAiCommandLog log;
+            std::vector<std::unique_ptr<AiPlayer>> players;
+            ai::AiThread aiThread(threadCount);
+
+            for (int player = 0; player < playerCount; player++) {
+                players.push_back(std::make_unique<AiPlayer>(player + 1, 1, nullptr));
+                std::shared_ptr<ai::AiScript> script = std::make_shared<ai::AiScript>(players.back().get(), timers);
+                for (int i=0; i<ruleCount; i++) {
+                    std::shared_ptr<ai::AiRule> rule = std::make_shared<ai::AiRule>(script.get());
+                    rule->addAction(std::make_shared<TestLoggingAction>(&log, player, i));
+                    const int threshold = (i % thresholdCount) * (ticks * changesPerTick / thresholdCount);
+                    script->addRule(rule, {
+                        std::make_shared<ai::Conditions::ResourceValue>(script->facts(), genie::ResourceType::FoodStorage, ai::RelOp::LessThan, threshold),
+                    });
+                }
+
+                // Starts itself over every time, and makes sure the other one never goes off
+                const Time period = 5 + player;
+                std::shared_ptr<ai::AiRule> repeating = std::make_shared<ai::AiRule>(script.get());
+                repeating->addAction(std::make_shared<ai::Actions::EnableTimer>(RepeatingTimer, period));
+                repeating->addAction(std::make_shared<ai::Actions::DisableTimer>(DisabledTimer));
+                repeating->addAction(std::make_shared<TestLoggingAction>(&log, player, RepeatingTimerRule));
+                script->addRule(repeating, { std::make_shared<ai::Conditions::TimerTriggered>(script.get(), RepeatingTimer) });
+
+                std::shared_ptr<ai::AiRule> disabled = std::make_shared<ai::AiRule>(script.get());
+                disabled->addAction(std::make_shared<TestLoggingAction>(&log, player, DisabledTimerRule));
+                script->addRule(disabled, { std::make_shared<ai::Conditions::TimerTriggered>(script.get(), DisabledTimer) });
+
+                script->addTimer(RepeatingTimer, period);
+                script->addTimer(DisabledTimer, ticks / 2);
+
+                aiThread.addScript(script);
+            }
+
+            // What the main thread spends on the AI, the rest of the tick is the game
+            DBG << playerCount << "AI players," << threadCount << "threads";
+            {
+                TIME_THIS;
+                for (int tick = 0; tick < ticks; tick++) {
+                    for (const std::unique_ptr<AiPlayer> &player : players) {
+                        for (int i=0; i<changesPerTick; i++) {
+                            player->addResource(genie::ResourceType::FoodStorage, 1);
+                        }
+                    }
+                    log.now = tick;
+                    timers->advance(tick);
+                    aiThread.update(tick);
+                }
+            }
+
+            // One more, the last changes are seen a tick later with threads
+            log.now = ticks;
+            timers->advance(ticks);
+            aiThread.update(ticks);
+            aiThread.finish();
+
+            for (int player = 0; player < playerCount; player++) {
+                const int period = 5 + player;
+
+                int repeatingFired = 0, disabledFired = 0;
+                for (const TestAiCommandLog::Entry &entry : log.entries) {
+                    if (entry.player != player) {
+                        continue;
+                    }
+                    repeatingFired += entry.rule == RepeatingTimerRule;
+                    disabledFired += entry.rule == DisabledTimerRule;
+                }
+
+                // It's set again from when the script saw it fire, not when the wheel got told
+                if (!CHECK(repeatingFired == ticks / period)) {
+                    WARN << "Player" << player << "timer fired" << repeatingFired << "times, expected" << ticks / period;
+                }
+                CHECK(disabledFired == 0);
+            }
+
+            if (threadCount == 0) {
+                reference = log.entries;
+                CHECK(!reference.empty());
+            } else if (!CHECK(log.entries == reference)) {
+                WARN << playerCount << "players with" << threadCount << "threads did" << log.entries.size() << "things, expected" << reference.size();
+            }
+        }
+    }
+}
+
+struct TestMoveListener : public EventListener
+{
+    TestMoveListener() { EventManager::registerListener(this, EventManager::UnitMoved); }
+
+    void onUnitMoved(Unit * /*unit*/, const MapPos &/*oldTile*/, const MapPos &/*newTile*/) override {
+        count++;
+        if (deregisterOther) {
+            EventManager::deregisterListener(deregisterOther, EventManager::UnitMoved);
+            deregisterOther = nullptr;
+        }
+        if (registerOther) {
+            EventManager::registerListener(registerOther, EventManager::UnitMoved);
+            registerOther = nullptr;
+        }
+        if (stopAfter > 0 && count >= stopAfter) {
+            EventManager::deregisterListener(this, EventManager::UnitMoved);
+            if (deleteWhenStopped) {
+                delete this;
+            }
+        }
+    }
+
+    int count = 0;
+    int stopAfter = 0;
+    bool deleteWhenStopped = false;
+    EventListener *deregisterOther = nullptr;
+    EventListener *registerOther = nullptr;
+};
+
+void testEventDispatch()
+{
+    DBG << "Testing event dispatch";
+
+    // The players, the scenario controller and whatever else is watching
+    const int listenerCount = 9;
+    const int ticks = 500;
+    const int movesPerTick = 2000;
+
+    // Never dereferenced, the listeners just count
+    std::vector<char> fakeUnits(movesPerTick);
+
+    {
+        std::vector<std::unique_ptr<TestMoveListener>> listeners;
+        for (int i=0; i<listenerCount; i++) {
+            listeners.push_back(std::make_unique<TestMoveListener>());
+        }
+
+        DBG << "Timing" << ticks * movesPerTick << "unit moves to" << listenerCount << "listeners";
+        {
+            TIME_THIS;
+            for (int tick = 0; tick < ticks; tick++) {
+                for (int i=0; i<movesPerTick; i++) {
+                    EventManager::unitMoved(reinterpret_cast<Unit*>(&fakeUnits[i]), MapPos(i, tick), MapPos(i + 1, tick));
+                }
+            }
+        }
+
+        int wrongCounts = 0;
+        for (const std::unique_ptr<TestMoveListener> &listener : listeners) {
+            wrongCounts += listener->count != ticks * movesPerTick;
+        }
+        CHECK(wrongCounts == 0);
+    }
+
+    // Deregistering from inside the callback, it gets nothing after that and the others get everything
+    TestMoveListener quitter, stayer;
+    quitter.stopAfter = 2;
+
+    // Deleting itself, nothing should touch it after that
+    TestMoveListener *deleted = new TestMoveListener;
+    deleted->stopAfter = 1;
+    deleted->deleteWhenStopped = true;
+
+    // Taken out by an earlier one in the middle of a move, so doesn't even get that one
+    TestMoveListener remover, removed, added;
+    remover.deregisterOther = &removed;
+    remover.registerOther = &added;
+    EventManager::deregisterListener(&added);
+
+    const int moves = 10;
+    for (int i=0; i<moves; i++) {
+        EventManager::unitMoved(reinterpret_cast<Unit*>(&fakeUnits[i]), MapPos(i, 0), MapPos(i + 1, 0));
+    }
+
+    CHECK(quitter.count == 2);
+    CHECK(stayer.count == moves);
+    CHECK(remover.count == moves);
+    CHECK(removed.count == 0);
+
+    // Registered in the middle of the first one, so gets the rest
+    CHECK(added.count == moves - 1);
+}
+
 int main(int argc, char *argv[]) try
 {
     if (argc < 2)  {
@@ -106,6 +1435,25 @@ int main(int argc, char *argv[]) try
     DBG << "Successfully loaded data files";
 
     testLoadTiles();
+    testSpawnUnits();
+    testUnitSleeping();
+    testUnitSetMembership();
+    testPlacementQueries();
+    testBasePlanner();
+    testTriggerConditionIndex();
+    testSignalEmitter();
+    testTimerWheel();
+    testRuleNetwork();
+    testFactTable();
+    testAffordabilityCache();
+    testScriptCache();
+    testAiThread();
+    testEventDispatch();
+
+    if (s_failedChecks > 0) {
+        WARN << s_failedChecks << "checks failed";
+        return 1;
+    }
 
     return 0;
 } catch(const std::exception &e) {
@@ -30,8 +30,7 @@ Minimap::Minimap(const IRenderTargetPtr &renderTarget) :
     m_renderTarget(renderTarget)
 {
     updateRect(renderTarget->getSize());
-    EventManager::registerListener(this, EventManager::TileDiscovered);
-    EventManager::registerListener(this, EventManager::TileHidden);
+    EventManager::registerListener(this, EventManager::VisibilityChanged);
 }
 
 bool Minimap::updateRect(const Size &size)
@@ -56,14 +55,7 @@ bool Minimap::updateRect(const Size &size)
     return true;
 }
 
-void Minimap::onTileDiscovered(const int playerID, const int /*tileX*/, const int /*tileY*/)
-{
-    if (playerID == m_unitManager->humanPlayerID()) {
-        m_terrainUpdated = true;
-    }
-}
-
-void Minimap::onTileHidden(const int playerID, const int /*tileX*/, const int /*tileY*/)
+void Minimap::onVisibilityChanged(const int playerID, const VisibilityDelta & /*delta*/)
 {
     if (playerID == m_unitManager->humanPlayerID()) {
         m_terrainUpdated = true;
@@ -45,8 +45,7 @@ private:
     void updateCamera();
     bool updateRect(const Size &windowSize);
 
-    void onTileDiscovered(const int playerID, const int tileX, const int tileY) override;
-    void onTileHidden(const int playerID, const int tileX, const int tileY) override;
+    void onVisibilityChanged(const int playerID, const VisibilityDelta &delta) override;
 
     Drawable::Color unitColor(const std::shared_ptr<Unit> &unit);
 
@@ -212,8 +212,8 @@ bool UnitInfoPanel::update(Time /*time*/)
         return false;
     }
 
-    if (unitManager->selected().units != m_selectedUnits) {
-        m_selectedUnits = unitManager->selected().units;
+    if (unitManager->selected().items() != m_selectedUnits) {
+        m_selectedUnits = unitManager->selected().items();
 
         m_dirty = true;
     }
@@ -253,11 +253,11 @@ void UnitInfoPanel::drawSingleUnit()
         return;
     }
 
-    REQUIRE(unit->data(), WARN << "Unit" << unit->debugName << "missing data"; return);
+    REQUIRE(unit->data(), WARN << "Unit" << unit->debugName() << "missing data"; return);
     REQUIRE(m_name, return);
 
     if (!unit->data()) {
-        WARN << "Unit" << unit->debugName << "missing data";
+        WARN << "Unit" << unit->debugName() << "missing data";
         return;
     }
 
@@ -458,14 +458,14 @@ void UnitInfoPanel::drawSingleUnit()
     for (const std::weak_ptr<Unit> &garrisonedWeak : building->garrisonedUnits) {
         Unit::Ptr garrisonedUnit = garrisonedWeak.lock();
         if (!garrisonedUnit) {
-            WARN << "Expired unit garrisoned in" << building->debugName;
+            WARN << "Expired unit garrisoned in" << building->debugName();
             continue;
         }
         garrisoned.add(garrisonedUnit);
     }
 
     if (!garrisoned.isEmpty()) {
-        updateUnitsList(garrisoned.units, ScreenPos(100, 2)); // a bit arbitrary
+        updateUnitsList(garrisoned.items(), ScreenPos(100, 2)); // a bit arbitrary
         drawUnitsList();
     }
 }